@@ -0,0 +1,264 @@
+/**
+ * @file block_layout.cpp
+ *
+ * @brief This file contains the definitions of the block layout: the chains of likely successors, and the placement and rotation
+ * of the loops.
+ *
+ * The layout grows a chain from the entry block, following from each placed block its likeliest successor that is not placed
+ * yet. When the chain reaches the header of a loop, the whole loop is laid out first, the same way, within the loop: the header
+ * (unless the loop is rotated), then the chains of its other blocks, then its latch and, for a rotated loop, its header. The chain
+ * goes on from the last block of the loop. When a chain has nowhere to go, a new one starts from the first block left in reverse
+ * postorder. With block counts, the blocks that never ran are neither followed nor started from, and go last with the unreachable
+ * blocks.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "block_layout.h"
+#include "dataflow.h"
+#include "dominator_tree.h"
+#include "natural_loops.h"
+
+// The whole function, as the scope of a chain, which is otherwise the index of a loop
+static const int FUNCTION_SCOPE = -1;
+
+typedef struct
+{
+    const ControlFlowGraph *cfg;
+    const NaturalLoops *loops;
+    std::vector<int> innermostLoops;     // <block, the index of the innermost loop it is in, or FUNCTION_SCOPE>
+    std::vector<int> parentLoops;        // <loop, the index of the loop it is nested in, or FUNCTION_SCOPE>
+    std::vector<bool> placed;            // <block, whether it is placed>
+    std::vector<bool> deferred;          // <block, whether it waits for the other blocks of its loop: a latch, or a rotated header>
+    const std::vector<uint64_t> *counts; // <block, the number of times it ran in the profile>, or NULL
+    std::vector<bool> cold;              // <block, whether it never ran in the profile>
+    std::vector<unsigned> order;         // the blocks placed, in order
+} LayoutState;
+
+/**
+ * @return true if a block is in a scope: the whole function, or a loop.
+ */
+static bool
+inScope(const LayoutState &state, unsigned block, int scope)
+{
+    return scope == FUNCTION_SCOPE || state.loops->contains(scope, block);
+}
+
+/**
+ * @return The loop directly nested in a scope that a block is in, or the scope itself if the block is in no such loop.
+ */
+static int
+getNestedLoop(const LayoutState &state, unsigned block, int scope)
+{
+    int loop = state.innermostLoops[block];
+    if (loop == scope)
+    {
+        return scope;
+    }
+    while (state.parentLoops[loop] != scope)
+    {
+        loop = state.parentLoops[loop];
+    }
+    return loop;
+}
+
+/**
+ * @return true if a block of a scope can start or continue a chain: it is not placed, it does not wait for its loop, and it ran.
+ */
+static bool
+canPlace(const LayoutState &state, unsigned block, int scope)
+{
+    return !state.placed[block] && !state.deferred[block] && !state.cold[block] && inScope(state, block, scope);
+}
+
+/**
+ * @return The successor of a block that is likeliest to run after it, among those of a scope that can be placed next, or
+ * DominatorTree::NO_BLOCK if there is none. A successor that ran more often in the profile is likelier, then one in a deeper
+ * loop, and otherwise the first one.
+ */
+static unsigned
+pickSuccessor(const LayoutState &state, unsigned block, int scope)
+{
+    unsigned best = DominatorTree::NO_BLOCK;
+    for (unsigned successor : state.cfg->successors(block))
+    {
+        if (!canPlace(state, successor, scope))
+        {
+            continue;
+        }
+        if (best == DominatorTree::NO_BLOCK)
+        {
+            best = successor;
+        }
+        else if (state.counts && (*state.counts)[successor] != (*state.counts)[best])
+        {
+            best = (*state.counts)[successor] > (*state.counts)[best] ? successor : best;
+        }
+        else if (state.loops->depth(successor) > state.loops->depth(best))
+        {
+            best = successor;
+        }
+    }
+    return best;
+}
+
+static void layoutLoop(LayoutState &state, int loop);
+
+/**
+ * Places the blocks of a scope that are not placed yet in chains, the first from a given block, laying out the loops nested in
+ * the scope as they are reached.
+ *
+ * @param state The layout.
+ * @param scope The scope: the whole function, or a loop.
+ * @param start The block to start the first chain from, or DominatorTree::NO_BLOCK.
+ */
+static void
+layoutChains(LayoutState &state, int scope, unsigned start)
+{
+    const std::vector<unsigned> &rpo = state.cfg->reversePostorder();
+    size_t next = 0;
+    unsigned block = start;
+    while (true)
+    {
+        while (block != DominatorTree::NO_BLOCK)
+        {
+            int nested = getNestedLoop(state, block, scope);
+            if (nested != scope)
+            {
+                layoutLoop(state, nested);
+            }
+            else
+            {
+                state.placed[block] = true;
+                state.order.push_back(block);
+            }
+            block = pickSuccessor(state, state.order.back(), scope);
+        }
+
+        // Start a new chain from the first block of the scope left, in reverse postorder
+        while (next < state.cfg->numReachable() && !canPlace(state, rpo[next], scope))
+        {
+            next++;
+        }
+        if (next == state.cfg->numReachable())
+        {
+            return;
+        }
+        block = rpo[next];
+    }
+}
+
+/**
+ * Places the blocks of a loop: its header unless the loop is rotated, then the chains of its other blocks, then its latch, and
+ * the header of a rotated loop. A loop is rotated if its header branches to one block in the loop and one out of it, and it has
+ * one latch, in no loop nested in it.
+ *
+ * @param state The layout.
+ * @param loop The index of the loop.
+ */
+static void
+layoutLoop(LayoutState &state, int loop)
+{
+    const NaturalLoop &naturalLoop = state.loops->loops()[loop];
+    unsigned header = naturalLoop.header;
+
+    unsigned latch = DominatorTree::NO_BLOCK;
+    if (naturalLoop.latches.size() == 1 && naturalLoop.latches[0] != header &&
+        state.innermostLoops[naturalLoop.latches[0]] == loop)
+    {
+        latch = naturalLoop.latches[0];
+    }
+
+    unsigned bodyStart = DominatorTree::NO_BLOCK;
+    const std::vector<unsigned> &successors = state.cfg->successors(header);
+    if (latch != DominatorTree::NO_BLOCK && successors.size() == 2 &&
+        state.loops->contains(loop, successors[0]) != state.loops->contains(loop, successors[1]))
+    {
+        bodyStart = state.loops->contains(loop, successors[0]) ? successors[0] : successors[1];
+    }
+
+    if (latch != DominatorTree::NO_BLOCK)
+    {
+        state.deferred[latch] = true;
+    }
+    if (bodyStart != DominatorTree::NO_BLOCK)
+    {
+        state.deferred[header] = true;
+        layoutChains(state, loop, bodyStart == latch ? DominatorTree::NO_BLOCK : bodyStart);
+    }
+    else
+    {
+        layoutChains(state, loop, header);
+    }
+
+    for (unsigned block : {latch, bodyStart != DominatorTree::NO_BLOCK ? header : DominatorTree::NO_BLOCK})
+    {
+        if (block != DominatorTree::NO_BLOCK)
+        {
+            state.deferred[block] = false;
+            state.placed[block] = true;
+            state.order.push_back(block);
+        }
+    }
+}
+
+std::vector<LLVMBasicBlockRef> computeBlockLayout(LLVMValueRef function, const std::vector<uint64_t> *blockCounts)
+{
+    ControlFlowGraph cfg(function);
+    DominatorTree dominators(cfg);
+    NaturalLoops loops(cfg, dominators);
+
+    LayoutState state;
+    state.cfg = &cfg;
+    state.loops = &loops;
+    state.placed.assign(cfg.size(), false);
+    state.deferred.assign(cfg.size(), false);
+
+    // The counts of a function that never ran say nothing of its blocks; the entry block is always placed first
+    state.counts = blockCounts && cfg.size() > 0 && blockCounts->size() == cfg.size() && (*blockCounts)[0] > 0 ? blockCounts : NULL;
+    state.cold.assign(cfg.size(), false);
+    for (unsigned block = 1; state.counts && block < cfg.size(); block++)
+    {
+        state.cold[block] = (*state.counts)[block] == 0;
+    }
+
+    // A block in no loop, and a loop nested in no other, are in the scope of the whole function
+    const std::vector<NaturalLoop> &loopList = loops.loops();
+    state.innermostLoops.assign(cfg.size(), FUNCTION_SCOPE);
+    state.parentLoops.assign(loopList.size(), FUNCTION_SCOPE);
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        if (loops.innermostLoop(block) != NaturalLoops::NO_LOOP)
+        {
+            state.innermostLoops[block] = loops.innermostLoop(block);
+        }
+    }
+    for (unsigned loop = 0; loop < loopList.size(); loop++)
+    {
+        if (loopList[loop].parent != NaturalLoops::NO_LOOP)
+        {
+            state.parentLoops[loop] = loopList[loop].parent;
+        }
+    }
+
+    if (cfg.size() > 0)
+    {
+        layoutChains(state, FUNCTION_SCOPE, 0);
+    }
+
+    // The unreachable blocks and the blocks that never ran go last, in the order of the function
+    std::vector<LLVMBasicBlockRef> layout;
+    for (unsigned block : state.order)
+    {
+        layout.push_back(cfg.block(block));
+    }
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        if (!state.placed[block])
+        {
+            layout.push_back(cfg.block(block));
+        }
+    }
+    return layout;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file block_layout.h
+ *
+ * @brief The order in which the code generator places the basic blocks of a function.
+ *
+ * The code generator ends every basic block with a jump, and the peephole optimizer removes the jumps to the block placed right
+ * after it (see peephole.h). The layout chains the blocks so that each block is followed by its likelier successor: the one in
+ * the deeper loop, which a loop is expected to take on every iteration but the last, and otherwise the first successor of its
+ * branch (the true side). Each loop is placed as one contiguous run of blocks, with the blocks that jump back to its header last.
+ * A loop whose header tests whether to leave it, such as a `while` statement, is rotated: its header, with the test, goes after
+ * the body, so the body falls through into the test, and the test jumps back to the top of the body or falls through to the code
+ * after the loop. Each iteration then takes one conditional branch, at the bottom, instead of a branch at the top and a jump
+ * back. The entry block stays first.
+ *
+ * With the block counts of a profile (see block_profile.h), the likelier successor is the one that ran more often, and the blocks
+ * that never ran are taken out of the chains and placed last, so that the code that runs is packed together.
+ *
+ * Usage:
+ *     std::vector<LLVMBasicBlockRef> layout = computeBlockLayout(function);
+ *     for (LLVMBasicBlockRef basicBlock : layout) ...
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef BLOCK_LAYOUT_H
+#define BLOCK_LAYOUT_H
+
+#include <llvm-c/Core.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Computes the order in which to place the basic blocks of a function.
+ *
+ * @param function The LLVM function, which has a body.
+ * @param blockCounts The number of times each basic block ran in the profile, in the order of the function, or NULL to lay out
+ *                    the blocks by the loops alone.
+ * @return Every basic block of the function, the entry block first, in the order to place them.
+ */
+std::vector<LLVMBasicBlockRef> computeBlockLayout(LLVMValueRef function, const std::vector<uint64_t> *blockCounts = NULL);
+
+#endif // BLOCK_LAYOUT_H
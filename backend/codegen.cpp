@@ -3,12 +3,16 @@
  * @brief A program that generates x86 assembly code from LLVM IR.
  *
  * This program takes an LLVM IR file as input, generates x86 assembly code from the IR, and writes the assembly code to a file.
+ * The code is 32-bit x86 by default, or x86-64 with the System V calling convention (the argument in `%edi`, the result in
+ * `%eax`): the values of MiniC are 32 bits on both, so the instructions that compute them are the same, and only the frames,
+ * the calls and the addresses differ.
  * The program uses the LLVM C API to parse the IR file, generate assembly code, and perform register allocation. The generated
  * assembly code is compatible with the GNU assembler and can be assembled and linked into an executable file.
  *
  * The program consists of several functions that are responsible for different parts of the code generation process. The main
- * function reads the input file, creates an LLVM module from the IR, and calls the `generateAssemblyCode` function to generate
- * assembly code for the module. The `generateAssemblyCode` function iterates through all functions in the module, allocates
+ * function (in codegen_main.cpp) reads the input file, creates an LLVM module from the IR, and calls the `generateAssemblyCode`
+ * function to generate assembly code for the module; the minicc driver calls it on its in-memory module instead. The
+ * `generateAssemblyCode` function iterates through all functions in the module, allocates
  * registers for each function, and calls the `generateAssemblyForFunction` function to generate assembly code for the function.
  * The `generateAssemblyForFunction` function generates assembly code for the basic blocks in the function, and calls the
  * `generateAssemblyForInstructions` function to generate assembly code for the instructions in each basic block.
@@ -18,10 +22,11 @@
  *
  * Usage:
  *   ./codegen <input_file>
- *   <input_file>  - The LLVM IR file to generate assembly code from.
+ *   <input_file>  - The LLVM IR file (or `.bc` bitcode file) to generate assembly code from.
  *
  * Output: The program writes the generated assembly code to a file with the same name as the input file but with a .s extension.
- *          If the input file is named `input.ll`, the program writes the assembly code to a file named `input.s`.
+ *          If the input file is named `input.ll`, the program writes the assembly code to a file named `input.s`. With
+ *          `-filetype=obj`, it writes the relocatable object `input.o` instead.
  *
  * Assumption:
  *  - The input LLVM IR file contains at most one function.
@@ -33,31 +38,72 @@
  */
 
 #include "codegen.h"
+#include "block_layout.h"
+#include "elf_object.h"
+#include "peephole.h"
+#include "thread_pool.h"
+#include "time_report.h"
 
 /**
  * @brief Create a label for a basic block.
  * @param basicBlock Reference to LLVM basic block.
- * @param bbLabelMap Map of basic block labels.
+ * @param firstLabel The number of the first label of the function, so that labels are unique in the file.
+ * @param bbLabelMap Map of basic block labels of the function.
  */
 static void
-createBBLabel(LLVMBasicBlockRef &basicBlock, BasicBlockLabelMap &bbLabelMap)
+createBBLabel(LLVMBasicBlockRef &basicBlock, int firstLabel, BasicBlockLabelMap &bbLabelMap)
 {
     // Create label for basic block and store in bbLabelMap
-    bbLabelMap[LLVMBasicBlockAsValue(basicBlock)] = ".L" + std::to_string(bbLabelMap.size());
+    bbLabelMap[LLVMBasicBlockAsValue(basicBlock)] = ".L" + std::to_string(firstLabel + bbLabelMap.size());
+}
+
+bool parseOutputFormatOption(const char *option, OutputFormat &format, bool &valid)
+{
+    const char *prefix = "-filetype=";
+    if (strncmp(option, prefix, strlen(prefix)))
+    {
+        return false;
+    }
+    const char *name = option + strlen(prefix);
+    if (!strcmp(name, getOutputFormatName(ASSEMBLY_OUTPUT)))
+    {
+        format = ASSEMBLY_OUTPUT;
+    }
+    else if (!strcmp(name, getOutputFormatName(OBJECT_OUTPUT)))
+    {
+        format = OBJECT_OUTPUT;
+    }
+    else
+    {
+        cerr << "Unknown output format '" << name << "'" << endl;
+        valid = false;
+    }
+    return true;
+}
+
+const char *getOutputFormatName(OutputFormat format)
+{
+    return format == OBJECT_OUTPUT ? "obj" : "asm";
+}
+
+const char *getOutputExtension(OutputFormat format)
+{
+    return format == OBJECT_OUTPUT ? ".o" : ".s";
 }
 
 /**
  * @brief Open an output file with a new extension.
  * @param filename Input file name.
+ * @param format The format of the output, which gives the extension.
  * @return Opened output file stream.
  */
 std::ofstream
-openOutputFile(const char *filename)
+openOutputFile(const char *filename, OutputFormat format)
 {
-    // Save the output to a file with the same name as the input file but with a .s extension
+    // Save the output to a file with the same name as the input file but with a .s (or .o) extension
     std::string outName;
-    changeFileExtension(filename, outName, ".s");
-    std::ofstream outputFile(outName);
+    changeFileExtension(filename, outName, getOutputExtension(format));
+    std::ofstream outputFile(outName, std::ios::binary);
 
     // Check if output file was opened successfully
     if (!outputFile.is_open())
@@ -70,65 +116,230 @@ openOutputFile(const char *filename)
 }
 
 /**
- * @brief Print top-level assembly directives to output stream.
- * @param out Output stream.
+ * @brief Print top-level assembly directives to the assembly of the module.
+ * @param text The assembly of the module.
  * @param filename Source filename.
  */
 static void
-printTopLevelDirective(std::ostream &out, const std::string &filename)
+printTopLevelDirective(std::string &text, const std::string &filename)
 {
     // Output the .file directive along with the name of the source file
-    out << "\t.file "
-        << "\"" << filename << "\"" << std::endl;
-    out << "\t.text" << std::endl; // Output the .text directive
+    text += "\t.file \"" + filename + "\"\n";
+    text += "\t.text\n"; // Output the .text directive
+}
+
+/**
+ * @brief Get the size of a pointer, and of the registers pushed on the stack, on a target.
+ * @param target The target.
+ * @return 4 on x86, 8 on x86-64.
+ */
+static int
+getPointerSize(Target target)
+{
+    return target == X86_64_TARGET ? 8 : 4;
+}
+
+/**
+ * @brief Get the operand of a register in an address, or pushed on the stack: the register itself on x86, and the 64-bit
+ * register that holds it on x86-64.
+ * @param context The code generation context.
+ * @param reg The register.
+ * @return The operand of the register.
+ */
+static MachineOperand
+getAddressRegister(CodeGenContext &context, Register reg)
+{
+    return registerOperand(reg, getPointerSize(context.target));
+}
+
+/**
+ * @brief Get the operand of a stack slot.
+ * @param context The code generation context.
+ * @param offset The offset of the slot from the base pointer.
+ * @return The slot, as `-8(%ebp)` (`-8(%rbp)` on x86-64).
+ */
+static MachineOperand
+getStackSlot(CodeGenContext &context, int offset)
+{
+    return memoryOperand(EBP, offset, getPointerSize(context.target));
+}
+
+/**
+ * @brief Append a machine instruction to the function of a code generation context.
+ * @param context The code generation context.
+ * @param opcode The opcode of the instruction.
+ * @param operands The operands of the instruction, the sources first.
+ */
+static void
+emit(CodeGenContext &context, MachineOpcode opcode, std::vector<MachineOperand> operands = {})
+{
+    context.machineFunction.instructions.push_back({opcode, std::move(operands)});
 }
 
 /**
- * @brief Print function-specific assembly directives to output stream.
+ * @brief Get the label of the block counters of a function in an instrumented module.
+ * @param funCounter The index of the function in the module.
+ * @return The label, `.LPC<n>`.
+ */
+static std::string
+getCounterLabel(int funCounter)
+{
+    return ".LPC" + std::to_string(funCounter);
+}
+
+/**
+ * @brief Emit the increment of the 64-bit counter of a basic block, at its entry. The flags are never live into a basic block, so
+ * the add can set them. On x86 the counter is added to in two halves, the carry of the low half going into the high half.
+ * @param context The code generation context.
+ * @param blockIndex The index of the basic block in the function, which is the index of its counter.
+ */
+static void
+emitBlockCounter(CodeGenContext &context, int blockIndex)
+{
+    if (context.target == X86_64_TARGET)
+    {
+        emit(context, ADDQ, {immediateOperand(1), symbolMemoryOperand(context.counterLabel, 8 * blockIndex, 8)});
+    }
+    else
+    {
+        emit(context, ADDL, {immediateOperand(1), symbolMemoryOperand(context.counterLabel, 8 * blockIndex, 4)});
+        emit(context, ADCL, {immediateOperand(0), symbolMemoryOperand(context.counterLabel, 8 * blockIndex + 4, 4)});
+    }
+}
+
+/**
+ * @brief Print the data of an instrumented module (-fprofile-generate): the block counters of each function, its name, and its
+ * descriptor in the `minicc_prof` section. The linker gathers the descriptors of every object between the `__start_minicc_prof`
+ * and `__stop_minicc_prof` symbols, where the profile runtime (profile_runtime.c) finds them to write the counters to the
+ * profile when the program exits. A descriptor holds the address of the name, the checksum of the control-flow graph, the number
+ * of basic blocks, the number of the first label and the address of the counters.
+ * @param text The assembly of the module.
+ * @param target The target.
+ * @param functions The functions of the module.
+ * @param firstLabels The number of the first basic block label of each function.
+ * @param checksums The checksum of the control-flow graph of each function.
+ */
+static void
+printProfileData(std::string &text, Target target, const std::vector<LLVMValueRef> &functions, const std::vector<int> &firstLabels,
+                 const std::vector<uint32_t> &checksums)
+{
+    std::string counters = "\t.bss\n\t.align 8\n";
+    std::string names = "\t.section .rodata\n";
+    std::string descriptors = "\t.section minicc_prof,\"aw\",@progbits\n";
+    descriptors += target == X86_64_TARGET ? "\t.align 8\n" : "\t.align 4\n";
+    for (size_t i = 0; i < functions.size(); i++)
+    {
+        unsigned numBlocks = LLVMCountBasicBlocks(functions[i]);
+        if (numBlocks == 0)
+        {
+            continue;
+        }
+        std::string counterLabel = getCounterLabel(i);
+        std::string nameLabel = ".LPN" + std::to_string(i);
+        counters += counterLabel + ":\n\t.zero " + std::to_string(8 * numBlocks) + "\n";
+        names += nameLabel + ":\n\t.string \"" + LLVMGetValueName(functions[i]) + "\"\n";
+        std::string fields = "\t.long " + std::to_string(checksums[i]) + "\n\t.long " + std::to_string(numBlocks) + "\n\t.long " +
+                             std::to_string(firstLabels[i]) + "\n";
+        if (target == X86_64_TARGET)
+        {
+            descriptors += "\t.quad " + nameLabel + "\n" + fields + "\t.long 0\n\t.quad " + counterLabel + "\n";
+        }
+        else
+        {
+            descriptors += "\t.long " + nameLabel + "\n" + fields + "\t.long " + counterLabel + "\n";
+        }
+    }
+    text += counters + names + descriptors;
+}
+
+/**
+ * @brief Print the assembly directives that end the file: on x86-64, the section that marks the stack as not executable, which
+ * the linker expects of every object.
+ * @param text The assembly of the module.
+ * @param target The target.
+ */
+static void
+printTopLevelEnd(std::string &text, Target target)
+{
+    if (target == X86_64_TARGET)
+    {
+        text += "\t.section .note.GNU-stack,\"\",@progbits\n";
+    }
+}
+
+/**
+ * @brief Emit the beginning of a function.
  *
- * This function prints the assembly directives that are specific to a function to the output stream. The directives include
- * specifying that the function is global, specifying the type of the function, setting up the stack frame, and allocating
- * space for the reserved registers and local variables. If the EBX register is used in the function, its value is saved.
+ * This function emits the labels of the function and its prologue: setting up the stack frame, and allocating space for the
+ * reserved registers and local variables (the `.globl` and `.type` directives are printed with the function, see
+ * printMachineFunction). The callee-saved registers used in the function are saved right below
+ * the base pointer. On x86-64 the frame keeps the stack aligned to 16 bytes for the calls, and the argument, which arrives in
+ * `%edi`, is stored to its stack slot.
  *
  * @param context The code generation context.
- * @param out The output stream to print the directives to.
- * @param functionName The name of the function.
  */
 static void
-printFunctionDirectives(CodeGenContext &context, std::ostream &out, const std::string &functionName)
+printFunctionDirectives(CodeGenContext &context)
 {
-    out << "\t.globl " << functionName << std::endl;                 // Specify that the function is global
-    out << "\t.type " << functionName << ", @function" << std::endl; // Specify the type of the function
-
     // Specify the beginning of the function
-    out << functionName << ":" << std::endl;
-    out << ".LFB" << std::to_string(context.funCounter) << ":" << std::endl;
+    emit(context, LABEL, {labelOperand(context.machineFunction.name)});
+    emit(context, LABEL, {labelOperand(".LFB" + std::to_string(context.funCounter))});
+
+    bool x86_64 = context.target == X86_64_TARGET;
 
     // Setup the stack frame
-    out << "\tpushl %ebp\n";
+    emit(context, x86_64 ? PUSHQ : PUSHL, {getAddressRegister(context, EBP)});
 
     // Set the new base pointer
-    out << "\tmovl %esp, %ebp\n";
+    emit(context, x86_64 ? MOVQ : MOVL, {getAddressRegister(context, ESP), getAddressRegister(context, EBP)});
 
-    // If the EBX register is used in the function, save its value
-    if (context.usedEBX)
+    // Save the callee-saved registers that the function uses
+    int savedSize = 0;
+    for (int reg = 0; reg < NUM_REGISTERS; reg++)
     {
-        out << "\tpushl %ebx\n";
+        if (context.usedCalleeSaved & registerBit((Register)reg))
+        {
+            emit(context, x86_64 ? PUSHQ : PUSHL, {getAddressRegister(context, (Register)reg)});
+            savedSize += getPointerSize(context.target);
+        }
     }
 
     // Allocate space for the reserved registers and local variables
-    out << "\tsubl $" << context.localMem << ", %esp\n";
+    if (x86_64)
+    {
+        emit(context, SUBQ, {immediateOperand((context.localMem + 15) / 16 * 16 - savedSize), registerOperand(ESP, 8)});
+        if (LLVMCountParams(context.function) > 0)
+        {
+            emit(context, MOVL, {registerOperand(EDI), getStackSlot(context, context.offsetMap[LLVMGetParam(context.function, 0)])});
+        }
+    }
+    else
+    {
+        emit(context, SUBL, {immediateOperand(context.localMem), registerOperand(ESP)});
+    }
 }
 
 /**
- * @brief Print assembly instructions to end a function.
- * @param out Output stream.
+ * @brief Emit the instructions that end a function.
+ * @param context The code generation context.
  */
 static void
-printFunctionEnd(std::ostream &out)
+printFunctionEnd(CodeGenContext &context)
 {
-    out << "\tleave\n"; // Restore the stack frame
-    out << "\tret\n";   // Return from the function
+    // Restore the callee-saved registers that the prologue pushed right below the base pointer
+    int offset = 0;
+    for (int reg = 0; reg < NUM_REGISTERS; reg++)
+    {
+        if (context.usedCalleeSaved & registerBit((Register)reg))
+        {
+            offset -= getPointerSize(context.target);
+            emit(context, context.target == X86_64_TARGET ? MOVQ : MOVL,
+                 {getStackSlot(context, offset), getAddressRegister(context, (Register)reg)});
+        }
+    }
+
+    emit(context, LEAVE); // Restore the stack frame
+    emit(context, RET);   // Return from the function
 }
 
 /**
@@ -180,85 +391,94 @@ throwError(LLVMValueRef ptr, std::string message)
 }
 
 /**
- * @brief Check if an LLVM instruction stores an argument.
+ * @brief Check if an LLVM instruction is the home of the parameter.
  *
- * This function checks if an LLVM instruction stores an argument by iterating through all uses of the instruction and checking
- * if the stored value is an argument. If the stored value is an argument, the function returns `true`. Otherwise, it returns
- * `false`.
+ * This function checks if an alloca only ever holds the argument: it is stored to at least once, and every store to it stores
+ * the argument. Such an alloca can share the slot the caller pushed the argument in. An alloca that is also assigned other
+ * values (such as a variable initialized with the parameter, once the optimizer has forwarded `n + 0` to `n`) needs a slot of
+ * its own, or its stores would overwrite the argument.
  *
  * @param instruction The LLVM instruction to check.
- * @return `true` if the instruction stores an argument, `false` otherwise.
+ * @return `true` if the instruction only holds the argument, `false` otherwise.
  */
 static bool
 isParameter(LLVMValueRef instruction)
 {
+    bool storesArgument = false;
+
     // Iterate through all uses of the instruction
     for (LLVMUseRef use = LLVMGetFirstUse(instruction); use != NULL; use = LLVMGetNextUse(use))
     {
         LLVMValueRef user = LLVMGetUser(use);
 
-        // Check if the user is a store instruction
-        if (LLVMIsAStoreInst(user))
+        // Check if the user is a store instruction to the alloca
+        if (LLVMIsAStoreInst(user) && LLVMGetOperand(user, 1) == instruction)
         {
-            LLVMValueRef storedValue = LLVMGetOperand(user, 0);
-
             // Check if the stored value is an argument
-            if (LLVMIsAArgument(storedValue))
+            if (!LLVMIsAArgument(LLVMGetOperand(user, 0)))
             {
-                return true;
+                return false;
             }
+            storesArgument = true;
         }
     }
-    return false;
+    return storesArgument;
 }
 
 /**
- * @brief Populate the offset map for a basic block.
+ * @brief Populate the offset map for a function.
  *
- * This function populates the offset map for a basic block by iterating through all instructions in the basic block and adding
- * alloca instructions and spilled instructions to the offset map. If an instruction stores an argument, its offset is set to 8
- * bytes (for the return address and first parameter). Otherwise, the local memory offset is incremented by 4 bytes for each
- * alloca instruction, and the instruction is added to the offset map with a negative offset.
+ * This function populates the offset map for a function by iterating through all instructions in the function and adding
+ * alloca instructions, spilled instructions and instructions whose live interval was split to the offset map. If an instruction
+ * stores an argument, it shares the slot of the argument: 8 bytes above the base pointer on x86 (past the return address), where
+ * the caller pushed it. The other instructions are given stack slots of 4 bytes by colorStackSlots, which lets the instructions
+ * that are never live at the same time share a slot, and are added to the offset map with negative offsets below the local
+ * memory offset, which grows by the size of the slots.
  *
- * @param basicBlock The basic block to populate the offset map for.
+ * @param function The function to populate the offset map for.
  * @param allocatedRegMap A map of LLVM instructions to their allocated registers.
- * @param usedEBX A flag indicating whether the EBX register is used in the basic block.
+ * @param splitIntervals The values whose live interval was split.
+ * @param parameterOffset The offset of the slot of the argument.
  * @param offsetMap The offset map to populate.
  * @param localMem The current local memory offset.
  */
 static void
-populateOffsetMap(LLVMBasicBlockRef basicBlock, AllocatedReg &allocatedRegMap,
-                  bool &usedEBX, OffsetMap &offsetMap, int &localMem)
+populateOffsetMap(LLVMValueRef function, AllocatedReg &allocatedRegMap, SplitIntervals &splitIntervals, int parameterOffset,
+                  OffsetMap &offsetMap, int &localMem)
 {
-    // Get the first instruction in the basic block
-    LLVMValueRef instruction = LLVMGetFirstInstruction(basicBlock);
-
     // The offset step is 4 bytes
     static const int offsetStep = 4;
 
-    while (instruction)
+    std::vector<LLVMValueRef> objects;
+    for (LLVMBasicBlockRef basicBlock = LLVMGetFirstBasicBlock(function); basicBlock;
+         basicBlock = LLVMGetNextBasicBlock(basicBlock))
     {
-        // Add the instruction to the offset map if it is an alloca instruction or a spilled instruction
-        if (isAlloca(instruction) || isSpilledInstruction(instruction, allocatedRegMap))
+        for (LLVMValueRef instruction = LLVMGetFirstInstruction(basicBlock); instruction;
+             instruction = LLVMGetNextInstruction(instruction))
         {
-            if (isParameter(instruction))
-            {
-                // 8 bytes for the return address and first parameter
-                offsetMap[instruction] = offsetStep * 2;
-            }
-            else
+            // The instruction needs a slot if it is an alloca instruction, a spilled instruction or a split one
+            if (isAlloca(instruction) || isSpilledInstruction(instruction, allocatedRegMap) ||
+                splitIntervals.splitPositions.count(instruction) > 0)
             {
-                // Increment the local memory offset
-                localMem += offsetStep;
-
-                // Add the alloca instruction to the offset map with a negative offset
-                offsetMap[instruction] = -localMem;
+                if (isParameter(instruction))
+                {
+                    offsetMap[instruction] = parameterOffset;
+                }
+                else
+                {
+                    objects.push_back(instruction);
+                }
             }
         }
+    }
 
-        // Get the next instruction
-        instruction = LLVMGetNextInstruction(instruction);
+    RegMap slots;
+    int numSlots = colorStackSlots(function, objects, slots);
+    for (LLVMValueRef object : objects)
+    {
+        offsetMap[object] = -(localMem + offsetStep * (slots[object] + 1));
     }
+    localMem += offsetStep * numSlots;
 }
 
 /**
@@ -284,7 +504,8 @@ printOffsetMap(OffsetMap &offsetMap)
  * @brief Check if an LLVM value is stored in a register.
  *
  * This function checks if an LLVM value is stored in a register by looking up the value in the `allocatedRegMap` map and checking
- * if its value is not `SPILL`. If the value is stored in a register, the function returns `true`. Otherwise, it returns `false`.
+ * if its value is not `SPILL`. A value whose live interval was split is only in its register before its split position. If the
+ * value is stored in a register, the function returns `true`. Otherwise, it returns `false`.
  *
  * @param context The code generation context.
  * @param value The LLVM value to check.
@@ -293,7 +514,12 @@ printOffsetMap(OffsetMap &offsetMap)
 static bool
 variableIsInRegister(CodeGenContext &context, LLVMValueRef value)
 {
-    return (context.allocatedRegMap.count(value) > 0 && context.allocatedRegMap[value] != SPILL);
+    if (context.allocatedRegMap.count(value) == 0 || context.allocatedRegMap[value] == SPILL)
+    {
+        return false;
+    }
+    auto split = context.splitIntervals.splitPositions.find(value);
+    return split == context.splitIntervals.splitPositions.end() || context.position < split->second;
 }
 
 /**
@@ -332,68 +558,152 @@ printLLVMValueRef(LLVMValueRef value, std::ostream &out)
 /**
  * @brief Get the assembly opcode for an LLVM integer predicate.
  *
- * This function returns the assembly opcode for an LLVM integer predicate. The function takes an `LLVMIntPredicate` value as input
- * and returns a string representation of the corresponding assembly opcode. If the predicate is not supported, the function prints
- * an error message and returns `nullptr`.
+ * This function returns the conditional jump for an LLVM integer predicate. The function takes an `LLVMIntPredicate` value as
+ * input and returns the corresponding opcode. If the predicate is not supported, the function prints an error message and exits.
  *
  * @param predicate The LLVM integer predicate to get the assembly opcode for.
- * @return The assembly opcode as a string, or `nullptr` if the predicate is not supported.
+ * @return The conditional jump opcode.
  */
-static std::string
+static MachineOpcode
 getAssemblyOpcodeForPredicate(LLVMIntPredicate predicate)
 {
     switch (predicate)
     {
     case LLVMIntEQ:
-        return "je";
+        return JE;
     case LLVMIntNE:
-        return "jne";
+        return JNE;
     case LLVMIntSGT:
-        return "jg";
+        return JG;
     case LLVMIntSGE:
-        return "jge";
+        return JGE;
     case LLVMIntSLT:
-        return "jl";
+        return JL;
     case LLVMIntSLE:
-        return "jle";
+        return JLE;
     default:
     {
         cout << "Unsupported comparison predicate\n";
-        return nullptr;
+        exit(EXIT_FAILURE);
     }
     }
 }
 
+/**
+ * @brief Get the `setcc` opcode that sets a byte to the result of an LLVM integer predicate.
+ * @param predicate The LLVM integer predicate.
+ * @return The opcode: SETE for LLVMIntEQ.
+ */
+static MachineOpcode
+getSetOpcodeForPredicate(LLVMIntPredicate predicate)
+{
+    // The set opcodes are in the order of the jumps
+    return (MachineOpcode)(SETE + (getAssemblyOpcodeForPredicate(predicate) - JE));
+}
+
 /**
  * @brief Get the assembly opcode for an LLVM instruction.
  *
  * This function returns the assembly opcode for an LLVM instruction. The function takes an `LLVMValueRef` value as input and returns
- * a string representation of the corresponding assembly opcode. If the instruction is not supported, the function prints an error
- * message and returns `nullptr`.
+ * the corresponding opcode. If the instruction is not supported, the function prints an error message and exits.
  *
  * @param instruction The LLVM instruction to get the assembly opcode for.
- * @return The assembly opcode as a string, or `nullptr` if the instruction is not supported.
+ * @return The assembly opcode.
  */
-static std::string
+static MachineOpcode
 getAssemblyOpcodeForInstruction(LLVMValueRef instruction)
 {
     LLVMOpcode opcode = LLVMGetInstructionOpcode(instruction);
     switch (opcode)
     {
     case LLVMAdd:
-        return "addl";
+        return ADDL;
     case LLVMSub:
-        return "subl";
+        return SUBL;
     case LLVMMul:
-        return "imull";
+        return IMULL;
+    case LLVMShl:
+        return SALL;
     case LLVMICmp:
-        return "cmpl";
+        return CMPL;
     default:
     {
         cout << "Unsupported opcode\n";
-        return nullptr;
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+/**
+ * @brief Check whether a branch on a comparison can jump on the flags that the comparison sets.
+ *
+ * It can if the comparison is in the block of the branch and no instruction between them changes the flags: loads, stores and
+ * phis are only moves, but arithmetic, other comparisons and calls do. Otherwise, as when the optimizer hoisted the comparison out
+ * of a loop or merged it with an earlier one, the comparison keeps its result (0 or 1) like any other value, and the branch
+ * tests it.
+ *
+ * @param condition The condition of the branch.
+ * @param branch The branch instruction.
+ * @return true if the branch can jump on the flags of the comparison, false otherwise.
+ */
+static bool
+branchesOnFlags(LLVMValueRef condition, LLVMValueRef branch)
+{
+    if (!LLVMIsAICmpInst(condition) || LLVMGetInstructionParent(condition) != LLVMGetInstructionParent(branch))
+    {
+        return false;
+    }
+    for (LLVMValueRef instruction = LLVMGetNextInstruction(condition); instruction != branch;
+         instruction = LLVMGetNextInstruction(instruction))
+    {
+        if (!LLVMIsALoadInst(instruction) && !LLVMIsAStoreInst(instruction) && !LLVMIsAPHINode(instruction) &&
+            !LLVMIsAAllocaInst(instruction))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Check whether the result of a comparison is used as a value, rather than only by branches that jump on its flags.
+ *
+ * @param comparison The LLVMICmp instruction.
+ * @return true if the comparison must keep its result, false otherwise.
+ */
+static bool
+comparisonNeedsValue(LLVMValueRef comparison)
+{
+    for (LLVMUseRef use = LLVMGetFirstUse(comparison); use; use = LLVMGetNextUse(use))
+    {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (!LLVMIsABranchInst(user) || !branchesOnFlags(comparison, user))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Get the assembly operand that holds an LLVM value.
+ *
+ * @param context The code generation context.
+ * @param value The LLVM value, a constant integer or a value in a register or in memory.
+ * @return An immediate (`$5`) for a constant, the register (`%ecx`) or the stack slot (`-8(%ebp)`) of the value otherwise.
+ */
+static MachineOperand
+getValueOperand(CodeGenContext &context, LLVMValueRef value)
+{
+    if (LLVMIsAConstantInt(value))
+    {
+        return immediateOperand(LLVMConstIntGetSExtValue(value));
     }
+    if (variableIsInRegister(context, value))
+    {
+        return registerOperand(context.allocatedRegMap[value]);
     }
+    return getStackSlot(context, context.offsetMap[value]);
 }
 
 /**
@@ -402,7 +712,8 @@ getAssemblyOpcodeForInstruction(LLVMValueRef instruction)
  * This function handles the LLVMRet opcode by generating assembly code to move the return value into the `%eax` register. If the
  * return value is a constant integer, the function generates code to move the integer value into `%eax`. If the return value is
  * stored in memory, the function generates code to move the value from the memory location into `%eax`. If the return value is
- * stored in a register, the function generates code to move the value from the register into `%eax`.
+ * stored in a register, the function generates code to move the value from the register into `%eax`. The function then returns
+ * (see printFunctionEnd): the block of the return is not always the last one placed (see block_layout.h).
  *
  * @param instruction The LLVM instruction to handle.
  * @param context The code generation context.
@@ -410,23 +721,22 @@ getAssemblyOpcodeForInstruction(LLVMValueRef instruction)
 static void
 handleLLVMRet(LLVMValueRef instruction, CodeGenContext &context)
 {
-    static std::ostream &out = context.outputFile;
     LLVMValueRef returnValue = LLVMGetOperand(instruction, 0);
 
     if (LLVMIsAConstantInt(returnValue))
     {
         int value = LLVMConstIntGetSExtValue(returnValue);
-        out << "\tmovl $" << value << ", %eax\n";
+        emit(context, MOVL, {immediateOperand(value), registerOperand(EAX)});
     }
     else if (variableIsInMemory(context, returnValue))
     {
         int offset = context.offsetMap[returnValue];
-        out << "\tmovl " << offset << "(%ebp), %eax\n";
+        emit(context, MOVL, {getStackSlot(context, offset), registerOperand(EAX)});
     }
     else if ((variableIsInRegister(context, returnValue)))
     {
         Register reg = context.allocatedRegMap[returnValue];
-        out << "\tmovl %" << getRegisterName(reg) << ", %eax\n";
+        emit(context, MOVL, {registerOperand(reg), registerOperand(EAX)});
     }
 #ifdef DEBUG
     else
@@ -434,6 +744,8 @@ handleLLVMRet(LLVMValueRef instruction, CodeGenContext &context)
         throwError(returnValue, "return");
     }
 #endif
+
+    printFunctionEnd(context);
 }
 
 /**
@@ -441,7 +753,7 @@ handleLLVMRet(LLVMValueRef instruction, CodeGenContext &context)
  *
  * This function handles the LLVMLoad opcode by generating assembly code to move the value from the memory location into a register.
  * If the value is stored in a register, the function generates code to move the value from the register into the destination
- * register.
+ * register, and from there into its stack slot too if its live interval was split.
  *
  * @param instruction The LLVM instruction to handle.
  * @param context The code generation context.
@@ -449,22 +761,28 @@ handleLLVMRet(LLVMValueRef instruction, CodeGenContext &context)
 static void
 handleLLVMLoad(LLVMValueRef instruction, CodeGenContext &context)
 {
-    static std::ostream &out = context.outputFile;
-
     if (variableIsInRegister(context, instruction))
     {
         LLVMValueRef loadValue = LLVMGetOperand(instruction, 0);
         int offset = context.offsetMap[loadValue];
         Register reg = context.allocatedRegMap[instruction];
-        out << "\tmovl " << offset << "(%ebp), %" << getRegisterName(reg) << "\n";
+        emit(context, MOVL, {getStackSlot(context, offset), registerOperand(reg)});
+        if (variableIsInMemory(context, instruction))
+        {
+            emit(context, MOVL, {registerOperand(reg), getStackSlot(context, context.offsetMap[instruction])});
+        }
     }
     else if (variableIsInMemory(context, instruction))
     {
+        // The value is already in place if the load shares the slot of the variable, which it outlives
         LLVMValueRef loadValue = LLVMGetOperand(instruction, 0);
         int offset1 = context.offsetMap[loadValue];
         int offset2 = context.offsetMap[instruction];
-        out << "\tmovl " << offset1 << "(%ebp), %eax\n";
-        out << "\tmovl %eax, " << offset2 << "(%ebp)\n";
+        if (offset1 != offset2)
+        {
+            emit(context, MOVL, {getStackSlot(context, offset1), registerOperand(EAX)});
+            emit(context, MOVL, {registerOperand(EAX), getStackSlot(context, offset2)});
+        }
     }
 #ifdef DEBUG
     else
@@ -488,7 +806,6 @@ handleLLVMLoad(LLVMValueRef instruction, CodeGenContext &context)
 static void
 handleLLVMStore(LLVMValueRef instruction, CodeGenContext &context)
 {
-    static std::ostream &out = context.outputFile;
     LLVMValueRef storedValue = LLVMGetOperand(instruction, 0);
     LLVMValueRef storeLocation = LLVMGetOperand(instruction, 1);
 
@@ -500,43 +817,61 @@ handleLLVMStore(LLVMValueRef instruction, CodeGenContext &context)
     {
         int offset = context.offsetMap[storeLocation];
         int value = LLVMConstIntGetSExtValue(storedValue);
-        out << "\tmovl $" << value << ", " << offset << "(%ebp)\n";
+        emit(context, MOVL, {immediateOperand(value), getStackSlot(context, offset)});
     }
     else if (variableIsInRegister(context, storedValue))
     {
         Register reg = context.allocatedRegMap[storedValue];
         int offset = context.offsetMap[storeLocation];
-        out << "\tmovl %" << getRegisterName(reg) << ", " << offset << "(%ebp)\n";
+        emit(context, MOVL, {registerOperand(reg), getStackSlot(context, offset)});
     }
-    else
+    else if (context.offsetMap[storedValue] != context.offsetMap[storeLocation])
     {
+        // x86 has no move from memory to memory; a value that shares the slot of the variable is already in place
         int offset1 = context.offsetMap[storedValue];
         int offset2 = context.offsetMap[storeLocation];
-        out << "\tmovl " << offset1 << "(%ebp), %eax\n";
-        out << "\tmovl %eax, " << offset2 << "(%ebp)\n";
+        emit(context, MOVL, {getStackSlot(context, offset1), registerOperand(EAX)});
+        emit(context, MOVL, {registerOperand(EAX), getStackSlot(context, offset2)});
     }
 }
 
 /**
  * @brief Handle an LLVM call instruction.
  *
- * This function handles an LLVM call instruction by pushing the registers onto the stack, getting the called function and the
+ * This function handles an LLVM call instruction by pushing the caller-saved registers that hold values live across the call
+ * onto the stack, getting the called function and the
  * number of parameters, and pushing the parameter onto the stack if it is a constant, in a register, or in memory. The function
- * then emits the function invoked by the call instruction and pops the registers off the stack. If the function returns an
+ * then emits the function invoked by the call instruction and pops the saved registers off the stack. If the function returns an
  * integer, the function moves the result to a register or memory location.
  *
+ * On x86-64 the argument is passed in `%edi` (System V), and the saved registers go to their slots in the frame (see
+ * CodeGenContext::callSaveSlots) instead of the stack, which the prologue aligned to 16 bytes for the call.
+ *
  * @param instruction The LLVM call instruction to handle.
  * @param context The code generation context.
  */
 static void
 handleLLVMCall(LLVMValueRef instruction, CodeGenContext &context)
 {
-    static std::ostream &out = context.outputFile;
-
-    // Push the registers onto the stack
-    out << "\tpushl %ebx\n";
-    out << "\tpushl %ecx\n";
-    out << "\tpushl %edx\n";
+    // Save the registers that the call may overwrite while they hold live values; the callee preserves the callee-saved ones
+    bool x86_64 = context.target == X86_64_TARGET;
+    auto saves = context.callSaves.find(instruction);
+    RegisterSet saved = saves != context.callSaves.end() ? saves->second : 0;
+    for (int reg = 0; reg < NUM_REGISTERS; reg++)
+    {
+        if (!(saved & registerBit((Register)reg)))
+        {
+            continue;
+        }
+        if (x86_64)
+        {
+            emit(context, MOVL, {registerOperand((Register)reg), getStackSlot(context, context.callSaveSlots[reg])});
+        }
+        else
+        {
+            emit(context, PUSHL, {registerOperand((Register)reg)});
+        }
+    }
 
     // Get the called function
     LLVMValueRef func = LLVMGetCalledValue(instruction);
@@ -549,21 +884,25 @@ handleLLVMCall(LLVMValueRef instruction, CodeGenContext &context)
         // MiniC always has one parameter
         LLVMValueRef param = LLVMGetOperand(instruction, 0);
 
+        if (x86_64)
+        {
+            emit(context, MOVL, {getValueOperand(context, param), registerOperand(EDI)});
+        }
         // Check if param is a constant
-        if (LLVMIsAConstant(param))
+        else if (LLVMIsAConstant(param))
         {
             int value = LLVMConstIntGetSExtValue(param);
-            out << "pushl $" << value << endl;
+            emit(context, PUSHL, {immediateOperand(value)});
         }
         else if (variableIsInRegister(context, param))
         {
             Register reg = context.allocatedRegMap[param];
-            out << "\tpushl %" << getRegisterName(reg) << "\n";
+            emit(context, PUSHL, {registerOperand(reg)});
         }
         else if (variableIsInMemory(context, param))
         {
             int offset = context.offsetMap[param];
-            out << "\tpushl " << offset << "(%ebp)\n";
+            emit(context, PUSHL, {getStackSlot(context, offset)});
         }
 #ifdef DEBUG
         else
@@ -575,18 +914,30 @@ handleLLVMCall(LLVMValueRef instruction, CodeGenContext &context)
 
     // Emit the function invoked by the call instruction
     const char *funcName = LLVMGetValueName(func);
-    out << "\tcall " << funcName << "@PLT\n";
+    emit(context, CALL, {labelOperand(std::string(funcName) + "@PLT")});
 
-    if (numParams > 0)
+    if (numParams > 0 && !x86_64)
     {
         // Undo the offset of pushing the parameter of func
-        out << "\taddl $" << 4 << ", %esp\n";
+        emit(context, ADDL, {immediateOperand(4), registerOperand(ESP)});
     }
 
-    // Pop the registers off the stack
-    out << "\tpopl %edx\n";
-    out << "\tpopl %ecx\n";
-    out << "\tpopl %ebx\n";
+    // Restore the saved registers, popping them off the stack in the reverse order on x86
+    for (int reg = NUM_REGISTERS - 1; reg >= 0; reg--)
+    {
+        if (!(saved & registerBit((Register)reg)))
+        {
+            continue;
+        }
+        if (x86_64)
+        {
+            emit(context, MOVL, {getStackSlot(context, context.callSaveSlots[reg]), registerOperand((Register)reg)});
+        }
+        else
+        {
+            emit(context, POPL, {registerOperand((Register)reg)});
+        }
+    }
 
     LLVMTypeRef returnType = LLVMTypeOf(instruction);
 
@@ -596,15 +947,15 @@ handleLLVMCall(LLVMValueRef instruction, CodeGenContext &context)
         if (variableIsInRegister(context, instruction))
         {
             Register reg = context.allocatedRegMap[instruction];
-            out << "\tmovl %eax, %" << getRegisterName(reg) << "\n";
+            emit(context, MOVL, {registerOperand(EAX), registerOperand(reg)});
         }
-        else if (variableIsInMemory(context, instruction))
+        if (variableIsInMemory(context, instruction))
         {
             int offset = context.offsetMap[instruction];
-            out << "\tmovl %eax, " << offset << "(%ebp)\n";
+            emit(context, MOVL, {registerOperand(EAX), getStackSlot(context, offset)});
         }
 #ifdef DEBUG
-        else
+        if (!variableIsInRegister(context, instruction) && !variableIsInMemory(context, instruction))
         {
             throwError(instruction, "call. The variable is not in register or memory");
         }
@@ -612,13 +963,177 @@ handleLLVMCall(LLVMValueRef instruction, CodeGenContext &context)
     }
 }
 
+/**
+ * @brief Get the copies on the edge from a basic block to one of its successors: the incoming values of the phis of the
+ * successor into the phis, and the values that the register allocator split into their registers (see SplitIntervals).
+ *
+ * @param context The code generation context, at the branch of the predecessor.
+ * @param from The predecessor.
+ * @param to The successor.
+ * @return The copies of the edge, as <source, destination> operands.
+ */
+static std::vector<std::pair<MachineOperand, MachineOperand>>
+getEdgeCopies(CodeGenContext &context, LLVMBasicBlockRef from, LLVMBasicBlockRef to)
+{
+    std::vector<std::pair<MachineOperand, MachineOperand>> copies; // <source, destination>
+    for (LLVMValueRef phi = LLVMGetFirstInstruction(to); phi && LLVMIsAPHINode(phi); phi = LLVMGetNextInstruction(phi))
+    {
+        for (unsigned i = 0; i < LLVMCountIncoming(phi); i++)
+        {
+            if (LLVMGetIncomingBlock(phi, i) != from)
+            {
+                continue;
+            }
+            MachineOperand source = getValueOperand(context, LLVMGetIncomingValue(phi, i));
+            MachineOperand destination = getValueOperand(context, phi);
+            if (source != destination)
+            {
+                copies.push_back({source, destination});
+            }
+            break;
+        }
+    }
+
+    auto reloads = context.splitIntervals.reloads.find({from, to});
+    if (reloads != context.splitIntervals.reloads.end())
+    {
+        for (LLVMValueRef value : reloads->second)
+        {
+            copies.push_back({getStackSlot(context, context.offsetMap[value]), registerOperand(context.allocatedRegMap[value])});
+        }
+    }
+    return copies;
+}
+
+/**
+ * @brief Emit one copy of an edge (see getEdgeCopies), through `%eax` from memory to memory.
+ *
+ * @param context The code generation context.
+ * @param copy The <source, destination> operands.
+ */
+static void
+emitEdgeCopy(CodeGenContext &context, const std::pair<MachineOperand, MachineOperand> &copy)
+{
+    if (copy.first.kind == MEMORY_OPERAND && copy.second.kind == MEMORY_OPERAND)
+    {
+        emit(context, MOVL, {copy.first, registerOperand(EAX)});
+        emit(context, MOVL, {registerOperand(EAX), copy.second});
+    }
+    else
+    {
+        emit(context, MOVL, {copy.first, copy.second});
+    }
+}
+
+/**
+ * @brief Emit the copies of an edge (see getEdgeCopies).
+ *
+ * The copies of an edge happen at the same time: a phi may be the incoming value of another phi of the block, as when a loop
+ * swaps two variables. A copy is moved into its destination once no other copy still has to read the destination; when every
+ * copy left writes an operand that another one reads, they form cycles, and one copy of a cycle pushes its source on the stack
+ * and pops it into its destination after all the others. On x86-64, where only 64-bit operands can be pushed, the copy goes
+ * through `%rax`. The register allocator gives the phis and the reloaded values
+ * registers that no other value live into the successor holds, so the copies only overwrite values that are dead on the edge,
+ * or that other copies read. None of the instructions changes the flags, so the copies can go between a comparison and its
+ * jump.
+ *
+ * @param context The code generation context.
+ * @param copies The copies of the edge.
+ */
+static void
+emitEdgeCopies(CodeGenContext &context, const std::vector<std::pair<MachineOperand, MachineOperand>> &copies)
+{
+    // The operands are keyed by their assembly
+    std::vector<std::pair<std::string, std::string>> keys(copies.size());
+    for (size_t i = 0; i < copies.size(); i++)
+    {
+        printMachineOperand(copies[i].first, keys[i].first);
+        printMachineOperand(copies[i].second, keys[i].second);
+    }
+
+    std::unordered_map<std::string, unsigned> readers; // <operand, the number of copies left that read it>
+    std::unordered_map<std::string, size_t> writers;   // <operand, the copy that writes it>
+    for (size_t i = 0; i < copies.size(); i++)
+    {
+        readers[keys[i].first]++;
+        writers[keys[i].second] = i;
+    }
+
+    std::vector<size_t> ready; // the copies left whose destination no copy left reads
+    for (size_t i = 0; i < copies.size(); i++)
+    {
+        if (readers.find(keys[i].second) == readers.end())
+        {
+            ready.push_back(i);
+        }
+    }
+
+    std::vector<bool> done(copies.size(), false);
+    std::vector<MachineOperand> delayed; // the destinations of the copies whose sources were pushed, in the order of the pushes
+    size_t next = 0;
+    for (size_t left = copies.size(); left > 0; left--)
+    {
+        size_t copy;
+        if (!ready.empty())
+        {
+            copy = ready.back();
+            ready.pop_back();
+            emitEdgeCopy(context, copies[copy]);
+        }
+        else
+        {
+            while (done[next])
+            {
+                next++;
+            }
+            copy = next;
+            if (context.target == X86_64_TARGET)
+            {
+                emit(context, MOVL, {copies[copy].first, registerOperand(EAX)});
+                emit(context, PUSHQ, {registerOperand(EAX, 8)});
+            }
+            else
+            {
+                emit(context, PUSHL, {copies[copy].first});
+            }
+            delayed.push_back(copies[copy].second);
+        }
+        done[copy] = true;
+
+        // The copy that writes the source may go once nothing else reads it
+        auto writer = writers.find(keys[copy].first);
+        if (--readers[keys[copy].first] == 0 && writer != writers.end() && !done[writer->second])
+        {
+            ready.push_back(writer->second);
+        }
+    }
+
+    for (auto destination = delayed.rbegin(); destination != delayed.rend(); ++destination)
+    {
+        if (context.target == X86_64_TARGET)
+        {
+            emit(context, POPQ, {registerOperand(EAX, 8)});
+            emit(context, MOVL, {registerOperand(EAX), *destination});
+        }
+        else
+        {
+            emit(context, POPL, {*destination});
+        }
+    }
+}
+
 /**
  * @brief Handle an LLVM branch instruction.
  *
  * This function handles an LLVM branch instruction by checking if the instruction is conditional or unconditional. If the
  * instruction is conditional, the function gets the comparison predicate, the true and false labels, and emits the corresponding
  * assembly opcode. If the instruction is unconditional, the function gets the branch label and emits a jump instruction to the
- * label.
+ * label. A branch on a constant condition (one that the optimizer folded) is a jump to the label it always takes, and a branch
+ * that cannot jump on the flags of its comparison (see branchesOnFlags) tests the result of the comparison instead.
+ *
+ * The copies of the edge to a successor (see getEdgeCopies) are emitted on the edge: before the jump for the false successor and
+ * for an unconditional branch, and in a block of their own (labelled `.L<block>_<successor>`) that the conditional jump goes to
+ * for the true successor.
  *
  * @param instruction The LLVM branch instruction to handle.
  * @param context The code generation context.
@@ -626,36 +1141,174 @@ handleLLVMCall(LLVMValueRef instruction, CodeGenContext &context)
 static void
 handleLLVMBr(LLVMValueRef instruction, CodeGenContext &context)
 {
-    static std::ostream &out = context.outputFile;
-    if (LLVMIsConditional(instruction))
+    LLVMBasicBlockRef basicBlock = LLVMGetInstructionParent(instruction);
+    LLVMValueRef condition = LLVMIsConditional(instruction) ? LLVMGetOperand(instruction, 0) : NULL;
+    if (condition && !LLVMIsAConstantInt(condition))
     {
-        LLVMValueRef condition = LLVMGetOperand(instruction, 0);
+        LLVMBasicBlockRef falseBlock = LLVMValueAsBasicBlock(LLVMGetOperand(instruction, 1));
+        LLVMBasicBlockRef trueBlock = LLVMValueAsBasicBlock(LLVMGetOperand(instruction, 2));
         std::string falseLabel = context.bbLabelMap[LLVMGetOperand(instruction, 1)];
         std::string trueLabel = context.bbLabelMap[LLVMGetOperand(instruction, 2)];
 
-        // Get the comparison predicate
-        LLVMIntPredicate predicate = LLVMGetICmpPredicate(condition);
+        // The true edge needs a block of its own for its copies
+        std::string trueTarget = trueLabel;
+        std::vector<std::pair<MachineOperand, MachineOperand>> trueEdgeCopies = getEdgeCopies(context, basicBlock, trueBlock);
+        if (!trueEdgeCopies.empty())
+        {
+            trueTarget = context.bbLabelMap[LLVMBasicBlockAsValue(basicBlock)] + "_" + trueLabel.substr(2);
+        }
 
-        // Get the corresponding assembly opcode
-        std::string jmpInstruction = getAssemblyOpcodeForPredicate(predicate);
+        // Jump on the flags of the comparison, or on its result if they are gone
+        MachineOpcode jmpInstruction = JNE;
+        if (branchesOnFlags(condition, instruction))
+        {
+            // Get the comparison predicate
+            LLVMIntPredicate predicate = LLVMGetICmpPredicate(condition);
 
-        out << "\t" << jmpInstruction << " " << trueLabel << "\n";
-        out << "\tjmp " << falseLabel << "\n";
+            // Get the corresponding assembly opcode
+            jmpInstruction = getAssemblyOpcodeForPredicate(predicate);
+        }
+        else
+        {
+            emit(context, CMPL, {immediateOperand(0), getValueOperand(context, condition)});
+        }
+
+        emit(context, jmpInstruction, {labelOperand(trueTarget)});
+        emitEdgeCopies(context, getEdgeCopies(context, basicBlock, falseBlock));
+        emit(context, JMP, {labelOperand(falseLabel)});
+
+        if (!trueEdgeCopies.empty())
+        {
+            emit(context, LABEL, {labelOperand(trueTarget)});
+            emitEdgeCopies(context, trueEdgeCopies);
+            emit(context, JMP, {labelOperand(trueLabel)});
+        }
     }
     else
     {
-        // Get branch label
-        std::string label = context.bbLabelMap[LLVMGetOperand(instruction, 0)];
-        out << "\tjmp " << label << "\n";
+        // Get branch label: the only successor, or the one a constant condition always takes
+        LLVMValueRef target = LLVMGetOperand(instruction, 0);
+        if (condition)
+        {
+            target = LLVMGetOperand(instruction, LLVMConstIntGetZExtValue(condition) ? 2 : 1);
+        }
+        emitEdgeCopies(context, getEdgeCopies(context, basicBlock, LLVMValueAsBasicBlock(target)));
+        std::string label = context.bbLabelMap[target];
+        emit(context, JMP, {labelOperand(label)});
+    }
+}
+
+/**
+ * @brief Get the address expression with which `leal` computes an instruction into a register other than its first operand's.
+ *
+ * `leal` adds a register to a constant or to another register, or to itself times 2, 4 or 8, and writes the sum to any register
+ * without changing the operands or the flags: an add or a subtraction of a constant, an add whose first operand is in another
+ * register, or a multiplication by 2, 3, 5 or 9, takes one `leal` instead of a `movl` and an `addl`, `subl` or `imull`.
+ *
+ * @param context The code generation context.
+ * @param opcode The opcode of the LLVM instruction to compute.
+ * @param operand1 The first operand of the instruction.
+ * @param operand2 The second operand of the instruction.
+ * @param operationReg The register the result goes to.
+ * @return The address expression (`8(%ebx)`, `(%ebx,%ecx)` or `(%ebx,%ebx,2)`, with the 64-bit registers on x86-64), or no
+ * operand if `leal` cannot compute the instruction.
+ */
+static MachineOperand
+getLeaAddress(CodeGenContext &context, LLVMOpcode opcode, LLVMValueRef operand1, LLVMValueRef operand2, Register operationReg)
+{
+    if (!variableIsInRegister(context, operand1) || context.allocatedRegMap[operand1] == operationReg)
+    {
+        return noOperand();
+    }
+    Register base = context.allocatedRegMap[operand1];
+    int size = getPointerSize(context.target);
+
+    if ((opcode == LLVMAdd || opcode == LLVMSub) && LLVMIsAConstantInt(operand2) &&
+        (opcode == LLVMAdd || LLVMConstIntGetSExtValue(operand2) != INT_MIN))
+    {
+        long long value = LLVMConstIntGetSExtValue(operand2);
+        return memoryOperand(base, opcode == LLVMAdd ? value : -value, size);
+    }
+    if (opcode == LLVMAdd && variableIsInRegister(context, operand2))
+    {
+        return indexedMemoryOperand(base, context.allocatedRegMap[operand2], 1, size);
     }
+    if (opcode == LLVMMul && LLVMIsAConstantInt(operand2))
+    {
+        long long value = LLVMConstIntGetSExtValue(operand2);
+        if (value == 2 || value == 3 || value == 5 || value == 9)
+        {
+            return indexedMemoryOperand(base, base, value == 2 ? 1 : value - 1, size);
+        }
+    }
+    return noOperand();
+}
+
+/**
+ * @brief Get the operand that a comparison can compare in place, without moving its first operand into a register.
+ *
+ * `cmpl` only sets the flags, so it can compare the register or the stack slot of the first operand with the second operand, as
+ * long as the first one is not a constant and the two are not both in memory.
+ *
+ * @param context The code generation context.
+ * @param operand1 The first operand of the comparison.
+ * @param operand2 The second operand of the comparison.
+ * @return The register or the stack slot of the first operand, or no operand if it has to be moved into a register first.
+ */
+static MachineOperand
+getComparedOperand(CodeGenContext &context, LLVMValueRef operand1, LLVMValueRef operand2)
+{
+    if (LLVMIsAConstantInt(operand1))
+    {
+        return noOperand();
+    }
+    MachineOperand first = getValueOperand(context, operand1);
+    if (first.kind == MEMORY_OPERAND && getValueOperand(context, operand2).kind == MEMORY_OPERAND)
+    {
+        return noOperand();
+    }
+    return first;
+}
+
+/**
+ * @brief Get the stack slot that an instruction can compute in place, when its result and its first operand share it.
+ *
+ * The values that are never live at the same time share a stack slot (see colorStackSlots), so a spilled result can have the
+ * slot of its first operand, which dies with the instruction. `addl`, `subl` and `sall` can then update the slot with the second
+ * operand, a constant or a register, instead of loading it into `%eax`, computing there and storing the result back. `imull`
+ * cannot write to memory.
+ *
+ * @param context The code generation context.
+ * @param instruction The LLVM instruction to compute.
+ * @param operand1 The first operand of the instruction.
+ * @param operand2 The second operand of the instruction.
+ * @return The stack slot, or no operand if the instruction is computed in a register.
+ */
+static MachineOperand
+getInPlaceSlot(CodeGenContext &context, LLVMValueRef instruction, LLVMValueRef operand1, LLVMValueRef operand2)
+{
+    LLVMOpcode opcode = LLVMGetInstructionOpcode(instruction);
+    if ((opcode != LLVMAdd && opcode != LLVMSub && opcode != LLVMShl) || variableIsInRegister(context, instruction) ||
+        !variableIsInMemory(context, instruction) || LLVMIsAConstantInt(operand1) || variableIsInRegister(context, operand1) ||
+        context.offsetMap[operand1] != context.offsetMap[instruction] ||
+        getValueOperand(context, operand2).kind == MEMORY_OPERAND)
+    {
+        return noOperand();
+    }
+    return getStackSlot(context, context.offsetMap[instruction]);
 }
 
 /**
  * @brief Handle binary and comparison instructions.
  *
- * This function handles binary and comparison instructions by getting the first and second operands, checking if they are
- * constants, in registers, or in memory, and emitting the corresponding assembly opcode. If the first operand is in memory, the
- * function moves the result to a register or memory location.
+ * This function handles binary and comparison instructions by selecting, among a few patterns, the one that takes the fewest
+ * instructions. The constants are immediates (`addl $5, %ecx`) and the values in stack slots memory operands (`addl -8(%ebp),
+ * %ecx`); a constant first operand of an add or a multiplication goes second, where it can be an immediate. Multiplications by a
+ * power of two are shifts, and `leal` computes the adds, subtractions and multiplications that it can into a new register (see
+ * getLeaAddress). A comparison compares its first operand where it is (see getComparedOperand), and a spilled result that shares
+ * the slot of its first operand is computed in that slot (see getInPlaceSlot). Otherwise, the first operand is moved into the
+ * register of the result, or into `%eax` if the result is spilled, and the operation is applied to it with the second operand;
+ * a spilled result is then moved to its stack slot.
  *
  * @param instruction The LLVM instruction to handle.
  * @param context The code generation context.
@@ -663,8 +1316,7 @@ handleLLVMBr(LLVMValueRef instruction, CodeGenContext &context)
 static void
 handleBinaryAndComparisonInstructions(LLVMValueRef instruction, CodeGenContext &context)
 {
-    // Code to handle the LLVMAdd, LLVMSub, LLVMMul, and LLVMICmp opcodes
-    static std::ostream &out = context.outputFile;
+    // Code to handle the LLVMAdd, LLVMSub, LLVMMul, LLVMShl, and LLVMICmp opcodes
     Register operationReg;
 
     if (variableIsInRegister(context, instruction))
@@ -676,56 +1328,81 @@ handleBinaryAndComparisonInstructions(LLVMValueRef instruction, CodeGenContext &
         operationReg = EAX;
     }
 
-    // If the first operand is a constant, move it to operationReg
     LLVMValueRef operand1 = LLVMGetOperand(instruction, 0);
-    if (LLVMIsAConstant(operand1))
+    LLVMValueRef operand2 = LLVMGetOperand(instruction, 1);
+    LLVMOpcode opcode = LLVMGetInstructionOpcode(instruction);
+    if (opcode == LLVMShl && !LLVMIsAConstantInt(operand2))
     {
-        int value = LLVMConstIntGetSExtValue(operand1);
-        out << "\tmovl $" << value << ", %" << getRegisterName(operationReg) << "\n";
+        // A shift by a register needs its count in %cl, which the register allocator may have given to another value
+        throwError(instruction, "shift by a variable amount");
+        return;
     }
-    else if (variableIsInRegister(context, operand1))
+
+    // Adds and multiplications commute, so a constant can go second, as an immediate
+    if ((opcode == LLVMAdd || opcode == LLVMMul) && LLVMIsAConstantInt(operand1) && !LLVMIsAConstantInt(operand2))
     {
-        Register reg = context.allocatedRegMap[operand1];
+        std::swap(operand1, operand2);
+    }
 
-        if (getRegisterName(reg) != getRegisterName(operationReg))
-        {
-            out << "\tmovl %" << getRegisterName(reg) << ", %" << getRegisterName(operationReg) << "\n";
-        }
+    MachineOperand leaAddress = getLeaAddress(context, opcode, operand1, operand2, operationReg);
+    MachineOperand comparedOperand = opcode == LLVMICmp ? getComparedOperand(context, operand1, operand2) : noOperand();
+    MachineOperand inPlaceSlot = getInPlaceSlot(context, instruction, operand1, operand2);
+    if (leaAddress.kind != NO_OPERAND)
+    {
+        emit(context, LEAL, {leaAddress, registerOperand(operationReg)});
     }
-    else if (variableIsInMemory(context, operand1))
+    else if (comparedOperand.kind != NO_OPERAND)
     {
-        int offset = context.offsetMap[operand1];
-        out << "\tmovl " << offset << "(%ebp), %" << getRegisterName(operationReg) << "\n";
+        emit(context, CMPL, {getValueOperand(context, operand2), comparedOperand});
     }
-
-    LLVMValueRef operand2 = LLVMGetOperand(instruction, 1);
-    if (LLVMIsAConstant(operand2))
+    else if (inPlaceSlot.kind != NO_OPERAND)
     {
-        int value = LLVMConstIntGetSExtValue(operand2);
-        out << "\t" << getAssemblyOpcodeForInstruction(instruction) << " $" << value << ", %" << getRegisterName(operationReg) << "\n";
+        emit(context, getAssemblyOpcodeForInstruction(instruction), {getValueOperand(context, operand2), inPlaceSlot});
     }
-    else if (variableIsInRegister(context, operand2))
+    else
     {
-        Register reg = context.allocatedRegMap[operand2];
-        out << "\t" << getAssemblyOpcodeForInstruction(instruction) << " %" << getRegisterName(reg) << ", %" << getRegisterName(operationReg) << "\n";
+        // Move the first operand into operationReg
+        MachineOperand first = getValueOperand(context, operand1);
+        if (first != registerOperand(operationReg))
+        {
+            emit(context, MOVL, {first, registerOperand(operationReg)});
+        }
+
+        // Apply the operation with the second operand
+        MachineOperand second = getValueOperand(context, operand2);
+        MachineOperand reg = registerOperand(operationReg);
+        long long value = second.value;
+        if (second.kind == IMMEDIATE_OPERAND && opcode == LLVMMul && (value == 3 || value == 5 || value == 9))
+        {
+            emit(context, LEAL, {indexedMemoryOperand(operationReg, operationReg, value - 1, getPointerSize(context.target)), reg});
+        }
+        else if (second.kind == IMMEDIATE_OPERAND && opcode == LLVMMul && value > 0 && (value & (value - 1)) == 0)
+        {
+            int shift = 0;
+            while ((1LL << shift) != value)
+            {
+                shift++;
+            }
+            emit(context, SALL, {immediateOperand(shift), reg});
+        }
+        else
+        {
+            emit(context, getAssemblyOpcodeForInstruction(instruction), {second, reg});
+        }
     }
-    else if (variableIsInMemory(context, operand2))
+
+    // A comparison whose flags do not reach its branches turns them into its result, 0 or 1
+    if (opcode == LLVMICmp && comparisonNeedsValue(instruction))
     {
-        int offset = context.offsetMap[operand2];
-        out << "\t" << getAssemblyOpcodeForInstruction(instruction) << " " << offset << "(%ebp), %" << getRegisterName(operationReg) << "\n";
+        emit(context, getSetOpcodeForPredicate(LLVMGetICmpPredicate(instruction)), {registerOperand(EAX, 1)});
+        emit(context, MOVZBL, {registerOperand(EAX, 1), registerOperand(operationReg)});
     }
-    // else if (variableIsInMemory(context, operand2))
-    // {
-    //     int offset = context.offsetMap[operand2];
-    //     out << "\tmovl " << offset << "(%ebp), %ebx\n"; // Load the spilled value into a different register, let's say EBX for this example
-    //     out << "\t" << getAssemblyOpcodeForInstruction(instruction) << " %ebx, %" << getRegisterName(operationReg) << "\n";
-    // }
 
     // If the instruction ptr is in memory, move the result to the memory location
-    if (variableIsInMemory(context, instruction))
+    if (variableIsInMemory(context, instruction) && inPlaceSlot.kind == NO_OPERAND)
     {
         int offset = context.offsetMap[instruction];
-        out << "\tmovl %" << getRegisterName(operationReg) << ", " << offset << "(%ebp)\n";
+        emit(context, MOVL, {registerOperand(operationReg), getStackSlot(context, offset)});
     }
 }
 
@@ -737,17 +1414,23 @@ handleBinaryAndComparisonInstructions(LLVMValueRef instruction, CodeGenContext &
  * opcode and calls the appropriate handler function to generate the corresponding assembly code.
  *
  * @param basicBlock The basic block to generate assembly code for.
+ * @param blockIndex The index of the basic block in the function.
  * @param context The code generation context to use.
  */
 static void
-generateAssemblyForInstructions(LLVMBasicBlockRef basicBlock, CodeGenContext &context)
+generateAssemblyForInstructions(LLVMBasicBlockRef basicBlock, int blockIndex, CodeGenContext &context)
 {
     // Emit basic block label
-    static std::ostream &out = context.outputFile;
     std::string label = context.bbLabelMap[LLVMBasicBlockAsValue(basicBlock)];
     if (label != ".L0")
     {
-        out << label << ":\n";
+        emit(context, LABEL, {labelOperand(label)});
+    }
+
+    // Count the runs of the basic block in an instrumented function
+    if (!context.counterLabel.empty())
+    {
+        emitBlockCounter(context, blockIndex);
     }
 
     // Iterate through all instructions in the basic block
@@ -787,9 +1470,15 @@ generateAssemblyForInstructions(LLVMBasicBlockRef basicBlock, CodeGenContext &co
             // Do nothing
             break;
         }
+        case LLVMPHI:
+        {
+            // The incoming values are copied into the phi on the edges into the basic block (see handleLLVMBr)
+            break;
+        }
         case LLVMAdd:
         case LLVMSub:
         case LLVMMul:
+        case LLVMShl:
         case LLVMICmp:
         {
             handleBinaryAndComparisonInstructions(instruction, context);
@@ -803,6 +1492,7 @@ generateAssemblyForInstructions(LLVMBasicBlockRef basicBlock, CodeGenContext &co
         }
 
         instruction = LLVMGetNextInstruction(instruction);
+        context.position++;
     }
 }
 
@@ -810,52 +1500,78 @@ generateAssemblyForInstructions(LLVMBasicBlockRef basicBlock, CodeGenContext &co
  * @brief Generates assembly code for the basic blocks in a given code generation context.
  *
  * This function generates assembly code for the basic blocks in a given code generation context. It first emits the function
- * directives to the output file, and then iterates through all basic blocks in the function. For each basic block, the function
- * calls the `generateAssemblyForInstructions` function to generate assembly code for the instructions in the basic block. After
- * generating assembly code for all basic blocks, the function emits the function end directive to the output file.
+ * directives to the output file, and then iterates through all basic blocks in the function, in the order of the block layout
+ * (see block_layout.h). For each basic block, the function calls the `generateAssemblyForInstructions` function to generate
+ * assembly code for the instructions in the basic block, from the position of its first instruction in the order of the function,
+ * which the register allocator numbered the instructions in. Each return ends the function itself (see handleLLVMRet).
  *
  * @param context The code generation context to generate assembly code for.
+ * @param layout The basic blocks of the function, in the order to place them.
  */
 static void
-generateAssemblyForBasicBlocks(CodeGenContext &context)
+generateAssemblyForBasicBlocks(CodeGenContext &context, const std::vector<LLVMBasicBlockRef> &layout)
 {
-    LLVMBasicBlockRef basicBlock = LLVMGetFirstBasicBlock(context.function);
-
-    if (basicBlock)
+    if (layout.empty())
     {
-        printFunctionDirectives(context, context.outputFile, LLVMGetValueName(context.function));
+        return;
+    }
+    printFunctionDirectives(context);
+
+    // The position of the first instruction of each basic block, and its index in the function
+    std::unordered_map<LLVMBasicBlockRef, int> blockPositions;
+    std::unordered_map<LLVMBasicBlockRef, int> blockIndices;
+    int position = 0;
+    for (LLVMBasicBlockRef basicBlock = LLVMGetFirstBasicBlock(context.function); basicBlock;
+         basicBlock = LLVMGetNextBasicBlock(basicBlock))
+    {
+        blockPositions[basicBlock] = position;
+        blockIndices.emplace(basicBlock, blockIndices.size());
+        for (LLVMValueRef instruction = LLVMGetFirstInstruction(basicBlock); instruction;
+             instruction = LLVMGetNextInstruction(instruction))
+        {
+            position++;
+        }
     }
 
     // Iterate through the basic blocks in the function
-    while (basicBlock)
+    for (LLVMBasicBlockRef basicBlock : layout)
     {
         // Iterate over the instructions and generate assembly
-        generateAssemblyForInstructions(basicBlock, context);
-
-        // Get the next basic block
-        basicBlock = LLVMGetNextBasicBlock(basicBlock);
+        context.position = blockPositions[basicBlock];
+        generateAssemblyForInstructions(basicBlock, blockIndices[basicBlock], context);
     }
-
-    printFunctionEnd(context.outputFile);
 }
 
 /**
  * @brief Generates assembly code for a given LLVM function.
  *
  * This function generates assembly code for a given LLVM function. It first initializes data structures to store the basic block
- * labels and the offsets of the local variables, and then iterates through all basic blocks in the function. For each basic block,
- * the function calls the `createBBLabel` and `populateOffsetMap` functions to generate the basic block label and calculate the
- * offset of the local variables. After initializing the code generation context, the function calls the `generateAssemblyForBasicBlocks`
- * function to generate assembly code for the basic blocks in the function.
+ * labels and the offsets of the local variables, and then iterates through all basic blocks in the function, calling the
+ * `createBBLabel` function to generate the label of each, and calls the `populateOffsetMap` function to calculate the offsets of
+ * the local variables. After initializing the code generation context, the function calls the `generateAssemblyForBasicBlocks`
+ * function to select the machine instructions of the basic blocks in the function.
+ *
+ * The frame holds, from the base pointer down, the callee-saved registers the function uses, then on x86-64 the slot of the
+ * argument and a slot for each caller-saved register that a call saves, and then the stack slots of the values, which the values
+ * that are never live at the same time share.
  *
  * @param function The LLVM function to generate assembly code for.
+ * @param target The target to generate assembly code for.
  * @param allocatedRegMap A map of allocated registers for the function.
- * @param outputFile The output file to write the assembly code to.
- * @param usedEBX A flag indicating whether the EBX register is used in the function.
+ * @param machineFunction Receives the machine instructions of the function.
+ * @param layout The basic blocks of the function, in the order to place them.
+ * @param usedCalleeSaved The callee-saved registers used in the function.
  * @param funCounter The index of the function in the module.
+ * @param firstLabel The number of the first basic block label of the function: the number of basic blocks in the functions
+ *                   before it, so that labels are unique in the file.
+ * @param splitIntervals The values whose live interval was split, and the edges they are reloaded on.
+ * @param callSaves The caller-saved registers that each call saves.
+ * @param counterLabel The label of the block counters of the function if it is instrumented, or empty.
  */
 static void
-generateAssemblyForFunction(LLVMValueRef function, AllocatedReg &allocatedRegMap, std::ofstream &outputFile, bool &usedEBX, const int &funCounter)
+generateAssemblyForFunction(LLVMValueRef function, Target target, AllocatedReg &allocatedRegMap, MachineFunction &machineFunction,
+                            const std::vector<LLVMBasicBlockRef> &layout, RegisterSet usedCalleeSaved, int funCounter, int firstLabel,
+                            SplitIntervals &splitIntervals, CallSaves &callSaves, const std::string &counterLabel)
 {
     LLVMBasicBlockRef basicBlock = LLVMGetFirstBasicBlock(function);
 
@@ -864,108 +1580,270 @@ generateAssemblyForFunction(LLVMValueRef function, AllocatedReg &allocatedRegMap
         return;
     }
 
-    // Create data structures to store the basic block labels and the offsets of the local variables
-    static BasicBlockLabelMap bbLabelMap;
-    static OffsetMap offsetMap;
+    // The basic block labels and the stack offsets of the local variables of the function
+    BasicBlockLabelMap bbLabelMap;
+    OffsetMap offsetMap;
 
     // Keep track of the number of basic blocks in the function
     int bbCounter = 0;
 
-    // Keep track of the offset of the local variables
+    // Keep track of the offset of the local variables, below the saved callee-saved registers
     int localMem = 0;
+    for (int reg = 0; reg < NUM_REGISTERS; reg++)
+    {
+        if (usedCalleeSaved & registerBit((Register)reg))
+        {
+            localMem += getPointerSize(target);
+        }
+    }
 
-    if (usedEBX)
+    // The parameter (MiniC has at most one) is read from where the caller pushed it, 8 bytes above the base pointer on x86, or
+    // from the slot the prologue stores it to on x86-64, once the optimizer has promoted its alloca
+    int parameterOffset = 8;
+    if (target == X86_64_TARGET)
     {
-        localMem += 4; // 4 bytes for the EBX register
+        localMem += 4;
+        parameterOffset = -localMem;
+    }
+    if (LLVMCountParams(function) > 0)
+    {
+        offsetMap[LLVMGetParam(function, 0)] = parameterOffset;
     }
 
-    while (basicBlock)
+    // On x86-64, the caller-saved registers that the calls save have a slot each
+    std::vector<int> callSaveSlots(NUM_REGISTERS, 0);
+    if (target == X86_64_TARGET)
     {
-        createBBLabel(basicBlock, bbLabelMap);
+        RegisterSet saved = 0;
+        for (auto &saves : callSaves)
+        {
+            saved |= saves.second;
+        }
+        for (int reg = 0; reg < NUM_REGISTERS; reg++)
+        {
+            if (saved & registerBit((Register)reg))
+            {
+                localMem += 4;
+                callSaveSlots[reg] = -localMem;
+            }
+        }
+    }
 
-        populateOffsetMap(basicBlock, allocatedRegMap, usedEBX, offsetMap, localMem);
+    while (basicBlock)
+    {
+        createBBLabel(basicBlock, firstLabel, bbLabelMap);
 
         // Get the next basic block and increment the basic block label counter
         basicBlock = LLVMGetNextBasicBlock(basicBlock);
         bbCounter++;
     }
 
+    populateOffsetMap(function, allocatedRegMap, splitIntervals, parameterOffset, offsetMap, localMem);
+
 #ifdef DEBUG
     printOffsetMap(offsetMap);
     cout << "Local memory: " << localMem << endl;
 #endif
 
-    CodeGenContext context(function, bbLabelMap, allocatedRegMap, offsetMap, outputFile, usedEBX, funCounter, localMem);
-    generateAssemblyForBasicBlocks(context);
+    CodeGenContext context(function, target, bbLabelMap, allocatedRegMap, offsetMap, usedCalleeSaved, funCounter, localMem,
+                           splitIntervals, callSaves, callSaveSlots, counterLabel);
+    generateAssemblyForBasicBlocks(context, layout);
+    machineFunction = std::move(context.machineFunction);
 }
 
 /**
- * @brief Generates assembly code for a given LLVM module.
+ * @brief Allocates the registers of a function, orders its basic blocks, selects its machine instructions and rewrites them.
  *
- * This function generates assembly code for a given LLVM module. It first initializes the output file and writes the top-level
- * directives to the output file. It then iterates through all functions in the module, allocating registers for each function and
- * calling the `generateAssemblyForFunction` function to generate assembly code for the function. After generating assembly code for
- * all functions, the function writes the top-level end directive to the output file and closes the output file.
+ * Everything this function reads or writes belongs to the function, so the functions of a module can be generated on different
+ * threads; the function must already be materialized.
  *
- * @param module The LLVM module to generate assembly code for.
- * @param filename The name of the output file to write the assembly code to.
+ * @param function The LLVM function to generate code for.
+ * @param allocator The register allocator to use.
+ * @param target The target to generate code for.
+ * @param funCounter The index of the function in the module.
+ * @param firstLabel The number of the first basic block label of the function.
+ * @param instrument Whether to count the runs of the basic blocks of the function (-fprofile-generate).
+ * @param blockCounts The number of times each basic block of the function ran in the profile (-fprofile-use), or NULL.
+ * @param machineFunction Receives the machine instructions of the function.
  */
-void generateAssemblyCode(LLVMModuleRef module, const char *filename)
+static void
+generateMachineFunction(LLVMValueRef function, RegisterAllocator allocator, Target target, int funCounter, int firstLabel,
+                        bool instrument, const std::vector<uint64_t> *blockCounts, MachineFunction &machineFunction)
 {
-    LLVMValueRef function = LLVMGetFirstFunction(module);
-
-    // Save the output to a file with the same name as the input file but with a .s extension
-    std::ofstream outputFile = openOutputFile(filename);
-    printTopLevelDirective(outputFile, filename);
-
-    int funCounter = 0;
-    while (function)
+    // Allocate registers for the function
+    RegisterSet usedCalleeSaved = 0;
+    AllocatedReg allocatedRegMap;
+    SplitIntervals splitIntervals;
+    CallSaves callSaves;
     {
-        // Allocate registers for the function
-        bool usedEBX = false;
-        AllocatedReg allocatedRegMap = allocateRegisterForFunction(function, usedEBX);
+        phaseTimer timer("Register allocation");
+        allocatedRegMap = allocator == GRAPH_COLORING_ALLOCATOR
+                              ? colorRegistersForFunction(function, target, usedCalleeSaved, callSaves, blockCounts)
+                              : allocateRegisterForFunction(function, target, usedCalleeSaved, splitIntervals, callSaves, blockCounts);
+    }
 
-        // Generate assembly code for the function
-        generateAssemblyForFunction(function, allocatedRegMap, outputFile, usedEBX, funCounter);
+    // Order the basic blocks of the function
+    std::vector<LLVMBasicBlockRef> layout;
+    if (LLVMGetFirstBasicBlock(function))
+    {
+        phaseTimer timer("Block layout");
+        layout = computeBlockLayout(function, blockCounts);
+    }
 
-        // Get the next function and increment the function counter
-        function = LLVMGetNextFunction(function);
-        funCounter++;
+    // Select the machine instructions of the function and rewrite them
+    {
+        phaseTimer timer("Instruction selection");
+        generateAssemblyForFunction(function, target, allocatedRegMap, machineFunction, layout, usedCalleeSaved, funCounter,
+                                    firstLabel, splitIntervals, callSaves, instrument ? getCounterLabel(funCounter) : "");
+    }
+    {
+        phaseTimer timer("Peephole optimization");
+        optimizePeepholes(machineFunction);
     }
 }
 
 /**
- * @brief The entry point of the program.
+ * @brief Generates assembly code for a given LLVM module into an output stream.
+ *
+ * This function writes the top-level directives to the output stream. It then generates the machine instructions of each
+ * function in the module with `generateMachineFunction`, with its basic blocks in the order of the block layout, and prints them
+ * as assembly. Each function is generated on its own: its basic block labels and stack offsets belong to it, and its labels are
+ * numbered from the number of basic blocks in the functions before it, which is known before any function is generated. With
+ * more than one thread, the functions are generated by a pool of workers, each function into its own buffer, and the buffers are
+ * concatenated in the order of the functions, so the output is the same as with one thread. The assembly code of the module is
+ * collected in a string and written to the output stream at once, rather than line by line. For an object, the machine
+ * instructions of every function are kept until the end, and encoded into the object at once.
  *
- * This function is the entry point of the program. It checks the number of command-line arguments and creates an LLVM module from
- * the specified IR file. If the module is valid, it calls the `generateAssemblyCode` function to generate assembly code for the
- * module. If the module is invalid, the function prints an error message and returns a non-zero exit code.
+ * An instrumented module counts the runs of each basic block, and ends with its counters and their descriptors (see
+ * printProfileData). With a profile, the block counts of each function whose control-flow graph has the checksum it was counted
+ * with guide its register allocation and block layout. Either way, the checksums are computed before the functions are generated,
+ * as the code generator changes nothing in the IR.
  *
- * @param argc The number of command-line arguments.
- * @param argv An array of command-line argument strings.
- * @return An integer representing the exit code of the program.
+ * @param module The LLVM module to generate assembly code for.
+ * @param filename The name of the source file, for the `.file` directive or the file symbol.
+ * @param outputFile The output stream to write the assembly code (or the object) to.
+ * @param allocator The register allocator to use.
+ * @param target The target to generate assembly code for.
+ * @param format The format to write: assembly, or an object.
+ * @param numThreads The number of threads to generate the functions with.
+ * @param profile The profile-guided compilation of the module: its instrumentation, or the profile to compile it by.
+ * @return true if the assembly code was generated, false if a function could not be read.
  */
-int main(int argc, char **argv)
+bool generateAssemblyCode(LLVMModuleRef module, const char *filename, std::ostream &outputFile, RegisterAllocator allocator,
+                          Target target, OutputFormat format, unsigned numThreads, const ProfileOptions &profile)
 {
-    // Check the number of arguments
-    if (argc != 2)
+    // Read the bodies of the functions first if the module was loaded lazily from bitcode, as the bitcode reader cannot run on
+    // several threads, and number the first label of each function
+    std::vector<LLVMValueRef> functions;
+    std::vector<int> firstLabels;
+    int numLabels = 0;
+    for (LLVMValueRef function = LLVMGetFirstFunction(module); function; function = LLVMGetNextFunction(function))
+    {
+        if (!materializeFunction(function))
+        {
+            return false;
+        }
+        functions.push_back(function);
+        firstLabels.push_back(numLabels);
+        numLabels += LLVMCountBasicBlocks(function);
+    }
+
+    // The checksums of the functions, and their block counts in the profile
+    std::vector<uint32_t> checksums(functions.size(), 0);
+    std::vector<const std::vector<uint64_t> *> blockCounts(functions.size(), NULL);
+    if (profile.instrument || profile.profile)
     {
-        cout << "Usage: " << argv[0] << " <filename.ll>" << endl;
-        return 1;
+        for (size_t i = 0; i < functions.size(); i++)
+        {
+            checksums[i] = computeCFGChecksum(ControlFlowGraph(functions[i]));
+            if (profile.profile)
+            {
+                blockCounts[i] = profile.profile->blockCounts(LLVMGetValueName(functions[i]), checksums[i]);
+            }
+        }
     }
 
-    // Create LLVM module from IR file
-    LLVMModuleRef module = createLLVMModel(argv[1]);
+#ifdef DEBUG
+    // The DEBUG output of the register allocator and the code generator goes straight to standard output
+    numThreads = 1;
+#endif
 
-    // Check if module is valid
-    if (!module)
+    // The machine instructions of each function, and for assembly the text they are printed as
+    std::vector<MachineFunction> machineFunctions(functions.size());
+    std::vector<std::string> texts(functions.size());
+    auto generateFunction = [&](size_t i)
     {
-        cout << "Error: Invalid LLVM IR file" << endl;
-        return 2;
+        generateMachineFunction(functions[i], allocator, target, i, firstLabels[i], profile.instrument, blockCounts[i],
+                                machineFunctions[i]);
+        if (format == ASSEMBLY_OUTPUT)
+        {
+            phaseTimer timer("Assembly emission");
+            printMachineFunction(machineFunctions[i], texts[i]);
+        }
+    };
+    if (numThreads <= 1 || functions.size() <= 1)
+    {
+        for (size_t i = 0; i < functions.size(); i++)
+        {
+            generateFunction(i);
+        }
+    }
+    else
+    {
+        ThreadPool pool(std::min<size_t>(numThreads, functions.size()));
+        for (size_t i = 0; i < functions.size(); i++)
+        {
+            pool.submit([&, i] { generateFunction(i); });
+        }
+        pool.wait();
     }
 
-    // Perform register allocation
-    generateAssemblyCode(module, argv[1]);
+    std::string text;
+    if (format == OBJECT_OUTPUT)
+    {
+        phaseTimer timer("Object emission");
+        writeELFObject(machineFunctions, filename, target, text);
+    }
+    else
+    {
+        printTopLevelDirective(text, filename);
+        for (const std::string &functionText : texts)
+        {
+            text += functionText;
+        }
+        if (profile.instrument)
+        {
+            printProfileData(text, target, functions, firstLabels, checksums);
+        }
+        printTopLevelEnd(text, target);
+    }
+    outputFile.write(text.data(), text.size());
+    return true;
+}
 
-    return 0;
-}
\ No newline at end of file
+/**
+ * @brief Generates assembly code for a given LLVM module.
+ *
+ * This function generates assembly code for a given LLVM module. It first initializes the output file, then generates the
+ * assembly code of the module into it with the stream version of `generateAssemblyCode`.
+ *
+ * @param module The LLVM module to generate assembly code for.
+ * @param filename The name of the output file to write the assembly code to.
+ * @param allocator The register allocator to use.
+ * @param target The target to generate assembly code for.
+ * @param format The format to write: assembly, or an object.
+ * @param numThreads The number of threads to generate the functions with.
+ * @param profile The profile-guided compilation of the module.
+ * @return true if the output file was written, false if it could not be opened or a function could not be read.
+ */
+bool generateAssemblyCode(LLVMModuleRef module, const char *filename, RegisterAllocator allocator, Target target,
+                          OutputFormat format, unsigned numThreads, const ProfileOptions &profile)
+{
+    // Save the output to a file with the same name as the input file but with a .s (or .o) extension
+    std::ofstream outputFile = openOutputFile(filename, format);
+    if (!outputFile.is_open())
+    {
+        return false;
+    }
+    return generateAssemblyCode(module, filename, outputFile, allocator, target, format, numThreads, profile);
+}
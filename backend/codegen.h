@@ -7,16 +7,24 @@
  * The `generateAssemblyCode` function generates assembly code for a given LLVM module. It first initializes the output file and writes
  * the top-level directives to the output file. It then iterates through all functions in the module, allocating registers for each
  * function and calling the `generateAssemblyForFunction` function to generate assembly code for the function. After generating assembly
- * code for all functions, the function writes the top-level end directive to the output file and closes the output file.
- *
- * The `CodeGenContext` class contains the context for code generation. It contains the LLVM function, basic block label map, allocated
- * register map, offset map, output file stream, and other parameters needed for code generation. The `function` member variable is the
- * LLVM function to generate code for. The `bbLabelMap` member variable is a map that associates each basic block with a label. The
- * `allocatedRegMap` member variable is a map that associates each register with an LLVM value. The `offsetMap` member variable is a map
- * that associates each local variable with its offset in the stack frame. The `outputFile` member variable is a reference to the output
- * file stream for the generated code. The `usedEBX` member variable indicates whether the `EBX` register is used as a base pointer in
- * the stack frame. The `funCounter` member variable is a counter that is incremented for each function in the module. The `localMem`
- * member variable is the total size of the local variables in the stack frame.
+ * code for all functions, the function writes the top-level end directive to the output file and closes the output file. The assembly
+ * of the module is collected in memory, and written to the output file at once. The code of each function depends on nothing but
+ * the function, so the functions can be generated on several threads, each into its own buffer; the buffers are concatenated in
+ * the order of the functions, and the output is the same as with one thread. With `-filetype=obj`, the machine instructions are
+ * encoded into a relocatable ELF object instead (see elf_object.h), which the linker takes without running the assembler.
+ * With `-fprofile-generate`, every basic block counts its runs, and the program writes the counts to a profile when it exits;
+ * with `-fprofile-use`, the counts of a profile guide the register allocation and the block layout (see block_profile.h).
+ *
+ * The `CodeGenContext` class contains the context for code generation of one function. It contains the LLVM function, basic block label map, allocated
+ * register map, offset map, machine instructions, and other parameters needed for code generation. The `function` member variable is the
+ * LLVM function to generate code for. The `bbLabelMap` member variable is a map that associates each basic block of the function with a
+ * label. The `allocatedRegMap` member variable is a map that associates each register with an LLVM value. The `offsetMap` member variable is a map
+ * that associates each local variable with its offset in the stack frame. The `machineFunction` member variable receives the machine
+ * instructions of the function, which are printed as assembly once the whole function has been generated. The `usedCalleeSaved`
+ * member variable holds the callee-saved registers that the function uses, which its prologue saves. The `funCounter` member
+ * variable is the index of the function in the module. The `localMem` member variable is the total size of
+ * the local variables in the stack frame. The `counterLabel` member variable is the label of the block counters of an instrumented
+ * function.
  *
  * Type definitions for data structures used in the code generation are also provided. The `BasicBlockLabelMap` type is a map that
  * associates each basic block with a label. The `OffsetMap` type is a map that associates each LLVM value with its offset in the stack
@@ -31,6 +39,8 @@
 #ifndef CODEGEN_H
 #define CODEGEN_H
 
+#include "block_profile.h"
+#include "machine_ir.h"
 #include "register_allocation.h"
 #include <fstream>
 
@@ -39,6 +49,33 @@ typedef std::unordered_map<LLVMValueRef, std::string>
     BasicBlockLabelMap;
 typedef std::unordered_map<LLVMValueRef, int> OffsetMap; // ptr -> offset value
 
+// The formats the code generator writes a module in
+enum OutputFormat
+{
+    ASSEMBLY_OUTPUT, // AT&T assembly for the assembler (-filetype=asm), in `<basename>.s`
+    OBJECT_OUTPUT    // a relocatable ELF object for the linker (-filetype=obj), in `<basename>.o`
+};
+
+/**
+ * Parses a `-filetype=<format>` option.
+ *
+ * @param option A command-line argument.
+ * @param format Set to the format the option names, if the argument is the option and the format exists.
+ * @param valid Set to false if the argument is the option but names no format.
+ * @return true if the argument is the option.
+ */
+bool parseOutputFormatOption(const char *option, OutputFormat &format, bool &valid);
+
+/**
+ * @return The name of an output format in the `-filetype` option: "asm" or "obj".
+ */
+const char *getOutputFormatName(OutputFormat format);
+
+/**
+ * @return The extension of the file written in an output format: ".s" or ".o".
+ */
+const char *getOutputExtension(OutputFormat format);
+
 /**
  * @brief Generates assembly code for a given LLVM module.
  *
@@ -49,47 +86,98 @@ typedef std::unordered_map<LLVMValueRef, int> OffsetMap; // ptr -> offset value
  *
  * @param module The LLVM module to generate assembly code for.
  * @param filename The name of the output file to write the assembly code to.
+ * @param allocator The register allocator to use: linear scan, or graph coloring for release builds.
+ * @param target The target to generate assembly code for: 32-bit x86, or x86-64.
+ * @param format The format to write: assembly in `<basename>.s`, or an object in `<basename>.o`.
+ * @param numThreads The number of threads to generate the functions with; the output is the same with any number.
+ * @param profile The profile-guided compilation of the module: whether to count the runs of its basic blocks, which needs the
+ *                assembly format, and the profile to compile it by.
+ * @return true if the output file was written, false if it could not be opened or a function could not be read.
+ */
+bool generateAssemblyCode(LLVMModuleRef module, const char *filename, RegisterAllocator allocator = LINEAR_SCAN_ALLOCATOR,
+                          Target target = X86_TARGET, OutputFormat format = ASSEMBLY_OUTPUT, unsigned numThreads = 1,
+                          const ProfileOptions &profile = ProfileOptions());
+
+/**
+ * @brief Generates assembly code for a given LLVM module into an output stream.
+ *
+ * Same as above, except that the assembly code is written to `outputFile` instead of a file named after `filename`; the compile
+ * server uses it to return the assembly of inline sources to its clients.
+ *
+ * @param module The LLVM module to generate assembly code for.
+ * @param filename The name of the source file, for the `.file` directive or the file symbol.
+ * @param outputFile The output stream to write the assembly code (or the object) to.
+ * @param allocator The register allocator to use.
+ * @param target The target to generate assembly code for.
+ * @param format The format to write: assembly, or an object.
+ * @param numThreads The number of threads to generate the functions with.
+ * @param profile The profile-guided compilation of the module.
+ * @return true if the assembly code was generated, false if a function could not be read.
  */
-void generateAssemblyCode(LLVMModuleRef module, const char *filename);
+bool generateAssemblyCode(LLVMModuleRef module, const char *filename, std::ostream &outputFile,
+                          RegisterAllocator allocator = LINEAR_SCAN_ALLOCATOR, Target target = X86_TARGET,
+                          OutputFormat format = ASSEMBLY_OUTPUT, unsigned numThreads = 1,
+                          const ProfileOptions &profile = ProfileOptions());
 
 /**
- * @brief A class that contains the context for code generation.
+ * @brief A class that contains the context for code generation of one function.
  *
+ * The context holds nothing that other functions share, so the functions of a module can be generated on different threads.
  * This class contains the LLVM function, basic block label map, allocated register map,
- * offset map, output file stream, and other parameters needed for code generation.
+ * offset map, machine instructions, and other parameters needed for code generation.
  *
  * The `function` member variable is the LLVM function to generate code for.
  *
- * The `bbLabelMap` member variable is a map that associates each basic block with a label.
+ * The `target` member variable is the target to generate code for.
+ *
+ * The `bbLabelMap` member variable is a map that associates each basic block of the function with a label, numbered after the
+ * labels of the functions before it.
  *
  * The `allocatedRegMap` member variable is a map that associates each register with an LLVM value.
  *
  * The `offsetMap` member variable is a map that associates each local variable with its offset in the stack frame.
  *
- * The `outputFile` member variable is a reference to the output file stream for the generated code.
+ * The `machineFunction` member variable receives the machine instructions that the handlers select for the function.
  *
- * The `usedEBX` member variable indicates whether the `EBX` register is used as a base pointer in the stack frame.
+ * The `usedCalleeSaved` member variable holds the callee-saved registers that the function uses, which its prologue saves.
  *
- * The `funCounter` member variable is a counter that is incremented for each function in the module.
+ * The `funCounter` member variable is the index of the function in the module.
  *
  * The `localMem` member variable is the total size of the local variables in the stack frame.
+ *
+ * The `splitIntervals` member variable holds the values that the register allocator split, and the edges they are reloaded on.
+ *
+ * The `position` member variable is the position of the instruction being generated (see SplitIntervals).
+ *
+ * The `callSaves` member variable holds the caller-saved registers that each call saves.
+ *
+ * The `callSaveSlots` member variable holds the offset of the stack slot that each caller-saved register is saved to around the
+ * calls on x86-64, by register. On x86 the calls push them instead.
+ *
+ * The `counterLabel` member variable is the label of the block counters of the function if it is instrumented, or empty.
  */
 class CodeGenContext
 {
 public:
-    CodeGenContext(LLVMValueRef function, BasicBlockLabelMap &bbLabelMap, AllocatedReg &allocatedRegMap, OffsetMap &offsetMap, std::ofstream &outputFile, bool usedEBX, int funCounter, int localMem)
-        : function(function), bbLabelMap(bbLabelMap), allocatedRegMap(allocatedRegMap), offsetMap(offsetMap), outputFile(outputFile), usedEBX(usedEBX), funCounter(funCounter), localMem(localMem)
+    CodeGenContext(LLVMValueRef function, Target target, BasicBlockLabelMap &bbLabelMap, AllocatedReg &allocatedRegMap, OffsetMap &offsetMap, RegisterSet usedCalleeSaved, int funCounter, int localMem, SplitIntervals &splitIntervals, CallSaves &callSaves, const std::vector<int> &callSaveSlots, const std::string &counterLabel)
+        : function(function), target(target), bbLabelMap(bbLabelMap), allocatedRegMap(allocatedRegMap), offsetMap(offsetMap), machineFunction({LLVMGetValueName(function), {}}), usedCalleeSaved(usedCalleeSaved), funCounter(funCounter), localMem(localMem), splitIntervals(splitIntervals), position(0), callSaves(callSaves), callSaveSlots(callSaveSlots), counterLabel(counterLabel)
     {
     }
 
     LLVMValueRef function;
+    Target target;
     BasicBlockLabelMap bbLabelMap;
     AllocatedReg allocatedRegMap;
     OffsetMap offsetMap;
-    std::ofstream &outputFile;
-    bool usedEBX;
+    MachineFunction machineFunction;
+    RegisterSet usedCalleeSaved;
     int funCounter;
     int localMem;
+    SplitIntervals splitIntervals;
+    int position;
+    CallSaves callSaves;
+    std::vector<int> callSaveSlots;
+    std::string counterLabel;
 };
 
 #endif // CODEGEN_H
\ No newline at end of file
@@ -0,0 +1,104 @@
+/**
+ * @file codegen_main.cpp
+ * @brief Entry point of the standalone codegen executable.
+ *
+ * Reads an LLVM IR file and writes the x86 assembly (or object) generated by `generateAssemblyCode` next to it. The code generator itself lives
+ * in codegen.cpp so that the minicc driver can link it and generate assembly from its in-memory module.
+ *
+ * Usage:
+ *   ./codegen [-ftime-report[=json]] [-regalloc=linear|graph] [-m32|-m64] [-filetype=asm|obj] [-j[<threads>]]
+ *             [-fprofile-generate | -fprofile-use[=<file>]] <input_file>
+ *   <input_file>   - The LLVM IR file (or `.bc` bitcode file) to generate assembly code from.
+ *   -ftime-report  - Print the time, allocations and peak memory of each phase to stderr (as JSON with =json).
+ *   -regalloc      - Allocate registers by linear scan (the default) or by coloring the interference graph.
+ *   -m32, -m64     - Generate 32-bit x86 (the default) or x86-64 assembly.
+ *   -filetype      - Write assembly to `<basename>.s` (asm, the default), or a relocatable ELF object to `<basename>.o` (obj).
+ *   -j             - Generate the code of the functions on <threads> threads (one per hardware thread by default).
+ *   -fprofile-generate - Count the runs of every basic block; link the program with profile_runtime.c to write the counts.
+ *   -fprofile-use  - Lay out the blocks and weigh the spills by the counts of a profile (minicc.profile by default).
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "codegen.h"
+#include "thread_pool.h"
+#include "time_report.h"
+
+/**
+ * @brief The entry point of the program.
+ *
+ * This function is the entry point of the program. It checks the number of command-line arguments and creates an LLVM module from
+ * the specified IR file. If the module is valid, it calls the `generateAssemblyCode` function to generate assembly code for the
+ * module. If the module is invalid, the function prints an error message and returns a non-zero exit code.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv An array of command-line argument strings.
+ * @return An integer representing the exit code of the program.
+ */
+int main(int argc, char **argv)
+{
+    // The options (-ftime-report or -ftime-report=json, -regalloc, -m32 or -m64, -filetype, -j and the profile options) come
+    // before the input file
+    bool timeReportJSON = false;
+    RegisterAllocator allocator = LINEAR_SCAN_ALLOCATOR;
+    Target target = X86_TARGET;
+    OutputFormat format = ASSEMBLY_OUTPUT;
+    unsigned numThreads = 1;
+    ProfileOptions profileOptions = {false, NULL};
+    BlockProfile profile;
+    bool valid = true;
+    int first = 1;
+    while (first < argc && valid)
+    {
+        if (!strncmp(argv[first], "-j", 2))
+        {
+            numThreads = argv[first][2] ? atoi(argv[first] + 2) : ThreadPool::hardwareThreads();
+            valid = numThreads > 0;
+        }
+        else if (!parseTimeReportOption(argv[first], timeReportJSON) &&
+                 !parseRegisterAllocatorOption(argv[first], allocator, valid) && !parseTargetOption(argv[first], target) &&
+                 !parseOutputFormatOption(argv[first], format, valid) &&
+                 !parseProfileOption(argv[first], profileOptions, profile, valid))
+        {
+            break;
+        }
+        first++;
+    }
+
+    // Check the number of arguments; the block counters are only written as assembly
+    if (argc != first + 1 || !valid || (profileOptions.instrument && format != ASSEMBLY_OUTPUT))
+    {
+        cout << "Usage: " << argv[0]
+             << " [-ftime-report[=json]] [-regalloc=linear|graph] [-m32|-m64] [-filetype=asm|obj] [-j[<threads>]]"
+             << " [-fprofile-generate | -fprofile-use[=<file>]] <filename.ll|filename.bc>"
+             << endl;
+        return 1;
+    }
+    char *filename = argv[first];
+
+    // Create LLVM module from IR file, in a context owned by this compilation
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMModuleRef module = createLLVMModel(filename, context);
+
+    int exitCode;
+    if (!module)
+    {
+        // The module is not valid
+        cout << "Error: Invalid LLVM IR file" << endl;
+        exitCode = 2;
+    }
+    else
+    {
+        // Allocate registers and write the assembly (or object) file
+        exitCode = generateAssemblyCode(module, filename, allocator, target, format, numThreads, profileOptions) ? 0 : 3;
+        LLVMDisposeModule(module);
+    }
+    LLVMContextDispose(context);
+
+    if (timeReportEnabled())
+    {
+        printTimeReport(cerr, timeReportJSON);
+    }
+    return exitCode;
+}
@@ -0,0 +1,640 @@
+/**
+ * @file elf_object.cpp
+ *
+ * @brief This file contains the definitions of the object file writer: the encoding of the machine instructions, the sizing of
+ * the jumps, and the sections, symbols and relocations of the ELF object.
+ *
+ * An instruction is encoded as its REX prefix (x86-64 only), its opcode, the ModRM byte of its register and register or memory
+ * operand, the SIB byte and displacement of an address, and its immediate, in the forms the GNU assembler picks for the same
+ * assembly: the sign-extended 8-bit immediate whenever the constant fits, and the register to register/memory form (`89`, `01`,
+ * `29`, `39`) for two registers. The fields of the ELF structures are written one by one, as 4 or 8 bytes by the class of the
+ * object, rather than by copying the structures of <elf.h>, whose layouts differ between the classes.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "elf_object.h"
+#include <elf.h>
+
+// An instruction of a function as it is placed in `.text`: its encoding, or a jump or a label, which are placed by their label
+typedef struct
+{
+    MachineOpcode opcode;
+    std::string code;  // the encoding of the instruction; empty for jumps and labels
+    std::string label; // the label a jump goes to or a label defines, or the callee of a call
+    bool longJump;     // whether a jump takes its 32-bit displacement (5 or 6 bytes) rather than its 8-bit one (2 bytes)
+    size_t offset;     // the offset of the instruction in the function
+} PlacedInstr;
+
+// A call to relocate: the callee, and the offset in `.text` of the displacement the linker fills in
+typedef struct
+{
+    std::string callee;
+    size_t offset;
+} CallRelocation;
+
+// The sections of the object, by their index in the section header table
+enum
+{
+    NULL_SECTION,
+    TEXT_SECTION,
+    RELOCATION_SECTION,
+    SYMBOL_TABLE_SECTION,
+    STRING_TABLE_SECTION,
+    SECTION_NAME_SECTION,
+    GNU_STACK_SECTION // x86-64 only
+};
+
+/**
+ * @return The number of a register in the encoding of the instructions: 0 for EAX, 3 for EBX, 8 for R8D.
+ */
+static int
+getRegisterNumber(Register reg)
+{
+    static const int numbers[] = {0, 3, 1, 2, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    if (reg == ESP)
+    {
+        return 4;
+    }
+    if (reg == EBP)
+    {
+        return 5;
+    }
+    return numbers[reg];
+}
+
+/**
+ * @return The condition code of a `setcc` or conditional jump opcode, the last 4 bits of its opcode byte: 0x4 for SETE and JE.
+ */
+static int
+getConditionCode(MachineOpcode opcode)
+{
+    // In the order of the predicates: e, ne, g, ge, l, le
+    static const int codes[] = {0x4, 0x5, 0xF, 0xD, 0xC, 0xE};
+    return codes[opcode >= JE ? opcode - JE : opcode - SETE];
+}
+
+/**
+ * @return true if a constant fits in a sign-extended 8-bit immediate or displacement.
+ */
+static bool
+fitsInByte(long long value)
+{
+    return value >= -128 && value <= 127;
+}
+
+/**
+ * Appends an integer to a string, little-endian.
+ *
+ * @param bytes The string to append to.
+ * @param value The integer.
+ * @param size The number of bytes to append: 1, 2, 4 or 8.
+ */
+static void
+appendInteger(std::string &bytes, unsigned long long value, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        bytes += (char)(value >> (8 * i));
+    }
+}
+
+/**
+ * Appends an instruction with a ModRM byte: its REX prefix if it needs one, its opcode, the ModRM byte, and the SIB byte and
+ * displacement of a memory operand.
+ *
+ * @param code The encoding to append to.
+ * @param wide Whether the instruction operates on 64 bits (REX.W).
+ * @param opcode The bytes of the opcode.
+ * @param regField The register of the ModRM byte, or the extension of the opcode (`/5`).
+ * @param operand The register or memory operand of the ModRM byte.
+ */
+static void
+appendModRM(std::string &code, bool wide, std::initializer_list<int> opcode, int regField, const MachineOperand &operand)
+{
+    int base = getRegisterNumber(operand.reg);
+    int index = operand.kind == MEMORY_OPERAND && operand.index != NUM_REGISTERS ? getRegisterNumber(operand.index) : -1;
+    int rex = (wide ? 8 : 0) | (regField >> 3) << 2 | (index >> 3 > 0 ? 2 : 0) | base >> 3;
+    if (rex)
+    {
+        code += (char)(0x40 | rex);
+    }
+    for (int byte : opcode)
+    {
+        code += (char)byte;
+    }
+
+    if (operand.kind == REGISTER_OPERAND)
+    {
+        code += (char)(0xC0 | (regField & 7) << 3 | (base & 7));
+        return;
+    }
+
+    // A base of EBP (or R13) has no form without a displacement, which encodes an address with no base
+    int mod = operand.value == 0 && (base & 7) != 5 ? 0 : fitsInByte(operand.value) ? 1 : 2;
+    if (index < 0 && (base & 7) != 4)
+    {
+        code += (char)(mod << 6 | (regField & 7) << 3 | (base & 7));
+    }
+    else
+    {
+        // An index, or a base of ESP (or R12), takes a SIB byte; an index of 4 in it stands for none
+        int scale = operand.scale == 8 ? 3 : operand.scale == 4 ? 2 : operand.scale == 2 ? 1 : 0;
+        code += (char)(mod << 6 | (regField & 7) << 3 | 4);
+        code += (char)(scale << 6 | (index < 0 ? 4 : index & 7) << 3 | (base & 7));
+    }
+    if (mod > 0)
+    {
+        appendInteger(code, operand.value, mod == 1 ? 1 : 4);
+    }
+}
+
+/**
+ * Appends an instruction that takes its register from its opcode (`push`, `pop`, `mov` of a constant): its REX prefix if the
+ * register is R8D to R15D, and its opcode plus the number of the register.
+ */
+static void
+appendRegisterInOpcode(std::string &code, int opcode, Register reg)
+{
+    int number = getRegisterNumber(reg);
+    if (number >= 8)
+    {
+        code += (char)0x41;
+    }
+    code += (char)(opcode + (number & 7));
+}
+
+/**
+ * Appends an instruction of the arithmetic group: `add`, `sub` or `cmp`.
+ *
+ * @param code The encoding to append to.
+ * @param instruction The instruction.
+ * @param wide Whether it operates on 64 bits.
+ * @param group The number of the instruction in the group: its first opcode byte over 8, and its extension of `83` and `81`.
+ */
+static void
+appendArithmetic(std::string &code, const MachineInstr &instruction, bool wide, int group)
+{
+    const MachineOperand &source = instruction.operands[0];
+    const MachineOperand &destination = instruction.operands[1];
+    if (source.kind == IMMEDIATE_OPERAND)
+    {
+        appendModRM(code, wide, {fitsInByte(source.value) ? 0x83 : 0x81}, group, destination);
+        appendInteger(code, source.value, fitsInByte(source.value) ? 1 : 4);
+    }
+    else if (source.kind == REGISTER_OPERAND)
+    {
+        appendModRM(code, wide, {group * 8 + 1}, getRegisterNumber(source.reg), destination);
+    }
+    else
+    {
+        appendModRM(code, wide, {group * 8 + 3}, getRegisterNumber(destination.reg), source);
+    }
+}
+
+/**
+ * Encodes an instruction other than a jump or a label. A call is encoded with a displacement of 0, which its relocation fills
+ * in.
+ *
+ * @param instruction The instruction.
+ * @return The bytes of the instruction.
+ */
+static std::string
+encodeInstruction(const MachineInstr &instruction)
+{
+    std::string code;
+    const std::vector<MachineOperand> &operands = instruction.operands;
+    switch (instruction.opcode)
+    {
+    case MOVL:
+    case MOVQ:
+    {
+        bool wide = instruction.opcode == MOVQ;
+        if (operands[0].kind == IMMEDIATE_OPERAND && operands[1].kind == REGISTER_OPERAND && !wide)
+        {
+            appendRegisterInOpcode(code, 0xB8, operands[1].reg);
+            appendInteger(code, operands[0].value, 4);
+        }
+        else if (operands[0].kind == IMMEDIATE_OPERAND)
+        {
+            appendModRM(code, wide, {0xC7}, 0, operands[1]);
+            appendInteger(code, operands[0].value, 4);
+        }
+        else if (operands[0].kind == REGISTER_OPERAND)
+        {
+            appendModRM(code, wide, {0x89}, getRegisterNumber(operands[0].reg), operands[1]);
+        }
+        else
+        {
+            appendModRM(code, wide, {0x8B}, getRegisterNumber(operands[1].reg), operands[0]);
+        }
+        break;
+    }
+    case MOVZBL:
+        appendModRM(code, false, {0x0F, 0xB6}, getRegisterNumber(operands[1].reg), operands[0]);
+        break;
+    case LEAL:
+        appendModRM(code, false, {0x8D}, getRegisterNumber(operands[1].reg), operands[0]);
+        break;
+    case ADDL:
+    case ADDQ:
+        appendArithmetic(code, instruction, instruction.opcode == ADDQ, 0);
+        break;
+    case ADCL:
+        appendArithmetic(code, instruction, false, 2);
+        break;
+    case SUBL:
+    case SUBQ:
+        appendArithmetic(code, instruction, instruction.opcode == SUBQ, 5);
+        break;
+    case CMPL:
+        appendArithmetic(code, instruction, false, 7);
+        break;
+    case IMULL:
+        if (operands[0].kind == IMMEDIATE_OPERAND)
+        {
+            // The three-operand form, with the destination as the source
+            bool byte = fitsInByte(operands[0].value);
+            appendModRM(code, false, {byte ? 0x6B : 0x69}, getRegisterNumber(operands[1].reg), operands[1]);
+            appendInteger(code, operands[0].value, byte ? 1 : 4);
+        }
+        else
+        {
+            appendModRM(code, false, {0x0F, 0xAF}, getRegisterNumber(operands[1].reg), operands[0]);
+        }
+        break;
+    case SALL:
+        if (operands[0].value == 1)
+        {
+            appendModRM(code, false, {0xD1}, 4, operands[1]);
+        }
+        else
+        {
+            appendModRM(code, false, {0xC1}, 4, operands[1]);
+            appendInteger(code, operands[0].value, 1);
+        }
+        break;
+    case SETE:
+    case SETNE:
+    case SETG:
+    case SETGE:
+    case SETL:
+    case SETLE:
+        appendModRM(code, false, {0x0F, 0x90 | getConditionCode(instruction.opcode)}, 0, operands[0]);
+        break;
+    case PUSHL:
+    case PUSHQ:
+        if (operands[0].kind == REGISTER_OPERAND)
+        {
+            appendRegisterInOpcode(code, 0x50, operands[0].reg);
+        }
+        else if (operands[0].kind == IMMEDIATE_OPERAND)
+        {
+            code += (char)(fitsInByte(operands[0].value) ? 0x6A : 0x68);
+            appendInteger(code, operands[0].value, fitsInByte(operands[0].value) ? 1 : 4);
+        }
+        else
+        {
+            appendModRM(code, false, {0xFF}, 6, operands[0]);
+        }
+        break;
+    case POPL:
+    case POPQ:
+        if (operands[0].kind == REGISTER_OPERAND)
+        {
+            appendRegisterInOpcode(code, 0x58, operands[0].reg);
+        }
+        else
+        {
+            appendModRM(code, false, {0x8F}, 0, operands[0]);
+        }
+        break;
+    case CALL:
+        code += (char)0xE8;
+        appendInteger(code, 0, 4);
+        break;
+    case LEAVE:
+        code += (char)0xC9;
+        break;
+    default: // RET
+        code += (char)0xC3;
+        break;
+    }
+    return code;
+}
+
+/**
+ * @return true if an opcode is a jump, conditional or not.
+ */
+static bool
+isJump(MachineOpcode opcode)
+{
+    return opcode >= JMP && opcode <= JLE;
+}
+
+/**
+ * @return The size of a placed instruction: its encoding, 2 bytes for a short jump, 5 or 6 for a long one, and none for a
+ * label.
+ */
+static size_t
+getPlacedSize(const PlacedInstr &instruction)
+{
+    if (instruction.opcode == LABEL)
+    {
+        return 0;
+    }
+    if (isJump(instruction.opcode))
+    {
+        return !instruction.longJump ? 2 : instruction.opcode == JMP ? 5 : 6;
+    }
+    return instruction.code.size();
+}
+
+/**
+ * Encodes the instructions of a function and appends them to `.text`. The jumps start short; while the target of a short jump is
+ * out of its reach, it is made long and the instructions are placed again. A jump never becomes short again, so this ends.
+ *
+ * @param function The function.
+ * @param text The contents of `.text`, to append to.
+ * @param calls The calls to relocate, to append to.
+ */
+static void
+encodeFunction(const MachineFunction &function, std::string &text, std::vector<CallRelocation> &calls)
+{
+    std::vector<PlacedInstr> placed;
+    placed.reserve(function.instructions.size());
+    for (const MachineInstr &instruction : function.instructions)
+    {
+        PlacedInstr entry = {instruction.opcode, "", "", false, 0};
+        if (instruction.opcode == LABEL || isJump(instruction.opcode) || instruction.opcode == CALL)
+        {
+            entry.label = instruction.operands[0].label;
+        }
+        if (instruction.opcode != LABEL && !isJump(instruction.opcode))
+        {
+            entry.code = encodeInstruction(instruction);
+        }
+        placed.push_back(entry);
+    }
+
+    // <label, its offset in the function>
+    std::unordered_map<std::string, size_t> labels;
+    bool grown = true;
+    while (grown)
+    {
+        size_t offset = 0;
+        for (PlacedInstr &instruction : placed)
+        {
+            instruction.offset = offset;
+            offset += getPlacedSize(instruction);
+            if (instruction.opcode == LABEL)
+            {
+                labels[instruction.label] = instruction.offset;
+            }
+        }
+
+        grown = false;
+        for (PlacedInstr &instruction : placed)
+        {
+            if (isJump(instruction.opcode) && !instruction.longJump &&
+                !fitsInByte((long long)labels[instruction.label] - (long long)(instruction.offset + 2)))
+            {
+                instruction.longJump = true;
+                grown = true;
+            }
+        }
+    }
+
+    size_t start = text.size();
+    for (const PlacedInstr &instruction : placed)
+    {
+        if (isJump(instruction.opcode))
+        {
+            long long displacement = (long long)labels[instruction.label] - (long long)(instruction.offset + getPlacedSize(instruction));
+            if (!instruction.longJump)
+            {
+                text += (char)(instruction.opcode == JMP ? 0xEB : 0x70 | getConditionCode(instruction.opcode));
+                appendInteger(text, displacement, 1);
+            }
+            else
+            {
+                text += instruction.opcode == JMP ? std::string(1, (char)0xE9)
+                                                  : std::string{(char)0x0F, (char)(0x80 | getConditionCode(instruction.opcode))};
+                appendInteger(text, displacement, 4);
+            }
+        }
+        else if (instruction.opcode == CALL)
+        {
+            // The callee is named as `print@PLT`: the linker goes through the PLT if the function is in a shared library
+            const std::string &callee = instruction.label;
+            calls.push_back({callee.substr(0, callee.find('@')), start + instruction.offset + 1});
+            text += instruction.code;
+        }
+        else
+        {
+            text += instruction.code;
+        }
+    }
+}
+
+/**
+ * Appends a symbol to the symbol table.
+ *
+ * @param symbols The symbol table, to append to.
+ * @param x86_64 Whether the object is 64-bit.
+ * @param name The offset of the name of the symbol in `.strtab`.
+ * @param info The binding and type of the symbol.
+ * @param section The index of the section of the symbol.
+ * @param value The offset of the symbol in its section.
+ * @param size The size of the symbol.
+ */
+static void
+appendSymbol(std::string &symbols, bool x86_64, size_t name, int info, int section, size_t value, size_t size)
+{
+    appendInteger(symbols, name, 4);
+    if (x86_64)
+    {
+        appendInteger(symbols, info, 1);
+        appendInteger(symbols, STV_DEFAULT, 1);
+        appendInteger(symbols, section, 2);
+        appendInteger(symbols, value, 8);
+        appendInteger(symbols, size, 8);
+    }
+    else
+    {
+        appendInteger(symbols, value, 4);
+        appendInteger(symbols, size, 4);
+        appendInteger(symbols, info, 1);
+        appendInteger(symbols, STV_DEFAULT, 1);
+        appendInteger(symbols, section, 2);
+    }
+}
+
+/**
+ * Appends a section header to the section header table.
+ *
+ * @param headers The section header table, to append to.
+ * @param word The size of the addresses, offsets and sizes of the object: 4 or 8 bytes.
+ * @param name The offset of the name of the section in `.shstrtab`.
+ * @param type The type of the section.
+ * @param flags The flags of the section.
+ * @param offset The offset of the contents of the section in the object.
+ * @param size The size of the contents of the section.
+ * @param link The section that the section links to.
+ * @param info The extra information of the section.
+ * @param alignment The alignment of the section.
+ * @param entrySize The size of the entries of the section, if it is a table.
+ */
+static void
+appendSectionHeader(std::string &headers, int word, size_t name, int type, int flags, size_t offset, size_t size, int link,
+                    int info, int alignment, int entrySize)
+{
+    appendInteger(headers, name, 4);
+    appendInteger(headers, type, 4);
+    appendInteger(headers, flags, word);
+    appendInteger(headers, 0, word); // the address, which the linker assigns
+    appendInteger(headers, offset, word);
+    appendInteger(headers, size, word);
+    appendInteger(headers, link, 4);
+    appendInteger(headers, info, 4);
+    appendInteger(headers, alignment, word);
+    appendInteger(headers, entrySize, word);
+}
+
+/**
+ * @return The offset of a name in a string table, to which it is appended.
+ */
+static size_t
+addString(std::string &table, const std::string &name)
+{
+    size_t offset = table.size();
+    table += name;
+    table += '\0';
+    return offset;
+}
+
+void writeELFObject(const std::vector<MachineFunction> &functions, const std::string &filename, Target target,
+                    std::string &object)
+{
+    bool x86_64 = target == X86_64_TARGET;
+    int word = x86_64 ? 8 : 4;
+
+    // .text, and the functions defined in it
+    std::string text;
+    std::vector<CallRelocation> calls;
+    std::vector<std::pair<size_t, size_t>> extents; // <function, its offset and size in .text>
+    for (const MachineFunction &function : functions)
+    {
+        size_t start = text.size();
+        encodeFunction(function, text, calls);
+        extents.push_back({start, text.size() - start});
+    }
+
+    // The symbols: the source file and .text (local), then the functions defined here and the callees that are not (global)
+    std::string strings(1, '\0');
+    std::string symbols;
+    appendSymbol(symbols, x86_64, 0, 0, SHN_UNDEF, 0, 0);
+    appendSymbol(symbols, x86_64, addString(strings, filename), ELF32_ST_INFO(STB_LOCAL, STT_FILE), SHN_ABS, 0, 0);
+    appendSymbol(symbols, x86_64, 0, ELF32_ST_INFO(STB_LOCAL, STT_SECTION), TEXT_SECTION, 0, 0);
+    int firstGlobal = 3;
+    std::unordered_map<std::string, int> symbolIndices;
+    for (size_t i = 0; i < functions.size(); i++)
+    {
+        if (!functions[i].instructions.empty())
+        {
+            int index = firstGlobal + symbolIndices.size();
+            symbolIndices[functions[i].name] = index;
+            appendSymbol(symbols, x86_64, addString(strings, functions[i].name), ELF32_ST_INFO(STB_GLOBAL, STT_FUNC),
+                         TEXT_SECTION, extents[i].first, extents[i].second);
+        }
+    }
+    for (const CallRelocation &call : calls)
+    {
+        if (symbolIndices.count(call.callee) == 0)
+        {
+            int index = firstGlobal + symbolIndices.size();
+            symbolIndices[call.callee] = index;
+            appendSymbol(symbols, x86_64, addString(strings, call.callee), ELF32_ST_INFO(STB_GLOBAL, STT_NOTYPE), SHN_UNDEF,
+                         0, 0);
+        }
+    }
+
+    // The relocations of the calls: the displacement is the callee (through the PLT) minus the end of the call, 4 bytes past
+    // the displacement. x86 keeps the -4 in .text (.rel), x86-64 in the relocation (.rela)
+    std::string relocations;
+    for (const CallRelocation &call : calls)
+    {
+        int symbol = symbolIndices[call.callee];
+        appendInteger(relocations, call.offset, word);
+        if (x86_64)
+        {
+            appendInteger(relocations, ELF64_R_INFO((unsigned long long)symbol, R_X86_64_PLT32), 8);
+            appendInteger(relocations, -4, 8);
+        }
+        else
+        {
+            appendInteger(relocations, ELF32_R_INFO(symbol, R_386_PLT32), 4);
+            text.replace(call.offset, 4, std::string{(char)0xFC, (char)0xFF, (char)0xFF, (char)0xFF});
+        }
+    }
+
+    std::string sectionNames(1, '\0');
+    size_t textName = addString(sectionNames, ".text");
+    size_t relocationName = addString(sectionNames, x86_64 ? ".rela.text" : ".rel.text");
+    size_t symbolTableName = addString(sectionNames, ".symtab");
+    size_t stringTableName = addString(sectionNames, ".strtab");
+    size_t sectionNameName = addString(sectionNames, ".shstrtab");
+    size_t gnuStackName = x86_64 ? addString(sectionNames, ".note.GNU-stack") : 0;
+
+    // The layout of the object: the ELF header, the contents of the sections, then the section header table
+    size_t headerSize = x86_64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr);
+    size_t textOffset = headerSize;
+    size_t relocationOffset = (textOffset + text.size() + word - 1) / word * word;
+    size_t symbolTableOffset = relocationOffset + relocations.size();
+    size_t stringTableOffset = symbolTableOffset + symbols.size();
+    size_t sectionNameOffset = stringTableOffset + strings.size();
+    size_t sectionHeaderOffset = (sectionNameOffset + sectionNames.size() + word - 1) / word * word;
+    int sections = x86_64 ? GNU_STACK_SECTION + 1 : GNU_STACK_SECTION;
+
+    size_t start = object.size();
+    object += std::string{ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, (char)(x86_64 ? ELFCLASS64 : ELFCLASS32), ELFDATA2LSB, EV_CURRENT,
+                          ELFOSABI_SYSV};
+    object.resize(start + EI_NIDENT, '\0');
+    appendInteger(object, ET_REL, 2);
+    appendInteger(object, x86_64 ? EM_X86_64 : EM_386, 2);
+    appendInteger(object, EV_CURRENT, 4);
+    appendInteger(object, 0, word); // no entry point
+    appendInteger(object, 0, word); // no program headers
+    appendInteger(object, sectionHeaderOffset, word);
+    appendInteger(object, 0, 4);
+    appendInteger(object, headerSize, 2);
+    appendInteger(object, 0, 2);
+    appendInteger(object, 0, 2);
+    appendInteger(object, x86_64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr), 2);
+    appendInteger(object, sections, 2);
+    appendInteger(object, SECTION_NAME_SECTION, 2);
+
+    object += text;
+    object.resize(start + relocationOffset, '\0');
+    object += relocations;
+    object += symbols;
+    object += strings;
+    object += sectionNames;
+    object.resize(start + sectionHeaderOffset, '\0');
+
+    int relocationSize = x86_64 ? sizeof(Elf64_Rela) : sizeof(Elf32_Rel);
+    int symbolSize = x86_64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+    appendSectionHeader(object, word, 0, SHT_NULL, 0, 0, 0, 0, 0, 0, 0);
+    appendSectionHeader(object, word, textName, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, textOffset, text.size(), 0, 0, 1, 0);
+    appendSectionHeader(object, word, relocationName, x86_64 ? SHT_RELA : SHT_REL, SHF_INFO_LINK, relocationOffset,
+                        relocations.size(), SYMBOL_TABLE_SECTION, TEXT_SECTION, word, relocationSize);
+    appendSectionHeader(object, word, symbolTableName, SHT_SYMTAB, 0, symbolTableOffset, symbols.size(), STRING_TABLE_SECTION,
+                        firstGlobal, word, symbolSize);
+    appendSectionHeader(object, word, stringTableName, SHT_STRTAB, 0, stringTableOffset, strings.size(), 0, 0, 1, 0);
+    appendSectionHeader(object, word, sectionNameName, SHT_STRTAB, 0, sectionNameOffset, sectionNames.size(), 0, 0, 1, 0);
+    if (x86_64)
+    {
+        appendSectionHeader(object, word, gnuStackName, SHT_PROGBITS, 0, sectionHeaderOffset, 0, 0, 0, 1, 0);
+    }
+}
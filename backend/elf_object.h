@@ -0,0 +1,40 @@
+/**
+ * @file elf_object.h
+ *
+ * @brief The object file writer of the code generator, which encodes the machine instructions of a module and writes them as a
+ * relocatable ELF object, without the assembler.
+ *
+ * The instructions of each function are encoded into the `.text` section one after the other, as the assembler would lay out
+ * the assembly that printMachineFunction prints. The jumps to the labels of the function are resolved here: each starts in its
+ * 2-byte form and grows to its 5 or 6-byte form if its target is too far, until none has to grow. The calls (to `print`, `read`
+ * or the functions of the module) are left to the linker, with a relocation against the symbol of the callee. The object is a
+ * 32-bit ELF file for x86 and a 64-bit one for x86-64, with the sections `.text`, `.rel.text` (`.rela.text` on x86-64),
+ * `.symtab`, `.strtab` and `.shstrtab`, and on x86-64 the `.note.GNU-stack` section that marks the stack as not executable.
+ *
+ * Usage:
+ *     std::vector<MachineFunction> functions = ...;
+ *     std::string object;
+ *     writeELFObject(functions, "p1.c", X86_TARGET, object);
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef ELF_OBJECT_H
+#define ELF_OBJECT_H
+
+#include "machine_ir.h"
+
+/**
+ * Encodes the machine instructions of the functions of a module and appends them to a string as a relocatable ELF object. The
+ * functions that have instructions are defined as global function symbols, and the callees that are not are undefined symbols.
+ *
+ * @param functions The functions of the module, in order; those without instructions are only declared.
+ * @param filename The name of the source file, for the file symbol.
+ * @param target The target of the instructions: 32-bit x86, or x86-64.
+ * @param object The string to append the object to.
+ */
+void writeELFObject(const std::vector<MachineFunction> &functions, const std::string &filename, Target target,
+                    std::string &object);
+
+#endif // ELF_OBJECT_H
@@ -0,0 +1,176 @@
+/**
+ * @file machine_ir.cpp
+ *
+ * @brief This file contains the definitions of the machine instructions: the operands, and the printing of the instructions as
+ * AT&T assembly.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "machine_ir.h"
+
+// The mnemonics of the opcodes, in the order of MachineOpcode
+static const char *const opcodeNames[] = {
+    "movl", "movq", "movzbl", "leal", "addl", "addq", "adcl", "subl", "subq", "imull", "sall", "cmpl",
+    "sete", "setne", "setg", "setge", "setl", "setle", "pushl", "pushq", "popl", "popq",
+    "jmp", "je", "jne", "jg", "jge", "jl", "jle", "call", "leave", "ret", ""};
+
+MachineOperand noOperand()
+{
+    return {NO_OPERAND, NUM_REGISTERS, 0, NUM_REGISTERS, 1, 0, ""};
+}
+
+MachineOperand registerOperand(Register reg, int size)
+{
+    return {REGISTER_OPERAND, reg, size, NUM_REGISTERS, 1, 0, ""};
+}
+
+MachineOperand immediateOperand(long long value)
+{
+    return {IMMEDIATE_OPERAND, NUM_REGISTERS, 0, NUM_REGISTERS, 1, value, ""};
+}
+
+MachineOperand memoryOperand(Register base, long long offset, int size)
+{
+    return {MEMORY_OPERAND, base, size, NUM_REGISTERS, 1, offset, ""};
+}
+
+MachineOperand indexedMemoryOperand(Register base, Register index, int scale, int size)
+{
+    return {MEMORY_OPERAND, base, size, index, scale, 0, ""};
+}
+
+MachineOperand symbolMemoryOperand(const std::string &symbol, long long offset, int size)
+{
+    return {MEMORY_OPERAND, NUM_REGISTERS, size, NUM_REGISTERS, 1, offset, symbol};
+}
+
+MachineOperand labelOperand(const std::string &label)
+{
+    return {LABEL_OPERAND, NUM_REGISTERS, 0, NUM_REGISTERS, 1, 0, label};
+}
+
+bool operator==(const MachineOperand &operand1, const MachineOperand &operand2)
+{
+    return operand1.kind == operand2.kind && operand1.reg == operand2.reg && operand1.size == operand2.size &&
+           operand1.index == operand2.index && operand1.scale == operand2.scale && operand1.value == operand2.value &&
+           operand1.label == operand2.label;
+}
+
+bool operator!=(const MachineOperand &operand1, const MachineOperand &operand2)
+{
+    return !(operand1 == operand2);
+}
+
+const char *getMachineOpcodeName(MachineOpcode opcode)
+{
+    return opcodeNames[opcode];
+}
+
+/**
+ * @brief Appends the name of a register of a given size to a string: `%al`, `%eax` or `%rax`.
+ */
+static void printRegister(Register reg, int size, std::string &text)
+{
+    text += '%';
+    if (size == 8)
+    {
+        text += getWideRegisterName(reg);
+    }
+    else if (size == 1 && reg >= R8D)
+    {
+        text += "r" + std::to_string(reg - R8D + 8) + "b";
+    }
+    else if (size == 1)
+    {
+        // al, bl, cl and dl, then sil and dil
+        std::string name = getRegisterName(reg);
+        text += reg <= EDX ? name.substr(1, 1) + "l" : name.substr(1) + "l";
+    }
+    else
+    {
+        text += getRegisterName(reg);
+    }
+}
+
+void printMachineOperand(const MachineOperand &operand, std::string &text)
+{
+    switch (operand.kind)
+    {
+    case REGISTER_OPERAND:
+        printRegister(operand.reg, operand.size, text);
+        break;
+    case IMMEDIATE_OPERAND:
+        text += '$';
+        text += std::to_string(operand.value);
+        break;
+    case MEMORY_OPERAND:
+        if (!operand.label.empty())
+        {
+            text += operand.label;
+            if (operand.value != 0)
+            {
+                text += '+';
+                text += std::to_string(operand.value);
+            }
+            if (operand.size == 8)
+            {
+                text += "(%rip)";
+            }
+            break;
+        }
+        // The displacement of an indexed address is left out when it is 0
+        if (operand.index == NUM_REGISTERS || operand.value != 0)
+        {
+            text += std::to_string(operand.value);
+        }
+        text += '(';
+        printRegister(operand.reg, operand.size, text);
+        if (operand.index != NUM_REGISTERS)
+        {
+            text += ',';
+            printRegister(operand.index, operand.size, text);
+            if (operand.scale != 1)
+            {
+                text += ',';
+                text += std::to_string(operand.scale);
+            }
+        }
+        text += ')';
+        break;
+    case LABEL_OPERAND:
+        text += operand.label;
+        break;
+    case NO_OPERAND:
+        break;
+    }
+}
+
+void printMachineFunction(const MachineFunction &function, std::string &text)
+{
+    if (function.instructions.empty())
+    {
+        return;
+    }
+    text += "\t.globl " + function.name + "\n";           // Specify that the function is global
+    text += "\t.type " + function.name + ", @function\n"; // Specify the type of the function
+
+    for (const MachineInstr &instruction : function.instructions)
+    {
+        if (instruction.opcode == LABEL)
+        {
+            text += instruction.operands[0].label;
+            text += ":\n";
+            continue;
+        }
+        text += '\t';
+        text += opcodeNames[instruction.opcode];
+        for (size_t i = 0; i < instruction.operands.size(); i++)
+        {
+            text += i ? ", " : " ";
+            printMachineOperand(instruction.operands[i], text);
+        }
+        text += '\n';
+    }
+}
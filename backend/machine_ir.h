@@ -0,0 +1,176 @@
+/**
+ * @file machine_ir.h
+ *
+ * @brief The machine instructions that the code generator selects for a function, before they are printed as assembly.
+ *
+ * The code generator appends the instructions of each function to a MachineFunction, as records of an opcode and its operands
+ * (registers, immediates, memory operands and labels), in the order they run. The labels of the function and of its basic blocks
+ * are instructions too (LABEL), so that the passes that run on the instructions before they are printed can see where the jumps
+ * go. printMachineFunction prints the instructions as AT&T assembly into a string, which the code generator writes out for the
+ * whole module at once.
+ *
+ * Usage:
+ *     MachineFunction function = {"main", {}};
+ *     function.instructions.push_back({MOVL, {immediateOperand(5), registerOperand(EAX)}});
+ *     function.instructions.push_back({RET, {}});
+ *     std::string text;
+ *     printMachineFunction(function, text);
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef MACHINE_IR_H
+#define MACHINE_IR_H
+
+#include "register_allocation.h"
+#include <string>
+#include <vector>
+
+// The opcodes of the machine instructions, by their AT&T mnemonics
+enum MachineOpcode
+{
+    MOVL,
+    MOVQ,
+    MOVZBL,
+    LEAL,
+    ADDL,
+    ADDQ,
+    ADCL,
+    SUBL,
+    SUBQ,
+    IMULL,
+    SALL,
+    CMPL,
+    SETE,
+    SETNE,
+    SETG,
+    SETGE,
+    SETL,
+    SETLE,
+    PUSHL,
+    PUSHQ,
+    POPL,
+    POPQ,
+    JMP,
+    JE,
+    JNE,
+    JG,
+    JGE,
+    JL,
+    JLE,
+    CALL,
+    LEAVE,
+    RET,
+    LABEL // not an instruction: defines the label of its operand
+};
+
+// The kinds of operands of the machine instructions
+enum MachineOperandKind
+{
+    NO_OPERAND,        // the operand of nothing, as the address of an add that `leal` cannot compute
+    REGISTER_OPERAND,  // a register: %ecx
+    IMMEDIATE_OPERAND, // a constant: $5
+    MEMORY_OPERAND,    // an address: -8(%ebp), (%ebx,%ecx), (%ebx,%ebx,2), or a symbol: .LPC0+8, .LPC0+8(%rip)
+    LABEL_OPERAND      // a label or a symbol: .L3, print@PLT
+};
+
+/**
+ * An operand of a machine instruction. A register operand is the register `reg`, of `size` bytes: 1 for `%al`, 4 for the 32-bit
+ * registers and 8 for the 64-bit ones. A memory operand is the address `value` + `reg` + `index` * `scale`, where `index` is
+ * NUM_REGISTERS when there is none, and `size` is the size of its registers: 4 on x86, 8 on x86-64. A memory operand with a `label`
+ * is the address of that symbol plus `value` instead, which is absolute on x86 and relative to `%rip` on x86-64.
+ */
+typedef struct
+{
+    MachineOperandKind kind;
+    Register reg;      // the register, or the base register of an address
+    int size;          // the size of the register, or of the registers of an address, in bytes
+    Register index;    // the index register of an address, or NUM_REGISTERS
+    int scale;         // the scale of the index register: 1, 2, 4 or 8
+    long long value;   // the constant, or the displacement of an address
+    std::string label; // the label or symbol
+} MachineOperand;
+
+// A machine instruction: its opcode, and its operands in the AT&T order (the sources, then the destination)
+typedef struct
+{
+    MachineOpcode opcode;
+    std::vector<MachineOperand> operands;
+} MachineInstr;
+
+// The machine instructions of a function, in the order they run
+typedef struct
+{
+    std::string name;
+    std::vector<MachineInstr> instructions;
+} MachineFunction;
+
+/**
+ * @return The operand of nothing.
+ */
+MachineOperand noOperand();
+
+/**
+ * @return The operand of a register, of 4 bytes unless `size` says otherwise.
+ */
+MachineOperand registerOperand(Register reg, int size = 4);
+
+/**
+ * @return The operand of a constant.
+ */
+MachineOperand immediateOperand(long long value);
+
+/**
+ * @return The operand of the address `offset` + `base`, whose register is of `size` bytes.
+ */
+MachineOperand memoryOperand(Register base, long long offset, int size);
+
+/**
+ * @return The operand of the address `base` + `index` * `scale`, whose registers are of `size` bytes.
+ */
+MachineOperand indexedMemoryOperand(Register base, Register index, int scale, int size);
+
+/**
+ * @return The operand of the address `offset` bytes past a symbol, on a target whose addresses are of `size` bytes.
+ */
+MachineOperand symbolMemoryOperand(const std::string &symbol, long long offset, int size);
+
+/**
+ * @return The operand of a label or a symbol.
+ */
+MachineOperand labelOperand(const std::string &label);
+
+/**
+ * @return true if two operands are the same register, constant, address or label.
+ */
+bool operator==(const MachineOperand &operand1, const MachineOperand &operand2);
+
+/**
+ * @return false if two operands are the same register, constant, address or label.
+ */
+bool operator!=(const MachineOperand &operand1, const MachineOperand &operand2);
+
+/**
+ * @return The mnemonic of an opcode: "movl" for MOVL.
+ */
+const char *getMachineOpcodeName(MachineOpcode opcode);
+
+/**
+ * Appends the AT&T assembly of an operand to a string: `%ecx`, `$5`, `-8(%ebp)`, `.LPC0+8` or `.L3`.
+ *
+ * @param operand The operand.
+ * @param text The string to append to.
+ */
+void printMachineOperand(const MachineOperand &operand, std::string &text);
+
+/**
+ * Appends the AT&T assembly of a function to a string: its `.globl` and `.type` directives, then its instructions, one per line.
+ * A function without instructions, which is only declared, appends nothing.
+ *
+ * @param function The function.
+ * @param text The string to append to.
+ */
+void printMachineFunction(const MachineFunction &function, std::string &text);
+
+#endif // MACHINE_IR_H
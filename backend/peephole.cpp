@@ -0,0 +1,396 @@
+/**
+ * @file peephole.cpp
+ *
+ * @brief This file contains the definitions of the peephole optimizer: the table of rewrites of short sequences of machine
+ * instructions, the threading of jumps and the removal of unreachable code.
+ *
+ * The rewrites run as the instructions are copied into a new list: after each instruction is appended, the rewrites of the table
+ * are tried on the end of the list until none applies, so that the instructions one rewrite leaves behind can be rewritten by
+ * another. A rewrite only looks at instructions that run one after the other, with no label between them (which a jump could
+ * land on), unless the label is part of its pattern.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "peephole.h"
+#include <unordered_map>
+#include <unordered_set>
+
+// A rewrite of the table: looks at the end of the instructions and rewrites it, returning whether it did
+typedef bool (*PeepholeRewrite)(std::vector<MachineInstr> &code);
+
+/**
+ * @return true if an opcode is a jump, conditional or not.
+ */
+static bool
+isJump(MachineOpcode opcode)
+{
+    return opcode >= JMP && opcode <= JLE;
+}
+
+/**
+ * @return The conditional jump taken when a conditional jump is not: JGE for JL.
+ */
+static MachineOpcode
+invertJump(MachineOpcode opcode)
+{
+    switch (opcode)
+    {
+    case JE:
+        return JNE;
+    case JNE:
+        return JE;
+    case JG:
+        return JLE;
+    case JLE:
+        return JG;
+    case JGE:
+        return JL;
+    default:
+        return JGE;
+    }
+}
+
+/**
+ * @return true if an instruction is a `movl` or `movq` from one operand to another of one kind.
+ */
+static bool
+isMove(const MachineInstr &instruction, MachineOperandKind from, MachineOperandKind to)
+{
+    return (instruction.opcode == MOVL || instruction.opcode == MOVQ) && instruction.operands[0].kind == from &&
+           instruction.operands[1].kind == to;
+}
+
+/**
+ * Removes a move of a register to itself: `movl %ecx, %ecx`.
+ */
+static bool
+removeSelfMove(std::vector<MachineInstr> &code)
+{
+    const MachineInstr &last = code.back();
+    if (isMove(last, REGISTER_OPERAND, REGISTER_OPERAND) && last.operands[0] == last.operands[1])
+    {
+        code.pop_back();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Forwards a store to the load of the same stack slot right after it: `movl %ecx, -8(%ebp)` then `movl -8(%ebp), %edx` loads
+ * `%ecx` into `%edx` with `movl %ecx, %edx`.
+ */
+static bool
+forwardStoreToLoad(std::vector<MachineInstr> &code)
+{
+    if (code.size() < 2)
+    {
+        return false;
+    }
+    const MachineInstr &store = code[code.size() - 2];
+    MachineInstr &load = code.back();
+    if (store.opcode == MOVL && load.opcode == MOVL && isMove(store, REGISTER_OPERAND, MEMORY_OPERAND) &&
+        isMove(load, MEMORY_OPERAND, REGISTER_OPERAND) && store.operands[1] == load.operands[0])
+    {
+        load.operands[0] = store.operands[0];
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Removes the store of a value to the stack slot it was just loaded from: `movl -8(%ebp), %ecx` then `movl %ecx, -8(%ebp)`.
+ */
+static bool
+removeStoreOfLoad(std::vector<MachineInstr> &code)
+{
+    if (code.size() < 2)
+    {
+        return false;
+    }
+    const MachineInstr &load = code[code.size() - 2];
+    const MachineInstr &store = code.back();
+    if (load.opcode == MOVL && store.opcode == MOVL && isMove(load, MEMORY_OPERAND, REGISTER_OPERAND) &&
+        isMove(store, REGISTER_OPERAND, MEMORY_OPERAND) && load.operands[0] == store.operands[1] &&
+        load.operands[1] == store.operands[0])
+    {
+        code.pop_back();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Removes a jump to the label that follows it, past any other labels: `jmp .L3` then `.L3:`.
+ */
+static bool
+removeJumpToNext(std::vector<MachineInstr> &code)
+{
+    if (code.back().opcode != LABEL)
+    {
+        return false;
+    }
+    const std::string &label = code.back().operands[0].label;
+    size_t i = code.size() - 1;
+    while (i > 0 && code[i - 1].opcode == LABEL)
+    {
+        i--;
+    }
+    if (i > 0 && isJump(code[i - 1].opcode) && code[i - 1].operands[0].label == label)
+    {
+        code.erase(code.begin() + (i - 1));
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Turns a conditional jump around a jump into the opposite conditional jump: `jl .L2`, `jmp .L3` then `.L2:` is `jge .L3` then
+ * `.L2:`.
+ */
+static bool
+invertBranchOverJump(std::vector<MachineInstr> &code)
+{
+    if (code.size() < 3)
+    {
+        return false;
+    }
+    MachineInstr &branch = code[code.size() - 3];
+    const MachineInstr &jump = code[code.size() - 2];
+    const MachineInstr &label = code.back();
+    if (label.opcode == LABEL && jump.opcode == JMP && isJump(branch.opcode) && branch.opcode != JMP &&
+        branch.operands[0].label == label.operands[0].label)
+    {
+        branch.opcode = invertJump(branch.opcode);
+        branch.operands[0] = jump.operands[0];
+        code.erase(code.end() - 2);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Branches on the flags of a comparison rather than on its result: `setl %al`, `movzbl %al, %ecx`, then `cmpl $0, %ecx` and
+ * `jne .L2` is `setl %al`, `movzbl %al, %ecx` then `jl .L2`, when only moves, which keep the flags, come between the `setcc`
+ * and the test, and the tested operand still holds the result there. The code after a branch sets the flags before it reads them,
+ * so it does not miss the flags of the test.
+ */
+static bool
+branchOnComparison(std::vector<MachineInstr> &code)
+{
+    if (code.size() < 4)
+    {
+        return false;
+    }
+    MachineInstr &branch = code.back();
+    const MachineInstr &test = code[code.size() - 2];
+    if ((branch.opcode != JNE && branch.opcode != JE) || test.opcode != CMPL || test.operands[0] != immediateOperand(0))
+    {
+        return false;
+    }
+
+    // Find the movzbl of the result, past the moves before the test
+    size_t extend = code.size() - 3;
+    while (extend > 0 && code[extend].opcode == MOVL)
+    {
+        extend--;
+    }
+    if (extend == 0 || code[extend].opcode != MOVZBL || code[extend - 1].opcode < SETE || code[extend - 1].opcode > SETLE)
+    {
+        return false;
+    }
+
+    // Follow the operands that hold the result through the moves
+    std::vector<MachineOperand> holders = {code[extend].operands[1]};
+    for (size_t i = extend + 1; i < code.size() - 2; i++)
+    {
+        const MachineOperand &source = code[i].operands[0];
+        const MachineOperand &destination = code[i].operands[1];
+        bool fromHolder = false;
+        for (size_t j = 0; j < holders.size(); j++)
+        {
+            fromHolder |= holders[j] == source;
+            if (holders[j] == destination)
+            {
+                holders.erase(holders.begin() + j--);
+            }
+        }
+        if (fromHolder)
+        {
+            holders.push_back(destination);
+        }
+    }
+    bool held = false;
+    for (const MachineOperand &holder : holders)
+    {
+        held |= holder == test.operands[1];
+    }
+    if (!held)
+    {
+        return false;
+    }
+
+    // The jumps are in the order of the setcc opcodes
+    MachineOpcode jump = (MachineOpcode)(JE + (code[extend - 1].opcode - SETE));
+    branch.opcode = branch.opcode == JNE ? jump : invertJump(jump);
+    code.erase(code.end() - 2);
+    return true;
+}
+
+// The rewrites, tried in this order on the end of the instructions
+static const struct
+{
+    const char *name;
+    PeepholeRewrite rewrite;
+} peepholeRewrites[] = {
+    {"self moves removed", removeSelfMove},
+    {"stores forwarded to loads", forwardStoreToLoad},
+    {"stores of loads removed", removeStoreOfLoad},
+    {"jumps to the next instruction removed", removeJumpToNext},
+    {"branches over jumps inverted", invertBranchOverJump},
+    {"branches on comparison results folded", branchOnComparison},
+};
+
+/**
+ * Makes the jumps to a label that is followed by a jump go where that jump goes.
+ *
+ * @param code The instructions of the function.
+ * @return The number of jumps threaded.
+ */
+static int
+threadJumps(std::vector<MachineInstr> &code)
+{
+    // <label, the label that the jump right after it goes to>
+    std::unordered_map<std::string, std::string> forwards;
+    for (size_t i = 0; i < code.size(); i++)
+    {
+        if (code[i].opcode != LABEL)
+        {
+            continue;
+        }
+        size_t next = i + 1;
+        while (next < code.size() && code[next].opcode == LABEL)
+        {
+            next++;
+        }
+        if (next < code.size() && code[next].opcode == JMP && code[next].operands[0].label != code[i].operands[0].label)
+        {
+            forwards[code[i].operands[0].label] = code[next].operands[0].label;
+        }
+    }
+
+    int threaded = 0;
+    for (MachineInstr &instruction : code)
+    {
+        if (!isJump(instruction.opcode))
+        {
+            continue;
+        }
+        // Follow the jumps at most once around a loop of labels that only jump to each other
+        std::string target = instruction.operands[0].label;
+        for (size_t steps = 0; steps < forwards.size() && forwards.count(target) > 0; steps++)
+        {
+            target = forwards[target];
+        }
+        if (target != instruction.operands[0].label)
+        {
+            instruction.operands[0] = labelOperand(target);
+            threaded++;
+        }
+    }
+    return threaded;
+}
+
+/**
+ * Removes the labels of basic blocks that no jump goes to, and the instructions after a jump or a return that no label leads to.
+ * The labels of the function (its name and `.LFB<n>`) stay.
+ *
+ * @param code The instructions of the function.
+ * @return The number of labels and instructions removed.
+ */
+static int
+removeUnreachableCode(std::vector<MachineInstr> &code)
+{
+    std::unordered_set<std::string> targets;
+    for (const MachineInstr &instruction : code)
+    {
+        if (isJump(instruction.opcode))
+        {
+            targets.insert(instruction.operands[0].label);
+        }
+    }
+
+    int removed = 0;
+    bool reachable = true;
+    size_t kept = 0;
+    for (size_t i = 0; i < code.size(); i++)
+    {
+        MachineInstr &instruction = code[i];
+        if (instruction.opcode == LABEL)
+        {
+            const std::string &label = instruction.operands[0].label;
+            bool blockLabel = label.compare(0, 2, ".L") == 0 && label.compare(0, 4, ".LFB") != 0;
+            if (blockLabel && targets.count(label) == 0)
+            {
+                removed++;
+                continue;
+            }
+            reachable = true;
+        }
+        else if (!reachable)
+        {
+            removed++;
+            continue;
+        }
+        else if (instruction.opcode == JMP || instruction.opcode == RET)
+        {
+            reachable = false;
+        }
+        if (kept != i)
+        {
+            code[kept] = std::move(instruction);
+        }
+        kept++;
+    }
+    code.resize(kept);
+    return removed;
+}
+
+int optimizePeepholes(MachineFunction &function)
+{
+    std::vector<MachineInstr> &code = function.instructions;
+    int rewrites = 0;
+    int round;
+    do
+    {
+        round = threadJumps(code) + removeUnreachableCode(code);
+
+        std::vector<MachineInstr> rewritten;
+        rewritten.reserve(code.size());
+        for (MachineInstr &instruction : code)
+        {
+            rewritten.push_back(std::move(instruction));
+            bool applied = true;
+            while (applied && !rewritten.empty())
+            {
+                applied = false;
+                for (const auto &entry : peepholeRewrites)
+                {
+                    if (entry.rewrite(rewritten))
+                    {
+#ifdef DEBUG
+                        cout << "Peephole: " << entry.name << " in " << function.name << endl;
+#endif
+                        applied = true;
+                        round++;
+                        break;
+                    }
+                }
+            }
+        }
+        code.swap(rewritten);
+        rewrites += round;
+    } while (round > 0);
+    return rewrites;
+}
@@ -0,0 +1,34 @@
+/**
+ * @file peephole.h
+ *
+ * @brief The peephole optimizer of the code generator, which rewrites the machine instructions of a function before they are
+ * printed as assembly.
+ *
+ * The code generator selects the instructions of each LLVM instruction on its own, so the code it puts together has moves of a
+ * register to itself, loads of the value that was just stored, jumps to the next instruction and branches around jumps. The
+ * peephole optimizer removes them with a table of rewrites of short sequences of instructions, and threads the jumps to blocks
+ * that only jump on, until none of them applies any more.
+ *
+ * Usage:
+ *     generateAssemblyForBasicBlocks(context);
+ *     optimizePeepholes(context.machineFunction);
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "machine_ir.h"
+
+/**
+ * Rewrites the machine instructions of a function with the peephole rewrites until none of them applies. The rewrites keep the
+ * registers, the stack slots and the flags that the code after them reads.
+ *
+ * @param function The function to rewrite.
+ * @return The number of rewrites made.
+ */
+int optimizePeepholes(MachineFunction &function);
+
+#endif // PEEPHOLE_H
@@ -0,0 +1,74 @@
+/*
+ * The runtime of the programs compiled with -fprofile-generate: link it with
+ * the instrumented assembly, and the program appends the block counts of its
+ * run to a profile when it exits, for -fprofile-use (see
+ * common/block_profile.h for the format).
+ *
+ * Every instrumented module puts a descriptor of each of its functions in the
+ * minicc_prof section (see printProfileData in codegen.cpp), and the linker
+ * gathers the sections of every module between __start_minicc_prof and
+ * __stop_minicc_prof. The symbols are weak, so a program without any
+ * instrumented module still links, and writes nothing.
+ *
+ * The profile is the file that MINICC_PROFILE_FILE names, or minicc.profile
+ * in the current directory. Each run appends its own records, and the
+ * compiler adds up the records of a function when it reads them.
+ *
+ * usage: gcc -m64 main.c p1.s profile_runtime.c -o p1
+ *        (with -m32, also -no-pie: the counters are absolute addresses on x86)
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Must match printProfileData in codegen.cpp */
+struct profile_function
+{
+	const char *name;
+	uint32_t checksum;
+	uint32_t blocks;
+	uint32_t first_label;
+	uint64_t *counters;
+};
+
+extern struct profile_function __start_minicc_prof[] __attribute__((weak));
+extern struct profile_function __stop_minicc_prof[] __attribute__((weak));
+
+static void __attribute__((destructor)) write_profile(void)
+{
+	struct profile_function *function;
+	const char *path;
+	FILE *file;
+	uint32_t i;
+
+	function = __start_minicc_prof;
+	if (function == __stop_minicc_prof)
+	{
+		return;
+	}
+	path = getenv("MINICC_PROFILE_FILE");
+	if (!path || !*path)
+	{
+		path = "minicc.profile"; /* DEFAULT_PROFILE_FILE of block_profile.h */
+	}
+	file = fopen(path, "a");
+	if (!file)
+	{
+		perror(path);
+		return;
+	}
+	for (; function < __stop_minicc_prof; function++)
+	{
+		fprintf(file, "function %s %u %u\n", function->name, (unsigned)function->checksum, (unsigned)function->blocks);
+		for (i = 0; i < function->blocks; i++)
+		{
+			fprintf(file, ".L%u %llu\n", (unsigned)(function->first_label + i),
+					(unsigned long long)function->counters[i]);
+		}
+	}
+	fclose(file);
+}
@@ -4,25 +4,94 @@
  * @brief This file implements register allocation for LLVM IR code using the linear scan algorithm.
  *
  * The register allocation algorithm performs the following steps:
- * 1. Computes liveness information for each basic block in the function.
- * 2. Allocates registers for each basic block using the linear scan algorithm.
- * 3. If no registers are available, selects an instruction to spill based on the live usage frequency of the instruction.
+ * 1. Computes which values are live across basic blocks with a function-wide liveness analysis. The incoming values of a phi
+ *    are live at the end of the basic blocks they come from, where the code generator copies them into the phi.
+ * 2. Numbers the instructions of the whole function in the order of its basic blocks, and builds the live interval of each
+ *    value: from its definition (the start of its basic block for a phi) to its last use, stretched over every basic block
+ *    it is live into or out of. A value that is live around a loop covers the whole loop.
+ * 3. Scans the intervals in the order they start, giving each a register that no overlapping interval holds. An arithmetic
+ *    instruction takes the register of its first operand if that is the operand's last use. A value that is live across a
+ *    call takes a callee-saved register (EBX on x86) first, as the calls preserve it.
+ * 4. If no registers are available, evicts the interval with the lowest spill weight: its definition and uses, each weighted by
+ *    10 to the power of its loop depth (or, with a profile, by how often its block ran), for each position it covers. The values used in loops stay in registers, and the long
+ *    intervals with few uses make way for the short ones (of equal weights, the interval that ends last). It is split where the new interval starts if it was used in its register before (it stays in the register up to
+ *    there, and in its stack slot from there on), and spilled to its stack slot otherwise. If the new interval weighs the least,
+ *    it is spilled instead.
+ * 5. Lists the edges on which a split value must be reloaded into its register: those that leave a block where it is in its
+ *    stack slot for a block where it is in its register.
+ * 6. Lists the caller-saved registers (ECX and EDX on x86) that hold a value live across each call, which the call has to save.
+ *
+ * The registers are those of the target: EBX, ECX and EDX on 32-bit x86, and on x86-64 the 13 registers other than RAX, RSP and
+ * RBP, 5 of them callee-saved by the System V calling convention.
+ *
+ * The stack slots of the allocas and of the spilled and split values are then colored the same way (colorStackSlots): two
+ * objects share a slot unless one is live where the other is written.
  *
  * Usage:
- *   AllocatedReg allocateRegisterForFunction(LLVMValueRef function, bool &usedEBX);
+ *   AllocatedReg allocateRegisterForFunction(LLVMValueRef function, Target target, RegisterSet &usedCalleeSaved,
+ *                                            SplitIntervals &splitIntervals, CallSaves &callSaves);
  *
- *   This function takes a valid LLVM function and a boolean variable by reference as input. It returns the LLVM IR code with
- *   registers allocated and sets the usedEBX variable to true if the function uses the EBX register.
+ *   This function takes a valid LLVM function and its target as input. It returns the LLVM IR code with registers allocated and
+ *   sets usedCalleeSaved to the callee-saved registers that the function uses.
  *
  * Output:
  *   The allocateRegisterForFunction function returns an std::unordered_map that maps each LLVM value in the function to the
- *   register that it is allocated to. The function also sets the usedEBX boolean variable to true if the function uses the EBX register.
+ *   register that it is allocated to. The function also sets usedCalleeSaved to the callee-saved registers the function uses.
  *
  * @author Aimen Abdulaziz
  * @date Spring 2023
  */
 
 #include "register_allocation.h"
+#include "bit_vector.h"
+#include "block_profile.h"
+#include "dataflow.h"
+#include "dominator_tree.h"
+#include "natural_loops.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <string.h>
+
+// A use of a value by a phi, at the end of the basic block it comes from
+typedef struct
+{
+    unsigned block;
+    unsigned value;
+    unsigned phi;
+} PhiUse;
+
+// The instructions of a function, numbered in the order of its basic blocks (their positions), and the values they compute,
+// numbered densely. The operands of every instruction are looked up once, when it is numbered, so the analyses that follow index
+// arrays instead of hashing values. Only the values used outside the basic block that computes them, the global values, can be
+// live where a block starts or ends, so the liveness sets of the blocks only hold those, numbered densely again: a function of
+// many blocks whose values are nearly all used where they are computed, as at -O0, gets small sets.
+typedef struct
+{
+    std::vector<LLVMValueRef> values;                // <value number, instruction that computes it>
+    std::vector<unsigned> globals;                   // <global number, number of the global value>
+    std::vector<int> globalNumbers;                  // <value number, its global number, or -1>
+    std::vector<int> results;                        // <position, number of the value the instruction computes, or -1>
+    std::vector<unsigned> operandStarts;             // <position, index of its first operand in operands>, and the end
+    std::vector<unsigned> operands;                  // the numbers of the values used by each instruction other than a phi
+    std::vector<unsigned> blockStarts;               // <block, position of its first instruction>, and the end
+    std::vector<PhiUse> phiUses;                     // the incoming values of every phi that are values
+    std::vector<std::pair<int, LLVMValueRef>> calls; // <position, call>, in the order of the positions
+} FunctionNumbering;
+
+// The live interval of a value: the positions from its definition to its last use, with no holes
+typedef struct
+{
+    LLVMValueRef value;
+    int start;
+    int end;
+    int firstUse;  // the position of the first instruction that uses the value, or INT_MAX
+    unsigned numUses; // the number of uses by instructions other than phis
+    double spillCost; // its definition and uses, each weighted by the execution frequency of its basic block
+    Register reg;
+    int split;     // the position the interval was split at, or -1
+} LiveInterval;
 
 /**
  * Determines whether the given LLVM instruction opcode produces a result (or a LHS).
@@ -35,163 +104,313 @@
 static bool
 hasResult(LLVMOpcode instrOpcode, LLVMValueRef instr = nullptr)
 {
-    static OpcodeSet noResultOpCode = {LLVMStore, LLVMBr, LLVMRet};
-    if (instrOpcode == LLVMCall)
+    switch (instrOpcode)
     {
+    case LLVMStore:
+    case LLVMBr:
+    case LLVMRet:
+        return false;
+    case LLVMCall:
         // Check if the call instruction has a void return type
-        LLVMTypeRef returnType = LLVMTypeOf(instr);
-        return LLVMGetTypeKind(returnType) != LLVMVoidTypeKind;
+        return LLVMGetTypeKind(LLVMTypeOf(instr)) != LLVMVoidTypeKind;
+    default:
+        return true;
     }
-    return noResultOpCode.find(instrOpcode) == noResultOpCode.end();
 }
 
 /**
- * Computes liveness information for a given LLVM basic block.
- * Liveness information is useful for register allocation: it determines where each value is live,
- * starting from its definition up to its last usage. This information is used for deciding
- * when a register can be safely reused.
+ * Numbers the instructions of a function and the values they compute, and records the operands of each instruction.
  *
- * @param basicBlock       The LLVM basic block for which to compute liveness.
- * @param liveUsageMap     An empty map which will be populated with LLVM value to a vector of its use points (represented by instruction indices).
- * @param instructionList  An empty list which will be populated with all non-alloca instructions in the current basic block.
+ * @param cfg The control-flow graph of the function.
+ * @param numbering Receives the positions of the instructions, the numbers of the values and the operands.
  */
 static void
-computeLiveness(LLVMBasicBlockRef basicBlock,
-                LiveUsageMap &liveUsageMap,
-                InstIndex &instructionList)
+numberInstructions(const ControlFlowGraph &cfg, FunctionNumbering &numbering)
 {
-    LLVMValueRef instruction = LLVMGetFirstInstruction(basicBlock);
-
-    while (instruction)
+    // Number the values, skipping allocas: they are stack slots, not registers
+    std::unordered_map<LLVMValueRef, unsigned> valueNumbers;
+    std::vector<unsigned> valueBlocks; // <value number, the block that computes it>
+    for (unsigned block = 0; block < cfg.size(); block++)
     {
-        // Alloca instructions are ignored for the purpose of liveness analysis
-        if (LLVMIsAAllocaInst(instruction))
+        numbering.blockStarts.push_back(numbering.results.size());
+        for (auto instruction = LLVMGetFirstInstruction(cfg.block(block)); instruction;
+             instruction = LLVMGetNextInstruction(instruction))
         {
-            instruction = LLVMGetNextInstruction(instruction);
-            continue;
-        }
+            if (LLVMIsACallInst(instruction))
+            {
+                numbering.calls.push_back({(int)numbering.results.size(), instruction});
+            }
 
-        // If instruction generates a result, add its index to the live range
-        LLVMOpcode instrOpcode = LLVMGetInstructionOpcode(instruction);
-        if (hasResult(instrOpcode, instruction))
-        {
-            liveUsageMap[instruction].push_back(instructionList.size());
+            int result = -1;
+            if (!LLVMIsAAllocaInst(instruction) && hasResult(LLVMGetInstructionOpcode(instruction), instruction))
+            {
+                result = numbering.values.size();
+                valueNumbers[instruction] = result;
+                numbering.values.push_back(instruction);
+                valueBlocks.push_back(block);
+            }
+            numbering.results.push_back(result);
         }
+    }
+    numbering.blockStarts.push_back(numbering.results.size());
 
-        // Update the live usage of any of the operands in the instruction
-        for (auto i = 0; i < LLVMGetNumOperands(instruction); i++)
+    // A value is global if another block uses it, or a phi, on the edge out of a block
+    std::vector<bool> global(numbering.values.size(), false);
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        for (auto instruction = LLVMGetFirstInstruction(cfg.block(block)); instruction;
+             instruction = LLVMGetNextInstruction(instruction))
         {
-            LLVMValueRef operand = LLVMGetOperand(instruction, i);
-            if (liveUsageMap.count(operand) > 0)
+            // A phi uses each incoming value at the end of the block it comes from, not where it is
+            for (unsigned i = 0; LLVMIsAPHINode(instruction) && i < LLVMCountIncoming(instruction); i++)
             {
-                liveUsageMap[operand].push_back(instructionList.size());
+                auto incoming = valueNumbers.find(LLVMGetIncomingValue(instruction, i));
+                if (incoming != valueNumbers.end())
+                {
+                    numbering.phiUses.push_back({cfg.index(LLVMGetIncomingBlock(instruction, i)), incoming->second,
+                                                 valueNumbers[instruction]});
+                    global[incoming->second] = true;
+                }
             }
-        }
 
-        // Append the instruction to the instruction list
-        instructionList.push_back(instruction);
+            numbering.operandStarts.push_back(numbering.operands.size());
+            for (int i = 0; i < (LLVMIsAPHINode(instruction) ? 0 : LLVMGetNumOperands(instruction)); i++)
+            {
+                auto operand = valueNumbers.find(LLVMGetOperand(instruction, i));
+                if (operand != valueNumbers.end())
+                {
+                    numbering.operands.push_back(operand->second);
+                    global[operand->second] = global[operand->second] || valueBlocks[operand->second] != block;
+                }
+            }
+        }
+    }
+    numbering.operandStarts.push_back(numbering.operands.size());
 
-        // Proceed to the next instruction in the basic block
-        instruction = LLVMGetNextInstruction(instruction);
+    numbering.globalNumbers.assign(numbering.values.size(), -1);
+    for (unsigned value = 0; value < numbering.values.size(); value++)
+    {
+        if (global[value])
+        {
+            numbering.globalNumbers[value] = numbering.globals.size();
+            numbering.globals.push_back(value);
+        }
     }
 }
 
 /**
- * Prints the instruction index vector to the console for debugging purpose.
+ * @brief The function-wide liveness analysis: the values that may still be used at the start and at the end of each basic block.
  *
- * @param instructionIndex The instruction index vector to print.
+ * A backward analysis over sets of values: OUT[B] is the union of the IN sets of B's successors, and
+ * IN[B] = (OUT[B] U PHI[B] - DEF[B]) U USE[B], where DEF[B] holds the values computed in B and USE[B] those that B uses before
+ * computing them, which in SSA form are the values computed in other basic blocks. PHI[B] holds the incoming values of the phis
+ * of B's successors for the edges from B, which are used at the very end of B, where the backend copies them into the phis.
  */
-static void
-printInstructionIndexVector(InstIndex &instructionIndex)
+class LivenessAnalysis
 {
-    // print the instruction index vector
-    for (auto i = 0; i < instructionIndex.size(); i++)
+public:
+    typedef BitVector Value;
+    static const DataflowDirection direction = BACKWARD_DATAFLOW;
+
+    LivenessAnalysis(size_t numValues, std::vector<BitVector> &defSets, std::vector<BitVector> &useSets,
+                     std::vector<BitVector> &phiUseSets)
+        : numValues(numValues), defSets(defSets), useSets(useSets), phiUseSets(phiUseSets)
     {
-        // Print the LLVMValueRef to a string
-        char *instruction = LLVMPrintValueToString(instructionIndex[i]);
-        cout << i << ": " << instruction << endl;
-        LLVMDisposeMessage(instruction);
     }
-    cout << endl;
-}
+
+    // Nothing is live after the function returns, and the union starts from the empty set
+    Value boundary() const { return BitVector(numValues); }
+    Value initial() const { return BitVector(numValues); }
+
+    void meet(Value &into, const Value &other) const { into |= other; }
+
+    void transfer(unsigned block, const Value &out, Value &in) const
+    {
+        in = out;
+        in |= phiUseSets[block];
+        in.subtract(defSets[block]);
+        in |= useSets[block];
+    }
+
+private:
+    size_t numValues;
+    std::vector<BitVector> &defSets;
+    std::vector<BitVector> &useSets;
+    std::vector<BitVector> &phiUseSets;
+};
 
 /**
- * Prints the live range of each instruction in the given LiveUsageMap to the console.
+ * Computes which values are live at the start and at the end of each basic block of a function.
  *
- * @param liveUsageMap The LiveUsageMap to print.
+ * @param cfg The control-flow graph of the function.
+ * @param numbering The numbered instructions and values of the function.
+ * @param liveness Receives the live values at the start (entry) and at the end (exit) of each basic block, by their global
+ * numbers. The values at the end include the incoming values of the phis of the successors.
  */
 static void
-printLiveUsageMap(LiveUsageMap &liveUsageMap)
+computeFunctionLiveness(const ControlFlowGraph &cfg, const FunctionNumbering &numbering, DataflowResult<BitVector> &liveness)
 {
-    // Print the live range of each instruction
-    for (auto usages : liveUsageMap)
+    // DEF, USE and PHI sets of each basic block
+    size_t numGlobals = numbering.globals.size();
+    std::vector<BitVector> defSets(cfg.size(), BitVector(numGlobals));
+    std::vector<BitVector> useSets(cfg.size(), BitVector(numGlobals));
+    std::vector<BitVector> phiUseSets(cfg.size(), BitVector(numGlobals));
+    for (unsigned block = 0; block < cfg.size(); block++)
     {
-        // print the vector of all the usages
-        cout << "Live range of";
-        char *instruction = LLVMPrintValueToString(usages.first);
-        cout << instruction << ": ";
-        LLVMDisposeMessage(instruction);
-        for (auto usage : usages.second)
+        for (unsigned position = numbering.blockStarts[block]; position < numbering.blockStarts[block + 1]; position++)
         {
-            cout << usage << " ";
+            for (unsigned i = numbering.operandStarts[position]; i < numbering.operandStarts[position + 1]; i++)
+            {
+                int operand = numbering.globalNumbers[numbering.operands[i]];
+                if (operand >= 0 && !defSets[block].test(operand))
+                {
+                    useSets[block].set(operand);
+                }
+            }
+
+            if (numbering.results[position] >= 0 && numbering.globalNumbers[numbering.results[position]] >= 0)
+            {
+                defSets[block].set(numbering.globalNumbers[numbering.results[position]]);
+            }
         }
-        cout << endl;
     }
+    for (auto &phiUse : numbering.phiUses)
+    {
+        phiUseSets[phiUse.block].set(numbering.globalNumbers[phiUse.value]);
+    }
+
+    LivenessAnalysis analysis(numGlobals, defSets, useSets, phiUseSets);
+    solveDataflow(cfg, analysis, liveness);
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        liveness.exit[block] |= phiUseSets[block];
+    }
+
+#ifdef DEBUG
+    cout << "Function-wide liveness: " << liveness.visits << " block visits for " << cfg.size() << " blocks" << endl;
+#endif
 }
 
-/**
- * @brief Removes the allocated register for the given instruction operand from the basic block allocated register map.
- *
- * The function iterates over each operand of the instruction and adds the physical register assigned to the
- * operand to the set of available registers.
- * If the operand does not have a physical register assigned to it, the function does nothing.
- *
- * @param instructionIdx The index of the current instruction in the instruction list.
- * @param operandStartIdx The index of the first operand to process.
- * @param instruction The LLVM instruction to remove the allocated register for.
- * @param liveUsageMap The LiveUsageMap for the function.
- * @param instructionIndex The instruction index map for the function.
- * @param bbAllocatedRegisterMap The allocated register map for the basic block.
- * @param availableRegisters The set of available registers.
- */
-static void
-removeAllocatedRegister(int instructionIdx,
-                        int operandStartIdx,
-                        LLVMValueRef instruction,
-                        LiveUsageMap &liveUsageMap,
-                        InstIndex &instructionIndex,
-                        AllocatedReg &bbAllocatedRegisterMap,
-                        RegisterSet &availableRegisters)
+bool
+parseRegisterAllocatorOption(const char *option, RegisterAllocator &allocator, bool &valid)
+{
+    const char *prefix = "-regalloc=";
+    if (strncmp(option, prefix, strlen(prefix)))
+    {
+        return false;
+    }
+    const char *name = option + strlen(prefix);
+    if (!strcmp(name, getRegisterAllocatorName(LINEAR_SCAN_ALLOCATOR)))
+    {
+        allocator = LINEAR_SCAN_ALLOCATOR;
+    }
+    else if (!strcmp(name, getRegisterAllocatorName(GRAPH_COLORING_ALLOCATOR)))
+    {
+        allocator = GRAPH_COLORING_ALLOCATOR;
+    }
+    else
+    {
+        cerr << "Unknown register allocator '" << name << "'" << endl;
+        valid = false;
+    }
+    return true;
+}
+
+const char *
+getRegisterAllocatorName(RegisterAllocator allocator)
 {
-    // Get the number of operands of the instruction
-    const int numOperands = LLVMGetNumOperands(instruction);
+    return allocator == GRAPH_COLORING_ALLOCATOR ? "graph" : "linear";
+}
 
-    // Iterate over each operand of the instruction
-    for (int i = operandStartIdx; i < numOperands; i++)
+bool
+parseTargetOption(const char *option, Target &target)
+{
+    if (!strcmp(option, getTargetOption(X86_TARGET)))
+    {
+        target = X86_TARGET;
+        return true;
+    }
+    if (!strcmp(option, getTargetOption(X86_64_TARGET)))
     {
-        // Get the i-th operand of the instruction
-        LLVMValueRef operand = LLVMGetOperand(instruction, i);
+        target = X86_64_TARGET;
+        return true;
+    }
+    return false;
+}
 
-        // Skip constants, operands that are not in the liveUsageMap, and operands that are live after the current instruction
-        if (LLVMIsAConstant(operand) || liveUsageMap.count(operand) == 0 || liveUsageMap[operand].back() > instructionIdx)
-        {
-            continue;
-        }
+const char *
+getTargetOption(Target target)
+{
+    return target == X86_64_TARGET ? "-m64" : "-m32";
+}
 
-        // Check if the operand has a physical register assigned to it
-        const auto it = bbAllocatedRegisterMap.find(operand);
-        if (it == bbAllocatedRegisterMap.end())
+RegisterSet
+getAllocatableRegisters(Target target)
+{
+    RegisterSet registers = registerBit(EBX) | registerBit(ECX) | registerBit(EDX);
+    if (target == X86_64_TARGET)
+    {
+        for (int reg = ESI; reg < NUM_REGISTERS; reg++)
         {
-            // If the operand does not have a physical register assigned to it, continue to the next operand
-            continue;
+            registers |= registerBit((Register)reg);
         }
+    }
+    return registers;
+}
+
+RegisterSet
+getCallerSavedRegisters(Target target)
+{
+    RegisterSet registers = registerBit(ECX) | registerBit(EDX);
+    if (target == X86_64_TARGET)
+    {
+        // System V: RBX, RBP and R12 to R15 are callee-saved
+        registers |= registerBit(ESI) | registerBit(EDI) | registerBit(R8D) | registerBit(R9D) | registerBit(R10D) |
+                     registerBit(R11D);
+    }
+    return registers;
+}
 
-        // Get the physical register assigned to the operand
-        const Register registerName = it->second;
+// The allocatable registers of a target, in the orders the allocators try them
+typedef struct
+{
+    std::vector<Register> order;            // caller-saved first: the function has to save a callee-saved register to use it
+    std::vector<Register> acrossCallsOrder; // callee-saved first, for the values live across a call, which the calls preserve
+    RegisterSet callerSaved;
+    RegisterSet calleeSaved;
+} RegisterFile;
 
-        // Add the physical register to the set of available registers
-        availableRegisters.insert(registerName);
+/**
+ * @return The allocatable registers of a target, in the orders the allocators try them.
+ */
+static RegisterFile
+getRegisterFile(Target target)
+{
+    RegisterFile file;
+    RegisterSet allocatable = getAllocatableRegisters(target);
+    file.callerSaved = getCallerSavedRegisters(target) & allocatable;
+    file.calleeSaved = allocatable & ~file.callerSaved;
+    for (RegisterSet first : {file.callerSaved, file.calleeSaved})
+    {
+        for (int reg = 0; reg < NUM_REGISTERS; reg++)
+        {
+            if (first & registerBit((Register)reg))
+            {
+                file.order.push_back((Register)reg);
+            }
+        }
+    }
+    for (RegisterSet first : {file.calleeSaved, file.callerSaved})
+    {
+        for (int reg = 0; reg < NUM_REGISTERS; reg++)
+        {
+            if (first & registerBit((Register)reg))
+            {
+                file.acrossCallsOrder.push_back((Register)reg);
+            }
+        }
     }
+    return file;
 }
 
 /**
@@ -213,41 +432,39 @@ getRegisterName(Register reg)
         return "ecx";
     case EDX:
         return "edx";
+    case ESI:
+        return "esi";
+    case EDI:
+        return "edi";
+    case ESP:
+        return "esp";
+    case EBP:
+        return "ebp";
     case SPILL:
         return "SPILL";
     default:
+        if (reg >= R8D && reg <= R15D)
+        {
+            return "r" + std::to_string(reg - R8D + 8) + "d";
+        }
         return "Unknown register";
     }
 }
 
-/**
- * Merges the allocated register map for a basic block with the global allocated register map.
- *
- * @param bbAllocatedRegisterMap a reference to the allocated register map for the basic block.
- * @param allocatedRegisterMap a reference to the global allocated register map.
- */
-static void
-mergeBBWGlobalMap(AllocatedReg &bbAllocatedRegisterMap,
-                  AllocatedReg &allocatedRegisterMap)
+std::string
+getWideRegisterName(Register reg)
 {
-    for (auto &entry : bbAllocatedRegisterMap)
+    if (reg >= R8D && reg <= R15D)
     {
-        LLVMValueRef instr = entry.first;
-        Register reg = entry.second;
-
-#ifdef DEBUG
-        char *str = LLVMPrintValueToString(instr);
-        cout << "Assigned register " << getRegisterName(reg) << " to" << str << endl;
-        LLVMDisposeMessage(str);
-#endif
-
-        allocatedRegisterMap[instr] = reg;
+        return "r" + std::to_string(reg - R8D + 8);
     }
+    return "r" + getRegisterName(reg).substr(1);
 }
 
 /**
  * Determines whether the given LLVM instruction opcode is an arithmetic operation.
- * Arithmetic operations for MiniC are LLVMAdd, LLVMSub, and LLVMMul
+ * Arithmetic operations for MiniC are LLVMAdd, LLVMSub, and LLVMMul, and the LLVMShl that the optimizer
+ * turns multiplications by a power of two into
  *
  * @param instrOpcode The LLVM instruction opcode to check.
  * @return True if the instruction is an arithmetic operation, false otherwise.
@@ -255,192 +472,1268 @@ mergeBBWGlobalMap(AllocatedReg &bbAllocatedRegisterMap,
 static bool
 isArithmetic(LLVMOpcode instrOpcode)
 {
-    static OpcodeSet arithmeticOpcode = {LLVMAdd, LLVMSub, LLVMMul};
-    return arithmeticOpcode.find(instrOpcode) != arithmeticOpcode.end();
+    return instrOpcode == LLVMAdd || instrOpcode == LLVMSub || instrOpcode == LLVMMul || instrOpcode == LLVMShl;
+}
+
+/**
+ * Stretches a live interval over a position.
+ *
+ * @param interval The live interval.
+ * @param position The position the value is live at.
+ */
+static void
+extendInterval(LiveInterval &interval, int position)
+{
+    interval.start = std::min(interval.start, position);
+    interval.end = std::max(interval.end, position);
+}
+
+/**
+ * Finds the first call after a position.
+ *
+ * @param numbering The numbered instructions of the function.
+ * @param position A position in the function.
+ * @return The index in numbering.calls of the first call after the position, or the number of calls if there is none.
+ */
+static size_t
+firstCallAfter(const FunctionNumbering &numbering, int position)
+{
+    return std::upper_bound(numbering.calls.begin(), numbering.calls.end(), position,
+                            [](int position, const std::pair<int, LLVMValueRef> &call)
+                            { return position < call.first; }) -
+           numbering.calls.begin();
+}
+
+/**
+ * Determines whether a value is live across a call: whether a call comes after its definition and before its last use.
+ *
+ * @param numbering The numbered instructions of the function.
+ * @param interval The live interval of the value.
+ * @return True if a call comes strictly inside the interval, false otherwise.
+ */
+static bool
+crossesCall(const FunctionNumbering &numbering, const LiveInterval &interval)
+{
+    size_t call = firstCallAfter(numbering, interval.start);
+    return call < numbering.calls.size() && numbering.calls[call].first < interval.end;
 }
 
+// The weight of a basic block that never ran in the profile, so that the values used there still weigh more than those never used
+static const double COLD_BLOCK_WEIGHT = 0.001;
+
 /**
- * @brief Selects an instruction to spill based on the live usage frequency of its operands.
+ * Estimates how often each basic block of a function runs, relative to the entry block: with block counts, how many times it ran
+ * per run of the function, and otherwise 10 to the power of its loop depth, as a loop is expected to run about 10 times each time
+ * it is entered.
  *
- * The function iterates over each instruction in the basic block and selects the instruction
- * with the lowest live usage frequency.
- * The selected instruction is returned as the spill instruction.
+ * @param cfg The control-flow graph of the function.
+ * @param blockCounts The number of times each basic block ran in the profile, or NULL.
+ * @param weights Receives the weight of each basic block.
+ */
+static void
+computeBlockWeights(const ControlFlowGraph &cfg, const std::vector<uint64_t> *blockCounts, std::vector<double> &weights)
+{
+    if (blockCounts && blockCounts->size() == cfg.size() && computeProfileWeights(*blockCounts, COLD_BLOCK_WEIGHT, weights))
+    {
+        return;
+    }
+    DominatorTree dominators(cfg);
+    NaturalLoops loops(cfg, dominators);
+    weights.resize(cfg.size());
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        weights[block] = std::pow(10.0, loops.depth(block));
+    }
+}
+
+/**
+ * Builds the live interval of every value of a function.
  *
- * @param liveUsageMap The LiveUsageMap for the function.
- * @param bbAllocatedRegisterMap The allocated register map for the basic block.
- * @param currInstr The current instruction being processed.
- * @return The instruction to spill, or nullptr if no instruction can be spilled.
+ * @param cfg The control-flow graph of the function.
+ * @param numbering The numbered instructions and values of the function.
+ * @param liveness The values live at the start and at the end of each basic block, by their global numbers.
+ * @param weights The weight of each basic block, for the spill costs.
+ * @param intervals Receives the live interval of each value, indexed by its number.
  */
-static LLVMValueRef
-selectSpillInstr(LiveUsageMap &liveUsageMap,
-                 AllocatedReg &bbAllocatedRegisterMap,
-                 LLVMValueRef currInstr,
-                 int currInstrIdx)
+static void
+computeLiveIntervals(const ControlFlowGraph &cfg, const FunctionNumbering &numbering, const DataflowResult<BitVector> &liveness,
+                     const std::vector<double> &weights, std::vector<LiveInterval> &intervals)
 {
-    LLVMValueRef spillVar = nullptr;
-    int minFrequency = INT_MAX;
-    for (auto it = bbAllocatedRegisterMap.begin(); it != bbAllocatedRegisterMap.end(); ++it)
+    intervals.assign(numbering.values.size(), {NULL, INT_MAX, INT_MIN, INT_MAX, 0, 0, SPILL, -1});
+    for (unsigned block = 0; block < cfg.size(); block++)
     {
-        LLVMValueRef instr = it->first;
-        // if the variable is not live, skip it
-        if (liveUsageMap[instr].back() < currInstrIdx)
+        for (int position = numbering.blockStarts[block]; position < (int)numbering.blockStarts[block + 1]; position++)
         {
-            continue;
+            for (unsigned i = numbering.operandStarts[position]; i < numbering.operandStarts[position + 1]; i++)
+            {
+                LiveInterval &operand = intervals[numbering.operands[i]];
+                extendInterval(operand, position);
+                operand.firstUse = std::min(operand.firstUse, position);
+                operand.numUses++;
+                operand.spillCost += weights[block];
+            }
+
+            // A phi is defined on the edges into its basic block, so it is live from the start of the block
+            int result = numbering.results[position];
+            if (result >= 0)
+            {
+                LiveInterval &interval = intervals[result];
+                interval.value = numbering.values[result];
+                interval.spillCost += weights[block];
+                extendInterval(interval, LLVMIsAPHINode(interval.value) ? numbering.blockStarts[block] : position);
+            }
         }
+    }
+
+    // An incoming value is copied into its phi at the end of the block it comes from
+    for (auto &phiUse : numbering.phiUses)
+    {
+        intervals[phiUse.value].spillCost += weights[phiUse.block];
+    }
+
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        int blockStart = numbering.blockStarts[block];
+        int blockEnd = numbering.blockStarts[block + 1] - 1;
+        liveness.entry[block].forEach([&](size_t global)
+                                      { extendInterval(intervals[numbering.globals[global]], blockStart); });
+        liveness.exit[block].forEach([&](size_t global)
+                                     { extendInterval(intervals[numbering.globals[global]], blockEnd); });
+    }
+}
 
-        Register registerName = it->second;
-        if (registerName != SPILL && liveUsageMap[instr].size() < minFrequency)
+/**
+ * Prints the live intervals and the registers allocated to them to the console for debugging purpose.
+ *
+ * @param intervals The live intervals of the function.
+ */
+static void
+printLiveIntervals(std::vector<LiveInterval> &intervals)
+{
+    for (auto &interval : intervals)
+    {
+        char *instruction = LLVMPrintValueToString(interval.value);
+        cout << "[" << interval.start << ", " << interval.end << "] " << getRegisterName(interval.reg);
+        if (interval.split >= 0)
         {
-            spillVar = instr;
-            minFrequency = liveUsageMap[instr].size();
+            cout << " until " << interval.split;
         }
+        cout << " (" << interval.numUses << " uses, cost " << interval.spillCost << "):" << instruction << endl;
+        LLVMDisposeMessage(instruction);
     }
-    return spillVar;
+}
+
+/**
+ * @return The spill weight of an interval: its spill cost for each position it holds a register over.
+ */
+static double
+getSpillWeight(const LiveInterval &interval)
+{
+    return interval.spillCost / (interval.end - interval.start + 1);
+}
+
+/**
+ * Adds an interval to the active intervals, which are sorted by the position they end at.
+ *
+ * @param active The active intervals.
+ * @param interval The interval that was given a register.
+ */
+static void
+activate(std::vector<LiveInterval *> &active, LiveInterval *interval)
+{
+    auto position = std::upper_bound(active.begin(), active.end(), interval, [](const LiveInterval *a, const LiveInterval *b)
+                                     { return a->end < b->end; });
+    active.insert(position, interval);
 }
 
 /**
  * @brief This function implements the linear scan register allocation algorithm.
  *
- * Allocates registers for the given LLVM basic block using the linear scan algorithm.
- * The function creates an AllocatedReg map to store the register allocated to each instruction in the basic block.
- * It then iterates over each instruction in the basic block and allocates registers for each instruction.
- * The allocated registers are stored in the AllocatedReg map.
- * The function also removes allocated registers for operands whose live range ends in the current instruction.
- * If no registers are available, the function selects an instruction to spill and spills it.
- * The function then merges the basic block allocated register map into the global allocated register map.
+ * The intervals are visited in the order they start. The intervals that ended before the current one starts give their registers
+ * back; an interval that ends where the current one starts still holds its register, since the instruction reads its operands
+ * after writing its result to the register, except for the first operand of an arithmetic instruction, which is moved into the
+ * register first. If no register is free, the interval with the lowest spill weight among the current one and the active ones
+ * that are still live after it starts gives up its register. The weight is the spill cost for each position the interval holds
+ * the register over, with each use weighted by the execution frequency of its basic block, so the values used in loops keep
+ * their registers, and an interval that holds a register long for few uses gives it up. Of intervals that weigh the same, the
+ * one that ends last gives it up, as it is the one whose register is wanted back the latest.
  *
- * @param basicBlock The LLVM basic block to allocate registers for.
- * @param instructionList The list of instructions in the basic block.
- * @param liveUsageMap The LiveUsageMap for the function.
- * @param allocatedRegisterMap The global allocated register map.
+ * The active intervals are kept sorted by the position they end at, so the intervals that ended are at the front of the list and
+ * the one that ends last is at its back; the free registers are a bit mask.
  *
- * @ret
+ * An interval that is live across a call takes a callee-saved register (EBX on x86) first: the calls preserve it, where the
+ * caller-saved ones would have to be saved around every call, and it is only saved once, by the prologue of the function.
+ *
+ * @param numbering The numbered instructions of the function.
+ * @param registers The registers of the target.
+ * @param intervals The live intervals of the function, indexed by the number of their value. Receives the register of each one,
+ * or SPILL, and the position it was split at.
+ * @param usedCalleeSaved Receives the callee-saved registers allocated to a value.
  */
-static bool
-allocateRegisterForBasicBlock(LLVMBasicBlockRef &basicBlock,
-                              InstIndex &instructionList,
-                              LiveUsageMap &liveUsageMap,
-                              AllocatedReg &allocatedRegisterMap)
+static void
+linearScan(const FunctionNumbering &numbering, const RegisterFile &registers, std::vector<LiveInterval> &intervals,
+           RegisterSet &usedCalleeSaved)
 {
-    // Create a map of instruction to register for the current basic block
-    AllocatedReg bbAllocatedRegisterMap;
-    RegisterSet availableRegisters = {EBX, ECX, EDX};
-    bool usedEBX = false;
-
-    for (int i = 0; i < instructionList.size(); i++)
+    std::vector<LiveInterval *> order;
+    for (auto &interval : intervals)
     {
-        LLVMValueRef currInstr = instructionList[i];
-        LLVMOpcode instrOpcode = LLVMGetInstructionOpcode(currInstr);
+        order.push_back(&interval);
+    }
+    std::stable_sort(order.begin(), order.end(), [](const LiveInterval *a, const LiveInterval *b)
+                     { return a->start < b->start; });
 
-        // Check if the instruction does NOT generates a result (no LHS)
-        if (!hasResult(instrOpcode, currInstr))
+    std::vector<LiveInterval *> active;
+    RegisterSet availableRegisters = registers.callerSaved | registers.calleeSaved;
+    for (LiveInterval *current : order)
+    {
+        // Give back the registers of the intervals that ended
+        auto ended = active.begin();
+        while (ended != active.end() && (*ended)->end < current->start)
         {
-            // Check and remove allocated registers for each operand whose live range ends in the current instruction
-            removeAllocatedRegister(i, 0, currInstr, liveUsageMap, instructionList, bbAllocatedRegisterMap, availableRegisters);
-            continue;
+            availableRegisters |= registerBit((*ended)->reg);
+            ++ended;
         }
+        active.erase(active.begin(), ended);
 
-        // Check if the instruction is an arithmetic instruction
-        if (isArithmetic(instrOpcode))
+        // If the first operand of an arithmetic instruction ends here, the result takes its register. Not if it is also the
+        // second operand (x + x), whose register the result would overwrite before reading it, nor if the result lives across a
+        // call in a caller-saved register and a callee-saved one is free.
+        LLVMValueRef instruction = current->value;
+        bool acrossCalls = crossesCall(numbering, *current);
+        const std::vector<Register> &order = acrossCalls ? registers.acrossCallsOrder : registers.order;
+        Register reg = SPILL;
+        if (isArithmetic(LLVMGetInstructionOpcode(instruction)) && LLVMGetOperand(instruction, 1) != LLVMGetOperand(instruction, 0))
         {
-            // Get the first operand of the instruction
-            LLVMValueRef firstOperand = LLVMGetOperand(currInstr, 0);
-
-            // If the first operand has a physical register assigned to it in and its liveness range ends at
-            // the current instruction, assign the same register to the instruction.
-            if (bbAllocatedRegisterMap.count(firstOperand) > 0 && liveUsageMap[firstOperand].back() == i)
+            for (auto it = active.begin(); it != active.end() && (*it)->end == current->start; ++it)
             {
-                // Get the physical register assigned to the first operand
-                Register reg = bbAllocatedRegisterMap[firstOperand];
-
-                // Add the reg to the curr instr
-                bbAllocatedRegisterMap[currInstr] = reg;
+                if ((*it)->value == LLVMGetOperand(instruction, 0) &&
+                    !(acrossCalls && !(registerBit((*it)->reg) & registers.calleeSaved) &&
+                      (availableRegisters & registers.calleeSaved)))
+                {
+                    reg = (*it)->reg;
+                    active.erase(it);
+                    break;
+                }
+            }
+        }
 
-                // Remove the allocated register for the second operand if its live range ends in the current instruction
-                removeAllocatedRegister(i, 1, currInstr, liveUsageMap, instructionList, bbAllocatedRegisterMap, availableRegisters);
-                continue;
+        for (unsigned i = 0; reg == SPILL && i < order.size(); i++)
+        {
+            if (availableRegisters & registerBit(order[i]))
+            {
+                reg = order[i];
+                availableRegisters &= ~registerBit(reg);
             }
         }
 
-        // If registers are available, allocate one to the current instruction
-        if (!availableRegisters.empty())
+        // No register is free: the interval of the lowest spill weight gives it up, the one that ends last if several weigh the
+        // same
+        auto cheapest = active.end();
+        for (auto it = active.end(); reg == SPILL && it != active.begin() && (*(it - 1))->end > current->start;)
+        {
+            --it;
+            if (cheapest == active.end() || getSpillWeight(**it) < getSpillWeight(**cheapest))
+            {
+                cheapest = it;
+            }
+        }
+        if (reg == SPILL && cheapest != active.end() &&
+            (getSpillWeight(**cheapest) < getSpillWeight(*current) ||
+             (getSpillWeight(**cheapest) == getSpillWeight(*current) && (*cheapest)->end > current->end)))
         {
-            Register registerName = *availableRegisters.begin();
-            availableRegisters.erase(registerName);
-            bbAllocatedRegisterMap[currInstr] = registerName;
-            removeAllocatedRegister(i, 0, currInstr, liveUsageMap, instructionList, bbAllocatedRegisterMap, availableRegisters);
+            LiveInterval *evicted = *cheapest;
+            reg = evicted->reg;
+            active.erase(cheapest);
 
-            if (registerName == EBX)
+            // A phi is written on the edges into its block, where it can only be in one place
+            if (!LLVMIsAPHINode(evicted->value) && evicted->firstUse < current->start)
             {
-                usedEBX = true;
+                evicted->split = current->start;
+            }
+            else
+            {
+                evicted->reg = SPILL;
             }
-            continue;
         }
 
-        // If there is no available register, find the instr to spill
-        LLVMValueRef spillInstr = selectSpillInstr(liveUsageMap, bbAllocatedRegisterMap, currInstr, i);
+        current->reg = reg;
+        if (reg != SPILL)
+        {
+            activate(active, current);
+            usedCalleeSaved |= registerBit(reg) & registers.calleeSaved;
+        }
+    }
+}
 
-        // If no registers are available, select an instruction to spill
-        if (liveUsageMap[spillInstr].size() > liveUsageMap[currInstr].size())
+/**
+ * Finds the caller-saved registers that each call has to save: those of the values that are in their register both before and
+ * after the call. A value whose interval ends at the call is dead after it, and a split value that is in its stack slot after the
+ * call is read from there.
+ *
+ * @param numbering The numbered instructions of the function.
+ * @param registers The registers of the target.
+ * @param intervals The live intervals of the function, with their registers.
+ * @param callSaves Receives the caller-saved registers of the values live across each call.
+ */
+static void
+computeCallSaves(const FunctionNumbering &numbering, const RegisterFile &registers, const std::vector<LiveInterval> &intervals,
+                 CallSaves &callSaves)
+{
+    for (auto &interval : intervals)
+    {
+        if (interval.reg == SPILL || !(registerBit(interval.reg) & registers.callerSaved))
         {
-            bbAllocatedRegisterMap[currInstr] = SPILL;
             continue;
         }
-        else
+
+        // The last position of a call that the value is in its register after
+        int last = interval.split >= 0 ? std::min(interval.end, interval.split - 1) - 1 : interval.end - 1;
+        for (size_t call = firstCallAfter(numbering, interval.start);
+             call < numbering.calls.size() && numbering.calls[call].first <= last; call++)
         {
-            // If the current instruction has more uses, spill the selected instruction
-            Register spilledRegisterName = bbAllocatedRegisterMap[spillInstr];
-            bbAllocatedRegisterMap[currInstr] = spilledRegisterName;
-            bbAllocatedRegisterMap[spillInstr] = SPILL;
+            callSaves[numbering.calls[call].second] |= registerBit(interval.reg);
         }
-
-        removeAllocatedRegister(i, 0, currInstr, liveUsageMap, instructionList, bbAllocatedRegisterMap, availableRegisters);
     }
-
-    // Merge the basic block allocated register map into the global allocated register map
-    mergeBBWGlobalMap(bbAllocatedRegisterMap, allocatedRegisterMap);
-
-    return usedEBX;
 }
 
 /**
- * Allocates registers for the given LLVM function using the linear scan algorithm.
+ * Allocates the registers of a target for the given LLVM function using the linear scan algorithm.
  * The function creates an AllocatedReg map to store the register allocated to each instruction.
- * It then iterates over each basic block in the function and allocates registers for each basic block.
+ * It builds the live intervals of the values of the whole function and allocates registers for them with linearScan.
  * The allocated registers are stored in the AllocatedReg map.
  *
  * @param function The LLVM function to allocate registers for.
- * @param usedEBX A flag to indicate if the EBX register is used in the function.
+ * @param target The target, whose registers are allocated.
+ * @param usedCalleeSaved Receives the callee-saved registers the function uses, which its prologue has to save.
+ * @param splitIntervals Receives the values whose interval was split, and the reloads on the edges of the function.
+ * @param callSaves Receives the caller-saved registers that are live across each call.
+ * @param blockCounts The number of times each basic block ran in the profile, or NULL.
  * @return The AllocatedReg map that stores the register allocated to each instruction.
  */
 AllocatedReg
-allocateRegisterForFunction(LLVMValueRef function, bool &usedEBX)
+allocateRegisterForFunction(LLVMValueRef function, Target target, RegisterSet &usedCalleeSaved, SplitIntervals &splitIntervals,
+                            CallSaves &callSaves, const std::vector<uint64_t> *blockCounts)
 {
+    // Find the values that are live across basic blocks
+    ControlFlowGraph cfg(function);
+    FunctionNumbering numbering;
+    numberInstructions(cfg, numbering);
+    DataflowResult<BitVector> liveness;
+    computeFunctionLiveness(cfg, numbering, liveness);
+
+    // Allocate registers to the live intervals of the whole function
+    std::vector<double> weights;
+    computeBlockWeights(cfg, blockCounts, weights);
+    std::vector<LiveInterval> intervals;
+    computeLiveIntervals(cfg, numbering, liveness, weights, intervals);
+    RegisterFile registers = getRegisterFile(target);
+    linearScan(numbering, registers, intervals, usedCalleeSaved);
+    computeCallSaves(numbering, registers, intervals, callSaves);
+
+#ifdef DEBUG
+    printLiveIntervals(intervals);
+#endif
+
     // Create a map to store the register allocated to each instruction
     AllocatedReg allocatedRegisterMap;
-
-    // Get the first basic block
-    LLVMBasicBlockRef basicBlock = LLVMGetFirstBasicBlock(function);
-    while (basicBlock)
+    allocatedRegisterMap.reserve(intervals.size());
+    for (auto &interval : intervals)
     {
-        // Create an instruction index for the basic block
-        InstIndex instructionList;
-        LiveUsageMap liveUsageMap;
-        computeLiveness(basicBlock, liveUsageMap, instructionList);
+        allocatedRegisterMap[interval.value] = interval.reg;
+        if (interval.split >= 0)
+        {
+            splitIntervals.splitPositions[interval.value] = interval.split;
+        }
+    }
 
+    // A split value is in its stack slot at the end of a block at or after its split position, so an edge from there into a block
+    // where it is in its register again reloads it
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        int blockEnd = numbering.blockStarts[block + 1] - 1;
+        std::vector<unsigned> successors;
+        for (unsigned successor : cfg.successors(block))
+        {
+            if (std::find(successors.begin(), successors.end(), successor) != successors.end())
+            {
+                continue;
+            }
+            successors.push_back(successor);
+            liveness.entry[successor].forEach([&](size_t global)
+                                              {
+                unsigned value = numbering.globals[global];
+                int split = intervals[value].split;
+                if (split >= 0 && blockEnd >= split && (int)numbering.blockStarts[successor] < split)
+                {
+                    splitIntervals.reloads[{cfg.block(block), cfg.block(successor)}].push_back(intervals[value].value);
 #ifdef DEBUG
-        printInstructionIndexVector(instructionList);
-        printLiveUsageMap(liveUsageMap);
+                    cout << "Reload on the edge from block " << block << " to block " << successor << endl;
 #endif
+                } });
+        }
+    }
+    return allocatedRegisterMap;
+}
 
-        // Allocate register on a basic block level
-        bool basicBlockUsedEBX = allocateRegisterForBasicBlock(basicBlock, instructionList, liveUsageMap, allocatedRegisterMap);
+// A node of the interference graph: a value, and the values coalesced into it
+typedef struct
+{
+    std::vector<unsigned> neighbors; // the values it interferes with
+    std::vector<unsigned> moves;     // the values it is copied from or into: a phi and its incoming values, an arithmetic
+                                     // instruction and its first operand
+    double spillCost;                // its definitions and uses, each weighted by 10 to the power of its loop depth
+    bool acrossCalls;                // whether one of its values is live across a call
+    unsigned degree;                 // the number of its neighbors still in the graph, while simplifying
+    Register reg;
+} InterferenceNode;
 
-        // Set the usedEBX flag to true if the EBX register is used in the basic block
-        usedEBX = usedEBX || basicBlockUsedEBX;
+/**
+ * Sets a set of values, by their value numbers, to the values live at the end of a basic block.
+ *
+ * @param numbering The numbered instructions and values of the function.
+ * @param liveness The values live at the start and at the end of each basic block, by their global numbers.
+ * @param block The basic block.
+ * @param live Receives the values live at the end of the block.
+ */
+static void
+getLiveOut(const FunctionNumbering &numbering, const DataflowResult<BitVector> &liveness, unsigned block, BitVector &live)
+{
+    live.clear();
+    liveness.exit[block].forEach([&](size_t global)
+                                 { live.set(numbering.globals[global]); });
+}
 
-        // Get the next basic block
-        basicBlock = LLVMGetNextBasicBlock(basicBlock);
+/**
+ * Walks the instructions of a basic block other than its phis backward, from the values live at its end.
+ *
+ * @param numbering The numbered instructions and values of the function.
+ * @param block The basic block.
+ * @param live The values live at the end of the block; receives those live just after its phis.
+ * @param visit Called with the position of each instruction, while `live` holds the values live just after it.
+ */
+template <typename Visitor>
+static void
+walkBlockBackward(const FunctionNumbering &numbering, unsigned block, BitVector &live, Visitor visit)
+{
+    for (int position = numbering.blockStarts[block + 1] - 1; position >= (int)numbering.blockStarts[block]; position--)
+    {
+        int result = numbering.results[position];
+        if (result >= 0 && LLVMIsAPHINode(numbering.values[result]))
+        {
+            break;
+        }
+        visit(position);
+        if (result >= 0)
+        {
+            live.reset(result);
+        }
+        for (unsigned i = numbering.operandStarts[position]; i < numbering.operandStarts[position + 1]; i++)
+        {
+            live.set(numbering.operands[i]);
+        }
     }
-    return allocatedRegisterMap;
-}
\ No newline at end of file
+}
+
+/**
+ * Determines whether the instruction at a position is a call.
+ */
+static bool
+isCallAt(const FunctionNumbering &numbering, int position)
+{
+    size_t call = firstCallAfter(numbering, position - 1);
+    return call < numbering.calls.size() && numbering.calls[call].first == position;
+}
+
+/**
+ * Adds an edge to the interference graph.
+ */
+static void
+addInterference(std::vector<InterferenceNode> &nodes, unsigned a, unsigned b)
+{
+    if (a != b)
+    {
+        nodes[a].neighbors.push_back(b);
+        nodes[b].neighbors.push_back(a);
+    }
+}
+
+/**
+ * Adds a move to the interference graph.
+ */
+static void
+addMove(std::vector<InterferenceNode> &nodes, unsigned a, unsigned b)
+{
+    nodes[a].moves.push_back(b);
+    nodes[b].moves.push_back(a);
+}
+
+/**
+ * Builds the interference graph of a function: two values interfere if one is live where the other is defined. The result of an
+ * instruction also interferes with its operands, which the code generator may still read after writing the result's register,
+ * except for the first operand of an arithmetic instruction, which it moves into that register first: that operand and the
+ * result are a move to coalesce instead, as are a phi and its incoming values. The phis of a basic block are all defined at its
+ * start, so they interfere with each other and with the values live there.
+ *
+ * @param cfg The control-flow graph of the function.
+ * @param numbering The numbered instructions and values of the function.
+ * @param liveness The values live at the start and at the end of each basic block, by their global numbers.
+ * @param blockCounts The number of times each basic block ran in the profile, or NULL.
+ * @param nodes Receives the nodes of the graph, indexed by the number of their value.
+ */
+static void
+buildInterferenceGraph(const ControlFlowGraph &cfg, const FunctionNumbering &numbering, const DataflowResult<BitVector> &liveness,
+                       const std::vector<uint64_t> *blockCounts, std::vector<InterferenceNode> &nodes)
+{
+    // A value used in a loop is used once per iteration
+    std::vector<double> weights;
+    computeBlockWeights(cfg, blockCounts, weights);
+
+    nodes.assign(numbering.values.size(), {{}, {}, 0, false, 0, SPILL});
+    BitVector live(numbering.values.size());
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        getLiveOut(numbering, liveness, block, live);
+        walkBlockBackward(numbering, block, live, [&](int position)
+                          {
+            int result = numbering.results[position];
+            if (isCallAt(numbering, position))
+            {
+                live.forEach([&](size_t value)
+                             { nodes[value].acrossCalls = nodes[value].acrossCalls || (int)value != result; });
+            }
+            for (unsigned i = numbering.operandStarts[position]; i < numbering.operandStarts[position + 1]; i++)
+            {
+                nodes[numbering.operands[i]].spillCost += weights[block];
+            }
+            if (result < 0)
+            {
+                return;
+            }
+
+            nodes[result].spillCost += weights[block];
+            live.forEach([&](size_t value)
+                         { addInterference(nodes, result, value); });
+            LLVMValueRef instruction = numbering.values[result];
+            bool firstIsMove = isArithmetic(LLVMGetInstructionOpcode(instruction)) &&
+                               LLVMGetOperand(instruction, 1) != LLVMGetOperand(instruction, 0);
+            for (unsigned i = numbering.operandStarts[position]; i < numbering.operandStarts[position + 1]; i++)
+            {
+                unsigned operand = numbering.operands[i];
+                if (firstIsMove && numbering.values[operand] == LLVMGetOperand(instruction, 0))
+                {
+                    addMove(nodes, result, operand);
+                }
+                else
+                {
+                    addInterference(nodes, result, operand);
+                }
+            } });
+
+        for (unsigned position = numbering.blockStarts[block]; position < numbering.blockStarts[block + 1]; position++)
+        {
+            int phi = numbering.results[position];
+            if (phi < 0 || !LLVMIsAPHINode(numbering.values[phi]))
+            {
+                break;
+            }
+            nodes[phi].spillCost += weights[block];
+            live.forEach([&](size_t value)
+                         { addInterference(nodes, phi, value); });
+            for (unsigned other = numbering.blockStarts[block]; other < position; other++)
+            {
+                addInterference(nodes, phi, numbering.results[other]);
+            }
+        }
+    }
+
+    // An incoming value is copied into its phi at the end of the block it comes from
+    for (auto &phiUse : numbering.phiUses)
+    {
+        nodes[phiUse.value].spillCost += weights[phiUse.block];
+        addMove(nodes, phiUse.phi, phiUse.value);
+    }
+}
+
+/**
+ * Finds the node a value was coalesced into.
+ *
+ * @param coalesced <value, value it was coalesced with>, itself for the value a node is named after.
+ * @param value The number of a value.
+ * @return The number of the value the node of the value is named after.
+ */
+static unsigned
+findNode(std::vector<unsigned> &coalesced, unsigned value)
+{
+    while (coalesced[value] != value)
+    {
+        coalesced[value] = coalesced[coalesced[value]];
+        value = coalesced[value];
+    }
+    return value;
+}
+
+/**
+ * Names the neighbors of every node by the nodes they were coalesced into, each once.
+ *
+ * @param nodes The interference graph.
+ * @param coalesced The value each value was coalesced with.
+ */
+static void
+renameNeighbors(std::vector<InterferenceNode> &nodes, std::vector<unsigned> &coalesced)
+{
+    std::vector<unsigned> named(nodes.size(), UINT_MAX); // <node, the last node it was found to be a neighbor of>
+    for (unsigned node = 0; node < nodes.size(); node++)
+    {
+        std::vector<unsigned> &neighbors = nodes[node].neighbors;
+        size_t kept = 0;
+        for (unsigned neighbor : neighbors)
+        {
+            neighbor = findNode(coalesced, neighbor);
+            if (named[neighbor] != node)
+            {
+                named[neighbor] = node;
+                neighbors[kept++] = neighbor;
+            }
+        }
+        neighbors.resize(kept);
+    }
+}
+
+/**
+ * Coalesces the values of the moves that do not interfere, so that they get the same register and the code generator leaves the
+ * move out. The moves in the hottest loops go first. Two nodes are only coalesced if the node they make has fewer than
+ * numColors neighbors of significant degree (numColors or more), which can always be simplified (Briggs's test): coalescing
+ * never turns a graph that could be colored into one that cannot.
+ *
+ * @param nodes The interference graph.
+ * @param coalesced The value each value was coalesced with, itself for each value at first.
+ * @param numColors The number of registers the graph is colored with.
+ */
+static void
+coalesceMoves(std::vector<InterferenceNode> &nodes, std::vector<unsigned> &coalesced, unsigned numColors)
+{
+    std::vector<std::pair<double, std::pair<unsigned, unsigned>>> moves; // <weight, <value, value>>
+    for (unsigned value = 0; value < nodes.size(); value++)
+    {
+        for (unsigned other : nodes[value].moves)
+        {
+            if (value < other)
+            {
+                moves.push_back({std::min(nodes[value].spillCost, nodes[other].spillCost), {value, other}});
+            }
+        }
+    }
+    std::stable_sort(moves.begin(), moves.end(), [](const std::pair<double, std::pair<unsigned, unsigned>> &a,
+                                                    const std::pair<double, std::pair<unsigned, unsigned>> &b)
+                     { return a.first > b.first; });
+
+    // The neighbors of a node keep the values they name until the end, so a node may be named more than once
+    std::vector<unsigned> visited(nodes.size(), 0);
+    unsigned visit = 0;
+    for (auto &move : moves)
+    {
+        unsigned a = findNode(coalesced, move.second.first);
+        unsigned b = findNode(coalesced, move.second.second);
+        bool interfere = a == b;
+        for (unsigned i = 0; !interfere && i < nodes[a].neighbors.size(); i++)
+        {
+            interfere = findNode(coalesced, nodes[a].neighbors[i]) == b;
+        }
+        if (interfere)
+        {
+            continue;
+        }
+
+        // The number of neighbors of a node counts those named more than once several times; too high is on the safe side
+        unsigned significant = 0;
+        visit++;
+        for (unsigned node : {a, b})
+        {
+            for (unsigned i = 0; significant < numColors && i < nodes[node].neighbors.size(); i++)
+            {
+                unsigned neighbor = findNode(coalesced, nodes[node].neighbors[i]);
+                if (visited[neighbor] != visit)
+                {
+                    visited[neighbor] = visit;
+                    significant += nodes[neighbor].neighbors.size() >= numColors;
+                }
+            }
+        }
+        if (significant >= numColors)
+        {
+            continue;
+        }
+
+        coalesced[b] = a;
+        nodes[a].neighbors.insert(nodes[a].neighbors.end(), nodes[b].neighbors.begin(), nodes[b].neighbors.end());
+        nodes[a].moves.insert(nodes[a].moves.end(), nodes[b].moves.begin(), nodes[b].moves.end());
+        nodes[a].spillCost += nodes[b].spillCost;
+        nodes[a].acrossCalls = nodes[a].acrossCalls || nodes[b].acrossCalls;
+        nodes[b].neighbors.clear();
+        nodes[b].moves.clear();
+    }
+    renameNeighbors(nodes, coalesced);
+}
+
+/**
+ * Colors the interference graph with the registers of the target, or spills.
+ *
+ * Simplify removes the nodes with fewer than numColors neighbors left, which can always be colored once their neighbors are,
+ * and pushes them on a stack. When every node left has numColors neighbors or more, the one with the lowest spill cost for its
+ * degree is pushed as well, optimistically (Briggs): its neighbors may still end up sharing colors. Select then pops the nodes
+ * and gives each a color that none of its colored neighbors has, preferring the color of a value it is copied from or into, then
+ * a callee-saved register for a value live across a call and a caller-saved one for the others, like linearScan. A node with
+ * no color left is spilled.
+ *
+ * @param nodes The coalesced interference graph. Receives the register of each node, or SPILL.
+ * @param coalesced The value each value was coalesced with.
+ * @param registers The registers of the target, the colors.
+ * @param usedCalleeSaved Receives the callee-saved registers allocated to a value.
+ */
+static void
+colorGraph(std::vector<InterferenceNode> &nodes, std::vector<unsigned> &coalesced, const RegisterFile &registers,
+           RegisterSet &usedCalleeSaved)
+{
+    const unsigned numColors = registers.order.size();
+
+    // Spill candidates by spill cost per neighbor; an entry whose node lost neighbors since is pushed again with its new key
+    typedef std::pair<double, unsigned> Candidate;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+    std::vector<unsigned> simplifiable;
+    std::vector<bool> removed(nodes.size(), true);
+    size_t numNodes = 0;
+    for (unsigned value = 0; value < nodes.size(); value++)
+    {
+        if (findNode(coalesced, value) != value)
+        {
+            continue;
+        }
+        removed[value] = false;
+        numNodes++;
+        nodes[value].degree = nodes[value].neighbors.size();
+        if (nodes[value].degree < numColors)
+        {
+            simplifiable.push_back(value);
+        }
+        else
+        {
+            candidates.push({nodes[value].spillCost / nodes[value].degree, value});
+        }
+    }
+
+    std::vector<unsigned> stack;
+    while (stack.size() < numNodes)
+    {
+        unsigned node;
+        if (!simplifiable.empty())
+        {
+            node = simplifiable.back();
+            simplifiable.pop_back();
+        }
+        else
+        {
+            Candidate candidate = candidates.top();
+            candidates.pop();
+            node = candidate.second;
+            if (removed[node] || nodes[node].degree < numColors)
+            {
+                continue;
+            }
+            if (candidate.first != nodes[node].spillCost / nodes[node].degree)
+            {
+                candidates.push({nodes[node].spillCost / nodes[node].degree, node});
+                continue;
+            }
+        }
+        if (removed[node])
+        {
+            continue;
+        }
+
+        removed[node] = true;
+        stack.push_back(node);
+        for (unsigned neighbor : nodes[node].neighbors)
+        {
+            if (!removed[neighbor] && --nodes[neighbor].degree == numColors - 1)
+            {
+                simplifiable.push_back(neighbor);
+            }
+        }
+    }
+
+    while (!stack.empty())
+    {
+        InterferenceNode &node = nodes[stack.back()];
+        stack.pop_back();
+        RegisterSet taken = 0;
+        for (unsigned neighbor : node.neighbors)
+        {
+            taken |= nodes[neighbor].reg != SPILL ? registerBit(nodes[neighbor].reg) : 0;
+        }
+
+        for (unsigned move : node.moves)
+        {
+            Register reg = nodes[findNode(coalesced, move)].reg;
+            if (reg != SPILL && !(taken & registerBit(reg)))
+            {
+                node.reg = reg;
+                break;
+            }
+        }
+        const std::vector<Register> &order = node.acrossCalls ? registers.acrossCallsOrder : registers.order;
+        for (unsigned i = 0; node.reg == SPILL && i < numColors; i++)
+        {
+            if (!(taken & registerBit(order[i])))
+            {
+                node.reg = order[i];
+            }
+        }
+        usedCalleeSaved |= node.reg != SPILL ? registerBit(node.reg) & registers.calleeSaved : 0;
+    }
+}
+
+/**
+ * Finds the caller-saved registers that each call has to save: those of the values live after it, other than its result.
+ *
+ * @param cfg The control-flow graph of the function.
+ * @param numbering The numbered instructions and values of the function.
+ * @param liveness The values live at the start and at the end of each basic block, by their global numbers.
+ * @param allocatedRegisterMap The register of each value.
+ * @param callerSaved The caller-saved registers of the target.
+ * @param callSaves Receives the caller-saved registers of the values live across each call.
+ */
+static void
+computeColoredCallSaves(const ControlFlowGraph &cfg, const FunctionNumbering &numbering,
+                        const DataflowResult<BitVector> &liveness, AllocatedReg &allocatedRegisterMap, RegisterSet callerSaved,
+                        CallSaves &callSaves)
+{
+    BitVector live(numbering.values.size());
+    for (unsigned block = 0; block < cfg.size() && !numbering.calls.empty(); block++)
+    {
+        getLiveOut(numbering, liveness, block, live);
+        walkBlockBackward(numbering, block, live, [&](int position)
+                          {
+            if (!isCallAt(numbering, position))
+            {
+                return;
+            }
+            RegisterSet saved = 0;
+            live.forEach([&](size_t value)
+                         {
+                Register reg = allocatedRegisterMap[numbering.values[value]];
+                if ((int)value != numbering.results[position] && reg != SPILL)
+                {
+                    saved |= registerBit(reg) & callerSaved;
+                } });
+            if (saved)
+            {
+                callSaves[numbering.calls[firstCallAfter(numbering, position - 1)].second] = saved;
+            } });
+    }
+}
+
+/**
+ * Allocates the registers of a target for the given LLVM function by coloring its interference graph (Chaitin and Briggs).
+ *
+ * @param function The LLVM function to allocate registers for.
+ * @param target The target, whose registers are allocated.
+ * @param usedCalleeSaved Receives the callee-saved registers the function uses, which its prologue has to save.
+ * @param callSaves Receives the caller-saved registers that are live across each call.
+ * @param blockCounts The number of times each basic block ran in the profile, or NULL.
+ * @return The AllocatedReg map that stores the register allocated to each instruction.
+ */
+AllocatedReg
+colorRegistersForFunction(LLVMValueRef function, Target target, RegisterSet &usedCalleeSaved, CallSaves &callSaves,
+                          const std::vector<uint64_t> *blockCounts)
+{
+    ControlFlowGraph cfg(function);
+    FunctionNumbering numbering;
+    numberInstructions(cfg, numbering);
+    DataflowResult<BitVector> liveness;
+    computeFunctionLiveness(cfg, numbering, liveness);
+
+    std::vector<InterferenceNode> nodes;
+    buildInterferenceGraph(cfg, numbering, liveness, blockCounts, nodes);
+    std::vector<unsigned> coalesced(nodes.size());
+    for (unsigned value = 0; value < nodes.size(); value++)
+    {
+        coalesced[value] = value;
+    }
+    RegisterFile registers = getRegisterFile(target);
+    renameNeighbors(nodes, coalesced);
+    coalesceMoves(nodes, coalesced, registers.order.size());
+    colorGraph(nodes, coalesced, registers, usedCalleeSaved);
+
+    AllocatedReg allocatedRegisterMap;
+    allocatedRegisterMap.reserve(nodes.size());
+    for (unsigned value = 0; value < nodes.size(); value++)
+    {
+        allocatedRegisterMap[numbering.values[value]] = nodes[findNode(coalesced, value)].reg;
+#ifdef DEBUG
+        char *instruction = LLVMPrintValueToString(numbering.values[value]);
+        cout << getRegisterName(allocatedRegisterMap[numbering.values[value]]) << " (node " << findNode(coalesced, value)
+             << ", cost " << nodes[findNode(coalesced, value)].spillCost << "):" << instruction << endl;
+        LLVMDisposeMessage(instruction);
+#endif
+    }
+    computeColoredCallSaves(cfg, numbering, liveness, allocatedRegisterMap, registers.callerSaved, callSaves);
+    return allocatedRegisterMap;
+}
+
+// The accesses of a function to its stack objects, numbered densely in the order they were given, by instruction position
+typedef struct
+{
+    std::vector<int> writes;                       // <position, the object the instruction writes, or -1>
+    std::vector<unsigned> readStarts;              // <position, index of its first read in reads>, and the end
+    std::vector<unsigned> reads;                   // the objects read by each instruction other than a phi
+    std::vector<int> sharedReads;                  // <position, the object read that the object written may share a slot with, or -1>
+    std::vector<unsigned> blockStarts;             // <block, position of its first instruction>, and the end
+    std::vector<std::vector<unsigned>> edgeWrites; // <block, the phis written on the edges out of it>
+    std::vector<std::vector<unsigned>> edgeReads;  // <block, the objects read on the edges out of it, into the phis>
+} StackAccesses;
+
+/**
+ * @return true if an alloca is only ever accessed as a whole, by the loads from it and the stores to it, so that its slot may be
+ * shared with the objects that are never live at the same time.
+ */
+static bool
+isUnaddressedAlloca(LLVMValueRef alloca)
+{
+    for (LLVMUseRef use = LLVMGetFirstUse(alloca); use != NULL; use = LLVMGetNextUse(use))
+    {
+        LLVMValueRef user = LLVMGetUser(use);
+        bool isLoad = LLVMIsALoadInst(user) != NULL;
+        bool isStore = LLVMIsAStoreInst(user) && LLVMGetOperand(user, 1) == alloca && LLVMGetOperand(user, 0) != alloca;
+        if (!isLoad && !isStore)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @return true if the code generator reads the first operand of an instruction before it writes the result, and can leave the
+ * result in the slot of that operand: a load copies the alloca, a store the value it stores, and an add, a subtraction or a
+ * shift can update the slot in place (see handleBinaryAndComparisonInstructions).
+ */
+static bool
+readsFirstOperandFirst(LLVMValueRef instruction)
+{
+    switch (LLVMGetInstructionOpcode(instruction))
+    {
+    case LLVMLoad:
+    case LLVMStore:
+    case LLVMAdd:
+    case LLVMSub:
+    case LLVMShl:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Records the accesses of the instructions of a function to its stack objects. An instruction whose result is an object writes
+ * it where it is computed, and a store writes the alloca it stores to; the other objects an instruction uses are read. A phi
+ * that is an object is written on the edges into its block, where the code generator copies its incoming values, which are read
+ * there.
+ *
+ * @param cfg The control-flow graph of the function.
+ * @param objectNumbers The numbers of the objects.
+ * @param accesses Receives the accesses of each instruction and edge.
+ */
+static void
+recordStackAccesses(const ControlFlowGraph &cfg, const std::unordered_map<LLVMValueRef, unsigned> &objectNumbers,
+                    StackAccesses &accesses)
+{
+    accesses.edgeWrites.resize(cfg.size());
+    accesses.edgeReads.resize(cfg.size());
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        accesses.blockStarts.push_back(accesses.writes.size());
+        for (auto instruction = LLVMGetFirstInstruction(cfg.block(block)); instruction;
+             instruction = LLVMGetNextInstruction(instruction))
+        {
+            auto object = objectNumbers.find(instruction);
+            bool isObject = object != objectNumbers.end();
+            accesses.readStarts.push_back(accesses.reads.size());
+            accesses.writes.push_back(isObject && !LLVMIsAAllocaInst(instruction) ? (int)object->second : -1);
+            accesses.sharedReads.push_back(-1);
+
+            if (LLVMIsAPHINode(instruction))
+            {
+                for (unsigned i = 0; i < LLVMCountIncoming(instruction); i++)
+                {
+                    unsigned from = cfg.index(LLVMGetIncomingBlock(instruction, i));
+                    auto incoming = objectNumbers.find(LLVMGetIncomingValue(instruction, i));
+                    if (incoming != objectNumbers.end())
+                    {
+                        accesses.edgeReads[from].push_back(incoming->second);
+                    }
+                    if (isObject)
+                    {
+                        accesses.edgeWrites[from].push_back(object->second);
+                    }
+                }
+                continue;
+            }
+
+            for (int i = 0; i < LLVMGetNumOperands(instruction); i++)
+            {
+                auto operand = objectNumbers.find(LLVMGetOperand(instruction, i));
+                if (operand == objectNumbers.end())
+                {
+                    continue;
+                }
+                if (LLVMIsAStoreInst(instruction) && i == 1)
+                {
+                    accesses.writes.back() = operand->second;
+                }
+                else
+                {
+                    accesses.reads.push_back(operand->second);
+                }
+                if (i == 0 && readsFirstOperandFirst(instruction))
+                {
+                    accesses.sharedReads.back() = operand->second;
+                }
+            }
+        }
+    }
+    accesses.blockStarts.push_back(accesses.writes.size());
+    accesses.readStarts.push_back(accesses.reads.size());
+}
+
+/**
+ * Computes which stack objects may still be read at the end of each basic block. Unlike the values, an alloca is written by
+ * every store to it, so only the reads that come before the first write in a block are live into it. Each object is followed
+ * backward on its own, from the blocks that read it to their predecessors, up to the blocks that write it, so that the work is
+ * proportional to the blocks it is live in rather than to the number of objects times the passes a dataflow solver would make
+ * over deeply nested loops.
+ *
+ * @param cfg The control-flow graph of the function.
+ * @param accesses The accesses of the function to its stack objects.
+ * @param numObjects The number of objects.
+ * @param liveOut Receives, for each block, the objects live at its end, including those read on the edges out of it.
+ */
+static void
+computeStackLiveness(const ControlFlowGraph &cfg, const StackAccesses &accesses, size_t numObjects,
+                     std::vector<BitVector> &liveOut)
+{
+    // The blocks that read each object before writing it, that read it on their outgoing edges, and that write it
+    std::vector<std::vector<unsigned>> readers(numObjects), edgeReaders(numObjects), writers(numObjects);
+    std::vector<unsigned> readIn(numObjects, 0), writtenIn(numObjects, 0); // <object, 1 + the last block that read/wrote it>
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        for (unsigned position = accesses.blockStarts[block]; position < accesses.blockStarts[block + 1]; position++)
+        {
+            for (unsigned i = accesses.readStarts[position]; i < accesses.readStarts[position + 1]; i++)
+            {
+                unsigned object = accesses.reads[i];
+                if (writtenIn[object] != block + 1 && readIn[object] != block + 1)
+                {
+                    readIn[object] = block + 1;
+                    readers[object].push_back(block);
+                }
+            }
+            int write = accesses.writes[position];
+            if (write >= 0 && writtenIn[write] != block + 1)
+            {
+                writtenIn[write] = block + 1;
+                writers[write].push_back(block);
+            }
+        }
+        for (unsigned object : accesses.edgeReads[block])
+        {
+            edgeReaders[object].push_back(block);
+        }
+    }
+
+    // Blocks are stamped with 1 + the object being followed, so the marks need no clearing between objects
+    liveOut.assign(cfg.size(), BitVector(numObjects));
+    std::vector<unsigned> writes(cfg.size(), 0), liveIn(cfg.size(), 0);
+    std::vector<unsigned> worklist;
+    for (unsigned object = 0; object < numObjects; object++)
+    {
+        unsigned stamp = object + 1;
+        auto markLiveIn = [&](unsigned block)
+        {
+            if (liveIn[block] != stamp)
+            {
+                liveIn[block] = stamp;
+                worklist.push_back(block);
+            }
+        };
+
+        for (unsigned block : writers[object])
+        {
+            writes[block] = stamp;
+        }
+        for (unsigned block : readers[object])
+        {
+            markLiveIn(block);
+        }
+        for (unsigned block : edgeReaders[object])
+        {
+            liveOut[block].set(object);
+            if (writes[block] != stamp)
+            {
+                markLiveIn(block);
+            }
+        }
+        while (!worklist.empty())
+        {
+            unsigned block = worklist.back();
+            worklist.pop_back();
+            for (unsigned predecessor : cfg.predecessors(block))
+            {
+                liveOut[predecessor].set(object);
+                if (writes[predecessor] != stamp)
+                {
+                    markLiveIn(predecessor);
+                }
+            }
+        }
+    }
+}
+
+int
+colorStackSlots(LLVMValueRef function, const std::vector<LLVMValueRef> &objects, RegMap &slots)
+{
+    // Number the objects that can share their slots; an alloca whose address is used otherwise gets a slot of its own
+    std::unordered_map<LLVMValueRef, unsigned> objectNumbers;
+    std::vector<LLVMValueRef> pooled;
+    std::vector<LLVMValueRef> addressed;
+    for (LLVMValueRef object : objects)
+    {
+        if (LLVMIsAAllocaInst(object) && !isUnaddressedAlloca(object))
+        {
+            addressed.push_back(object);
+            continue;
+        }
+        objectNumbers[object] = pooled.size();
+        pooled.push_back(object);
+    }
+
+    ControlFlowGraph cfg(function);
+    StackAccesses accesses;
+    recordStackAccesses(cfg, objectNumbers, accesses);
+
+    // The objects that may still be read at the end of each basic block
+    size_t numObjects = pooled.size();
+    std::vector<BitVector> liveOut;
+    computeStackLiveness(cfg, accesses, numObjects, liveOut);
+
+    // Two objects interfere if one is live where the other is written. An instruction writes its result after reading its
+    // operands, but the result is still kept apart from them, as the code generator may write it through more than one
+    // instruction, except from the first operand of the instructions that read it first (see readsFirstOperandFirst), whose
+    // slot the result is given if it can. Each object keeps the objects live where it is written, a word at a time; the
+    // coloring looks at both sides.
+    std::vector<std::vector<unsigned>> partners(numObjects); // <object, the objects whose slot it would rather share>
+    std::vector<BitVector> interference(numObjects, BitVector(numObjects));
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        BitVector live = liveOut[block];
+
+        // The edges copy into the phis after the branch reads its condition
+        unsigned branch = accesses.blockStarts[block + 1] - 1;
+        for (unsigned i = accesses.readStarts[branch]; i < accesses.readStarts[branch + 1]; i++)
+        {
+            live.set(accesses.reads[i]);
+        }
+        for (unsigned phi : accesses.edgeWrites[block])
+        {
+            live.set(phi);
+        }
+        for (unsigned phi : accesses.edgeWrites[block])
+        {
+            interference[phi] |= live;
+        }
+
+        for (unsigned position = accesses.blockStarts[block + 1]; position-- > accesses.blockStarts[block];)
+        {
+            int write = accesses.writes[position];
+            if (write >= 0)
+            {
+                interference[write] |= live;
+            }
+            int shared = accesses.sharedReads[position];
+            for (unsigned i = accesses.readStarts[position]; i < accesses.readStarts[position + 1]; i++)
+            {
+                if (write >= 0 && (int)accesses.reads[i] != shared)
+                {
+                    interference[write].set(accesses.reads[i]);
+                }
+            }
+            if (write >= 0 && shared >= 0 && shared != write)
+            {
+                partners[write].push_back(shared);
+                partners[shared].push_back(write);
+            }
+            if (write >= 0)
+            {
+                live.reset(write);
+            }
+            for (unsigned i = accesses.readStarts[position]; i < accesses.readStarts[position + 1]; i++)
+            {
+                live.set(accesses.reads[i]);
+            }
+        }
+    }
+
+    // Give each object the slot of a partner if it can, and otherwise the lowest slot that none of the objects it interferes
+    // with has: neither those it keeps, nor those that keep it, which the slot records
+    std::vector<int> colors(numObjects, -1);
+    std::vector<BitVector> slotInterference; // <slot, the objects that the objects in it keep>
+    int numSlots = 0;
+    for (unsigned object = 0; object < numObjects; object++)
+    {
+        interference[object].reset(object);
+        std::vector<bool> taken(numSlots + 1, false);
+        interference[object].forEach([&](size_t other)
+                                     {
+            if (colors[other] >= 0)
+            {
+                taken[colors[other]] = true;
+            } });
+        auto isFree = [&](int color)
+        {
+            return !taken[color] && (color == numSlots || !slotInterference[color].test(object));
+        };
+        int color = -1;
+        for (unsigned partner : partners[object])
+        {
+            if (colors[partner] >= 0 && isFree(colors[partner]))
+            {
+                color = colors[partner];
+                break;
+            }
+        }
+        if (color < 0)
+        {
+            color = 0;
+            while (!isFree(color))
+            {
+                color++;
+            }
+        }
+        if (color == numSlots)
+        {
+            slotInterference.push_back(BitVector(numObjects));
+            numSlots++;
+        }
+        slotInterference[color] |= interference[object];
+        colors[object] = color;
+        slots[pooled[object]] = color;
+    }
+    for (LLVMValueRef object : addressed)
+    {
+        slots[object] = numSlots++;
+    }
+
+#ifdef DEBUG
+    cout << "Stack slots: " << numSlots << " for " << objects.size() << " objects" << endl;
+#endif
+    return numSlots;
+}
@@ -4,10 +4,13 @@
  * @brief Header file for register allocation algorithm for LLVM IR code using the linear scan algorithm.
  *
  * This file defines the data structures and function declarations for the register allocation algorithm.
- * The algorithm uses the linear scan algorithm to allocate registers for LLVM IR code.
- * The file includes type definitions for the LiveUsageMap, InstIndex, RegMap, RegisterSet, and AllocatedReg data structures.
- * It also defines the Register enumeration and sets of opcodes for instructions that do not have a result value and arithmetic opcodes.
- * The file provides function declarations for allocating registers for a single function and for all functions in a module.
+ * The algorithm uses the linear scan algorithm over the live intervals of a whole function to allocate registers for LLVM IR code.
+ * A slower graph-coloring allocator, which spills less, can be selected instead for release builds.
+ * Both allocate the registers of the target: EBX, ECX and EDX on 32-bit x86, and 13 registers on x86-64.
+ * The file includes type definitions for the RegMap, RegisterSet, AllocatedReg, CallSaves and SplitIntervals data structures.
+ * It also defines the Register and Target enumerations.
+ * The file provides function declarations for allocating registers for a single function and for all functions in a module,
+ * and for sharing the stack slots of a function between the objects that are never live at the same time.
  *
  * Usage: #include "register_allocation.h"
  *
@@ -20,38 +23,128 @@
 
 #include "file_utils.h"
 #include <llvm-c/Core.h>
+#include <stdint.h>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <climits>
-#include <unordered_set>
+#include <map>
+#include <utility>
 #include <unordered_map>
 
 using namespace std;
 
 // Type definitions for data structures used in the register allocation
-typedef std::unordered_map<LLVMValueRef, std::vector<int>> LiveUsageMap;
-typedef std::vector<LLVMValueRef> InstIndex;
 typedef std::unordered_map<LLVMValueRef, int> RegMap;
-typedef std::unordered_set<LLVMOpcode> OpcodeSet;
 
-// Enumeration of available registers
+// Enumeration of available registers, by the names of their 32 bits, which hold the values of MiniC. ESI to R15D are x86-64 only.
 enum Register
 {
     EAX,
     EBX,
     ECX,
     EDX,
+    ESI,
+    EDI,
+    R8D,
+    R9D,
+    R10D,
+    R11D,
+    R12D,
+    R13D,
+    R14D,
+    R15D,
     NUM_REGISTERS,
+    ESP, // the stack and base pointers hold the frame, and are never allocated
+    EBP,
     SPILL
 };
 
-// Set of available registers
-typedef std::unordered_set<Register> RegisterSet;
+// The targets the code generator emits assembly for
+enum Target
+{
+    X86_TARGET,   // 32-bit x86 (-m32): the argument on the stack, EBX, ECX and EDX allocatable
+    X86_64_TARGET // x86-64 with the System V calling convention (-m64): the argument in EDI, 13 registers allocatable
+};
+
+/**
+ * Parses a `-m32` or `-m64` option.
+ *
+ * @param option A command-line argument.
+ * @param target Set to the target the option selects, if the argument is the option.
+ * @return true if the argument is the option.
+ */
+bool parseTargetOption(const char *option, Target &target);
+
+/**
+ * @return The option that selects a target: "-m32" or "-m64".
+ */
+const char *getTargetOption(Target target);
+
+// Set of available registers, one bit per register
+typedef uint32_t RegisterSet;
+
+/**
+ * @return The bit of a register in a RegisterSet.
+ */
+inline RegisterSet
+registerBit(Register reg)
+{
+    return (RegisterSet)1 << reg;
+}
 
 // Map of allocated registers
 typedef std::unordered_map<LLVMValueRef, Register> AllocatedReg;
 
+/**
+ * @return The registers of a target that the allocators may use. EAX is left out: the code generator uses it as scratch.
+ */
+RegisterSet getAllocatableRegisters(Target target);
+
+/**
+ * @return The registers of a target that a call may overwrite. The others are callee-saved: the functions MiniC calls (print and
+ * read) preserve them, and a function saves those it uses in its prologue.
+ */
+RegisterSet getCallerSavedRegisters(Target target);
+
+// <call, the caller-saved registers that hold values live across it>, for the calls that have to save any
+typedef std::unordered_map<LLVMValueRef, RegisterSet> CallSaves;
+
+/**
+ * The live intervals that were split. The position of an instruction is its index among all the instructions of its function, in
+ * the order of the basic blocks. A split value is in its register up to its split position, and in its stack slot from there on:
+ * it is stored to its slot where it is computed, and the instructions at or after the split position read it from the slot.
+ * Where an edge leaves a block at or after the split position for a block before it (a loop back edge), the value is reloaded
+ * into its register on the edge.
+ */
+typedef struct
+{
+    RegMap splitPositions;                                                                    // <value, split position>
+    std::map<std::pair<LLVMBasicBlockRef, LLVMBasicBlockRef>, std::vector<LLVMValueRef>> reloads; // <edge, values to reload>
+} SplitIntervals;
+
+// The register allocation algorithms
+enum RegisterAllocator
+{
+    LINEAR_SCAN_ALLOCATOR,    // linear scan over live intervals: fast, for debug builds
+    GRAPH_COLORING_ALLOCATOR  // coloring of the interference graph: fewer spills and moves, for release builds
+};
+
+/**
+ * Parses a `-regalloc=linear` or `-regalloc=graph` option.
+ *
+ * @param option A command-line argument.
+ * @param allocator Set to the allocator the option selects, if the argument is the option.
+ * @param valid Set to false if the argument is the option with an unknown allocator.
+ * @return true if the argument is the option.
+ */
+bool parseRegisterAllocatorOption(const char *option, RegisterAllocator &allocator, bool &valid);
+
+/**
+ * @return The name of an allocator in `-regalloc=<name>`: "linear" or "graph".
+ */
+const char *getRegisterAllocatorName(RegisterAllocator allocator);
+
 /**
  * Returns the name of the given register as a string.
  *
@@ -61,17 +154,68 @@ typedef std::unordered_map<LLVMValueRef, Register> AllocatedReg;
 std::string
 getRegisterName(Register reg);
 
+/**
+ * Returns the name of the 64-bit register that holds the given one on x86-64 ("rbx" for EBX, "r8" for R8D), for the addresses
+ * and for the pushes and pops of the register.
+ *
+ * @param reg The register to get the name of.
+ * @return The name of the 64-bit register as a string.
+ */
+std::string
+getWideRegisterName(Register reg);
+
 // Function declarations
 /**
- * Allocates registers for the given LLVM function using the linear scan algorithm.
- * The function creates an AllocatedReg map to store the register allocated to each instruction.
- * It then iterates over each basic block in the function and allocates registers for each basic block.
- * The allocated registers are stored in the AllocatedReg map.
+ * Allocates the registers of a target for the given LLVM function using the linear scan algorithm.
+ * The function numbers the instructions of the whole function, builds the live interval of each value from a function-wide
+ * liveness analysis, and scans the intervals in the order they start. A value keeps its register across basic blocks and
+ * loops; when the registers run out, an interval is split or spilled to its stack slot. A value that lives across a call
+ * prefers a callee-saved register, which the call preserves, and each call lists the caller-saved registers it has to save.
+ * The allocated registers are stored in the AllocatedReg map. The spill weights weigh each use by how often its basic block
+ * runs: by the loop depth of the block, or by the counts of a profile (see block_profile.h) when there are some.
+ *
+ * @param function The LLVM function to allocate registers for.
+ * @param target The target, whose registers are allocated.
+ * @param usedCalleeSaved Receives the callee-saved registers the function uses, which its prologue has to save.
+ * @param splitIntervals Receives the values whose interval was split, and the reloads on the edges of the function.
+ * @param callSaves Receives the caller-saved registers that are live across each call.
+ * @param blockCounts The number of times each basic block of the function ran in the profile, in the order of the function, or
+ *                    NULL to weigh the blocks by their loop depth.
+ * @return The AllocatedReg map that stores the register allocated to each instruction.
+ */
+AllocatedReg allocateRegisterForFunction(LLVMValueRef function, Target target, RegisterSet &usedCalleeSaved, SplitIntervals &splitIntervals,
+                                         CallSaves &callSaves, const std::vector<uint64_t> *blockCounts = NULL);
+
+/**
+ * Allocates the registers of a target for the given LLVM function by coloring its interference graph (Chaitin and Briggs).
+ * Two values interfere if one is live where the other is defined, by the function-wide liveness, so a value only holds its
+ * register where it is live. The copies between a phi and its incoming values, and between an arithmetic instruction and its
+ * first operand, are coalesced when that cannot make the graph harder to color. When the registers run out, the values with the
+ * lowest use counts for their interferences, weighted by loop depth (or by the counts of a profile), are spilled to their stack
+ * slots for their whole lives; no value is split.
  *
  * @param function The LLVM function to allocate registers for.
- * @param usedEBX A flag to indicate if the EBX register is used in the function.
+ * @param target The target, whose registers are allocated.
+ * @param usedCalleeSaved Receives the callee-saved registers the function uses, which its prologue has to save.
+ * @param callSaves Receives the caller-saved registers that are live across each call.
+ * @param blockCounts The number of times each basic block of the function ran in the profile, or NULL.
  * @return The AllocatedReg map that stores the register allocated to each instruction.
  */
-AllocatedReg allocateRegisterForFunction(LLVMValueRef function, bool &usedEBX);
+AllocatedReg colorRegistersForFunction(LLVMValueRef function, Target target, RegisterSet &usedCalleeSaved, CallSaves &callSaves,
+                                       const std::vector<uint64_t> *blockCounts = NULL);
+
+/**
+ * Assigns the stack slots of a function: the allocas, and the values that the register allocator spilled or split. Objects that
+ * are never live at the same time, by a liveness analysis of the loads, stores and uses of the objects, share a slot, so that the
+ * frame holds as many slots as objects are live at once rather than one per object. The result of a load, a store, an add, a
+ * subtraction or a shift takes the slot of its first operand if it can, since the code generator reads that operand first. An
+ * alloca whose address is used other than by a load or a store gets a slot of its own.
+ *
+ * @param function The LLVM function.
+ * @param objects The objects that need a stack slot, in the order of the function.
+ * @param slots Receives the index of the slot of each object, from 0.
+ * @return The number of slots.
+ */
+int colorStackSlots(LLVMValueRef function, const std::vector<LLVMValueRef> &objects, RegMap &slots);
 
 #endif // REGISTER_ALLOCATION_H
\ No newline at end of file
@@ -4,9 +4,9 @@
 # This script is designed to test backend programs. It iterates over all 
 # .c test files in a specified directory, excluding those named 'main.c'.
 # For each of these files, it generates LLVM IR code using Clang and then
-# x86 assembly code using a custom 'codegen' executable. It compiles the
-# original C file and the generated assembly code into two separate
-# executables. 
+# x86 assembly code using a custom 'codegen' executable, once for 32-bit
+# x86 (-m32) and once for x86-64 (-m64). It compiles the original C file
+# and the generated assembly code into two separate executables. 
 #
 # If the C file requires input (i.e., it contains a call to 'read()'),
 # it generates a random integer between 1 and 100 and uses this as input
@@ -38,66 +38,69 @@ RED='\033[0;31m'
 GREEN='\033[0;32m'
 NC='\033[0m' # No Color
 
-# Loop over each test file in the directory
-for file in `ls "$dir"/*.c | grep -v main.c`; do
-    # Exit if main.c is not found
-    if [ ! -f "$dir"/main.c ]; then
-        echo "main.c not found"
-        exit 1
-    fi
-
-    echo "Testing $file"
-
-    # Extract the base name of the file without the .c extension
-    base=$(basename "$file" .c)
-
-    # Generate LLVM IR code from the C file
-    clang -S -emit-llvm "$dir"/"$base".c -o "$dir"/"$base".ll
-
-    # Generate x86 assembly code from the LLVM IR code using the codegen executable
-    ./codegen "$dir"/"$base".ll
-
-    # Check if the codegen executable ran successfully
-    if [ $? -ne 0 ]; then
-        echo "Codegen couldn't run "$dir"/"$base".ll"
-        continue
-    fi 
-
-    # Compile the C file and the generated assembly code into an executable
-    clang "$dir"/main.c "$dir"/"$base".c -o "$dir"/"$base".expected
-    clang "$dir"/main.c "$dir"/"$base".s -m32 -o "$dir"/"$base".out
-
-    # Check if the test file requires input
-    if grep -q "= *read *(" "$dir/$base.c"; then
-        # Generate a random integer between 1 and 100
-        input=$(shuf -i 1-1000 -n 1)
-
-        echo "Test "$base" with input "$input""
-
-        # Pass the random integer as input to the expected executable and capture the output
-        expected=$(echo "$input" | "./$dir/$base.expected")
-
-        # Run the executable with the random integer as input and capture the output
-        output=$(echo "$input" | "./$dir/$base.out")
-    else
-        # Read the expected output from a file
-        expected=$("./$dir/$base.expected")
-
-        # Run the executable and capture the output
-        output=$("./$dir/$base.out")
-    fi
-
-
-    # Compare the output to the expected output
-    if [ "$output" != "$expected" ]; then
-        echo -e "${RED}Test failed: $base${NC}"
-        echo -e "${RED}Expected:${NC}"
-        echo "$expected"
-        echo -e "${RED}Got:${NC}"
-        echo "$output"
-    else
-        echo -e "${GREEN}Test passed: $base${NC}"
-    fi
-
-    rm -f "$dir"/"$base".ll "$dir"/"$base".s "$dir"/"$base".expected "$dir"/"$base".out
-done
\ No newline at end of file
+# Test both targets: the flags of codegen are also those of clang
+for target in -m32 -m64; do
+    # Loop over each test file in the directory
+    for file in `ls "$dir"/*.c | grep -v main.c`; do
+        # Exit if main.c is not found
+        if [ ! -f "$dir"/main.c ]; then
+            echo "main.c not found"
+            exit 1
+        fi
+
+        echo "Testing $file ($target)"
+
+        # Extract the base name of the file without the .c extension
+        base=$(basename "$file" .c)
+
+        # Generate LLVM IR code from the C file
+        clang -S -emit-llvm "$dir"/"$base".c -o "$dir"/"$base".ll
+
+        # Generate x86 assembly code from the LLVM IR code using the codegen executable
+        ./codegen $target "$dir"/"$base".ll
+
+        # Check if the codegen executable ran successfully
+        if [ $? -ne 0 ]; then
+            echo "Codegen couldn't run "$dir"/"$base".ll"
+            continue
+        fi 
+
+        # Compile the C file and the generated assembly code into an executable
+        clang "$dir"/main.c "$dir"/"$base".c -o "$dir"/"$base".expected
+        clang "$dir"/main.c "$dir"/"$base".s $target -o "$dir"/"$base".out
+
+        # Check if the test file requires input
+        if grep -q "= *read *(" "$dir/$base.c"; then
+            # Generate a random integer between 1 and 100
+            input=$(shuf -i 1-1000 -n 1)
+
+            echo "Test "$base" with input "$input""
+
+            # Pass the random integer as input to the expected executable and capture the output
+            expected=$(echo "$input" | "./$dir/$base.expected")
+
+            # Run the executable with the random integer as input and capture the output
+            output=$(echo "$input" | "./$dir/$base.out")
+        else
+            # Read the expected output from a file
+            expected=$("./$dir/$base.expected")
+
+            # Run the executable and capture the output
+            output=$("./$dir/$base.out")
+        fi
+
+
+        # Compare the output to the expected output
+        if [ "$output" != "$expected" ]; then
+            echo -e "${RED}Test failed: $base ($target)${NC}"
+            echo -e "${RED}Expected:${NC}"
+            echo "$expected"
+            echo -e "${RED}Got:${NC}"
+            echo "$output"
+        else
+            echo -e "${GREEN}Test passed: $base ($target)${NC}"
+        fi
+
+        rm -f "$dir"/"$base".ll "$dir"/"$base".s "$dir"/"$base".expected "$dir"/"$base".out
+    done
+done
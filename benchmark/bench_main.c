@@ -0,0 +1,43 @@
+/*
+ * The main function of the runtime benchmark: it calls the MiniC function
+ * many times, so that its own time outweighs the startup of the process.
+ *
+ * Unlike tests/backend/main.c, read() does not read stdin and print() does
+ * not write stdout: read() returns 1 to 2000 in turn, and print() only adds
+ * its argument to a sum. The time of the executable is then the time of the
+ * function and of its calls, and not of scanf and printf.
+ *
+ * usage: ./program [<iterations>] (default: 1)
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#include <stdlib.h>
+
+int func(int);
+
+static int next;
+static volatile int sum;
+
+int read()
+{
+	next = next % 2000 + 1;
+	return next;
+}
+
+void print(int x)
+{
+	sum += x;
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 1;
+	int i;
+	for (i = 0; i < iterations; i++)
+	{
+		sum += func(5);
+	}
+	return 0;
+}
@@ -0,0 +1,128 @@
+#!/bin/bash
+#######################################################################
+#
+# This script measures how the compile time of each phase of the
+# compiler grows with the size of its input. For every shape of
+# workload_gen (straight-line arithmetic, deep nesting, register
+# pressure and I/O calls), it generates programs of increasing size,
+# compiles each of them with 'minicc -ftime-report=json', which runs
+# every stage in one process, and keeps the best of REPEAT runs.
+#
+# For each shape it prints a table with one row per phase and one
+# column per size, followed by the growth of the phase between the two
+# largest sizes as an exponent: about 1 for a phase that scales
+# linearly, 2 for a quadratic one. Once a compilation takes longer than
+# TIME_LIMIT seconds, the larger sizes of that shape are skipped. Every
+# measurement is also written to RESULTS as CSV, for plotting.
+#
+# usage: ./benchmark.sh [<shape>...] (or make bench); the default is
+#        every shape. Environment variables:
+#   SIZES        - The sizes to generate (default: 100 200 400 800 1600 3200)
+#   NESTED_SIZES - The nesting depths of the nested shape, whose programs
+#                  grow faster (default: 10 20 40 80 160 320)
+#   REPEAT       - The runs per size, of which the fastest is kept (default: 3)
+#   TIME_LIMIT   - The longest a compilation may run, in seconds (default: 60)
+#   RESULTS      - The CSV file to write (default: results.csv)
+#   MINICC       - The compiler driver (default: ../driver/minicc)
+#   GENERATOR    - The program generator (default: ./workload_gen)
+#
+# Author: Aimen Abdulaziz
+# Date: Spring 2023
+
+SIZES=${SIZES:-"100 200 400 800 1600 3200"}
+NESTED_SIZES=${NESTED_SIZES:-"10 20 40 80 160 320"}
+REPEAT=${REPEAT:-3}
+TIME_LIMIT=${TIME_LIMIT:-60}
+RESULTS=${RESULTS:-results.csv}
+MINICC=${MINICC:-../driver/minicc}
+GENERATOR=${GENERATOR:-./workload_gen}
+
+shapes="$@"
+if [ -z "$shapes" ]; then
+    shapes="straight nested pressure io"
+fi
+
+for program in "$MINICC" "$GENERATOR"; do
+    if [ ! -x "$program" ]; then
+        echo "$program not found; run make first"
+        exit 1
+    fi
+done
+
+# The generated programs and their outputs live in a scratch directory
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+echo "shape,size,lines,run,phase,calls,wall_seconds,allocations,peak_rss_kib" > "$RESULTS"
+
+for shape in $shapes; do
+    sizes=$SIZES
+    if [ "$shape" = nested ]; then
+        sizes=$NESTED_SIZES
+    fi
+    echo "Benchmarking $shape: sizes $sizes"
+
+    for size in $sizes; do
+        source="$work/${shape}_$size.c"
+        if ! "$GENERATOR" "$shape" "$size" > "$source"; then
+            exit 1
+        fi
+        lines=$(wc -l < "$source")
+
+        for run in `seq $REPEAT`; do
+            timeout "$TIME_LIMIT" "$MINICC" -ftime-report=json "$source" > /dev/null 2> "$work/report.json"
+            status=$?
+            if [ $status -eq 124 ]; then
+                echo "  $shape $size: took longer than $TIME_LIMIT seconds, skipping the larger sizes"
+                continue 3
+            elif [ $status -ne 0 ]; then
+                echo "  $shape $size: minicc failed with exit code $status"
+                cat "$work/report.json"
+                exit 1
+            fi
+
+            # One CSV row per phase, and one for the whole compilation
+            sed -n 's/^ *{"name": "\([^"]*\)", "calls": \([0-9]*\), "wall_seconds": \([0-9.]*\), "allocations": \([0-9]*\), "peak_rss_kib": \([0-9]*\)}.*/\1,\2,\3,\4,\5/p' \
+                "$work/report.json" | sed "s/^/$shape,$size,$lines,$run,/" >> "$RESULTS"
+            total=$(sed -n 's/^ *"total_wall_seconds": \([0-9.]*\),/\1/p' "$work/report.json")
+            rss=$(sed -n 's/^ *"peak_rss_kib": \([0-9]*\),/\1/p' "$work/report.json")
+            echo "$shape,$size,$lines,$run,Total,1,$total,0,$rss" >> "$RESULTS"
+        done
+    done
+done
+
+# Print the fastest run of every phase, by shape and size, with its growth between the two largest sizes
+for shape in $shapes; do
+    awk -F, -v shape="$shape" '
+        $1 == shape {
+            key = $5 SUBSEP $2
+            if (!(key in best) || $7 < best[key]) best[key] = $7
+            if (!($5 in seen)) { seen[$5] = 1; phases[++nphases] = $5 }
+            if (!($2 in measured)) { measured[$2] = 1; sizes[++nsizes] = $2; lines[$2] = $3 }
+        }
+        END {
+            if (!nsizes) exit
+            printf "\n%s\n%-44s", shape, "phase \\ size (lines)"
+            for (s = 1; s <= nsizes; s++) printf " %12s", sizes[s] " (" lines[sizes[s]] ")"
+            printf " %8s\n", "growth"
+            for (p = 1; p <= nphases; p++) {
+                printf "%-44s", phases[p]
+                for (s = 1; s <= nsizes; s++) {
+                    key = phases[p] SUBSEP sizes[s]
+                    if (key in best) printf " %12.6f", best[key]; else printf " %12s", "-"
+                }
+                # Growth exponent: log(t2 / t1) / log(n2 / n1); too noisy below 10 microseconds
+                growth = "-"
+                if (nsizes > 1) {
+                    t1 = best[phases[p] SUBSEP sizes[nsizes - 1]]
+                    t2 = best[phases[p] SUBSEP sizes[nsizes]]
+                    if (t1 >= 0.00001 && t2 >= 0.00001)
+                        growth = sprintf("%.2f", log(t2 / t1) / log(sizes[nsizes] / sizes[nsizes - 1]))
+                }
+                printf " %8s\n", growth
+            }
+        }' "$RESULTS"
+done
+
+echo
+echo "Results written to $RESULTS"
@@ -0,0 +1,205 @@
+/**
+ * @file perf_run.cpp
+ * @brief Runs a program repeatedly and measures its cycles, instructions and wall time, for the runtime benchmark.
+ *
+ * Each run forks the program with its stdin read from a file and its stdout discarded, and counts the user-space cycles and
+ * instructions of the process with perf_event_open. The counters are enabled when the program is exec'ed, so they cover the
+ * program and its dynamic loader but not this runner. The wall time goes from the exec to the exit of the program. Of all the
+ * runs, the median of each measure is printed, which keeps one run that was interrupted by the scheduler from skewing it.
+ *
+ * The hardware counters are not always available: virtual machines often do not expose them, and a perf_event_paranoid above 2
+ * forbids them. Without them only the wall time is measured, and the counters are printed as "-".
+ *
+ * Usage:
+ *   ./perf_run <runs> <input> <program> [<argument>...]
+ *   <runs>    - The number of runs of the program.
+ *   <input>   - The file the program reads on stdin, such as /dev/null.
+ *   <program> - The program to run, and its arguments.
+ *
+ * Output: One line on stdout, "<instructions> <cycles> <wall_seconds>", the medians of the runs.
+ *
+ * Exit codes: 0 on success, 1 for a usage error, 2 if the program cannot be run or exits with an error.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Opens a user-space hardware counter of a process, enabled when the process calls exec.
+ *
+ * @param pid The process to count.
+ * @param config The hardware event, such as PERF_COUNT_HW_INSTRUCTIONS.
+ * @return The file descriptor of the counter, or -1 if the counter is not available.
+ */
+static int openCounter(pid_t pid, uint64_t config)
+{
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = config;
+    attributes.disabled = 1;
+    attributes.enable_on_exec = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attributes, pid, -1, -1, 0);
+}
+
+/**
+ * @brief Reads a counter and closes it.
+ *
+ * @param fd The file descriptor of the counter.
+ * @return Its count.
+ */
+static uint64_t readCounter(int fd)
+{
+    uint64_t count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+    {
+        count = 0;
+    }
+    close(fd);
+    return count;
+}
+
+/**
+ * @brief The measures of one run.
+ */
+typedef struct
+{
+    uint64_t instructions;
+    uint64_t cycles;
+    double wallSeconds;
+} runMeasures;
+
+/**
+ * @brief Runs the program once.
+ *
+ * The child waits on a pipe until the counters are attached to it, then execs the program; closing the pipe starts the run.
+ *
+ * @param input The file for the stdin of the program.
+ * @param argv The program and its arguments.
+ * @param counters Set to false if the hardware counters are not available.
+ * @param measures Receives the measures of the run.
+ * @return true if the program ran and exited with 0.
+ */
+static bool runOnce(const char *input, char **argv, bool &counters, runMeasures &measures)
+{
+    int start[2];
+    if (pipe(start))
+    {
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        return false;
+    }
+    if (pid == 0)
+    {
+        close(start[1]);
+        char go;
+        int in = open(input, O_RDONLY);
+        int out = open("/dev/null", O_WRONLY);
+        if (in < 0 || out < 0 || read(start[0], &go, 1) < 0)
+        {
+            _exit(127);
+        }
+        dup2(in, STDIN_FILENO);
+        dup2(out, STDOUT_FILENO);
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+
+    close(start[0]);
+    int instructions = -1, cycles = -1;
+    if (counters)
+    {
+        instructions = openCounter(pid, PERF_COUNT_HW_INSTRUCTIONS);
+        cycles = openCounter(pid, PERF_COUNT_HW_CPU_CYCLES);
+        if (instructions < 0 || cycles < 0)
+        {
+            cerr << "Hardware counters are not available (" << strerror(errno) << "); measuring the wall time only" << endl;
+            counters = false;
+        }
+    }
+
+    auto begin = chrono::steady_clock::now();
+    close(start[1]);
+    int status;
+    waitpid(pid, &status, 0);
+    measures.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    measures.instructions = instructions >= 0 ? readCounter(instructions) : 0;
+    measures.cycles = cycles >= 0 ? readCounter(cycles) : 0;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief Returns the median of some values; it sorts them.
+ */
+template <typename T> static T median(vector<T> &values)
+{
+    sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        cerr << "Usage: " << argv[0] << " <runs> <input> <program> [<argument>...]" << endl;
+        return 1;
+    }
+
+    char *end;
+    long runs = strtol(argv[1], &end, 10);
+    if (*end || runs < 1 || runs > 100000)
+    {
+        cerr << "Invalid number of runs '" << argv[1] << "'" << endl;
+        return 1;
+    }
+
+    bool counters = true;
+    vector<uint64_t> instructions, cycles;
+    vector<double> wallSeconds;
+    for (long run = 0; run < runs; run++)
+    {
+        runMeasures measures;
+        if (!runOnce(argv[2], argv + 3, counters, measures))
+        {
+            cerr << argv[3] << " failed" << endl;
+            return 2;
+        }
+        instructions.push_back(measures.instructions);
+        cycles.push_back(measures.cycles);
+        wallSeconds.push_back(measures.wallSeconds);
+    }
+
+    if (counters)
+    {
+        cout << median(instructions) << " " << median(cycles);
+    }
+    else
+    {
+        cout << "- -";
+    }
+    cout << " " << median(wallSeconds) << endl;
+    return 0;
+}
@@ -0,0 +1,230 @@
+#!/bin/bash
+#######################################################################
+#
+# This script measures how fast the code that minicc generates runs,
+# next to the same programs compiled by gcc without and with
+# optimization. Every program in tests/backend and a few programs of
+# workload_gen are built three ways:
+#   minicc  - the assembly of minicc (with MINICC_FLAGS)
+#   gcc-O0  - gcc -O0
+#   gcc-O2  - gcc -O2
+# Each build is linked with main.c, and the three executables must print
+# the same output. Each is also linked with bench_main.c, which calls
+# the function ITERATIONS times without any I/O, and run REPEAT times
+# with perf_run, which reports the median user-space instructions,
+# cycles and wall time. The same measures of a function that returns at
+# once are subtracted, and the rest divided by ITERATIONS, so that the
+# numbers are those of one call of the function rather than of the
+# process startup.
+#
+# It prints a table of the measures and of the ratio of minicc's
+# instructions (or wall time, without hardware counters) to gcc's, and
+# writes every measure to RESULTS as CSV. The minicc measures are then
+# checked against BASELINE: an instruction count more than
+# INSTRUCTION_THRESHOLD percent above the baseline, or a cycle count
+# more than CYCLE_THRESHOLD percent above it, is a regression, and the
+# script exits with 1. Without a baseline, or with UPDATE_BASELINE=1,
+# the results become the baseline. The baseline is only meaningful on
+# the machine and with the gcc that recorded it.
+#
+# usage: ./runtime.sh [<program>...] (or make runtime); a program is a
+#        MiniC file or a workload_gen <shape>:<size>, and the default is
+#        tests/backend and GENERATED. Environment variables:
+#   GENERATED             - The workload_gen programs of the default
+#                           list (default: straight:2000 nested:100
+#                           pressure:200 io:500)
+#   MINICC_FLAGS          - The options of minicc (default: none)
+#   TARGET                - -m32 or -m64 (default: -m32)
+#   ITERATIONS            - The calls of the function in each run
+#                           (default: 10000)
+#   REPEAT                - The runs of each executable (default: 21)
+#   INSTRUCTION_THRESHOLD - The regression threshold of the instructions,
+#                           in percent (default: 2)
+#   CYCLE_THRESHOLD       - The regression threshold of the cycles, in
+#                           percent (default: 10)
+#   BASELINE              - The baseline file (default: runtime_baseline.csv)
+#   UPDATE_BASELINE       - Set to 1 to replace the baseline
+#   RESULTS               - The CSV file to write (default: runtime.csv)
+#   CC                    - The reference compiler (default: gcc)
+#   MINICC                - The compiler driver (default: ../driver/minicc)
+#   GENERATOR             - The program generator (default: ./workload_gen)
+#   RUNNER                - The measuring program (default: ./perf_run)
+#
+# Author: Aimen Abdulaziz
+# Date: Spring 2023
+
+GENERATED=${GENERATED:-"straight:2000 nested:100 pressure:200 io:500"}
+TARGET=${TARGET:--m32}
+ITERATIONS=${ITERATIONS:-10000}
+REPEAT=${REPEAT:-21}
+INSTRUCTION_THRESHOLD=${INSTRUCTION_THRESHOLD:-2}
+CYCLE_THRESHOLD=${CYCLE_THRESHOLD:-10}
+BASELINE=${BASELINE:-runtime_baseline.csv}
+RESULTS=${RESULTS:-runtime.csv}
+CC=${CC:-gcc}
+MINICC=${MINICC:-../driver/minicc}
+GENERATOR=${GENERATOR:-./workload_gen}
+RUNNER=${RUNNER:-./perf_run}
+main=../tests/backend/main.c
+
+programs="$@"
+if [ -z "$programs" ]; then
+    programs="$(ls ../tests/backend/*.c | grep -v main.c) $GENERATED"
+fi
+
+for program in "$MINICC" "$GENERATOR" "$RUNNER"; do
+    if [ ! -x "$program" ]; then
+        echo "$program not found; run make first"
+        exit 1
+    fi
+done
+
+# The executables and their outputs live in a scratch directory
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# Enough numbers for every read() of the largest program, for main.c
+seq 1 2000 > "$work/input"
+
+# The mains are the same in every executable, so that only the function differs
+for source in "$main" bench_main.c; do
+    if ! $CC $TARGET -O2 -c "$source" -o "$work/$(basename "$source" .c).o"; then
+        echo "$CC cannot compile $source for $TARGET"
+        exit 1
+    fi
+done
+
+# The measures of a function that does nothing, to subtract from the others
+printf 'int func(int n)\n{\n\treturn 0;\n}\n' > "$work/empty.c"
+$CC $TARGET -O2 "$work/bench_main.o" "$work/empty.c" -o "$work/empty" || exit 1
+# The runner warns here if the hardware counters are not available, and is silenced for the other programs
+read empty_instructions empty_cycles empty_wall <<< "$("$RUNNER" "$REPEAT" /dev/null "$work/empty" "$ITERATIONS")"
+
+echo "program,build,instructions,cycles,wall_ns" > "$RESULTS"
+failed=0
+
+for program in $programs; do
+    # A program is a MiniC file or a workload_gen shape and size
+    if [ -f "$program" ]; then
+        name=$(basename "$program" .c)
+        cp "$program" "$work/$name.c"
+    else
+        name=${program/:/_}
+        if ! "$GENERATOR" "${program%:*}" "${program#*:}" 7 > "$work/$name.c"; then
+            exit 1
+        fi
+    fi
+    echo "Measuring $name"
+
+    # Compile the function three ways, and link each build with both mains
+    if ! "$MINICC" $TARGET $MINICC_FLAGS "$work/$name.c" > /dev/null ||
+       ! $CC $TARGET -c "$work/$name.s" -o "$work/$name.minicc.o" ||
+       ! $CC $TARGET -O0 -w -c "$work/$name.c" -o "$work/$name.gcc-O0.o" ||
+       ! $CC $TARGET -O2 -w -c "$work/$name.c" -o "$work/$name.gcc-O2.o"; then
+        echo "  $name: cannot be built"
+        failed=1
+        continue
+    fi
+    for build in minicc gcc-O0 gcc-O2; do
+        if ! $CC $TARGET "$work/main.o" "$work/$name.$build.o" -o "$work/$name.$build" ||
+           ! $CC $TARGET "$work/bench_main.o" "$work/$name.$build.o" -o "$work/$name.$build.bench"; then
+            echo "  $name: the $build build cannot be linked"
+            failed=1
+            continue 2
+        fi
+    done
+
+    # A faster program that computes something else is no faster
+    expected=$("$work/$name.gcc-O0" < "$work/input")
+    for build in minicc gcc-O2; do
+        if [ "$("$work/$name.$build" < "$work/input")" != "$expected" ]; then
+            echo "  $name: the $build build prints a different output than gcc-O0"
+            failed=1
+            continue 2
+        fi
+    done
+
+    for build in minicc gcc-O0 gcc-O2; do
+        if ! measures=$("$RUNNER" "$REPEAT" /dev/null "$work/$name.$build.bench" "$ITERATIONS" 2> /dev/null); then
+            echo "  $name: the $build build fails"
+            failed=1
+            continue 2
+        fi
+        # The measures of one call, without those of the empty function
+        echo "$measures" | awk -v empty="$empty_instructions $empty_cycles $empty_wall" -v iterations="$ITERATIONS" \
+                               -v prefix="$name,$build" '{
+            split(empty, base, " ")
+            instructions = $1 == "-" ? "-" : sprintf("%.1f", ($1 - base[1]) / iterations)
+            cycles = $2 == "-" ? "-" : sprintf("%.1f", ($2 - base[2]) / iterations)
+            printf "%s,%s,%s,%.1f\n", prefix, instructions, cycles, ($3 - base[3]) * 1000000000 / iterations
+        }' >> "$RESULTS"
+    done
+done
+
+# One row per program, with the measures of each build and minicc's ratio to gcc; the wall times without hardware counters
+echo
+awk -F, '
+    NR > 1 {
+        if (!($1 in seen)) { seen[$1] = 1; names[++n] = $1 }
+        instructions[$1, $2] = $3; cycles[$1, $2] = $4; wall[$1, $2] = $5
+        counters = $3 != "-"
+    }
+    END {
+        split("minicc gcc-O0 gcc-O2", builds, " ")
+        printf "%-16s", "program"
+        for (b = 1; b <= 3; b++)
+            if (counters) printf " %14s %14s", builds[b] " ins", builds[b] " cyc"; else printf " %14s", builds[b] " ns"
+        printf " %10s %10s\n", "vs gcc-O0", "vs gcc-O2"
+        for (i = 1; i <= n; i++) {
+            p = names[i]
+            printf "%-16s", p
+            for (b = 1; b <= 3; b++)
+                if (counters) printf " %14.1f %14.1f", instructions[p, builds[b]], cycles[p, builds[b]]
+                else printf " %14.1f", wall[p, builds[b]]
+            for (b = 2; b <= 3; b++) {
+                ours = counters ? instructions[p, "minicc"] : wall[p, "minicc"]
+                theirs = counters ? instructions[p, builds[b]] : wall[p, builds[b]]
+                if (ours > 0 && theirs > 0) printf " %10.2f", ours / theirs; else printf " %10s", "-"
+            }
+            printf "\n"
+        }
+        printf "\nThe ratios are of the %s of minicc'"'"'s code to gcc'"'"'s; below 1, minicc'"'"'s is faster.\n",
+               counters ? "instructions" : "wall time"
+        if (!counters) print "Without hardware counters only the wall times are measured, and nothing is checked against the baseline."
+    }' "$RESULTS"
+echo "Results written to $RESULTS"
+
+# Check the minicc measures against the baseline, or record it
+if [ "$UPDATE_BASELINE" = 1 ] || [ ! -f "$BASELINE" ]; then
+    cp "$RESULTS" "$BASELINE"
+    echo "Baseline written to $BASELINE"
+    exit $failed
+fi
+echo
+awk -F, -v instruction_threshold="$INSTRUCTION_THRESHOLD" -v cycle_threshold="$CYCLE_THRESHOLD" '
+    FNR == 1 { next }
+    FILENAME == ARGV[1] { baseline[$1, $2, "instructions"] = $3; baseline[$1, $2, "cycles"] = $4; next }
+    $2 == "minicc" {
+        for (m = 0; m < 2; m++) {
+            measure = m ? "cycles" : "instructions"
+            threshold = m ? cycle_threshold : instruction_threshold
+            value = m ? $4 : $3
+            old = baseline[$1, $2, measure]
+            if (value == "-" || old == "" || old == "-" || old <= 0)
+                continue
+            checked++
+            change = 100 * (value - old) / old
+            if (change > threshold) {
+                printf "Regression: %s %s %.1f -> %.1f (%+.1f%%, threshold %s%%)\n", $1, measure, old, value, change, threshold
+                regressions++
+            } else if (change < -threshold) {
+                printf "Improvement: %s %s %.1f -> %.1f (%+.1f%%)\n", $1, measure, old, value, change
+            }
+        }
+    }
+    END {
+        if (regressions) exit 1
+        if (checked) print "No regression against the baseline"; else print "Nothing to check against the baseline"
+    }' "$BASELINE" "$RESULTS" || failed=1
+
+exit $failed
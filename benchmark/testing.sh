@@ -0,0 +1,85 @@
+#!/bin/bash
+#######################################################################
+#
+# This script checks the programs of workload_gen end to end. For a few
+# sizes of every shape, it generates a program, compiles it with
+# minicc, and compiles it with clang as the reference. Both executables
+# read the same numbers and their outputs are compared. Each
+# compilation is given a time limit, so that a pass that stops
+# converging on a large input fails the test instead of hanging it, and
+# a memory limit, so that one whose data grows with the square of the
+# program fails too. A size may name the flags to compile it with: the
+# deepest nest is compiled at -O0, whose time and memory grow with the
+# program alone.
+# Last, the runtime benchmark is run on two programs, without a stored
+# baseline, to check that it builds and measures all three builds.
+#
+# Colors are used in the terminal output to make the pass/fail results
+# more visually distinct. Specifically, green is used for 'passed' messages,
+# and red is used for 'failed' messages.
+#
+# usage: ./testing.sh (make sure ./testing.sh is executable) or use make test
+#
+# Author: Aimen Abdulaziz
+# Date: Spring 2023
+
+# Compile the generator and the driver
+make
+make -C ../driver
+
+# The runtime of the test programs
+main=../tests/backend/main.c
+
+# Define ANSI escape codes for colors
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m' # No Color
+
+work=$(mktemp -d)
+
+# Enough numbers for every read() of the largest program
+input=$(seq 1 2000)
+
+# The address space a compilation may use, in KiB
+memory_limit=524288
+
+for test in straight:5 straight:500 nested:1 nested:15 nested:8000:-O0 pressure:5 pressure:300 io:5 io:500; do
+    IFS=: read -r shape size flags <<< "$test"
+    base="$work/${shape}_$size"
+    echo "Testing $shape $size $flags"
+
+    ./workload_gen "$shape" "$size" 7 > "$base".c
+
+    # Compile the program with minicc and with clang
+    if ! (ulimit -v $memory_limit && timeout 60 ../driver/minicc $flags "$base".c > /dev/null); then
+        echo -e "${RED}Test failed: minicc could not compile $shape $size${NC}"
+        continue
+    fi
+    clang "$main" "$base".s -m32 -o "$base".out
+    clang "$main" "$base".c -o "$base".expected
+
+    expected=$(echo "$input" | "$base".expected)
+    output=$(echo "$input" | "$base".out)
+
+    # Compare the output to the expected output
+    if [ "$output" != "$expected" ]; then
+        echo -e "${RED}Test failed: $shape $size${NC}"
+        echo -e "${RED}Expected:${NC}"
+        echo "$expected" | head -5
+        echo -e "${RED}Got:${NC}"
+        echo "$output" | head -5
+    else
+        echo -e "${GREEN}Test passed: $shape $size${NC}"
+    fi
+done
+
+# The runtime benchmark must build and check every way of compiling a program
+echo "Testing the runtime benchmark"
+if RESULTS="$work/runtime.csv" BASELINE="$work/baseline.csv" REPEAT=1 ITERATIONS=10 ./runtime.sh ../tests/backend/p10.c io:5 > /dev/null &&
+   [ $(grep -c -e ',minicc,' -e ',gcc-O0,' -e ',gcc-O2,' "$work/runtime.csv") -eq 6 ]; then
+    echo -e "${GREEN}Test passed: runtime benchmark${NC}"
+else
+    echo -e "${RED}Test failed: runtime benchmark${NC}"
+fi
+
+rm -rf "$work"
@@ -0,0 +1,367 @@
+/**
+ * @file workload_gen.cpp
+ * @brief Generator of MiniC programs of any size, for the compile-time benchmark.
+ *
+ * Each shape stresses a different part of the compiler as it grows:
+ *   straight - One long basic block of arithmetic over a few locals, with repeated subexpressions and constants, for the
+ *              local optimizations (constant folding and propagation, CSE) and the per-block dataflow.
+ *   nested   - `if` and `while` statements nested <size> deep, for the parser's and the AST walks' depth, the number of
+ *              basic blocks and the dataflow over the control-flow graph.
+ *   pressure - <size> locals that are all live across one loop, for liveness and register allocation.
+ *   io       - <size> `read` and `print` calls, whose results and arguments have to survive the calls.
+ *
+ * The programs are valid MiniC (no division, at most one operator per expression, comparisons between terms only), always
+ * terminate, and print a value that depends on every statement, so that they can also be run and compared against clang.
+ * The same shape, size and seed always give the same program.
+ *
+ * Usage:
+ *   ./workload_gen <shape> <size> [<seed>]
+ *   <shape> - straight, nested, pressure or io.
+ *   <size>  - The number of statements, the nesting depth, the number of locals or the number of calls, depending on the shape.
+ *   <seed>  - Seed of the choice of operators and operands (default: 1).
+ *
+ * Output: The program, on stdout.
+ *
+ * Exit codes: 0 on success, 1 for a usage error.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+using namespace std;
+
+// Locals of the straight-line and io shapes; few enough that they stay in registers
+#define STRAIGHT_LOCALS 8
+
+// Deepest indentation of the nested shape, so that its source grows linearly with the depth
+#define MAX_INDENT 16
+
+/**
+ * @brief A small deterministic random number generator (xorshift64), the same on every platform.
+ */
+class workloadRandom
+{
+public:
+    explicit workloadRandom(uint64_t seed) : state(seed * 2654435761ULL + 1) {}
+
+    /**
+     * @return A number from 0 to bound - 1.
+     */
+    unsigned next(unsigned bound)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return (unsigned)(state % bound);
+    }
+
+private:
+    uint64_t state;
+};
+
+/**
+ * @brief Returns the name of the i-th local of a program.
+ *
+ * @param prefix The prefix of the name.
+ * @param i The number of the local.
+ * @return The name.
+ */
+static string local(const char *prefix, int i)
+{
+    return prefix + to_string(i);
+}
+
+/**
+ * @brief Returns the indentation of a statement at a nesting depth.
+ *
+ * @param depth The nesting depth, 1 for the function body.
+ * @return The tabs.
+ */
+static string indentation(int depth)
+{
+    return string(depth < MAX_INDENT ? depth : MAX_INDENT, '\t');
+}
+
+/**
+ * @brief Returns an arithmetic operator; multiplication is rarer so that values do not overflow all the time.
+ *
+ * @param random The random number generator.
+ * @return "+", "-" or "*".
+ */
+static const char *arithmeticOperator(workloadRandom &random)
+{
+    static const char *operators[] = {"+", "-", "+", "-", "*"};
+    return operators[random.next(5)];
+}
+
+/**
+ * @brief Prints the extern declarations and the function header.
+ *
+ * @param out The stream to print to.
+ */
+static void printHeader(ostream &out)
+{
+    out << "extern void print(int);" << endl;
+    out << "extern int read();" << endl;
+    out << endl;
+    out << "int func(int n)" << endl;
+    out << "{" << endl;
+}
+
+/**
+ * @brief Prints a long straight-line block of arithmetic.
+ *
+ * About a quarter of the statements repeat the expression of an earlier one, and another quarter use a constant operand, so
+ * there is work for CSE and for constant folding and propagation all along the block.
+ *
+ * @param out The stream to print to.
+ * @param size The number of arithmetic statements.
+ * @param random The random number generator.
+ */
+static void generateStraight(ostream &out, int size, workloadRandom &random)
+{
+    for (int i = 0; i < STRAIGHT_LOCALS; i++)
+    {
+        out << "\tint " << local("v", i) << ";" << endl;
+    }
+    for (int i = 0; i < STRAIGHT_LOCALS; i++)
+    {
+        if (i % 2)
+        {
+            out << "\t" << local("v", i) << " = " << i + 1 << ";" << endl;
+        }
+        else
+        {
+            out << "\t" << local("v", i) << " = n + " << i << ";" << endl;
+        }
+    }
+
+    string previous = "v0 + v1";
+    for (int i = 0; i < size; i++)
+    {
+        string target = local("v", random.next(STRAIGHT_LOCALS));
+        string expression;
+        switch (random.next(4))
+        {
+        case 0:
+            expression = previous;
+            break;
+        case 1:
+            expression = local("v", random.next(STRAIGHT_LOCALS)) + " " + arithmeticOperator(random) + " " +
+                         to_string(random.next(100));
+            break;
+        default:
+            expression = local("v", random.next(STRAIGHT_LOCALS)) + " " + arithmeticOperator(random) + " " +
+                         local("v", random.next(STRAIGHT_LOCALS));
+            previous = expression;
+            break;
+        }
+        out << "\t" << target << " = " << expression << ";" << endl;
+    }
+
+    for (int i = 1; i < STRAIGHT_LOCALS; i++)
+    {
+        out << "\tv0 = v0 + " << local("v", i) << ";" << endl;
+    }
+    out << "\tprint(v0);" << endl;
+    out << "\treturn v0;" << endl;
+}
+
+/**
+ * @brief Prints `if` and `while` statements nested `size` deep.
+ *
+ * Even levels are `if` statements with an `else` branch, odd levels are `while` loops that run once, so the program runs the
+ * innermost statement once whatever the depth.
+ *
+ * @param out The stream to print to.
+ * @param size The nesting depth.
+ * @param random The random number generator.
+ */
+static void generateNested(ostream &out, int size, workloadRandom &random)
+{
+    out << "\tint s;" << endl;
+    for (int i = 1; i < size; i += 2)
+    {
+        out << "\tint " << local("c", i) << ";" << endl;
+    }
+    out << "\ts = 0;" << endl;
+
+    for (int i = 0; i < size; i++)
+    {
+        string indent = indentation(i + 1);
+        if (i % 2 == 0)
+        {
+            out << indent << "if (n > " << random.next(10) << ")" << endl;
+            out << indent << "{" << endl;
+            out << indent << "\ts = s + " << i << ";" << endl;
+        }
+        else
+        {
+            out << indent << local("c", i) << " = 0;" << endl;
+            out << indent << "while (" << local("c", i) << " < 1)" << endl;
+            out << indent << "{" << endl;
+            out << indent << "\ts = s - " << i << ";" << endl;
+        }
+    }
+    out << indentation(size + 1) << "s = s * 2;" << endl;
+    for (int i = size - 1; i >= 0; i--)
+    {
+        string indent = indentation(i + 1);
+        if (i % 2 == 0)
+        {
+            out << indent << "}" << endl;
+            out << indent << "else" << endl;
+            out << indent << "\ts = s + 1;" << endl;
+        }
+        else
+        {
+            out << indent << "\t" << local("c", i) << " = " << local("c", i) << " + 1;" << endl;
+            out << indent << "}" << endl;
+        }
+    }
+
+    out << "\tprint(s);" << endl;
+    out << "\treturn s;" << endl;
+}
+
+/**
+ * @brief Prints `size` locals that are all live across a loop.
+ *
+ * Every local is defined before the loop, updated from its neighbour inside it and read after it, so all of them are live at
+ * once and register allocation has to spill all but a few.
+ *
+ * @param out The stream to print to.
+ * @param size The number of locals.
+ * @param random The random number generator.
+ */
+static void generatePressure(ostream &out, int size, workloadRandom &random)
+{
+    out << "\tint i;" << endl;
+    out << "\tint s;" << endl;
+    for (int i = 0; i < size; i++)
+    {
+        out << "\tint " << local("r", i) << ";" << endl;
+    }
+    for (int i = 0; i < size; i++)
+    {
+        out << "\t" << local("r", i) << " = n + " << random.next(100) << ";" << endl;
+    }
+
+    out << "\ti = 0;" << endl;
+    out << "\twhile (i < 3)" << endl;
+    out << "\t{" << endl;
+    for (int i = 0; i < size; i++)
+    {
+        out << "\t\t" << local("r", i) << " = " << local("r", i) << " " << (random.next(2) ? "+" : "-") << " "
+            << local("r", (i + 1) % size) << ";" << endl;
+    }
+    out << "\t\ti = i + 1;" << endl;
+    out << "\t}" << endl;
+
+    out << "\ts = 0;" << endl;
+    for (int i = size - 1; i >= 0; i--)
+    {
+        out << "\ts = s + " << local("r", i) << ";" << endl;
+    }
+    out << "\tprint(s);" << endl;
+    out << "\treturn s;" << endl;
+}
+
+/**
+ * @brief Prints `size` calls to `read` and `print`, mixed with arithmetic on their results.
+ *
+ * @param out The stream to print to.
+ * @param size The number of calls.
+ * @param random The random number generator.
+ */
+static void generateIO(ostream &out, int size, workloadRandom &random)
+{
+    for (int i = 0; i < STRAIGHT_LOCALS; i++)
+    {
+        out << "\tint " << local("v", i) << ";" << endl;
+    }
+    for (int i = 0; i < STRAIGHT_LOCALS; i++)
+    {
+        out << "\t" << local("v", i) << " = n + " << i << ";" << endl;
+    }
+
+    for (int i = 0; i < size; i++)
+    {
+        string var = local("v", random.next(STRAIGHT_LOCALS));
+        if (random.next(2))
+        {
+            out << "\t" << var << " = read();" << endl;
+        }
+        else
+        {
+            out << "\tprint(" << var << ");" << endl;
+        }
+        // Keep the values flowing through the calls
+        out << "\t" << local("v", random.next(STRAIGHT_LOCALS)) << " = " << var << " + "
+            << local("v", random.next(STRAIGHT_LOCALS)) << ";" << endl;
+    }
+
+    for (int i = 1; i < STRAIGHT_LOCALS; i++)
+    {
+        out << "\tv0 = v0 + " << local("v", i) << ";" << endl;
+    }
+    out << "\tprint(v0);" << endl;
+    out << "\treturn v0;" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3 && argc != 4)
+    {
+        cerr << "Usage: " << argv[0] << " <straight|nested|pressure|io> <size> [<seed>]" << endl;
+        return 1;
+    }
+
+    char *end;
+    long size = strtol(argv[2], &end, 10);
+    if (*end || size < 1 || size > 10000000)
+    {
+        cerr << "Invalid size '" << argv[2] << "'" << endl;
+        return 1;
+    }
+    unsigned long long seed = 1;
+    if (argc == 4)
+    {
+        seed = strtoull(argv[3], &end, 10);
+        if (*end)
+        {
+            cerr << "Invalid seed '" << argv[3] << "'" << endl;
+            return 1;
+        }
+    }
+
+    struct
+    {
+        const char *name;
+        void (*generate)(ostream &, int, workloadRandom &);
+    } shapes[] = {{"straight", generateStraight},
+                  {"nested", generateNested},
+                  {"pressure", generatePressure},
+                  {"io", generateIO}};
+
+    for (auto &shape : shapes)
+    {
+        if (!strcmp(argv[1], shape.name))
+        {
+            workloadRandom random(seed);
+            printHeader(cout);
+            shape.generate(cout, (int)size, random);
+            cout << "}" << endl;
+            return 0;
+        }
+    }
+
+    cerr << "Unknown shape '" << argv[1] << "'" << endl;
+    return 1;
+}
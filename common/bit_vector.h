@@ -0,0 +1,142 @@
+/**
+ * @file bit_vector.h
+ *
+ * @brief A fixed-size set of small integers, packed into 64-bit words.
+ *
+ * Used by the dataflow analyses, which number the facts they track (such as the store instructions of a function) densely from
+ * 0 and keep one set of them per basic block. Union, intersection and difference work a whole word at a time in plain loops
+ * that the compiler vectorizes, and equality is a comparison of the words, so an iteration of the analysis costs a few words
+ * per block instead of a hash-set operation per fact. The sets taking part in an operation must have the same size.
+ *
+ * Usage:
+ *     BitVector in(numStores), kill(numStores);
+ *     kill.set(3);
+ *     in.subtract(kill);
+ *     in.forEach([&](size_t i) { use(stores[i]); });
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef BIT_VECTOR_H
+#define BIT_VECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class BitVector
+{
+public:
+    BitVector() : numBits(0) {}
+
+    /**
+     * @brief Creates an empty set of the numbers 0 to `numBits` - 1.
+     */
+    explicit BitVector(size_t numBits) : words((numBits + 63) / 64, 0), numBits(numBits) {}
+
+    size_t size() const { return numBits; }
+
+    void set(size_t i) { words[i / 64] |= (uint64_t)1 << (i % 64); }
+    void reset(size_t i) { words[i / 64] &= ~((uint64_t)1 << (i % 64)); }
+    bool test(size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+
+    /**
+     * @brief Removes every number from the set.
+     */
+    void clear()
+    {
+        for (uint64_t &word : words)
+        {
+            word = 0;
+        }
+    }
+
+    /**
+     * @return true if the set is empty.
+     */
+    bool none() const
+    {
+        for (uint64_t word : words)
+        {
+            if (word)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @return The number of numbers in the set.
+     */
+    size_t count() const
+    {
+        size_t total = 0;
+        for (uint64_t word : words)
+        {
+            total += __builtin_popcountll(word);
+        }
+        return total;
+    }
+
+    /**
+     * @brief Adds the numbers of `other` (union).
+     */
+    BitVector &operator|=(const BitVector &other)
+    {
+        for (size_t i = 0; i < words.size(); i++)
+        {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Keeps only the numbers that are also in `other` (intersection).
+     */
+    BitVector &operator&=(const BitVector &other)
+    {
+        for (size_t i = 0; i < words.size(); i++)
+        {
+            words[i] &= other.words[i];
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Removes the numbers of `other` (difference).
+     */
+    BitVector &subtract(const BitVector &other)
+    {
+        for (size_t i = 0; i < words.size(); i++)
+        {
+            words[i] &= ~other.words[i];
+        }
+        return *this;
+    }
+
+    bool operator==(const BitVector &other) const { return numBits == other.numBits && words == other.words; }
+    bool operator!=(const BitVector &other) const { return !(*this == other); }
+
+    /**
+     * @brief Calls `visit(i)` for every number `i` of the set, in increasing order.
+     */
+    template <typename Visitor>
+    void forEach(Visitor visit) const
+    {
+        for (size_t i = 0; i < words.size(); i++)
+        {
+            for (uint64_t word = words[i]; word; word &= word - 1)
+            {
+                visit(i * 64 + __builtin_ctzll(word));
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> words;
+    size_t numBits;
+};
+
+#endif // BIT_VECTOR_H
@@ -0,0 +1,175 @@
+/**
+ * @file block_profile.cpp
+ *
+ * @brief This file contains the definitions of the block profiles: the reader of the profile files, and the checksum of the
+ * control-flow graphs that ties the counts to the functions they were counted on.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "block_profile.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+
+bool BlockProfile::read(const std::string &path, std::string &error)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    std::vector<uint64_t> *counts = NULL; // the counts of the record being read
+    size_t block = 0;                     // the next block of the record
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string first;
+        fields >> first;
+        if (counts && block < counts->size())
+        {
+            // `<label> <count>`: the label is only there for the reader, as the block is the next one of the function
+            uint64_t count;
+            if (!(fields >> count))
+            {
+                error = path + ":" + std::to_string(lineNumber) + ": expected the count of block " + std::to_string(block);
+                return false;
+            }
+            (*counts)[block++] += count;
+        }
+        else if (first == "function")
+        {
+            // `function <name> <checksum> <blocks>`: a record of a run, added to the records of the same function
+            std::string name;
+            uint32_t checksum;
+            size_t numBlocks;
+            if (!(fields >> name >> checksum >> numBlocks))
+            {
+                error = path + ":" + std::to_string(lineNumber) + ": malformed function record";
+                return false;
+            }
+            counts = &functions[name][checksum];
+            if (counts->empty())
+            {
+                counts->assign(numBlocks, 0);
+            }
+            else if (counts->size() != numBlocks)
+            {
+                error = path + ":" + std::to_string(lineNumber) + ": " + name + " has " + std::to_string(counts->size()) +
+                        " blocks in an earlier record";
+                return false;
+            }
+            block = 0;
+        }
+        else
+        {
+            error = path + ":" + std::to_string(lineNumber) + ": expected a function record";
+            return false;
+        }
+    }
+    if (counts && block < counts->size())
+    {
+        error = path + ": the last record ends before its last block";
+        return false;
+    }
+    return true;
+}
+
+const std::vector<uint64_t> *BlockProfile::blockCounts(const std::string &function, uint32_t checksum) const
+{
+    auto records = functions.find(function);
+    if (records == functions.end())
+    {
+        return NULL;
+    }
+    auto counts = records->second.find(checksum);
+    return counts == records->second.end() ? NULL : &counts->second;
+}
+
+bool BlockProfile::hasFunction(const std::string &function) const
+{
+    return functions.count(function) > 0;
+}
+
+uint64_t BlockProfile::entryCount(const std::string &function) const
+{
+    uint64_t count = 0;
+    auto records = functions.find(function);
+    if (records != functions.end())
+    {
+        for (auto &record : records->second)
+        {
+            count += record.second.empty() ? 0 : record.second[0];
+        }
+    }
+    return count;
+}
+
+bool parseProfileOption(const char *option, ProfileOptions &options, BlockProfile &profile, bool &valid)
+{
+    if (!strcmp(option, "-fprofile-generate"))
+    {
+        options.instrument = true;
+        return true;
+    }
+    if (strcmp(option, "-fprofile-use") && strncmp(option, "-fprofile-use=", strlen("-fprofile-use=")))
+    {
+        return false;
+    }
+    const char *path = option[strlen("-fprofile-use")] ? option + strlen("-fprofile-use=") : DEFAULT_PROFILE_FILE;
+    std::string error;
+    if (!profile.read(path, error))
+    {
+        std::cerr << "Invalid profile: " << error << std::endl;
+        valid = false;
+    }
+    options.profile = &profile;
+    return true;
+}
+
+uint32_t computeCFGChecksum(const ControlFlowGraph &cfg)
+{
+    uint32_t hash = 2166136261u;
+    auto add = [&hash](uint32_t value)
+    {
+        for (int byte = 0; byte < 4; byte++)
+        {
+            hash = (hash ^ ((value >> (8 * byte)) & 0xFF)) * 16777619u;
+        }
+    };
+    add(cfg.size());
+    for (unsigned block = 0; block < cfg.size(); block++)
+    {
+        add(cfg.successors(block).size());
+        for (unsigned successor : cfg.successors(block))
+        {
+            add(successor);
+        }
+    }
+    return hash;
+}
+
+bool computeProfileWeights(const std::vector<uint64_t> &counts, double coldWeight, std::vector<double> &weights)
+{
+    if (counts.empty() || counts[0] == 0)
+    {
+        return false;
+    }
+    weights.resize(counts.size());
+    for (size_t block = 0; block < counts.size(); block++)
+    {
+        weights[block] = counts[block] ? (double)counts[block] / counts[0] : coldWeight;
+    }
+    return true;
+}
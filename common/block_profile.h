@@ -0,0 +1,117 @@
+/**
+ * @file block_profile.h
+ *
+ * @brief The block profiles of profile-guided compilation: how many times each basic block of each function ran.
+ *
+ * A program compiled with `-fprofile-generate` counts the runs of every basic block, and the runtime it is linked with
+ * (`backend/profile_runtime.c`) appends the counts to a profile file when the program exits. A profile holds, for every function,
+ * a `function <name> <checksum> <blocks>` line, then a `<label> <count>` line for each of its basic blocks, in the order of the
+ * function, under the labels the code generator gave them (see createBBLabel). Every run appends its own records, and the reader
+ * adds up the records of a function, so a profile can gather any number of runs; lines that start with `#` are comments.
+ *
+ * A compilation with `-fprofile-use` reads the profile back. The counts of a function are only used if its control-flow graph has
+ * the same checksum as when it was counted, so a function that changed since, or that is compiled with other options, is
+ * compiled as it would be without a profile. Its blocks are matched by their position in the function rather than by their
+ * labels, which also depend on the functions before it. The one exception is the optimizer, which runs before the graph that
+ * was counted exists: it finds a function that never ran by name alone, with hasFunction and entryCount.
+ *
+ * Usage:
+ *     BlockProfile profile;
+ *     std::string error;
+ *     if (!profile.read("minicc.profile", error)) ...
+ *     const std::vector<uint64_t> *counts = profile.blockCounts("func", computeCFGChecksum(cfg));
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef BLOCK_PROFILE_H
+#define BLOCK_PROFILE_H
+
+#include "dataflow.h"
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// The profile file that instrumented programs write, unless the MINICC_PROFILE_FILE environment variable names another, and that
+// -fprofile-use reads unless it names another
+#define DEFAULT_PROFILE_FILE "minicc.profile"
+
+/**
+ * @brief The block counts of the functions of a program, gathered from the runs of its instrumented build.
+ */
+class BlockProfile
+{
+public:
+    /**
+     * @brief Reads a profile file, adding its counts to those already read.
+     *
+     * @param path The profile file.
+     * @param error Receives the reason if the file cannot be read or is not a profile.
+     * @return true if the file was read.
+     */
+    bool read(const std::string &path, std::string &error);
+
+    /**
+     * @return The number of times each basic block of a function ran, in the order of its blocks, or NULL if the profile has no
+     * counts for the function with this control-flow graph.
+     */
+    const std::vector<uint64_t> *blockCounts(const std::string &function, uint32_t checksum) const;
+
+    /**
+     * @return true if the profile has counts for a function, whatever its control-flow graph was.
+     */
+    bool hasFunction(const std::string &function) const;
+
+    /**
+     * @return The number of times a function was entered, in all its records; 0 if the profile has none.
+     */
+    uint64_t entryCount(const std::string &function) const;
+
+private:
+    // <function, <checksum, the counts of its blocks>>
+    std::map<std::string, std::map<uint32_t, std::vector<uint64_t>>> functions;
+};
+
+// The profile-guided compilation of a module
+typedef struct
+{
+    bool instrument;             // count the runs of every basic block (-fprofile-generate)
+    const BlockProfile *profile; // the counts of the runs to compile by (-fprofile-use), or NULL
+} ProfileOptions;
+
+/**
+ * @brief Parses a `-fprofile-generate` or `-fprofile-use[=<file>]` option. The profile of `-fprofile-use` (DEFAULT_PROFILE_FILE
+ * unless the option names one) is read at once, with a message on stderr if it cannot be.
+ *
+ * @param option A command-line argument.
+ * @param options Updated if the argument is one of the options: instrumented, or compiled by `profile`.
+ * @param profile Receives the counts of the profile file of `-fprofile-use`.
+ * @param valid Set to false if the argument is `-fprofile-use` but its file cannot be read.
+ * @return true if the argument is one of the options.
+ */
+bool parseProfileOption(const char *option, ProfileOptions &options, BlockProfile &profile, bool &valid);
+
+/**
+ * @brief Computes the checksum of the control-flow graph of a function: its number of basic blocks and the successors of each.
+ *
+ * @param cfg The control-flow graph.
+ * @return The checksum (32-bit FNV-1a).
+ */
+uint32_t computeCFGChecksum(const ControlFlowGraph &cfg);
+
+/**
+ * @brief Returns the weight of each basic block of a function for a heuristic: how many times it ran per run of the function.
+ *
+ * A block that never ran weighs `coldWeight` instead of 0, so that the heuristic can still tell such blocks apart by what they
+ * hold.
+ *
+ * @param counts The number of times each basic block ran; the entry block is the first.
+ * @param coldWeight The weight of a block that never ran.
+ * @param weights Receives the weight of each basic block, unless the function never ran.
+ * @return true if the weights were computed, false if the function never ran, so that its counts say nothing.
+ */
+bool computeProfileWeights(const std::vector<uint64_t> &counts, double coldWeight, std::vector<double> &weights);
+
+#endif // BLOCK_PROFILE_H
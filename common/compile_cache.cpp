@@ -0,0 +1,421 @@
+/**
+ * @file compile_cache.cpp
+ *
+ * @brief This file contains the definitions of the content-addressed compilation cache.
+ *
+ * An entry file starts with the line `minicc-cache 1`, followed by each artifact as a `<name> <size>` line and the `size`
+ * bytes of its contents. The stats file holds one `<counter> <value>` line per counter.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "compile_cache.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// First line of every entry file; bump the version when the format changes
+static const char *ENTRY_HEADER = "minicc-cache 1\n";
+
+/**
+ * @brief Creates `directory` and any missing parent directories.
+ *
+ * @param directory The directory to create.
+ * @return true if the directory exists afterwards.
+ */
+static bool makeDirectories(const string &directory)
+{
+    for (size_t slash = directory.find('/', 1); slash != string::npos; slash = directory.find('/', slash + 1))
+    {
+        mkdir(directory.substr(0, slash).c_str(), 0777);
+    }
+    struct stat info;
+    return (mkdir(directory.c_str(), 0777) == 0 || errno == EEXIST) && stat(directory.c_str(), &info) == 0 &&
+           S_ISDIR(info.st_mode);
+}
+
+// The first 32 bits of the fractional parts of the cube roots of the first 64 primes (FIPS 180-4)
+static const uint32_t SHA256_ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
+    0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
+    0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static inline uint32_t rotateRight(uint32_t value, unsigned count)
+{
+    return (value >> count) | (value << (32 - count));
+}
+
+compileCacheKey::compileCacheKey()
+    : state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19}, hashedBytes(0)
+{
+}
+
+void compileCacheKey::addBytes(const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    while (size > 0)
+    {
+        size_t filled = hashedBytes % sizeof(block);
+        size_t chunk = min(size, sizeof(block) - filled);
+        memcpy(block + filled, bytes, chunk);
+        hashedBytes += chunk;
+        bytes += chunk;
+        size -= chunk;
+        if (hashedBytes % sizeof(block) == 0)
+        {
+            compress();
+        }
+    }
+}
+
+/**
+ * @brief Mixes the full block into the state of the hash (the SHA-256 compression function).
+ */
+void compileCacheKey::compress()
+{
+    uint32_t schedule[64];
+    for (int i = 0; i < 16; i++)
+    {
+        schedule[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 | (uint32_t)block[4 * i + 2] << 8 |
+                      block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = rotateRight(schedule[i - 15], 7) ^ rotateRight(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+        uint32_t s1 = rotateRight(schedule[i - 2], 17) ^ rotateRight(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        uint32_t choice = (e & f) ^ (~e & g);
+        uint32_t temp1 = h + s1 + choice + SHA256_ROUND_CONSTANTS[i] + schedule[i];
+        uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+string compileCacheKey::value() const
+{
+    // Pad a copy, so that more parts can still be added to the key: a 1 bit, zeros up to the last 8 bytes of a block, and the
+    // length in bits as a big-endian number
+    compileCacheKey padded = *this;
+    unsigned char padding[sizeof(block) + 8] = {0x80};
+    size_t zeros = (sizeof(block) + 56 - (hashedBytes + 1) % sizeof(block)) % sizeof(block);
+    uint64_t bits = hashedBytes * 8;
+    for (int i = 0; i < 8; i++)
+    {
+        padding[1 + zeros + i] = (unsigned char)(bits >> (56 - 8 * i));
+    }
+    padded.addBytes(padding, 1 + zeros + 8);
+
+    char digits[65];
+    for (int i = 0; i < 8; i++)
+    {
+        snprintf(digits + 8 * i, 9, "%08x", padded.state[i]);
+    }
+    return string(digits, 64);
+}
+
+CompileCache::CompileCache(const string &directory, uint64_t maxBytes)
+    : directory(directory), maxBytes(maxBytes), open(makeDirectories(directory))
+{
+}
+
+string CompileCache::entryPath(const string &key, const string &kind) const
+{
+    return directory + "/" + key + "." + kind;
+}
+
+bool CompileCache::lookup(const string &key, const string &kind, cacheArtifacts &artifacts)
+{
+    artifacts.clear();
+    if (!open)
+    {
+        return false;
+    }
+
+    string path = entryPath(key, kind);
+    ifstream file(path, ios::binary);
+    bool hit = false;
+    if (file)
+    {
+        ostringstream contents;
+        contents << file.rdbuf();
+        string entry = contents.str();
+
+        // Split the entry into its artifacts
+        size_t position = strlen(ENTRY_HEADER);
+        hit = entry.compare(0, position, ENTRY_HEADER) == 0;
+        while (hit && position < entry.size())
+        {
+            size_t space = entry.find(' ', position);
+            size_t newline = entry.find('\n', position);
+            if (space == string::npos || newline == string::npos || space > newline)
+            {
+                hit = false;
+                break;
+            }
+            uint64_t size = strtoull(entry.c_str() + space + 1, NULL, 10);
+            if (size > entry.size() - newline - 1)
+            {
+                hit = false;
+                break;
+            }
+            artifacts[entry.substr(position, space - position)] = entry.substr(newline + 1, size);
+            position = newline + 1 + size;
+        }
+
+        if (hit)
+        {
+            // Mark the entry as the most recently used one
+            utimensat(AT_FDCWD, path.c_str(), NULL, 0);
+        }
+        else
+        {
+            // A damaged entry is no use to anyone
+            unlink(path.c_str());
+            artifacts.clear();
+        }
+    }
+
+    count({{kind + (hit ? "_hits" : "_misses"), 1}});
+    return hit;
+}
+
+bool CompileCache::store(const string &key, const string &kind, const cacheArtifacts &artifacts)
+{
+    if (!open)
+    {
+        return false;
+    }
+
+    string entry = ENTRY_HEADER;
+    for (auto &artifact : artifacts)
+    {
+        entry += artifact.first + " " + to_string(artifact.second.size()) + "\n" + artifact.second;
+    }
+
+    // Write the entry next to its final name and rename it into place, so readers see all of it or none of it
+    string path = entryPath(key, kind);
+    string temporary = path + ".tmp" + to_string(getpid());
+    bool written;
+    {
+        ofstream file(temporary, ios::binary);
+        written = file && file.write(entry.data(), entry.size()) && file.flush();
+    }
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    // A size that this entry alone accounts for may be new to the stats file, so the directory is listed to set it
+    cacheStatistics counters = count({{"size", entry.size()}});
+    if (counters.empty() || counters["size"] > maxBytes || counters["size"] == entry.size())
+    {
+        evict();
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the `<counter> <value>` lines of a stats file.
+ *
+ * @param fd The open stats file.
+ * @param statistics The counters read.
+ */
+static void readCounters(int fd, cacheStatistics &statistics)
+{
+    string contents;
+    char buffer[1024];
+    ssize_t count;
+    off_t offset = 0;
+    while ((count = pread(fd, buffer, sizeof(buffer), offset)) > 0)
+    {
+        contents.append(buffer, count);
+        offset += count;
+    }
+
+    istringstream lines(contents);
+    string name;
+    uint64_t value;
+    while (lines >> name >> value)
+    {
+        statistics[name] = value;
+    }
+}
+
+/**
+ * @brief Adds `increments` to the counters of the stats file and sets the counters of `values`.
+ *
+ * @return The counters after the update, or none if the stats file cannot be updated.
+ */
+cacheStatistics CompileCache::count(const cacheStatistics &increments, const cacheStatistics &values) const
+{
+    cacheStatistics counters;
+    int fd = ::open((directory + "/stats").c_str(), O_RDWR | O_CREAT, 0666);
+    if (fd < 0)
+    {
+        return counters;
+    }
+
+    // Other processes sharing the cache update the same file
+    if (flock(fd, LOCK_EX) == 0)
+    {
+        readCounters(fd, counters);
+        for (auto &increment : increments)
+        {
+            counters[increment.first] += increment.second;
+        }
+        for (auto &value : values)
+        {
+            counters[value.first] = value.second;
+        }
+
+        string contents;
+        for (auto &counter : counters)
+        {
+            contents += counter.first + " " + to_string(counter.second) + "\n";
+        }
+        if (ftruncate(fd, 0) == 0 && pwrite(fd, contents.data(), contents.size(), 0) != (ssize_t)contents.size())
+        {
+            ftruncate(fd, 0);
+        }
+        flock(fd, LOCK_UN);
+    }
+    close(fd);
+    return counters;
+}
+
+/**
+ * @brief An entry file found in the cache directory.
+ */
+typedef struct
+{
+    string path;
+    uint64_t size;
+    struct timespec used; // modification time, refreshed by every hit
+} cacheEntryFile;
+
+/**
+ * @brief Lists the entry files of a cache directory (every regular file except the stats file).
+ *
+ * @param directory The cache directory.
+ * @param entries The entry files found.
+ */
+static void listEntries(const string &directory, vector<cacheEntryFile> &entries)
+{
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+    {
+        return;
+    }
+
+    while (struct dirent *file = readdir(dir))
+    {
+        string path = directory + "/" + file->d_name;
+        struct stat info;
+        if (strcmp(file->d_name, "stats") != 0 && stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+        {
+            entries.push_back({path, (uint64_t)info.st_size, info.st_mtim});
+        }
+    }
+    closedir(dir);
+}
+
+void CompileCache::evict() const
+{
+    vector<cacheEntryFile> entries;
+    listEntries(directory, entries);
+
+    uint64_t total = 0;
+    for (auto &entry : entries)
+    {
+        total += entry.size;
+    }
+    if (total <= maxBytes)
+    {
+        count({}, {{"size", total}});
+        return;
+    }
+
+    // Remove the least recently used entries first
+    sort(entries.begin(), entries.end(), [](const cacheEntryFile &a, const cacheEntryFile &b) {
+        return a.used.tv_sec != b.used.tv_sec ? a.used.tv_sec < b.used.tv_sec : a.used.tv_nsec < b.used.tv_nsec;
+    });
+    uint64_t evicted = 0;
+    for (auto &entry : entries)
+    {
+        if (total <= maxBytes)
+        {
+            break;
+        }
+        if (unlink(entry.path.c_str()) == 0)
+        {
+            evicted++;
+        }
+        total -= entry.size;
+    }
+
+    // The stores of other processes since the directory was listed are forgotten until the next listing
+    count({{"evictions", evicted}}, {{"size", total}});
+}
+
+void CompileCache::statistics(cacheStatistics &statistics) const
+{
+    statistics.clear();
+    int fd = ::open((directory + "/stats").c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        if (flock(fd, LOCK_SH) == 0)
+        {
+            readCounters(fd, statistics);
+            flock(fd, LOCK_UN);
+        }
+        close(fd);
+    }
+
+    vector<cacheEntryFile> entries;
+    listEntries(directory, entries);
+    statistics["entries"] = entries.size();
+    statistics["bytes"] = 0;
+    for (auto &entry : entries)
+    {
+        statistics["bytes"] += entry.size;
+    }
+}
@@ -0,0 +1,136 @@
+/**
+ * @file compile_cache.h
+ *
+ * @brief A content-addressed cache of compilation artifacts on disk.
+ *
+ * Every entry is one file in the cache directory, named after the SHA-256 hash of everything its artifacts depend on (built
+ * with compileCacheKey), and holds any number of named artifacts such as the text of a `.ll` or `.s` file. Entries are written
+ * to a temporary file and renamed into place, so processes sharing a cache directory never see half an entry.
+ *
+ * The cache is bounded in size: once a store takes the entries over the limit, the least recently used entries are removed
+ * until they fit in it again. Use is tracked by modification time, which every lookup that hits refreshes. Counters of hits and
+ * misses (per kind of entry, as `<kind>_hits` and `<kind>_misses`) and of evictions are kept in a `stats` file in the
+ * directory, updated under a file lock, along with the running size of the entries (`size`), so that stores do not have to
+ * list the directory to find out whether it is over the limit.
+ *
+ * Usage:
+ *     CompileCache cache("/tmp/minicc-cache", 64 << 20);
+ *     compileCacheKey key;
+ *     key.add(version);
+ *     key.add(source);
+ *     cacheArtifacts artifacts;
+ *     if (!cache.lookup(key.value(), "out", artifacts)) { ...; cache.store(key.value(), "out", artifacts); }
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <string_view>
+using namespace std;
+
+// Names and contents of the artifacts of one entry
+typedef map<string, string> cacheArtifacts;
+
+// Counters kept in the cache's stats file, by name
+typedef map<string, uint64_t> cacheStatistics;
+
+/**
+ * @brief Hashes the inputs of a compilation into a cache key (SHA-256).
+ *
+ * Each part is hashed together with its length, so that moving bytes from one part to the next changes the key. A key can be
+ * copied to extend it with more parts.
+ */
+class compileCacheKey
+{
+public:
+    compileCacheKey();
+
+    void add(string_view part)
+    {
+        uint64_t length = part.size();
+        addBytes(&length, sizeof(length));
+        addBytes(part.data(), part.size());
+    }
+
+    /**
+     * @return The hash of the parts added so far, as 64 hexadecimal digits.
+     */
+    string value() const;
+
+private:
+    void addBytes(const void *data, size_t size);
+    void compress();
+
+    uint32_t state[8];
+    unsigned char block[64]; // the bytes of the block being filled
+    uint64_t hashedBytes;
+};
+
+/**
+ * @brief A cache directory of compilation artifacts, bounded in size.
+ */
+class CompileCache
+{
+public:
+    /**
+     * @brief Opens the cache in `directory`, which is created if it does not exist.
+     *
+     * @param directory The cache directory.
+     * @param maxBytes The most bytes the entries may take up together.
+     */
+    CompileCache(const string &directory, uint64_t maxBytes);
+
+    /**
+     * @return false if the cache directory cannot be created; lookups then always miss and stores do nothing.
+     */
+    bool isOpen() const { return open; }
+
+    /**
+     * @brief Reads the entry for `key` and counts a hit or a miss.
+     *
+     * @param key The key of the entry.
+     * @param kind The kind of entry, used as the extension of the entry's file and in the names of its counters.
+     * @param artifacts The artifacts of the entry, on a hit.
+     * @return true on a hit. An entry that cannot be read is removed and counts as a miss.
+     */
+    bool lookup(const string &key, const string &kind, cacheArtifacts &artifacts);
+
+    /**
+     * @brief Writes the entry for `key`, then evicts the least recently used entries if the cache is over its size limit. Only
+     * then is the directory listed, to find the entries and their real size.
+     *
+     * @param key The key of the entry.
+     * @param kind The kind of entry.
+     * @param artifacts The artifacts of the entry.
+     * @return true if the entry was written.
+     */
+    bool store(const string &key, const string &kind, const cacheArtifacts &artifacts);
+
+    /**
+     * @brief Reads the counters of the stats file, and adds the current number of entries ("entries") and their size
+     * ("bytes").
+     *
+     * @param statistics The counters.
+     */
+    void statistics(cacheStatistics &statistics) const;
+
+    const string &getDirectory() const { return directory; }
+    uint64_t getMaxBytes() const { return maxBytes; }
+
+private:
+    string entryPath(const string &key, const string &kind) const;
+    cacheStatistics count(const cacheStatistics &increments, const cacheStatistics &values = cacheStatistics()) const;
+    void evict() const;
+
+    string directory;
+    uint64_t maxBytes;
+    bool open;
+};
+
+#endif // COMPILE_CACHE_H
@@ -0,0 +1,233 @@
+/**
+ * @file dataflow.h
+ *
+ * @brief A generic worklist solver for dataflow analyses over the basic blocks of an LLVM function.
+ *
+ * ControlFlowGraph numbers the basic blocks of a function in layout order and caches their predecessor and successor lists and
+ * a reverse postorder, so that the graph is built once and shared by every analysis of the function (as long as no pass
+ * changes its blocks or branches). solveDataflow runs an analysis to its fixed point with a worklist ordered by reverse
+ * postorder (by postorder for backward analyses), so that a block is usually visited after the blocks its facts come from, and
+ * only the blocks whose inputs changed are visited again.
+ *
+ * An analysis is a class that defines:
+ *     typedef ... Value;                                          the lattice, e.g. a BitVector
+ *     static const DataflowDirection direction;                   FORWARD_DATAFLOW or BACKWARD_DATAFLOW
+ *     Value boundary() const;                                     the facts at the entry (forward) or the exits (backward)
+ *     Value initial() const;                                      the starting value of every other block (the meet's identity)
+ *     void meet(Value &into, const Value &other) const;           merges the facts of another path into `into`
+ *     void transfer(unsigned block, const Value &in, Value &out) const;  the facts after the block, from those before it
+ * "Before" and "after" follow the direction of the analysis: for a backward analysis, `in` holds the facts at the end of the
+ * block and `out` those at its start. Value must support assignment and `!=`.
+ *
+ * Usage:
+ *     ControlFlowGraph cfg(function);
+ *     ReachingStores analysis(...);
+ *     DataflowResult<BitVector> result;
+ *     solveDataflow(cfg, analysis, result);
+ *     use(result.entry[cfg.index(basicBlock)]);
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include <llvm-c/Core.h>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// The direction in which facts flow through the control-flow graph
+enum DataflowDirection
+{
+    FORWARD_DATAFLOW,
+    BACKWARD_DATAFLOW
+};
+
+class ControlFlowGraph
+{
+public:
+    /**
+     * @brief Numbers the basic blocks of `function` and records its edges and its reverse postorder.
+     */
+    explicit ControlFlowGraph(LLVMValueRef function)
+    {
+        for (auto basicBlock = LLVMGetFirstBasicBlock(function); basicBlock; basicBlock = LLVMGetNextBasicBlock(basicBlock))
+        {
+            indices[basicBlock] = blocks.size();
+            blocks.push_back(basicBlock);
+        }
+        predecessorLists.resize(blocks.size());
+        successorLists.resize(blocks.size());
+
+        for (unsigned i = 0; i < blocks.size(); i++)
+        {
+            LLVMValueRef terminator = LLVMGetBasicBlockTerminator(blocks[i]);
+            unsigned numSuccessors = terminator ? LLVMGetNumSuccessors(terminator) : 0;
+            for (unsigned s = 0; s < numSuccessors; s++)
+            {
+                unsigned successor = indices[LLVMGetSuccessor(terminator, s)];
+                successorLists[i].push_back(successor);
+                predecessorLists[successor].push_back(i);
+            }
+        }
+
+        computeReversePostorder();
+    }
+
+    unsigned size() const { return blocks.size(); }
+    LLVMBasicBlockRef block(unsigned i) const { return blocks[i]; }
+    unsigned index(LLVMBasicBlockRef basicBlock) const { return indices.at(basicBlock); }
+    const std::vector<unsigned> &predecessors(unsigned i) const { return predecessorLists[i]; }
+    const std::vector<unsigned> &successors(unsigned i) const { return successorLists[i]; }
+
+    /**
+     * @return The blocks in reverse postorder from the entry block, followed by the unreachable blocks in layout order.
+     */
+    const std::vector<unsigned> &reversePostorder() const { return rpo; }
+
+    /**
+     * @return The number of blocks reachable from the entry block, which come first in the reverse postorder.
+     */
+    unsigned numReachable() const { return reachableCount; }
+
+private:
+    void computeReversePostorder()
+    {
+        std::vector<bool> visited(blocks.size(), false);
+        std::vector<unsigned> postorder;
+
+        // Depth-first search with an explicit stack of (block, next successor to visit), as CFGs can be deep
+        std::vector<std::pair<unsigned, unsigned>> stack;
+        if (!blocks.empty())
+        {
+            stack.push_back({0, 0});
+            visited[0] = true;
+        }
+        while (!stack.empty())
+        {
+            auto &top = stack.back();
+            if (top.second < successorLists[top.first].size())
+            {
+                unsigned successor = successorLists[top.first][top.second++];
+                if (!visited[successor])
+                {
+                    visited[successor] = true;
+                    stack.push_back({successor, 0});
+                }
+                continue;
+            }
+            postorder.push_back(top.first);
+            stack.pop_back();
+        }
+
+        rpo.assign(postorder.rbegin(), postorder.rend());
+        reachableCount = rpo.size();
+        for (unsigned i = 0; i < blocks.size(); i++)
+        {
+            if (!visited[i])
+            {
+                rpo.push_back(i);
+            }
+        }
+    }
+
+    std::vector<LLVMBasicBlockRef> blocks;
+    std::unordered_map<LLVMBasicBlockRef, unsigned> indices;
+    std::vector<std::vector<unsigned>> predecessorLists;
+    std::vector<std::vector<unsigned>> successorLists;
+    std::vector<unsigned> rpo;
+    unsigned reachableCount = 0;
+};
+
+/**
+ * @brief The facts at the start and at the end of every basic block, indexed like the blocks of the ControlFlowGraph.
+ */
+template <typename Value>
+struct DataflowResult
+{
+    std::vector<Value> entry;
+    std::vector<Value> exit;
+    size_t visits = 0; // transfer functions applied until the fixed point
+};
+
+/**
+ * @brief Runs `analysis` over `cfg` until no block's facts change.
+ *
+ * @param cfg The control-flow graph of the function.
+ * @param analysis The analysis to run.
+ * @param result Receives the facts at the start and at the end of every block.
+ */
+template <typename Analysis>
+void solveDataflow(const ControlFlowGraph &cfg, const Analysis &analysis, DataflowResult<typename Analysis::Value> &result)
+{
+    typedef typename Analysis::Value Value;
+    const bool forward = Analysis::direction == FORWARD_DATAFLOW;
+    const unsigned numBlocks = cfg.size();
+
+    // For each block, its facts before (`in`) and after (`out`) the transfer function, in the direction of the analysis
+    std::vector<Value> &in = forward ? result.entry : result.exit;
+    std::vector<Value> &out = forward ? result.exit : result.entry;
+    in.assign(numBlocks, analysis.initial());
+    out.assign(numBlocks, analysis.initial());
+    result.visits = 0;
+
+    // Visit blocks in reverse postorder for forward analyses and in postorder for backward ones
+    const std::vector<unsigned> &rpo = cfg.reversePostorder();
+    std::vector<unsigned> blockAt(numBlocks), order(numBlocks);
+    for (unsigned position = 0; position < numBlocks; position++)
+    {
+        blockAt[position] = forward ? rpo[position] : rpo[numBlocks - 1 - position];
+        order[blockAt[position]] = position;
+    }
+
+    // The worklist holds the positions of the blocks in that order, smallest first
+    std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>> worklist;
+    std::vector<bool> queued(numBlocks, true);
+    for (unsigned position = 0; position < numBlocks; position++)
+    {
+        worklist.push(position);
+    }
+
+    Value newOut = analysis.initial();
+    while (!worklist.empty())
+    {
+        unsigned block = blockAt[worklist.top()];
+        worklist.pop();
+        queued[block] = false;
+
+        // Meet the facts of the blocks that flow into this one; the boundary blocks start from the boundary facts
+        const std::vector<unsigned> &sources = forward ? cfg.predecessors(block) : cfg.successors(block);
+        bool boundary = forward ? block == 0 : sources.empty();
+        in[block] = boundary ? analysis.boundary() : analysis.initial();
+        for (unsigned source : sources)
+        {
+            analysis.meet(in[block], out[source]);
+        }
+
+        analysis.transfer(block, in[block], newOut);
+        result.visits++;
+
+        // Every block starts on the worklist, so a block whose facts did not change has nothing to pass on
+        if (!(newOut != out[block]))
+        {
+            continue;
+        }
+        out[block] = newOut;
+
+        // The blocks this one flows into have to be visited again
+        const std::vector<unsigned> &targets = forward ? cfg.successors(block) : cfg.predecessors(block);
+        for (unsigned target : targets)
+        {
+            if (!queued[target])
+            {
+                queued[target] = true;
+                worklist.push(order[target]);
+            }
+        }
+    }
+}
+
+#endif // DATAFLOW_H
@@ -0,0 +1,197 @@
+/**
+ * @file dominator_tree.h
+ *
+ * @brief The dominator tree of a control-flow graph.
+ *
+ * A block A dominates a block B if every path from the entry block to B goes through A. The immediate dominator of B is the
+ * closest of its strict dominators, and the immediate dominators form a tree rooted at the entry block. The tree is computed
+ * with the iterative algorithm of Cooper, Harvey and Kennedy ("A Simple, Fast Dominance Algorithm"), which intersects the
+ * dominators of the predecessors of each block in reverse postorder until nothing changes; on the reducible control flow of
+ * MiniC it converges in two passes. Blocks that cannot be reached from the entry block are not in the tree.
+ *
+ * Usage:
+ *     ControlFlowGraph cfg(function);
+ *     DominatorTree dominators(cfg);
+ *     if (dominators.dominates(cfg.index(header), cfg.index(body))) ...
+ *     for (unsigned child : dominators.children(block)) ...
+ *     std::vector<std::vector<unsigned>> frontiers = dominators.dominanceFrontiers(cfg);
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef DOMINATOR_TREE_H
+#define DOMINATOR_TREE_H
+
+#include <vector>
+#include "dataflow.h"
+
+class DominatorTree
+{
+public:
+    // The immediate dominator of the entry block and of the unreachable blocks
+    enum : unsigned
+    {
+        NO_BLOCK = ~0u
+    };
+
+    explicit DominatorTree(const ControlFlowGraph &cfg)
+        : immediateDominators(cfg.size(), NO_BLOCK), childLists(cfg.size()), preorder(cfg.size(), 0), postorder(cfg.size(), 0)
+    {
+        const std::vector<unsigned> &rpo = cfg.reversePostorder();
+        const unsigned numReachable = cfg.numReachable();
+        if (numReachable == 0)
+        {
+            return;
+        }
+
+        // The position of every reachable block in reverse postorder
+        std::vector<unsigned> order(cfg.size(), NO_BLOCK);
+        for (unsigned position = 0; position < numReachable; position++)
+        {
+            order[rpo[position]] = position;
+        }
+
+        // The entry block is its own immediate dominator while the tree is computed
+        immediateDominators[rpo[0]] = rpo[0];
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (unsigned position = 1; position < numReachable; position++)
+            {
+                unsigned block = rpo[position];
+                unsigned newDominator = NO_BLOCK;
+                for (unsigned predecessor : cfg.predecessors(block))
+                {
+                    // Skip the predecessors that have not been processed yet, and the unreachable ones
+                    if (immediateDominators[predecessor] == NO_BLOCK)
+                    {
+                        continue;
+                    }
+                    newDominator = newDominator == NO_BLOCK ? predecessor
+                                                            : intersect(predecessor, newDominator, order);
+                }
+                if (immediateDominators[block] != newDominator)
+                {
+                    immediateDominators[block] = newDominator;
+                    changed = true;
+                }
+            }
+        }
+        immediateDominators[rpo[0]] = NO_BLOCK;
+
+        for (unsigned position = 1; position < numReachable; position++)
+        {
+            unsigned block = rpo[position];
+            childLists[immediateDominators[block]].push_back(block);
+        }
+        numberTree(rpo[0]);
+    }
+
+    /**
+     * @return The immediate dominator of `block`, or NO_BLOCK for the entry block and the unreachable blocks.
+     */
+    unsigned immediateDominator(unsigned block) const { return immediateDominators[block]; }
+
+    /**
+     * @return The blocks whose immediate dominator is `block`, in reverse postorder.
+     */
+    const std::vector<unsigned> &children(unsigned block) const { return childLists[block]; }
+
+    /**
+     * @return true if `a` dominates `b`. Every block dominates itself; an unreachable block dominates and is dominated by none.
+     */
+    bool dominates(unsigned a, unsigned b) const
+    {
+        return preorder[a] && preorder[b] && preorder[a] <= preorder[b] && postorder[b] <= postorder[a];
+    }
+
+    /**
+     * @brief Computes the dominance frontier of every block: the blocks where its dominance ends, which have a predecessor that
+     * the block dominates but are not strictly dominated by it. As in Cooper, Harvey and Kennedy, it walks up the tree from the
+     * predecessors of every join block until the immediate dominator of the join block.
+     *
+     * @param cfg The control-flow graph the tree was built from.
+     * @return The frontier of every block, in no particular order; empty for the unreachable blocks.
+     */
+    std::vector<std::vector<unsigned>> dominanceFrontiers(const ControlFlowGraph &cfg) const
+    {
+        std::vector<std::vector<unsigned>> frontiers(cfg.size());
+        for (unsigned block = 0; block < cfg.size(); block++)
+        {
+            const std::vector<unsigned> &predecessors = cfg.predecessors(block);
+            if (!preorder[block] || predecessors.size() < 2)
+            {
+                continue;
+            }
+            for (unsigned predecessor : predecessors)
+            {
+                // A block reaches the join block through several of its predecessors, but is added to its frontier once
+                for (unsigned runner = predecessor;
+                     runner != NO_BLOCK && preorder[runner] && runner != immediateDominators[block];
+                     runner = immediateDominators[runner])
+                {
+                    if (!frontiers[runner].empty() && frontiers[runner].back() == block)
+                    {
+                        break;
+                    }
+                    frontiers[runner].push_back(block);
+                }
+            }
+        }
+        return frontiers;
+    }
+
+private:
+    /**
+     * @brief Walks up the tree from `a` and `b` to their closest common dominator.
+     */
+    unsigned intersect(unsigned a, unsigned b, const std::vector<unsigned> &order) const
+    {
+        while (a != b)
+        {
+            while (order[a] > order[b])
+            {
+                a = immediateDominators[a];
+            }
+            while (order[b] > order[a])
+            {
+                b = immediateDominators[b];
+            }
+        }
+        return a;
+    }
+
+    /**
+     * @brief Numbers the blocks of the tree in preorder and postorder (from 1, so that 0 marks the unreachable blocks), which
+     * makes dominates() two comparisons.
+     */
+    void numberTree(unsigned root)
+    {
+        unsigned nextPreorder = 1, nextPostorder = 1;
+        std::vector<std::pair<unsigned, unsigned>> stack; // (block, next child to visit)
+        stack.push_back({root, 0});
+        preorder[root] = nextPreorder++;
+        while (!stack.empty())
+        {
+            auto &top = stack.back();
+            if (top.second < childLists[top.first].size())
+            {
+                unsigned child = childLists[top.first][top.second++];
+                preorder[child] = nextPreorder++;
+                stack.push_back({child, 0});
+                continue;
+            }
+            postorder[top.first] = nextPostorder++;
+            stack.pop_back();
+        }
+    }
+
+    std::vector<unsigned> immediateDominators;
+    std::vector<std::vector<unsigned>> childLists;
+    std::vector<unsigned> preorder;
+    std::vector<unsigned> postorder;
+};
+
+#endif // DOMINATOR_TREE_H
@@ -2,9 +2,12 @@
  * @file file_utils.cpp
  *
  * @brief This file contains the definitions for utility functions used across the compiler.
- * These include creating an LLVM model from a given filename and changing the file extension of a given filename.
+ * These include creating an LLVM model from a given filename, saving one, and changing the file extension of a given filename.
  * These utilities are used in multiple stages of the compiler process.
  *
+ * The C API has no call to materialize a single function of a lazily loaded module, so materializeFunction and
+ * saveLLVMModel reach through to the C++ API for that one step.
+ *
  * The functions are defined in a separate compilation unit and can be linked into other components as a library.
  *
  * @author Aimen Abdulaziz
@@ -12,14 +15,50 @@
  */
 
 #include "file_utils.h"
+#include "time_report.h"
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+
+/**
+ * Check whether the given filename names an LLVM bitcode file (`.bc` extension)
+ * @param filename Path of the LLVM IR or bitcode file
+ * @return true for bitcode, false for textual LLVM IR
+ */
+bool isBitcodeFile(const char *filename)
+{
+    size_t length = strlen(filename);
+    return length >= 3 && strcmp(filename + length - 3, ".bc") == 0;
+}
+
+/**
+ * Diagnostic handler used while reading bitcode: prints the error instead of letting LLVM exit the process
+ * @param info The diagnostic reported by the bitcode reader
+ * @param failed Points to a flag that is set when the diagnostic is an error
+ */
+static void bitcodeDiagnosticHandler(LLVMDiagnosticInfoRef info, void *failed)
+{
+    if (LLVMGetDiagInfoSeverity(info) == LLVMDSError)
+    {
+        char *description = LLVMGetDiagInfoDescription(info);
+        printf("Error reading LLVM bitcode: %s\n", description);
+        LLVMDisposeMessage(description);
+        *(bool *)failed = true;
+    }
+}
 
 /**
  * Create LLVM module from the given filename
- * @param filename Path to the LLVM IR file
- * @return LLVMModuleRef representing the module created from the given file, or NULL if error occurs
+ * @param filename Path to the LLVM IR file, or to an LLVM bitcode file if it ends in `.bc`
+ * @param context The LLVM context that will own the module (one per compilation)
+ * @return LLVMModuleRef representing the module created from the given file, or NULL if error occurs.
+ *         The function bodies of a bitcode module are not read yet; see materializeFunction.
  */
-LLVMModuleRef createLLVMModel(char *filename)
+LLVMModuleRef createLLVMModel(char *filename, LLVMContextRef context)
 {
+    phaseTimer timer("IR reading");
     char *err = 0;
 
     LLVMMemoryBufferRef ll_f = 0;
@@ -36,8 +75,24 @@ LLVMModuleRef createLLVMModel(char *filename)
         return NULL;
     }
 
+    // Bitcode: read the module lazily. The module keeps the buffer and reads each function body
+    // from it when the function is materialized
+    if (isBitcodeFile(filename))
+    {
+        LLVMDiagnosticHandler previousHandler = LLVMContextGetDiagnosticHandler(context);
+        void *previousContext = LLVMContextGetDiagnosticContext(context);
+        bool failed = false;
+        LLVMContextSetDiagnosticHandler(context, bitcodeDiagnosticHandler, &failed);
+        if (LLVMGetBitcodeModuleInContext2(context, ll_f, &m) || failed)
+        {
+            m = NULL;
+        }
+        LLVMContextSetDiagnosticHandler(context, previousHandler, previousContext);
+        return m;
+    }
+
     // Parse the LLVM IR in the memory buffer and create a new module
-    LLVMParseIRInContext(LLVMGetGlobalContext(), ll_f, &m, &err);
+    LLVMParseIRInContext(context, ll_f, &m, &err);
     if (err != NULL)
     {
         printf("Error parsing LLVM IR: %s\n", err);
@@ -49,6 +104,92 @@ LLVMModuleRef createLLVMModel(char *filename)
     return m;
 }
 
+/**
+ * Create LLVM module from textual LLVM IR that is already in memory
+ * @param ir The textual LLVM IR
+ * @param name The identifier of the module (the name of the file the IR came from)
+ * @param context The LLVM context that will own the module
+ * @return LLVMModuleRef representing the parsed module, or NULL (after printing the error) if the IR cannot be parsed
+ */
+LLVMModuleRef parseLLVMModel(const string &ir, const char *name, LLVMContextRef context)
+{
+    phaseTimer timer("IR reading");
+    char *err = 0;
+    LLVMModuleRef m = 0;
+
+    // The parser takes ownership of the buffer, and names the module after it
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(ir.data(), ir.size(), name);
+    LLVMParseIRInContext(context, buffer, &m, &err);
+    if (err != NULL)
+    {
+        printf("Error parsing LLVM IR: %s\n", err);
+        LLVMDisposeMessage(err);
+        return NULL;
+    }
+    return m;
+}
+
+/**
+ * Read the body of a function of a lazily loaded bitcode module, if it has not been read yet
+ * @param function The function to materialize; declarations and functions that are already complete are left alone
+ * @return true if the body is available, false (after printing the error) otherwise
+ */
+bool materializeFunction(LLVMValueRef function)
+{
+    llvm::Function *f = llvm::unwrap<llvm::Function>(function);
+    if (!f->isMaterializable())
+    {
+        return true;
+    }
+
+    phaseTimer timer("IR reading");
+    if (llvm::Error error = f->materialize())
+    {
+        printf("Error reading function %s: %s\n", f->getName().str().c_str(), llvm::toString(std::move(error)).c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Save an LLVM module to the given filename as textual LLVM IR, or as LLVM bitcode if it ends in `.bc`
+ * @param module The LLVM module to save; any function bodies that were not materialized yet are read first
+ * @param filename Path of the file to write
+ * @return true if the file was written, false (after printing the error) otherwise
+ */
+bool saveLLVMModel(LLVMModuleRef module, const char *filename)
+{
+    phaseTimer timer("IR writing");
+    char *err = 0;
+
+    // Both writers need every function body
+    if (llvm::Error error = llvm::unwrap(module)->materializeAll())
+    {
+        printf("Error reading LLVM bitcode: %s\n", llvm::toString(std::move(error)).c_str());
+        return false;
+    }
+
+    // Write the module as bitcode
+    if (isBitcodeFile(filename))
+    {
+        if (LLVMWriteBitcodeToFile(module, filename))
+        {
+            printf("Error writing LLVM bitcode: %s\n", filename);
+            return false;
+        }
+        return true;
+    }
+
+    // Print the module as text into the file
+    if (LLVMPrintModuleToFile(module, filename, &err))
+    {
+        printf("Error writing LLVM IR: %s\n", err);
+        LLVMDisposeMessage(err);
+        return false;
+    }
+    return true;
+}
+
 /**
  * @brief Changes the file extension of the given filename.
  *
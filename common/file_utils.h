@@ -2,8 +2,12 @@
  * @file file_utils.h
  * 
  * @brief This header file contains the declarations for utility functions used across the compiler. 
- * These include creating an LLVM model from a given filename and changing the file extension of a given filename.
+ * These include creating an LLVM model from a given filename, saving one, and changing the file extension of a given filename.
  * These utilities are used in multiple stages of the compiler process.
+ *
+ * Modules are read and written as textual LLVM IR, or as LLVM bitcode when the filename ends in `.bc`. Bitcode is loaded
+ * lazily: only the module's globals and function declarations are read up front, and each function body is read from the
+ * file the first time `materializeFunction` is called on it.
  * 
  * The functions are declared in this header and their definitions can be found in file_utils.cpp.
  * Include this header in any file where these utility functions are required.
@@ -12,6 +16,9 @@
  * @date Spring 2023
  */
 
+#ifndef FILE_UTILS_H
+#define FILE_UTILS_H
+
 #include <llvm-c/Core.h>
 #include <llvm-c/IRReader.h>
 #include <string>
@@ -19,12 +26,46 @@
 using namespace std;
 
 
+/**
+ * Check whether the given filename names an LLVM bitcode file (`.bc` extension)
+ * @param filename Path of the LLVM IR or bitcode file
+ * @return true for bitcode, false for textual LLVM IR
+ */
+bool isBitcodeFile(const char *filename);
+
 /**
  * Create LLVM module from the given filename
- * @param filename Path to the LLVM IR file
- * @return LLVMModuleRef representing the module created from the given file, or NULL if error occurs
+ * @param filename Path to the LLVM IR file, or to an LLVM bitcode file if it ends in `.bc`
+ * @param context The LLVM context that will own the module (one per compilation)
+ * @return LLVMModuleRef representing the module created from the given file, or NULL if error occurs.
+ *         The function bodies of a bitcode module are not read yet; see materializeFunction.
+ */
+LLVMModuleRef createLLVMModel(char *filename, LLVMContextRef context);
+
+/**
+ * Create LLVM module from textual LLVM IR that is already in memory
+ * @param ir The textual LLVM IR
+ * @param name The identifier of the module (the name of the file the IR came from)
+ * @param context The LLVM context that will own the module
+ * @return LLVMModuleRef representing the parsed module, or NULL (after printing the error) if the IR cannot be parsed
  */
-LLVMModuleRef createLLVMModel(char *filename);
+LLVMModuleRef parseLLVMModel(const string &ir, const char *name, LLVMContextRef context);
+
+/**
+ * Read the body of a function of a lazily loaded bitcode module, if it has not been read yet
+ * @param function The function to materialize; declarations and functions that are already complete are left alone
+ * @return true if the body is available, false (after printing the error) otherwise
+ */
+bool materializeFunction(LLVMValueRef function);
+
+/**
+ * Save an LLVM module to the given filename as textual LLVM IR, or as LLVM bitcode if it ends in `.bc`
+ * @param module The LLVM module to save; any function bodies that were not materialized yet are read first
+ * @param filename Path of the file to write
+ * @return true if the file was written, false (after printing the error) otherwise
+ */
+bool saveLLVMModel(LLVMModuleRef module, const char *filename);
+
 /**
  * @brief Changes the file extension of the given filename.
  *
@@ -36,4 +77,6 @@ LLVMModuleRef createLLVMModel(char *filename);
  * @param[in] fileExtension The new file extension as a std::string.
  * @param[out] output The modified filename with the new extension as a reference to a std::string.
  */
-void changeFileExtension(const char *filename, string &output, string fileExtension);
\ No newline at end of file
+void changeFileExtension(const char *filename, string &output, string fileExtension);
+
+#endif // FILE_UTILS_H
@@ -0,0 +1,241 @@
+/**
+ * @file natural_loops.h
+ *
+ * @brief The natural loops of a control-flow graph.
+ *
+ * An edge from a block T to a block H is a back edge if H dominates T. The natural loop of the back edge is H (its header) and
+ * every block that can reach T without going through H; the loops of the back edges that share a header are merged into one. On
+ * the reducible control flow of MiniC, every `while` statement is one natural loop, and the loops of nested statements are
+ * nested. The preheader of a loop is the block outside of it that branches to its header and nowhere else, if it is the only
+ * way into the loop; the optimizer hoists loop-invariant code there.
+ *
+ * The loops form a tree. Each block is only listed by its innermost loop, and a loop contains a block if the innermost loop of
+ * the block is in its subtree, which the preorder numbers of the tree tell in constant time. Finding the loops takes about
+ * linear time and space, even for thousands of nested loops.
+ *
+ * Usage:
+ *     ControlFlowGraph cfg(function);
+ *     DominatorTree dominators(cfg);
+ *     NaturalLoops loops(cfg, dominators);
+ *     for (const NaturalLoop &loop : loops.loops()) ...   // innermost loops first
+ *     bool inLoop = loops.contains(loop, block);
+ *     unsigned depth = loops.depth(block);
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef NATURAL_LOOPS_H
+#define NATURAL_LOOPS_H
+
+#include <utility>
+#include <vector>
+#include "dataflow.h"
+#include "dominator_tree.h"
+
+typedef struct NaturalLoop
+{
+    unsigned header;
+    unsigned preheader;                 // DominatorTree::NO_BLOCK if the loop has none
+    unsigned parent;                    // the index of the loop it is nested in, or NaturalLoops::NO_LOOP
+    std::vector<unsigned> ownBlocks;    // the blocks of the loop that are in none of its inner loops, header included, in
+                                        // reverse postorder
+    std::vector<unsigned> latches;      // the blocks with a back edge to the header
+} NaturalLoop;
+
+class NaturalLoops
+{
+public:
+    // The innermost loop of a block in no loop, and the parent of a loop nested in no other
+    enum : unsigned
+    {
+        NO_LOOP = ~0u
+    };
+
+    NaturalLoops(const ControlFlowGraph &cfg, const DominatorTree &dominators) : innermostLoops(cfg.size(), NO_LOOP)
+    {
+        // The header of an inner loop comes after the header of the loops around it in reverse postorder, so walking the headers
+        // backwards finds every loop before the loops it is nested in. Walking back from the latches of a loop, a block that is
+        // already in a loop stands for the outermost loop found around it so far, which is walked past from its header: every
+        // block is walked once per loop it is the innermost in, and every loop header once more by its parent.
+        const std::vector<unsigned> &rpo = cfg.reversePostorder();
+        std::vector<unsigned> outermost; // <loop, the outermost loop found around it so far, or itself>
+        for (unsigned position = cfg.numReachable(); position-- > 0;)
+        {
+            unsigned header = rpo[position];
+            NaturalLoop loop;
+            loop.header = header;
+            loop.preheader = DominatorTree::NO_BLOCK;
+            loop.parent = NO_LOOP;
+            for (unsigned predecessor : cfg.predecessors(header))
+            {
+                if (dominators.dominates(header, predecessor))
+                {
+                    loop.latches.push_back(predecessor);
+                }
+            }
+            if (loop.latches.empty())
+            {
+                continue;
+            }
+
+            // Walk back from the latches to the header; the blocks that reach a latch without going through the header are the
+            // blocks the header dominates, unless they are unreachable
+            unsigned index = loopList.size();
+            outermost.push_back(index);
+            innermostLoops[header] = index;
+            std::vector<unsigned> worklist(loop.latches);
+            while (!worklist.empty())
+            {
+                unsigned block = worklist.back();
+                worklist.pop_back();
+                if (innermostLoops[block] == NO_LOOP)
+                {
+                    innermostLoops[block] = index;
+                }
+                else
+                {
+                    unsigned inner = findOutermost(outermost, innermostLoops[block]);
+                    if (inner == index)
+                    {
+                        continue;
+                    }
+                    loopList[inner].parent = index;
+                    outermost[inner] = index;
+                    block = loopList[inner].header;
+                }
+                for (unsigned predecessor : cfg.predecessors(block))
+                {
+                    if (dominators.dominates(header, predecessor) && predecessor != header)
+                    {
+                        worklist.push_back(predecessor);
+                    }
+                }
+            }
+            loopList.push_back(loop);
+        }
+
+        for (unsigned position = 0; position < cfg.numReachable(); position++)
+        {
+            unsigned block = rpo[position];
+            if (innermostLoops[block] != NO_LOOP)
+            {
+                loopList[innermostLoops[block]].ownBlocks.push_back(block);
+            }
+        }
+        numberLoops();
+
+        // The preheader is the only way into the loop, and only leads to it
+        for (unsigned index = 0; index < loopList.size(); index++)
+        {
+            NaturalLoop &loop = loopList[index];
+            std::vector<unsigned> entries;
+            for (unsigned predecessor : cfg.predecessors(loop.header))
+            {
+                if (!contains(index, predecessor))
+                {
+                    entries.push_back(predecessor);
+                }
+            }
+            if (entries.size() == 1 && cfg.successors(entries[0]).size() == 1)
+            {
+                loop.preheader = entries[0];
+            }
+        }
+    }
+
+    /**
+     * @return The loops of the function, each inner loop before the loops it is nested in.
+     */
+    const std::vector<NaturalLoop> &loops() const { return loopList; }
+
+    /**
+     * @return The index of the innermost loop `block` is in, or NO_LOOP if it is in no loop.
+     */
+    unsigned innermostLoop(unsigned block) const { return innermostLoops[block]; }
+
+    /**
+     * @return true if `block` is in the loop of index `loop`, or in a loop nested in it.
+     */
+    bool contains(unsigned loop, unsigned block) const
+    {
+        unsigned innermost = innermostLoops[block];
+        return innermost != NO_LOOP && preorder[loop] <= preorder[innermost] && preorder[innermost] <= lastDescendants[loop];
+    }
+
+    /**
+     * @return The number of loops `block` is in: 0 outside of any loop, 1 in a loop that is not nested in another, and so on.
+     */
+    unsigned depth(unsigned block) const { return innermostLoops[block] == NO_LOOP ? 0 : loopDepths[innermostLoops[block]]; }
+
+private:
+    // Returns the outermost loop found so far around `loop`, shortening the paths to it for the next lookups
+    static unsigned findOutermost(std::vector<unsigned> &outermost, unsigned loop)
+    {
+        unsigned root = loop;
+        while (outermost[root] != root)
+        {
+            root = outermost[root];
+        }
+        while (outermost[loop] != root)
+        {
+            unsigned next = outermost[loop];
+            outermost[loop] = root;
+            loop = next;
+        }
+        return root;
+    }
+
+    // Numbers the loops in preorder of the loop nesting tree, so that the loops nested in a loop are numbered from its number to
+    // the number of its last descendant, and gives each loop its depth
+    void numberLoops()
+    {
+        std::vector<std::vector<unsigned>> children(loopList.size());
+        std::vector<unsigned> roots;
+        for (unsigned loop = 0; loop < loopList.size(); loop++)
+        {
+            if (loopList[loop].parent == NO_LOOP)
+            {
+                roots.push_back(loop);
+            }
+            else
+            {
+                children[loopList[loop].parent].push_back(loop);
+            }
+        }
+        preorder.assign(loopList.size(), 0);
+        lastDescendants.assign(loopList.size(), 0);
+        loopDepths.assign(loopList.size(), 0);
+
+        unsigned nextPreorder = 0;
+        std::vector<std::pair<unsigned, unsigned>> stack; // (loop, next child to visit)
+        for (unsigned root : roots)
+        {
+            preorder[root] = nextPreorder++;
+            loopDepths[root] = 1;
+            stack.push_back({root, 0});
+            while (!stack.empty())
+            {
+                auto &top = stack.back();
+                if (top.second < children[top.first].size())
+                {
+                    unsigned child = children[top.first][top.second++];
+                    preorder[child] = nextPreorder++;
+                    loopDepths[child] = loopDepths[top.first] + 1;
+                    stack.push_back({child, 0});
+                    continue;
+                }
+                lastDescendants[top.first] = nextPreorder - 1;
+                stack.pop_back();
+            }
+        }
+    }
+
+    std::vector<NaturalLoop> loopList;
+    std::vector<unsigned> innermostLoops; // <block, the index of the innermost loop it is in, or NO_LOOP>
+    std::vector<unsigned> preorder;       // <loop, its number in preorder of the loop nesting tree>
+    std::vector<unsigned> lastDescendants; // <loop, the preorder number of the last loop nested in it, or its own>
+    std::vector<unsigned> loopDepths;     // <loop, the number of loops it is in, itself included>
+};
+
+#endif // NATURAL_LOOPS_H
@@ -0,0 +1,275 @@
+/**
+ * @file opt_report.cpp
+ *
+ * @brief This file contains the definitions of the optimization report: the reports of the functions and the printing of
+ * their totals and remarks.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "opt_report.h"
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+
+static bool enabled = false;
+static mutex functionsMutex;
+static vector<FunctionReport> functions; // in the order they were submitted
+
+void enableOptReport()
+{
+    enabled = true;
+}
+
+bool optReportEnabled()
+{
+    return enabled;
+}
+
+bool parseOptReportOption(const char *option, bool &json)
+{
+    if (strcmp(option, "-fopt-report") && strcmp(option, "-fopt-report=json"))
+    {
+        return false;
+    }
+    json = option[strlen("-fopt-report")] == '=';
+    enableOptReport();
+    return true;
+}
+
+FunctionReport::passTotals &FunctionReport::totals(const char *pass)
+{
+    for (auto &totals : passList)
+    {
+        if (!strcmp(totals.name, pass))
+        {
+            return totals;
+        }
+    }
+    passList.push_back({pass, 0, 0, {}});
+    return passList.back();
+}
+
+void FunctionReport::remark(const char *pass, const char *change, const string &block, const string &message)
+{
+    passTotals &entry = totals(pass);
+    bool counted = false;
+    for (auto &changes : entry.changes)
+    {
+        if (!strcmp(changes.first, change))
+        {
+            changes.second++;
+            counted = true;
+            break;
+        }
+    }
+    if (!counted)
+    {
+        entry.changes.push_back({change, 1});
+    }
+    remarkList.push_back({pass, change, block, message});
+}
+
+void FunctionReport::addTime(const char *pass, double seconds)
+{
+    passTotals &entry = totals(pass);
+    entry.runs++;
+    entry.wallSeconds += seconds;
+}
+
+void FunctionReport::submit()
+{
+    lock_guard<mutex> lock(functionsMutex);
+    functions.push_back(*this);
+}
+
+/**
+ * @brief Adds the totals of the passes of a function to those of the program.
+ */
+static void addPassTotals(vector<FunctionReport::passTotals> &program, const vector<FunctionReport::passTotals> &function)
+{
+    for (auto &pass : function)
+    {
+        FunctionReport::passTotals *totals = NULL;
+        for (auto &programPass : program)
+        {
+            if (!strcmp(programPass.name, pass.name))
+            {
+                totals = &programPass;
+                break;
+            }
+        }
+        if (!totals)
+        {
+            program.push_back({pass.name, 0, 0, {}});
+            totals = &program.back();
+        }
+        totals->runs += pass.runs;
+        totals->wallSeconds += pass.wallSeconds;
+        for (auto &change : pass.changes)
+        {
+            bool counted = false;
+            for (auto &programChange : totals->changes)
+            {
+                if (!strcmp(programChange.first, change.first))
+                {
+                    programChange.second += change.second;
+                    counted = true;
+                    break;
+                }
+            }
+            if (!counted)
+            {
+                totals->changes.push_back(change);
+            }
+        }
+    }
+}
+
+/**
+ * @return The number of changes a pass made, of all kinds.
+ */
+static uint64_t countChanges(const FunctionReport::passTotals &pass)
+{
+    uint64_t changes = 0;
+    for (auto &change : pass.changes)
+    {
+        changes += change.second;
+    }
+    return changes;
+}
+
+/**
+ * @return A string as a JSON string literal. The names of LLVM values may hold quotes and backslashes.
+ */
+static string jsonString(const string &text)
+{
+    string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        }
+        else
+        {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+/**
+ * @brief Prints the totals of passes as a JSON array.
+ */
+static void printPassesJSON(ostream &out, const vector<FunctionReport::passTotals> &passes, const char *indent)
+{
+    char line[256];
+    out << "[";
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        // Pass and change names are plain literals, so they need no escaping
+        snprintf(line, sizeof(line), "%s\n%s  {\"name\": \"%s\", \"runs\": %llu, \"wall_seconds\": %.6f, \"changes\": {",
+                 i ? "," : "", indent, passes[i].name, (unsigned long long)passes[i].runs, passes[i].wallSeconds);
+        out << line;
+        for (size_t j = 0; j < passes[i].changes.size(); j++)
+        {
+            snprintf(line, sizeof(line), "%s\"%s\": %llu", j ? ", " : "", passes[i].changes[j].first,
+                     (unsigned long long)passes[i].changes[j].second);
+            out << line;
+        }
+        out << "}}";
+    }
+    out << "\n" << indent << "]";
+}
+
+void printOptReport(ostream &out, bool json)
+{
+    lock_guard<mutex> lock(functionsMutex);
+    vector<FunctionReport::passTotals> program;
+    uint64_t rounds = 0;
+    for (auto &function : functions)
+    {
+        addPassTotals(program, function.passes());
+        rounds += function.numRounds();
+    }
+
+    char line[256];
+    if (json)
+    {
+        snprintf(line, sizeof(line), "{\n  \"rounds\": %llu,\n  \"passes\": ", (unsigned long long)rounds);
+        out << line;
+        printPassesJSON(out, program, "  ");
+        out << ",\n  \"functions\": [";
+        for (size_t i = 0; i < functions.size(); i++)
+        {
+            out << (i ? "," : "") << "\n    {\n      \"name\": " << jsonString(functions[i].functionName());
+            snprintf(line, sizeof(line), ",\n      \"rounds\": %llu,\n      \"passes\": ",
+                     (unsigned long long)functions[i].numRounds());
+            out << line;
+            printPassesJSON(out, functions[i].passes(), "      ");
+            out << ",\n      \"remarks\": [";
+            const vector<FunctionReport::remarkEntry> &remarks = functions[i].remarks();
+            for (size_t j = 0; j < remarks.size(); j++)
+            {
+                out << (j ? "," : "") << "\n        {\"pass\": \"" << remarks[j].pass << "\", \"change\": \""
+                    << remarks[j].change << "\", \"block\": " << jsonString(remarks[j].block)
+                    << ", \"message\": " << jsonString(remarks[j].message) << "}";
+            }
+            out << "\n      ]\n    }";
+        }
+        out << "\n  ]\n}" << endl;
+        return;
+    }
+
+    out << "===" << string(73, '-') << "===" << endl;
+    out << "                      MiniC Compiler Optimization Report" << endl;
+    out << "===" << string(73, '-') << "===" << endl;
+    snprintf(line, sizeof(line), "  Functions: %zu, fixpoint rounds: %llu\n\n", functions.size(), (unsigned long long)rounds);
+    out << line;
+    out << "   -----Wall Time-----   ---Runs---  --Changes--  --- Name ---" << endl;
+    double passSeconds = 0;
+    uint64_t changes = 0;
+    for (auto &pass : program)
+    {
+        passSeconds += pass.wallSeconds;
+        changes += countChanges(pass);
+    }
+    for (auto &pass : program)
+    {
+        snprintf(line, sizeof(line), "   %9.6f (%5.1f%%)  %10llu  %11llu  %s\n", pass.wallSeconds,
+                 passSeconds > 0 ? 100 * pass.wallSeconds / passSeconds : 0.0, (unsigned long long)pass.runs,
+                 (unsigned long long)countChanges(pass), pass.name);
+        out << line;
+        for (auto &change : pass.changes)
+        {
+            snprintf(line, sizeof(line), "   %19s  %10s  %11llu    %s\n", "", "", (unsigned long long)change.second,
+                     change.first);
+            out << line;
+        }
+    }
+    snprintf(line, sizeof(line), "   %9.6f (100.0%%)  %10s  %11llu  %s\n\n", passSeconds, "", (unsigned long long)changes,
+             "Total");
+    out << line;
+
+    out << "   ---Rounds---  --Changes--  --- Function ---" << endl;
+    for (auto &function : functions)
+    {
+        uint64_t functionChanges = 0;
+        for (auto &pass : function.passes())
+        {
+            functionChanges += countChanges(pass);
+        }
+        snprintf(line, sizeof(line), "   %12llu  %11llu  ", (unsigned long long)function.numRounds(),
+                 (unsigned long long)functionChanges);
+        out << line << function.functionName() << endl;
+    }
+}
@@ -0,0 +1,168 @@
+/**
+ * @file opt_report.h
+ *
+ * @brief What the optimizer did to each function (`-fopt-report`): how many changes of each kind every pass made, how long
+ * it ran, how many rounds the optimizer took to reach its fixed point, and a remark for every change.
+ *
+ * The optimizer fills one FunctionReport per function, on the thread that optimizes it, and submits it once the function is
+ * done; the passes record their changes with remark, naming the kind of change and the basic block it was made in, and are
+ * timed by a passTimer, which is also the phaseTimer of the pass. Until enableOptReport has been called the optimizer makes
+ * no FunctionReport at all. printOptReport prints the totals of every pass for the whole program as a table, or the totals
+ * and the remarks of every function as JSON.
+ *
+ * Usage:
+ *     enableOptReport();
+ *     FunctionReport report("func");
+ *     {
+ *         passTimer timer(&report, "Constant folding");
+ *         report.remark("Constant folding", "constants folded", "%7", "%8 = add i32 1, 2 -> i32 3");
+ *     }
+ *     report.addRound();
+ *     report.submit();
+ *     printOptReport(cerr, false);
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef OPT_REPORT_H
+#define OPT_REPORT_H
+
+#include <stdint.h>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "time_report.h"
+using namespace std;
+
+/**
+ * @brief Starts recording the functions the optimizer submits.
+ */
+void enableOptReport();
+
+/**
+ * @return true once enableOptReport has been called.
+ */
+bool optReportEnabled();
+
+/**
+ * @brief Prints the totals of every pass over the submitted functions, in the order the passes first ran, and the number of
+ * rounds and changes of each function; as JSON, the totals of each function and its remarks follow.
+ *
+ * @param out The stream to print to.
+ * @param json Print JSON for other tools instead of a table for people.
+ */
+void printOptReport(ostream &out, bool json);
+
+/**
+ * @brief Parses a `-fopt-report` or `-fopt-report=json` option, and enables the report if it is one.
+ *
+ * @param option A command-line argument.
+ * @param json Set to whether JSON was requested, if the argument is the option.
+ * @return true if the argument is the option.
+ */
+bool parseOptReportOption(const char *option, bool &json);
+
+/**
+ * @brief The passes, rounds and changes of the optimization of one function. It is only used by the thread that optimizes
+ * the function, so it takes no lock until it is submitted.
+ */
+class FunctionReport
+{
+public:
+    // The totals of one pass
+    typedef struct passTotals
+    {
+        const char *name;
+        uint64_t runs;
+        double wallSeconds;
+        vector<pair<const char *, uint64_t>> changes; // <kind of change, count>, in the order they were first made
+    } passTotals;
+
+    // One change
+    typedef struct remarkEntry
+    {
+        const char *pass;
+        const char *change;
+        string block;
+        string message;
+    } remarkEntry;
+
+    explicit FunctionReport(const string &function) : function(function), rounds(0) {}
+
+    /**
+     * @brief Records a change made by a pass.
+     *
+     * @param pass The name of the pass, as given to its passTimer.
+     * @param change The kind of change, in the plural ("loads propagated"); like the pass, a string literal.
+     * @param block The label of the basic block the change was made in.
+     * @param message The instruction or the blocks that changed.
+     */
+    void remark(const char *pass, const char *change, const string &block, const string &message);
+
+    /**
+     * @brief Adds the time of one run of a pass.
+     */
+    void addTime(const char *pass, double seconds);
+
+    /**
+     * @brief Counts one round of the passes over the function.
+     */
+    void addRound() { rounds++; }
+
+    /**
+     * @brief Adds the report of the function to the report of the program, after those submitted before it.
+     */
+    void submit();
+
+    const string &functionName() const { return function; }
+    uint64_t numRounds() const { return rounds; }
+    const vector<passTotals> &passes() const { return passList; }
+    const vector<remarkEntry> &remarks() const { return remarkList; }
+
+private:
+    passTotals &totals(const char *pass);
+
+    string function;
+    uint64_t rounds;
+    vector<passTotals> passList; // in the order the passes first ran
+    vector<remarkEntry> remarkList;
+};
+
+/**
+ * @brief Times the enclosing scope as a phase of the time report and, if there is a report of the function, as a run of
+ * the pass in it.
+ */
+class passTimer
+{
+public:
+    /**
+     * @param report The report of the function, or NULL if the optimization report is disabled.
+     * @param pass The name of the pass; it must outlive the report (a string literal).
+     */
+    passTimer(FunctionReport *report, const char *pass) : phase(pass), report(report), pass(pass)
+    {
+        if (report)
+        {
+            start = chrono::steady_clock::now();
+        }
+    }
+
+    ~passTimer()
+    {
+        if (report)
+        {
+            report->addTime(pass, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+    }
+
+private:
+    phaseTimer phase;
+    FunctionReport *report;
+    const char *pass;
+    chrono::steady_clock::time_point start;
+};
+
+#endif // OPT_REPORT_H
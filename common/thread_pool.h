@@ -0,0 +1,136 @@
+/**
+ * @file thread_pool.h
+ *
+ * @brief A fixed-size pool of worker threads that run queued jobs.
+ *
+ * Used by the batch modes of the compiler stages to process many independent
+ * inputs at once. Jobs must not share mutable state unless they synchronize it
+ * themselves; wait() blocks until every job submitted so far has finished.
+ *
+ * Usage:
+ *     ThreadPool pool(4);
+ *     for (auto &file : files)
+ *         pool.submit([&file] { compile(file); });
+ *     pool.wait();
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    /**
+     * @brief Starts `numThreads` workers (at least one).
+     */
+    explicit ThreadPool(unsigned numThreads)
+    {
+        if (numThreads == 0)
+        {
+            numThreads = 1;
+        }
+        for (unsigned i = 0; i < numThreads; i++)
+        {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    /**
+     * @brief Finishes the queued jobs and joins the workers.
+     */
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief Queues a job to run on the next idle worker.
+     */
+    void submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+            pending++;
+        }
+        jobAvailable.notify_one();
+    }
+
+    /**
+     * @brief Blocks until every submitted job has finished.
+     */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock, [this] { return pending == 0; });
+    }
+
+    /**
+     * @brief Number of hardware threads, or 1 if unknown.
+     */
+    static unsigned hardwareThreads()
+    {
+        unsigned n = std::thread::hardware_concurrency();
+        return n ? n : 1;
+    }
+
+private:
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                {
+                    return; // stopping and nothing left to do
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            job();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0)
+                {
+                    allDone.notify_all();
+                }
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable allDone;
+    size_t pending = 0; // submitted jobs that have not finished yet
+    bool stopping = false;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,202 @@
+/**
+ * @file time_report.cpp
+ *
+ * @brief This file contains the definitions of the per-phase timing and memory report, and the global operator new that
+ * counts allocations for it.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "time_report.h"
+#include <mutex>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <sys/resource.h>
+
+// Totals of one phase
+typedef struct
+{
+    const char *name;
+    uint64_t calls;
+    double wallSeconds;
+    uint64_t allocations;
+    long peakRSS; // KiB
+} phaseTotals;
+
+static bool enabled = false;
+static chrono::steady_clock::time_point reportStart;
+static mutex phasesMutex;
+static vector<phaseTotals> phases; // in the order the phases first ran
+
+// Allocations made by operator new on this thread
+static thread_local uint64_t threadAllocations = 0;
+
+void *operator new(size_t size)
+{
+    threadAllocations++;
+    if (void *memory = malloc(size ? size : 1))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    threadAllocations++;
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+/**
+ * @return The peak resident set size of the process so far, in KiB.
+ */
+static long peakRSS()
+{
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+}
+
+void enableTimeReport()
+{
+    enabled = true;
+    reportStart = chrono::steady_clock::now();
+}
+
+bool timeReportEnabled()
+{
+    return enabled;
+}
+
+bool parseTimeReportOption(const char *option, bool &json)
+{
+    if (strcmp(option, "-ftime-report") && strcmp(option, "-ftime-report=json"))
+    {
+        return false;
+    }
+    json = option[strlen("-ftime-report")] == '=';
+    enableTimeReport();
+    return true;
+}
+
+phaseTimer::phaseTimer(const char *phase) : phase(enabled ? phase : NULL)
+{
+    if (this->phase)
+    {
+        startAllocations = threadAllocations;
+        start = chrono::steady_clock::now();
+    }
+}
+
+phaseTimer::~phaseTimer()
+{
+    if (!phase)
+    {
+        return;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    uint64_t allocations = threadAllocations - startAllocations;
+    long rss = peakRSS();
+
+    lock_guard<mutex> lock(phasesMutex);
+    for (auto &totals : phases)
+    {
+        if (!strcmp(totals.name, phase))
+        {
+            totals.calls++;
+            totals.wallSeconds += seconds;
+            totals.allocations += allocations;
+            totals.peakRSS = max(totals.peakRSS, rss);
+            return;
+        }
+    }
+    phases.push_back({phase, 1, seconds, allocations, rss});
+}
+
+void printTimeReport(ostream &out, bool json)
+{
+    double totalSeconds = chrono::duration<double>(chrono::steady_clock::now() - reportStart).count();
+    long rss = peakRSS();
+    char line[256];
+
+    lock_guard<mutex> lock(phasesMutex);
+    if (json)
+    {
+        snprintf(line, sizeof(line), "{\n  \"total_wall_seconds\": %.6f,\n  \"peak_rss_kib\": %ld,\n  \"phases\": [", totalSeconds,
+                 rss);
+        out << line;
+        for (size_t i = 0; i < phases.size(); i++)
+        {
+            // Phase names are plain literals, so they need no escaping
+            snprintf(line, sizeof(line),
+                     "%s\n    {\"name\": \"%s\", \"calls\": %llu, \"wall_seconds\": %.6f, \"allocations\": %llu, "
+                     "\"peak_rss_kib\": %ld}",
+                     i ? "," : "", phases[i].name, (unsigned long long)phases[i].calls, phases[i].wallSeconds,
+                     (unsigned long long)phases[i].allocations, phases[i].peakRSS);
+            out << line;
+        }
+        out << "\n  ]\n}" << endl;
+        return;
+    }
+
+    out << "===" << string(73, '-') << "===" << endl;
+    out << "                          MiniC Compiler Time Report" << endl;
+    out << "===" << string(73, '-') << "===" << endl;
+    snprintf(line, sizeof(line), "  Total Execution Time: %.6f seconds, peak RSS %ld KiB\n\n", totalSeconds, rss);
+    out << line;
+    out << "   -----Wall Time-----   ---Calls---  --Allocations--  --Peak RSS--  --- Name ---" << endl;
+    double phaseSeconds = 0;
+    for (auto &totals : phases)
+    {
+        snprintf(line, sizeof(line), "   %9.6f (%5.1f%%)  %11llu  %15llu  %8ld KiB  %s\n", totals.wallSeconds,
+                 totalSeconds > 0 ? 100 * totals.wallSeconds / totalSeconds : 0.0, (unsigned long long)totals.calls,
+                 (unsigned long long)totals.allocations, totals.peakRSS, totals.name);
+        out << line;
+        phaseSeconds += totals.wallSeconds;
+    }
+
+    // Start-up, argument parsing and anything else outside the phases. The phases of parallel compilations overlap,
+    // so in batch mode their sum can exceed the total
+    if (phaseSeconds <= totalSeconds)
+    {
+        snprintf(line, sizeof(line), "   %9.6f (%5.1f%%)  %11s  %15s  %12s  %s\n", totalSeconds - phaseSeconds,
+                 totalSeconds > 0 ? 100 * (totalSeconds - phaseSeconds) / totalSeconds : 0.0, "", "", "", "Other");
+        out << line;
+    }
+    snprintf(line, sizeof(line), "   %9.6f (100.0%%)  %11s  %15s  %12s  %s\n", totalSeconds, "", "", "", "Total");
+    out << line;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file time_report.h
+ *
+ * @brief Per-phase timing and memory report of a compiler run (`-ftime-report`).
+ *
+ * Each phase of the compiler (parsing, each optimization pass, register allocation, ...) is wrapped in a phaseTimer. Once
+ * enableTimeReport has been called, every timer adds its wall time, the number of allocations made by its thread while it
+ * ran and the peak resident set size of the process when it stopped to the totals of its phase; until then the timers do
+ * nothing. printTimeReport prints the totals as a table or as JSON.
+ *
+ * Allocations are counted by the global operator new, which covers LLVM and the standard containers but not the C allocations
+ * of the scanner and the AST. The peak RSS is the high-water mark of the whole process up to the end of the phase, as reported
+ * by getrusage. Timers must not nest, so that each phase's time is its own; any number of threads may run timers at once.
+ *
+ * Usage:
+ *     enableTimeReport();
+ *     {
+ *         phaseTimer timer("Lexing and parsing");
+ *         yyparse(scanner, &root);
+ *     }
+ *     printTimeReport(cerr, false);
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+#include <stdint.h>
+#include <chrono>
+#include <ostream>
+using namespace std;
+
+/**
+ * @brief Starts recording the phases, and the total time of the report.
+ */
+void enableTimeReport();
+
+/**
+ * @return true once enableTimeReport has been called.
+ */
+bool timeReportEnabled();
+
+/**
+ * @brief Prints the totals of every phase in the order the phases first ran.
+ *
+ * @param out The stream to print to.
+ * @param json Print JSON for other tools instead of a table for people.
+ */
+void printTimeReport(ostream &out, bool json);
+
+/**
+ * @brief Parses a `-ftime-report` or `-ftime-report=json` option, and enables the report if it is one.
+ *
+ * @param option A command-line argument.
+ * @param json Set to whether JSON was requested, if the argument is the option.
+ * @return true if the argument is the option.
+ */
+bool parseTimeReportOption(const char *option, bool &json);
+
+/**
+ * @brief Adds the time, allocations and memory of the enclosing scope to the totals of a phase.
+ */
+class phaseTimer
+{
+public:
+    /**
+     * @param phase The name of the phase; it must outlive the report (a string literal).
+     */
+    explicit phaseTimer(const char *phase);
+    ~phaseTimer();
+
+private:
+    const char *phase; // NULL when the report is disabled
+    chrono::steady_clock::time_point start;
+    uint64_t startAllocations;
+};
+
+#endif // TIME_REPORT_H
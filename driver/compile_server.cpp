@@ -0,0 +1,668 @@
+/**
+ * @file compile_server.cpp
+ * @brief A persistent MiniC compile server and its client.
+ *
+ * The server handles one request at a time. It keeps one LLVM context and one AST arena for all of them: the arena is reset
+ * after each compilation, keeping its memory for the next one, and the context is replaced after CONTEXT_REUSE_LIMIT
+ * compilations so that the types and constants it interns cannot grow without bound. The stages print their results to
+ * stdout and stderr, so those are redirected to a temporary file for the duration of each compilation and sent back to the
+ * client from there.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "compile_server.h"
+#include "file_utils.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Number of compilations that share one LLVM context before it is replaced
+#define CONTEXT_REUSE_LIMIT 256
+
+// Longest request line the server accepts
+#define MAX_REQUEST_LINE 8192
+
+/**
+ * @brief Buffered reading and writing of the protocol on a connected socket.
+ */
+class connection
+{
+public:
+    explicit connection(int fd) : fd(fd), begin(0), end(0) {}
+    ~connection() { close(fd); }
+
+    /**
+     * @brief Reads the next line, without its newline.
+     *
+     * @param line The line read.
+     * @return false at the end of the connection or if the line is too long.
+     */
+    bool readLine(string &line)
+    {
+        line.clear();
+        while (true)
+        {
+            if (begin == end && !fill())
+            {
+                return false;
+            }
+            char *newline = (char *)memchr(buffer + begin, '\n', end - begin);
+            size_t length = newline ? newline - (buffer + begin) : end - begin;
+            line.append(buffer + begin, length);
+            begin += length;
+            if (newline)
+            {
+                begin++;
+                return true;
+            }
+            if (line.size() > MAX_REQUEST_LINE)
+            {
+                return false;
+            }
+        }
+    }
+
+    /**
+     * @brief Reads exactly `length` bytes.
+     *
+     * @param length The number of bytes to read.
+     * @param data The bytes read.
+     * @return false if the connection ends first.
+     */
+    bool readBytes(size_t length, string &data)
+    {
+        data.clear();
+        while (data.size() < length)
+        {
+            if (begin == end && !fill())
+            {
+                return false;
+            }
+            size_t count = min(length - data.size(), end - begin);
+            data.append(buffer + begin, count);
+            begin += count;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Writes all of `data`.
+     *
+     * @param data The bytes to write.
+     * @return false if the peer has gone away.
+     */
+    bool write(const string &data)
+    {
+        size_t written = 0;
+        while (written < data.size())
+        {
+            // MSG_NOSIGNAL: a client that disconnects must not kill the server with SIGPIPE
+            ssize_t count = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+            if (count <= 0)
+            {
+                return false;
+            }
+            written += count;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reads a `<keyword> <n>\n` header and the n bytes that follow it.
+     *
+     * @param keyword The expected keyword.
+     * @param data The bytes read.
+     * @return false if the header is missing or the connection ends first.
+     */
+    bool readBlock(const char *keyword, string &data)
+    {
+        string line;
+        size_t keywordLength = strlen(keyword);
+        if (!readLine(line) || line.compare(0, keywordLength, keyword) || line[keywordLength] != ' ')
+        {
+            return false;
+        }
+        return readBytes(strtoul(line.c_str() + keywordLength + 1, NULL, 10), data);
+    }
+
+    /**
+     * @brief Writes `data` preceded by a `<keyword> <n>\n` header.
+     *
+     * @param keyword The keyword of the header.
+     * @param data The bytes to write.
+     * @return false if the peer has gone away.
+     */
+    bool writeBlock(const char *keyword, const string &data)
+    {
+        return write(string(keyword) + " " + to_string(data.size()) + "\n") && write(data);
+    }
+
+private:
+    bool fill()
+    {
+        ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0)
+        {
+            return false;
+        }
+        begin = 0;
+        end = count;
+        return true;
+    }
+
+    int fd;
+    char buffer[4096];
+    size_t begin, end;
+};
+
+/**
+ * @brief Redirects stdout and stderr to a temporary file while it is active.
+ */
+class outputCapture
+{
+public:
+    outputCapture() : file(tmpfile()), savedOut(-1), savedErr(-1) {}
+    ~outputCapture()
+    {
+        if (file)
+        {
+            fclose(file);
+        }
+    }
+
+    bool isOpen() const { return file != NULL; }
+
+    /**
+     * @brief Starts sending everything written to stdout and stderr to the temporary file, which is emptied first.
+     */
+    void start()
+    {
+        flushAll();
+        ftruncate(fileno(file), 0);
+        lseek(fileno(file), 0, SEEK_SET);
+        savedOut = dup(STDOUT_FILENO);
+        savedErr = dup(STDERR_FILENO);
+        dup2(fileno(file), STDOUT_FILENO);
+        dup2(fileno(file), STDERR_FILENO);
+    }
+
+    /**
+     * @brief Restores stdout and stderr.
+     *
+     * @param output Everything written to them since `start`.
+     */
+    void stop(string &output)
+    {
+        flushAll();
+        dup2(savedOut, STDOUT_FILENO);
+        dup2(savedErr, STDERR_FILENO);
+        close(savedOut);
+        close(savedErr);
+
+        output.clear();
+        off_t size = lseek(fileno(file), 0, SEEK_END);
+        output.resize(size);
+        if (size > 0 && pread(fileno(file), &output[0], size, 0) != size)
+        {
+            output.clear();
+        }
+    }
+
+private:
+    static void flushAll()
+    {
+        cout.flush();
+        cerr.flush();
+        fflush(stdout);
+        fflush(stderr);
+    }
+
+    FILE *file;
+    int savedOut, savedErr;
+};
+
+/**
+ * @brief Fills in the address of the Unix domain socket at `socketPath`.
+ *
+ * @param socketPath The path of the socket.
+ * @param address The address to fill in.
+ * @return false if the path is too long for a socket address.
+ */
+static bool socketAddress(const char *socketPath, sockaddr_un &address)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        cerr << "Socket path '" << socketPath << "' is too long" << endl;
+        return false;
+    }
+    strcpy(address.sun_path, socketPath);
+    return true;
+}
+
+/**
+ * @brief Parses the leading `--` options of a request and returns the rest of the line.
+ *
+ * @param arguments The request line after its keyword.
+ * @param request The request whose options are set.
+ * @param rest The text after the options.
+ * @return false if an option is not recognized.
+ */
+static bool parseRequestOptions(const string &arguments, compileRequest &request, string &rest)
+{
+    size_t position = 0;
+    while (arguments.compare(position, 2, "--") == 0)
+    {
+        size_t space = arguments.find(' ', position);
+        if (space == string::npos)
+        {
+            return false;
+        }
+        string option = arguments.substr(position, space - position);
+        if (option == "--mmap")
+        {
+            request.options.useMmap = true;
+        }
+        else if (option == "--fused")
+        {
+            request.options.fused = true;
+        }
+        else if (option == "--emit-ll")
+        {
+            request.dumpFormat = ".ll";
+        }
+        else if (option == "--emit-bc")
+        {
+            request.dumpFormat = ".bc";
+        }
+        else if (option.compare(0, 9, "--passes=") == 0 || option.compare(0, 13, "--max-rounds=") == 0)
+        {
+            // The pipeline options of the command line, with the extra dash of the protocol
+            bool valid = true;
+            parseOptimizationOption(option.c_str() + 1, request.optimization, valid);
+            if (!valid)
+            {
+                return false;
+            }
+        }
+        else if (parseTargetOption(option.c_str() + 1, request.target))
+        {
+            // -m32 or -m64, with the extra dash of the protocol
+        }
+        else if (option.compare(0, 11, "--filetype=") == 0)
+        {
+            bool valid = true;
+            parseOutputFormatOption(option.c_str() + 1, request.format, valid);
+            if (!valid)
+            {
+                return false;
+            }
+        }
+        else if (option.compare(0, 11, "--regalloc=") == 0)
+        {
+            bool valid = true;
+            parseRegisterAllocatorOption(option.c_str() + 1, request.allocator, valid);
+            if (!valid)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+        position = space + 1;
+    }
+    rest = arguments.substr(position);
+    return !rest.empty();
+}
+
+/**
+ * @brief Warm state of the server, reused by every compilation.
+ */
+typedef struct
+{
+    LLVMContextRef context;
+    astArena *arena;
+    unsigned compilations; // compilations run in `context`
+    outputCapture *capture;
+    CompileCache *cache;
+} serverState;
+
+/**
+ * @brief Runs one compilation with the server's warm context and arena, capturing what it prints.
+ *
+ * @param state The server state.
+ * @param request The compilation to run.
+ * @param output What the compilation printed.
+ * @return The exit code of the compilation.
+ */
+static int serveCompilation(serverState &state, const compileRequest &request, string &output)
+{
+    if (state.compilations == CONTEXT_REUSE_LIMIT)
+    {
+        LLVMContextDispose(state.context);
+        state.context = LLVMContextCreate();
+        state.compilations = 0;
+    }
+    state.compilations++;
+
+    state.capture->start();
+    compileRequest cachedRequest = request;
+    cachedRequest.cache = state.cache;
+    int exitCode = compileProgram(cachedRequest, state.context, state.arena, cout);
+    state.capture->stop(output);
+    return exitCode;
+}
+
+/**
+ * @brief Answers the requests of one client until it disconnects or asks the server to stop.
+ *
+ * @param state The server state.
+ * @param client The connection to the client.
+ * @return true if the client sent `shutdown`.
+ */
+static bool serveClient(serverState &state, connection &client)
+{
+    string line;
+    while (client.readLine(line))
+    {
+        if (line == "shutdown")
+        {
+            client.writeBlock("output", "");
+            client.write("exit 0\n");
+            return true;
+        }
+        if (line.compare(0, 3, "cd ") == 0)
+        {
+            bool changed = chdir(line.c_str() + 3) == 0;
+            if (!client.writeBlock("output", changed ? "" : "Could not change to directory '" + line.substr(3) + "'\n") ||
+                !client.write(changed ? "exit 0\n" : "exit 1\n"))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        compileRequest request = {NULL, NULL, 0, {false, false, false}, optimizationLevel(2), GRAPH_COLORING_ALLOCATOR, X86_TARGET,
+                                  ASSEMBLY_OUTPUT, 1, NULL, NULL, NULL, NULL, {false, NULL}};
+        string output, assembly, source, name;
+        int exitCode;
+        if (line.compare(0, 8, "compile ") == 0 && parseRequestOptions(line.substr(8), request, name))
+        {
+            request.filename = name.c_str();
+            exitCode = serveCompilation(state, request, output);
+        }
+        else if (line.compare(0, 7, "source ") == 0 && parseRequestOptions(line.substr(7), request, name) &&
+                 !request.options.useMmap && !request.dumpFormat)
+        {
+            // The length comes first, so the name may contain spaces
+            char *nameStart;
+            request.length = strtoul(name.c_str(), &nameStart, 10);
+            if (*nameStart != ' ' || !client.readBytes(request.length, source))
+            {
+                return false;
+            }
+            name = nameStart + 1;
+            request.filename = name.c_str();
+            request.source = source.c_str();
+
+            ostringstream assemblyStream;
+            request.assembly = &assemblyStream;
+            exitCode = serveCompilation(state, request, output);
+            assembly = assemblyStream.str();
+        }
+        else
+        {
+            output = "Unrecognized request: " + line + "\n";
+            exitCode = 1;
+        }
+
+        bool answered = client.writeBlock("output", output);
+        if (answered && request.source && exitCode == 0)
+        {
+            answered = client.writeBlock("asm", assembly);
+        }
+        if (!answered || !client.write("exit " + to_string(exitCode) + "\n"))
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+int runCompileServer(const char *socketPath, CompileCache *cache)
+{
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address))
+    {
+        return 1;
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath);
+    if (listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 16) != 0)
+    {
+        cerr << "Could not listen on socket '" << socketPath << "'" << endl;
+        if (listener >= 0)
+        {
+            close(listener);
+        }
+        return 1;
+    }
+
+    outputCapture capture;
+    if (!capture.isOpen())
+    {
+        cerr << "Could not create a temporary file for the compilation output" << endl;
+        close(listener);
+        unlink(socketPath);
+        return 1;
+    }
+
+    int directory = open(".", O_RDONLY | O_DIRECTORY);
+    if (directory < 0)
+    {
+        cerr << "Could not open the server's working directory" << endl;
+        close(listener);
+        unlink(socketPath);
+        return 1;
+    }
+
+    cout << "Compile server listening on " << socketPath << endl;
+    serverState state = {LLVMContextCreate(), createArena(), 0, &capture, cache};
+    bool stop = false;
+    while (!stop)
+    {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0)
+        {
+            continue;
+        }
+        connection client(fd);
+        stop = serveClient(state, client);
+
+        // A client's `cd` only applies to its own requests
+        if (fchdir(directory) != 0)
+        {
+            cerr << "Could not return to the server's working directory" << endl;
+            stop = true;
+        }
+    }
+
+    freeArena(state.arena);
+    LLVMContextDispose(state.context);
+    close(directory);
+    close(listener);
+    unlink(socketPath);
+    return 0;
+}
+
+/**
+ * @brief Connects to the compile server at `socketPath`.
+ *
+ * @param socketPath The path of the server's socket.
+ * @return The connected socket, or -1 if the server cannot be reached.
+ */
+static int connectToServer(const char *socketPath)
+{
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address))
+    {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        cerr << "Could not connect to compile server '" << socketPath << "'" << endl;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Sends one request and reads the answer.
+ *
+ * @param server The connection to the server.
+ * @param request The request line and its payload.
+ * @param expectAssembly Whether a successful answer carries assembly.
+ * @param assembly The assembly of the answer, if any.
+ * @return The exit code of the answer, or 1 if the connection fails.
+ */
+static int exchange(connection &server, const string &request, bool expectAssembly, string &assembly)
+{
+    string output, line;
+    if (!server.write(request) || !server.readBlock("output", output))
+    {
+        cerr << "The compile server closed the connection" << endl;
+        return 1;
+    }
+    cout << output << flush;
+
+    if (!server.readLine(line))
+    {
+        cerr << "The compile server closed the connection" << endl;
+        return 1;
+    }
+    if (expectAssembly && line.compare(0, 4, "asm ") == 0)
+    {
+        if (!server.readBytes(strtoul(line.c_str() + 4, NULL, 10), assembly) || !server.readLine(line))
+        {
+            cerr << "The compile server closed the connection" << endl;
+            return 1;
+        }
+    }
+    if (line.compare(0, 5, "exit ") != 0)
+    {
+        cerr << "Unexpected answer from the compile server: " << line << endl;
+        return 1;
+    }
+    return atoi(line.c_str() + 5);
+}
+
+int runCompileClient(const char *socketPath, const compileRequest &request, bool inlineSource)
+{
+    string options = formatOptimizationOptions(request.optimization, "--") + " --regalloc=" +
+                     getRegisterAllocatorName(request.allocator) + " -" + getTargetOption(request.target) + " --filetype=" +
+                     getOutputFormatName(request.format) + " ";
+    if (request.options.useMmap && !inlineSource)
+    {
+        options += "--mmap ";
+    }
+    if (request.options.fused)
+    {
+        options += "--fused ";
+    }
+    if (request.dumpFormat)
+    {
+        options += string("--emit-") + (request.dumpFormat + 1) + " ";
+    }
+
+    string line;
+    if (inlineSource)
+    {
+        ifstream file(request.filename, ios::binary);
+        if (!file)
+        {
+            cerr << "Could not open file '" << request.filename << "'" << endl;
+            return 1;
+        }
+        ostringstream source;
+        source << file.rdbuf();
+        line = "source " + options + to_string(source.str().size()) + " " + request.filename + "\n" + source.str();
+    }
+    else
+    {
+        line = "compile " + options + request.filename + "\n";
+    }
+
+    int fd = connectToServer(socketPath);
+    if (fd < 0)
+    {
+        return 1;
+    }
+    connection server(fd);
+
+    string assembly;
+    if (!inlineSource)
+    {
+        // Have the server resolve the path, and name its outputs, as this process would
+        char directory[PATH_MAX];
+        if (!getcwd(directory, sizeof(directory)))
+        {
+            cerr << "Could not get the working directory" << endl;
+            return 1;
+        }
+        int exitCode = exchange(server, string("cd ") + directory + "\n", false, assembly);
+        if (exitCode != 0)
+        {
+            return exitCode;
+        }
+    }
+    int exitCode = exchange(server, line, inlineSource, assembly);
+    if (inlineSource && exitCode == 0)
+    {
+        // Save the assembly (or object) next to the input file, as a local compilation would
+        string outName;
+        changeFileExtension(request.filename, outName, getOutputExtension(request.format));
+        ofstream outputFile(outName, ios::binary);
+        if (!(outputFile << assembly))
+        {
+            cerr << "Could not write file '" << outName << "'" << endl;
+            exitCode = 5;
+        }
+    }
+    return exitCode;
+}
+
+int shutdownCompileServer(const char *socketPath)
+{
+    int fd = connectToServer(socketPath);
+    if (fd < 0)
+    {
+        return 1;
+    }
+    connection server(fd);
+
+    string assembly;
+    return exchange(server, "shutdown\n", false, assembly);
+}
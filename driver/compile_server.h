@@ -0,0 +1,75 @@
+/**
+ * @file compile_server.h
+ * @brief A persistent MiniC compile server and its client.
+ *
+ * `minicc --serve <socket>` starts a server that listens on a Unix domain socket and runs every compilation it is sent in the
+ * same process, with one LLVM context and one AST arena kept warm across requests. `minicc --connect <socket> ...` is the client:
+ * it compiles like a plain minicc run, without paying the start-up of a new compiler process for each file.
+ *
+ * The protocol is line based and a connection may carry any number of requests:
+ *
+ *   cd <directory>\n
+ *       Makes <directory> the working directory of the following requests of the connection.
+ *   compile [--passes=<list>] [--max-rounds=<n>] [--regalloc=<allocator>] [--m32 | --m64] [--filetype=<format>] [--mmap]
+ *           [--fused] [--emit-ll | --emit-bc] <path>\n
+ *       Compiles the file at <path> and writes the assembly and the dumps next to it, exactly as `minicc` would when run in
+ *       the working directory.
+ *   source [--passes=<list>] [--max-rounds=<n>] [--regalloc=<allocator>] [--m32 | --m64] [--filetype=<format>] [--fused]
+ *          <length> <name>\n<length bytes>
+ *       Compiles the source sent after the request line, reported under <name>, and sends the assembly (or object) back.
+ *   shutdown\n
+ *       Answers, then stops the server.
+ *
+ * The optimization pipeline is given as `minicc -passes=<list> -max-rounds=<n>` would give it (an -O level is sent as the
+ * passes and the round limit it stands for), the register allocator as `minicc -regalloc=<allocator>` would give it, and the
+ * target and the output format as `minicc -m32` or `-m64` and `-filetype=<format>` would, with the extra dash; without them the
+ * server optimizes at -O2, allocates registers by graph coloring and generates 32-bit x86 assembly.
+ *
+ * Each request is answered with `output <n>\n` and the n bytes the compilation printed, then, for a source request that
+ * succeeded, `asm <n>\n` and the n bytes of assembly (or of the object), and finally `exit <code>\n` with the exit code of the compilation.
+ * Paths and names are the rest of their line, so they may contain spaces but not newlines.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef COMPILE_SERVER_H
+#define COMPILE_SERVER_H
+
+#include "pipeline.h"
+
+/**
+ * @brief Serves compile requests on a Unix domain socket until a client sends `shutdown`.
+ *
+ * Requests are handled one at a time, in the order they arrive. A stale socket file at `socketPath` is replaced; the socket is
+ * removed again when the server stops.
+ *
+ * @param socketPath The path of the socket to listen on.
+ * @param cache The compilation cache of every request, or NULL for none.
+ * @return 0 after a shutdown request, 1 if the socket cannot be set up.
+ */
+int runCompileServer(const char *socketPath, CompileCache *cache);
+
+/**
+ * @brief Sends one compile request to a compile server and reports its answer as if the compilation had run locally.
+ *
+ * The compilation's output is printed to stdout. With `inlineSource`, the file is read here and sent as a source request, and
+ * the assembly the server returns is written to `<basename>.s` (the object to `<basename>.o`); otherwise the server reads and
+ * writes the files itself, in this process's working directory.
+ *
+ * @param socketPath The path of the server's socket.
+ * @param request The file to compile and the options of the compilation. `source` and `assembly` are ignored.
+ * @param inlineSource Whether to send the contents of the file instead of its path.
+ * @return The exit code of the compilation, or 1 if the server cannot be reached or the file cannot be read.
+ */
+int runCompileClient(const char *socketPath, const compileRequest &request, bool inlineSource);
+
+/**
+ * @brief Asks a compile server to stop.
+ *
+ * @param socketPath The path of the server's socket.
+ * @return 0 if the server acknowledged the request, 1 if it cannot be reached.
+ */
+int shutdownCompileServer(const char *socketPath);
+
+#endif // COMPILE_SERVER_H
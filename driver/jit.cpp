@@ -0,0 +1,148 @@
+/**
+ * @file jit.cpp
+ * @brief Runs the function of a MiniC module in the driver's process, with LLVM's MCJIT.
+ *
+ * The JIT compiles a clone of the module, which its execution engine owns and disposes, so the driver keeps its module for the
+ * next stage. `print` and `read` are mapped to the callbacks below, which write to and read from the run in progress on their
+ * thread. The code is generated without LLVM's own optimizations, so the run shows what the MiniC optimizer made of the
+ * program and nothing else.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "jit.h"
+#include "file_utils.h"
+#include "time_report.h"
+#include <llvm-c/ExecutionEngine.h>
+#include <llvm-c/Target.h>
+#include <stdio.h>
+
+using namespace std;
+
+// The state of the run in progress on a thread, for the callbacks
+typedef struct
+{
+    const vector<int> *input; // the numbers that `read` returns
+    size_t next;              // the index of the next one
+    string *output;           // the output of the run
+} jitRunState;
+
+static thread_local jitRunState *currentRun = NULL;
+
+/**
+ * @brief The `print` of a run: appends the number and a newline to its output, as `main.c` prints it.
+ */
+static void jitPrint(int value)
+{
+    char line[16];
+    snprintf(line, sizeof(line), "%d\n", value);
+    *currentRun->output += line;
+}
+
+/**
+ * @brief The `read` of a run: returns the next number of its input, or 0 once there is none left.
+ */
+static int jitRead()
+{
+    if (currentRun->next == currentRun->input->size())
+    {
+        return 0;
+    }
+    return (*currentRun->input)[currentRun->next++];
+}
+
+/**
+ * @brief Links in MCJIT and the native target, once per process.
+ *
+ * @return true.
+ */
+static bool initializeJIT()
+{
+    LLVMLinkInMCJIT();
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+    return true;
+}
+
+bool runModule(LLVMModuleRef module, const jitRequest &run, string &output, string &error)
+{
+    static bool initialized = initializeJIT();
+    (void)initialized;
+
+    // The function of the program: the one with a body
+    LLVMValueRef function = LLVMGetFirstFunction(module);
+    while (function && (!materializeFunction(function) || LLVMCountBasicBlocks(function) == 0))
+    {
+        function = LLVMGetNextFunction(function);
+    }
+    if (!function)
+    {
+        error = "the module has no function to run";
+        return false;
+    }
+
+    // Compile a copy of the module for the machine the driver runs on
+    LLVMExecutionEngineRef engine;
+    int (*entry)(int);
+    {
+        phaseTimer timer("JIT compilation");
+        LLVMModuleRef clone = LLVMCloneModule(module);
+        char *triple = LLVMGetDefaultTargetTriple();
+        LLVMSetTarget(clone, triple);
+        LLVMDisposeMessage(triple);
+
+        LLVMMCJITCompilerOptions options;
+        LLVMInitializeMCJITCompilerOptions(&options, sizeof(options));
+        options.OptLevel = 0;
+        char *message = NULL;
+        if (LLVMCreateMCJITCompilerForModule(&engine, clone, &options, sizeof(options), &message))
+        {
+            error = message;
+            LLVMDisposeMessage(message);
+            return false;
+        }
+        for (LLVMValueRef callee = LLVMGetFirstFunction(clone); callee; callee = LLVMGetNextFunction(callee))
+        {
+            string name = LLVMGetValueName(callee);
+            if (name == "print")
+            {
+                LLVMAddGlobalMapping(engine, callee, (void *)jitPrint);
+            }
+            else if (name == "read")
+            {
+                LLVMAddGlobalMapping(engine, callee, (void *)jitRead);
+            }
+        }
+        entry = (int (*)(int))LLVMGetFunctionAddress(engine, LLVMGetValueName(function));
+    }
+    if (!entry)
+    {
+        error = string("the JIT could not compile '") + LLVMGetValueName(function) + "'";
+        LLVMDisposeExecutionEngine(engine);
+        return false;
+    }
+
+    // Call the function as main.c would, with the output and the input of this run
+    jitRunState state = {&run.input, 0, &output};
+    currentRun = &state;
+    int result;
+    {
+        phaseTimer timer("JIT execution");
+        result = entry(run.argument);
+    }
+    currentRun = NULL;
+    output += "In main printing return value of test: " + to_string(result) + "\n";
+
+    LLVMDisposeExecutionEngine(engine);
+    return true;
+}
+
+void readJITInput(istream &in, vector<int> &input)
+{
+    int value;
+    while (in >> value)
+    {
+        input.push_back(value);
+    }
+}
@@ -0,0 +1,60 @@
+/**
+ * @file jit.h
+ * @brief Runs the function of a MiniC module in the driver's process, with LLVM's MCJIT, instead of assembling and linking it.
+ *
+ * A MiniC program is one function, which `tests/backend/main.c` calls with the argument 5 and whose result it prints, and which
+ * calls `print` and `read`. `runModule` compiles a copy of the module to native code in memory, binds `print` and `read` to
+ * callbacks of the driver, and calls the function as `main.c` would: each `print` appends a line to the output, `read` returns
+ * the next number of the input, and the output ends with the line `main.c` prints for the result. The run needs neither the
+ * assembler nor the linker, so a differential test of the optimizer costs one compilation and one call.
+ *
+ * Usage:
+ *     jitRequest run = {5, {3, 7}, true};
+ *     std::string output, error;
+ *     if (!runModule(module, run, output, error)) ...
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <llvm-c/Core.h>
+#include <istream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A run of a MiniC program with the JIT, which the driver does instead of generating its assembly.
+ */
+typedef struct
+{
+    int argument;           // the argument of the function; main.c passes 5
+    std::vector<int> input; // the numbers that `read` returns, in order, and then 0
+    bool compare;           // also run the module before optimization, and fail if the outputs differ
+} jitRequest;
+
+/**
+ * @brief Runs the function of a module with the JIT.
+ *
+ * The module is left as it is: the JIT compiles a copy of it, without optimizing it further. The run cannot be interrupted, so a
+ * program that does not terminate does not return.
+ *
+ * @param module The MiniC module, with one function and the declarations of `print` and `read`.
+ * @param run The argument of the function and the input of `read`.
+ * @param output Receives what `main.c` would print: a line for each `print`, then the line of the result.
+ * @param error Receives the reason if the module cannot be run.
+ * @return true if the function ran, false if the module has no function or the JIT cannot compile it.
+ */
+bool runModule(LLVMModuleRef module, const jitRequest &run, std::string &output, std::string &error);
+
+/**
+ * @brief Reads the input of a run: the whitespace-separated numbers of a stream, as `scanf("%d")` would read them.
+ *
+ * @param in The stream to read.
+ * @param input Receives the numbers, up to the first word that is not one.
+ */
+void readJITInput(std::istream &in, std::vector<int> &input);
+
+#endif // JIT_H
@@ -0,0 +1,394 @@
+/**
+ * @file minicc.cpp
+ * @brief End-to-end MiniC compiler driver.
+ *
+ * This program runs the frontend, the optimizer and the backend in a single process. The LLVM module generated from the AST
+ * stays in memory from IR generation to assembly, so none of the stages prints textual IR for the next one to parse again, and
+ * the compiler starts up once instead of three times. The `_manual.ll` and `_manual_opt.ll` files of the three-executable
+ * pipeline are only written on request, as dumps.
+ *
+ * Usage:
+ *   ./minicc [-O0|-O1|-O2] [-passes=<list>] [-max-rounds=<n>] [-regalloc=<allocator>] [-m32|-m64] [-filetype=asm|obj]
+ *            [--cache-dir <dir>] [--cache-size <size>] [-ftime-report[=json]] [-fopt-report[=json]] [-j[<threads>]] [--mmap]
+ *            [--fused] [--emit-ll | --emit-bc] [--run[=<n>] | --run-check[=<n>]] [-fprofile-generate | -fprofile-use[=<file>]]
+ *            <input_file>
+ *   ./minicc --connect <socket> [-O0|-O1|-O2] [-passes=<list>] [-max-rounds=<n>] [-regalloc=<allocator>] [-m32|-m64]
+ *            [-filetype=asm|obj] [--inline] [--mmap] [--fused] [--emit-ll | --emit-bc] <input_file>
+ *   ./minicc --serve <socket> [--cache-dir <dir>] [--cache-size <size>]
+ *   ./minicc --connect <socket> --shutdown
+ *   ./minicc --cache-stats [--cache-dir <dir>]
+ *   <input_file>  - The MiniC source file to compile.
+ *   -O0, -O1, -O2 - The optimization level: -O0 leaves the IR as it is, -O1 runs the passes that need no SSA form for at
+ *                   most 2 rounds, and -O2 (the default) runs every pass for at most 16 rounds.
+ *   -passes       - Run only the comma-separated optimization passes of <list>: mem2reg, sccp, constprop, dse, gvn, licm,
+ *                   fold, simplify, cse, dce and simplifycfg.
+ *   -max-rounds   - Stop optimizing a function after <n> rounds of the passes.
+ *   -regalloc     - The register allocator: `linear` (linear scan, the default at -O0 and -O1) or `graph` (graph coloring,
+ *                   slower to run but with fewer spills; the default at -O2).
+ *   -m32, -m64    - Generate 32-bit x86 assembly (the default), or x86-64 assembly with the System V calling convention.
+ *   -filetype     - Write the assembly (asm, the default), or encode it into a relocatable ELF object (obj) that the linker
+ *                   takes as it is, without running the assembler.
+ *   -j            - Optimize the functions of the module and generate their code on <threads> threads (one per hardware
+ *                   thread by default); the output is the same as with one thread.
+ *   --mmap        - Memory-map the source file instead of reading it through stdio.
+ *   --fused       - Check declarations during IR generation instead of in a separate AST walk.
+ *   --emit-ll     - Also write the IR before and after optimization to `<basename>_manual.ll` and `<basename>_manual_opt.ll`.
+ *   --emit-bc     - The same, as LLVM bitcode in `<basename>_manual.bc` and `<basename>_manual_opt.bc`.
+ *   --run         - Run the optimized program with the JIT instead of writing its assembly: call its function with <n> (5, as
+ *                   main.c does, by default), with `read` returning the numbers on stdin, and print what main.c would.
+ *   --run-check   - The same, and also run the program before optimization; fail if the two outputs differ.
+ *   -fprofile-generate - Count the runs of every basic block in the assembly; linked with backend/profile_runtime.c, the program
+ *                   appends the counts to a profile when it exits (see block_profile.h). Not with -filetype=obj or --run.
+ *   -fprofile-use - Guide the block layout, the spill weights and the optimizer's round limits with the counts of a profile
+ *                   (<file>, or minicc.profile by default); the functions that changed since it was recorded are compiled as
+ *                   without it.
+ *   --serve       - Run as a compile server on the Unix domain socket <socket> (see compile_server.h).
+ *   --connect     - Have the compile server on <socket> run the compilation instead of compiling in this process.
+ *   --inline      - With --connect, send the source itself rather than its path, and write the returned assembly here.
+ *   --shutdown    - With --connect, stop the compile server.
+ *   --cache-dir   - Take the artifacts of programs compiled before from the compilation cache in <dir>, and add new ones to
+ *                   it (default: $MINICC_CACHE_DIR; no cache if neither is set).
+ *   --cache-size  - Evict the least recently used cache entries beyond <size>, such as 512K, 64M or 1G (default:
+ *                   $MINICC_CACHE_SIZE, or 64M).
+ *   --cache-stats - Print the hit and miss counters and the size of the cache.
+ *   -ftime-report - Print the wall time, allocations and peak memory of each phase to stderr; -ftime-report=json prints them
+ *                   as JSON.
+ *   -fopt-report  - Print the changes, runs and time of each optimization pass and the rounds of each function to stderr;
+ *                   -fopt-report=json prints them as JSON, with a remark for every change.
+ *
+ * Output: The assembly code is written next to the input file, with the same name but a .s extension (.o for an object).
+ *
+ * Exit codes: 0 on success, 1 for a usage error or an unreadable input, 2 for a syntax error, 3 for a semantic error, 4 if IR
+ * generation fails, 5 if an output file cannot be written, 6 if the JIT cannot run the program and 7 if its output differs
+ * before and after optimization (--run-check).
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "pipeline.h"
+#include "compile_server.h"
+#include "time_report.h"
+#include "opt_report.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+// Size limit of the compilation cache, unless --cache-size or MINICC_CACHE_SIZE says otherwise
+#define DEFAULT_CACHE_SIZE "64M"
+
+/**
+ * @brief Parses a size such as "512K", "64M" or "1G"; a number without a suffix is in megabytes.
+ *
+ * @param size The size to parse.
+ * @return The size in bytes, or 0 if it is not a valid size.
+ */
+static uint64_t parseSize(const char *size)
+{
+    char *suffix;
+    uint64_t value = strtoull(size, &suffix, 10);
+    if (suffix == size || (suffix[0] && suffix[1]))
+    {
+        return 0;
+    }
+    switch (suffix[0] ? suffix[0] : 'M')
+    {
+    case 'K':
+        return value << 10;
+    case 'M':
+        return value << 20;
+    case 'G':
+        return value << 30;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Parses a `--run[=<n>]` or `--run-check[=<n>]` option.
+ *
+ * @param option A command-line argument.
+ * @param run Set to the run the option asks for, if the argument is the option.
+ * @param valid Set to false if the argument is the option but its argument is not a number.
+ * @return true if the argument is the option.
+ */
+static bool parseRunOption(const char *option, jitRequest &run, bool &valid)
+{
+    const char *argument;
+    if (!strncmp(option, "--run-check", 11))
+    {
+        run.compare = true;
+        argument = option + 11;
+    }
+    else if (!strncmp(option, "--run", 5))
+    {
+        run.compare = false;
+        argument = option + 5;
+    }
+    else
+    {
+        return false;
+    }
+    if (argument[0] == '=')
+    {
+        char *end;
+        run.argument = strtol(argument + 1, &end, 10);
+        valid = valid && end != argument + 1 && !*end;
+    }
+    else if (argument[0])
+    {
+        valid = false;
+    }
+    return true;
+}
+
+/**
+ * @brief Prints the contents and the counters of a compilation cache.
+ *
+ * @param cache The compilation cache.
+ */
+static void printCacheStatistics(const CompileCache &cache)
+{
+    cacheStatistics statistics;
+    cache.statistics(statistics);
+    cout << "Cache directory: " << cache.getDirectory() << endl;
+    cout << "Entries: " << statistics["entries"] << " (" << statistics["bytes"] << " of at most " << cache.getMaxBytes()
+         << " bytes)" << endl;
+    cout << "Final artifacts: " << statistics["out_hits"] << " hits, " << statistics["out_misses"] << " misses" << endl;
+    cout << "Optimizer input: " << statistics["ir_hits"] << " hits, " << statistics["ir_misses"] << " misses" << endl;
+    cout << "Evictions: " << statistics["evictions"] << endl;
+}
+
+/**
+ * @brief The entry point of the driver.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv An array of command-line argument strings.
+ * @return An integer representing the exit code of the program.
+ */
+int main(int argc, char **argv)
+{
+    compileRequest request = {NULL, NULL, 0, {false, false, false}, optimizationLevel(2), GRAPH_COLORING_ALLOCATOR, X86_TARGET,
+                              ASSEMBLY_OUTPUT, 1, NULL, NULL, NULL, NULL, {false, NULL}};
+    BlockProfile profile;
+    bool profileOption = false;
+    const char *serveSocket = NULL;
+    const char *connectSocket = NULL;
+    bool inlineSource = false;
+    bool shutdown = false;
+    const char *cacheDirectory = getenv("MINICC_CACHE_DIR");
+    const char *cacheSize = getenv("MINICC_CACHE_SIZE");
+    bool cacheOption = false;
+    bool cacheStatistics = false;
+    bool timeReport = false;
+    bool timeReportJSON = false;
+    bool optReport = false;
+    bool optReportJSON = false;
+    bool optimizationOption = false;
+    bool allocatorOption = false;
+    bool threadsOption = false;
+    jitRequest run = {5, {}, false};
+    bool runOption = false;
+    bool valid = true;
+    for (int i = 1; i < argc && valid; i++)
+    {
+        if (parseOptimizationOption(argv[i], request.optimization, valid))
+        {
+            optimizationOption = true;
+
+            // Release builds (-O2) color the interference graph, debug builds use the faster linear scan
+            if (!allocatorOption && argv[i][1] == 'O')
+            {
+                request.allocator = strcmp(argv[i], "-O2") ? LINEAR_SCAN_ALLOCATOR : GRAPH_COLORING_ALLOCATOR;
+            }
+        }
+        else if (parseRegisterAllocatorOption(argv[i], request.allocator, valid))
+        {
+            optimizationOption = true;
+            allocatorOption = true;
+        }
+        else if (parseTargetOption(argv[i], request.target) || parseOutputFormatOption(argv[i], request.format, valid))
+        {
+            optimizationOption = true;
+        }
+        else if (parseTimeReportOption(argv[i], timeReportJSON))
+        {
+            timeReport = true;
+        }
+        else if (parseOptReportOption(argv[i], optReportJSON))
+        {
+            optReport = true;
+        }
+        else if (!strncmp(argv[i], "-j", 2))
+        {
+            request.numThreads = argv[i][2] ? atoi(argv[i] + 2) : ThreadPool::hardwareThreads();
+            valid = request.numThreads > 0;
+            threadsOption = true;
+        }
+        else if (parseRunOption(argv[i], run, valid))
+        {
+            runOption = true;
+        }
+        else if (parseProfileOption(argv[i], request.profile, profile, valid))
+        {
+            profileOption = true;
+        }
+        else if (!strcmp(argv[i], "--mmap"))
+        {
+            request.options.useMmap = true;
+        }
+        else if (!strcmp(argv[i], "--fused"))
+        {
+            request.options.fused = true;
+        }
+        else if (!strcmp(argv[i], "--emit-ll"))
+        {
+            request.dumpFormat = ".ll";
+        }
+        else if (!strcmp(argv[i], "--emit-bc"))
+        {
+            request.dumpFormat = ".bc";
+        }
+        else if (!strcmp(argv[i], "--serve") && i + 1 < argc)
+        {
+            serveSocket = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--connect") && i + 1 < argc)
+        {
+            connectSocket = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--inline"))
+        {
+            inlineSource = true;
+        }
+        else if (!strcmp(argv[i], "--shutdown"))
+        {
+            shutdown = true;
+        }
+        else if (!strcmp(argv[i], "--cache-dir") && i + 1 < argc)
+        {
+            cacheDirectory = argv[++i];
+            cacheOption = true;
+        }
+        else if (!strcmp(argv[i], "--cache-size") && i + 1 < argc)
+        {
+            cacheSize = argv[++i];
+            cacheOption = true;
+        }
+        else if (!strcmp(argv[i], "--cache-stats"))
+        {
+            cacheStatistics = true;
+        }
+        else if (!request.filename && argv[i][0] != '-')
+        {
+            request.filename = argv[i];
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+
+    // Check the arguments: a server takes nothing but its cache, a client needs --connect for its own options
+    // and leaves the cache to the server, and an inline source has no file for the server to map or to dump next to
+    bool compileOption = request.options.useMmap || request.options.fused || request.dumpFormat || inlineSource ||
+                         optimizationOption;
+    if (timeReport || optReport || threadsOption || runOption || profileOption)
+    {
+        // The reports, the threads, the runs and the profiles cover the compilation of this process only
+        valid = valid && !serveSocket && !connectSocket && !cacheStatistics;
+    }
+    if (request.profile.instrument)
+    {
+        // The counters are only written as assembly, and only a linked program writes its profile
+        valid = valid && request.format == ASSEMBLY_OUTPUT && !runOption;
+    }
+    if (serveSocket)
+    {
+        valid = valid && !request.filename && !connectSocket && !shutdown && !cacheStatistics && !compileOption;
+    }
+    else if (shutdown)
+    {
+        valid = valid && connectSocket && argc == 4;
+    }
+    else if (cacheStatistics)
+    {
+        valid = valid && cacheDirectory && !request.filename && !connectSocket && !compileOption;
+    }
+    else
+    {
+        valid = valid && request.filename && (connectSocket || !inlineSource) &&
+                !(inlineSource && request.dumpFormat) && !(connectSocket && cacheOption);
+    }
+    uint64_t cacheBytes = parseSize(cacheSize ? cacheSize : DEFAULT_CACHE_SIZE);
+    valid = valid && cacheBytes > 0;
+    if (!valid)
+    {
+        cout << "Usage: " << argv[0] << " [-O0|-O1|-O2] [-passes=<list>] [-max-rounds=<n>] [-regalloc=linear|graph] [-m32|-m64]"
+             << " [-filetype=asm|obj] [--cache-dir <dir>] [--cache-size <size>] [-ftime-report[=json]] [-fopt-report[=json]]"
+             << " [-j[<threads>]] [--mmap] [--fused] [--emit-ll | --emit-bc] [--run[=<n>] | --run-check[=<n>]]"
+             << " [-fprofile-generate | -fprofile-use[=<file>]] <filename.c>" << endl;
+        cout << "       " << argv[0] << " --connect <socket> [-O0|-O1|-O2] [-passes=<list>] [-max-rounds=<n>]"
+             << " [-regalloc=linear|graph] [-m32|-m64] [-filetype=asm|obj] [--inline] [--mmap] [--fused] [--emit-ll | --emit-bc] <filename.c>" << endl;
+        cout << "       " << argv[0] << " --serve <socket> [--cache-dir <dir>] [--cache-size <size>]" << endl;
+        cout << "       " << argv[0] << " --connect <socket> --shutdown" << endl;
+        cout << "       " << argv[0] << " --cache-stats [--cache-dir <dir>]" << endl;
+        return 1;
+    }
+
+    if (shutdown)
+    {
+        return shutdownCompileServer(connectSocket);
+    }
+    if (connectSocket)
+    {
+        return runCompileClient(connectSocket, request, inlineSource);
+    }
+
+    CompileCache *cache = NULL;
+    if (cacheDirectory)
+    {
+        cache = new CompileCache(cacheDirectory, cacheBytes);
+        if (!cache->isOpen())
+        {
+            cerr << "Could not create cache directory '" << cacheDirectory << "'; compiling without the cache" << endl;
+        }
+    }
+
+    int exitCode;
+    if (cacheStatistics)
+    {
+        printCacheStatistics(*cache);
+        exitCode = 0;
+    }
+    else if (serveSocket)
+    {
+        exitCode = runCompileServer(serveSocket, cache);
+    }
+    else
+    {
+        LLVMContextRef context = LLVMContextCreate();
+        request.cache = cache;
+        if (runOption)
+        {
+            // The program reads its input from stdin, as it would when linked with main.c
+            readJITInput(cin, run.input);
+            request.run = &run;
+        }
+        exitCode = compileProgram(request, context, NULL, cout);
+        LLVMContextDispose(context);
+        if (optReport)
+        {
+            printOptReport(cerr, optReportJSON);
+        }
+        if (timeReport)
+        {
+            printTimeReport(cerr, timeReportJSON);
+        }
+    }
+    delete cache;
+    return exitCode;
+}
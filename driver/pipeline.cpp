@@ -0,0 +1,397 @@
+/**
+ * @file pipeline.cpp
+ * @brief The in-memory compilation pipeline shared by the minicc command line and its compile server.
+ *
+ * With a compilation cache, a program is looked up twice. The final artifacts (the IR before and after optimization and the
+ * assembly or object) are keyed by the source, the compiler, the optimization options, the register allocator, the target and
+ * the output format; a hit
+ * writes them out and runs no stage at all. The optimizer input (the IR before optimization) is keyed by the source and the
+ * compiler only; a hit there still skips the frontend, and the cached IR is parsed back into a module for the optimizer and
+ * the backend. The name of the source is part of both keys because the artifacts contain it (the module ID and the `.file`
+ * directive, or the file symbol of an object).
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#include "pipeline.h"
+#include "optimizer.h"
+#include "codegen.h"
+#include "file_utils.h"
+#include "jit.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string.h>
+
+using namespace std;
+
+// Identifies the compiler in cache keys. The driver is built from all of its sources in one command, so every rebuild stamps
+// a new time here and never reuses the artifacts of an older build; releases can pass -DMINICC_VERSION instead
+#ifndef MINICC_VERSION
+#define MINICC_VERSION __DATE__ " " __TIME__
+#endif
+
+/**
+ * @brief Writes a dump of the module next to the input file.
+ *
+ * @param module The LLVM module to save.
+ * @param filename The input filename, used as the basis for the dump's name.
+ * @param suffix The suffix appended to the input file's basename.
+ * @param format The extension of the dump, ".ll" for textual IR or ".bc" for bitcode.
+ * @return true if the dump was written.
+ */
+static bool dumpModule(LLVMModuleRef module, const char *filename, const char *suffix, const char *format)
+{
+    std::string dumpFilename;
+    changeFileExtension(filename, dumpFilename, std::string(suffix) + format);
+    return saveLLVMModel(module, dumpFilename.c_str());
+}
+
+/**
+ * @brief Writes `contents` to the file named after the input file with `extension` instead of its own.
+ *
+ * @param filename The input filename.
+ * @param extension The suffix and extension of the file to write.
+ * @param contents The contents of the file.
+ * @return true if the file was written.
+ */
+static bool writeOutputFile(const char *filename, const std::string &extension, const std::string &contents)
+{
+    std::string outName;
+    changeFileExtension(filename, outName, extension);
+    std::ofstream outputFile(outName, std::ios::binary);
+    if (!(outputFile << contents))
+    {
+        cerr << "Could not write file '" << outName << "'" << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the name of the cached artifact of the backend's output.
+ *
+ * @param format The output format.
+ * @return "asm.s" for assembly, "obj.o" for an object.
+ */
+static const char *getOutputArtifact(OutputFormat format)
+{
+    return format == OBJECT_OUTPUT ? "obj.o" : "asm.s";
+}
+
+/**
+ * @brief Returns the textual IR of a module.
+ *
+ * @param module The LLVM module to print.
+ * @return The module as textual LLVM IR.
+ */
+static std::string printModule(LLVMModuleRef module)
+{
+    char *text = LLVMPrintModuleToString(module);
+    std::string ir(text);
+    LLVMDisposeMessage(text);
+    return ir;
+}
+
+/**
+ * @brief Runs the frontend on the program of a request.
+ *
+ * @param request The program to compile.
+ * @param context The LLVM context to create the module in.
+ * @param arena The AST arena to reuse, or NULL.
+ * @param module The module, or NULL if the frontend fails.
+ * @param out The stream for the "Result:" lines.
+ * @return The exit code of the frontend.
+ */
+static int runFrontend(const compileRequest &request, LLVMContextRef context, astArena *arena, LLVMModuleRef *module,
+                       std::ostream &out)
+{
+    if (request.source)
+    {
+        return compileSourceToModule(request.filename, request.source, request.length, request.options, context, module,
+                                     out, arena);
+    }
+    return compileToModule(request.filename, request.options, context, module, out, arena);
+}
+
+/**
+ * @brief Runs a module with the JIT, reporting to stderr if it cannot.
+ *
+ * @param module The module to run; it is left as it is.
+ * @param run The argument and the input of the run.
+ * @param output Receives the output of the run.
+ * @return 0 if the module ran, 6 if it could not be run.
+ */
+static int runWithJIT(LLVMModuleRef module, const jitRequest &run, std::string &output)
+{
+    std::string error;
+    if (!runModule(module, run, output, error))
+    {
+        cerr << "Could not run the program: " << error << endl;
+        return 6;
+    }
+    return 0;
+}
+
+/**
+ * @brief Optimizes a module and generates its assembly, writing the dumps on the way if the request asks for them.
+ *
+ * With a run, the optimized module is run with the JIT and its output printed instead of generating its assembly; a run that
+ * compares also runs the module before optimization, and fails if the two outputs differ.
+ *
+ * @param request The program being compiled.
+ * @param module The module generated by the frontend; it is disposed before returning.
+ * @param out The stream for the "Result:" lines.
+ * @param artifacts If it is not NULL, receives the IR before and after optimization and the assembly (or object), for the cache.
+ * @return The exit code of the compilation.
+ */
+static int optimizeAndGenerateAssembly(const compileRequest &request, LLVMModuleRef module, std::ostream &out,
+                                       cacheArtifacts *artifacts)
+{
+    int exitCode = 0;
+    if (request.dumpFormat && !dumpModule(module, request.filename, "_manual", request.dumpFormat))
+    {
+        exitCode = 5;
+    }
+    if (artifacts)
+    {
+        (*artifacts)["manual.ll"] = printModule(module);
+    }
+
+    std::string outputBefore;
+    if (exitCode == 0 && request.run && request.run->compare)
+    {
+        exitCode = runWithJIT(module, *request.run, outputBefore);
+    }
+
+    // Optimizer: transform the same module in place; at -O0 it leaves the module as it is
+    if (exitCode == 0)
+    {
+        optimizeProgram(module, request.numThreads, request.optimization, request.profile.profile);
+        out << "Result: Optimization successful." << endl;
+
+        if (request.dumpFormat && !dumpModule(module, request.filename, "_manual_opt", request.dumpFormat))
+        {
+            exitCode = 5;
+        }
+        if (artifacts)
+        {
+            (*artifacts)["opt.ll"] = printModule(module);
+        }
+    }
+
+    // JIT: run the optimized module instead of generating its assembly
+    if (exitCode == 0 && request.run)
+    {
+        std::string output;
+        exitCode = runWithJIT(module, *request.run, output);
+        if (exitCode == 0)
+        {
+            out << "Result: Execution successful." << endl;
+            out << output;
+        }
+        if (exitCode == 0 && request.run->compare && output != outputBefore)
+        {
+            cerr << "The output differs before optimization:" << endl
+                 << outputBefore;
+            exitCode = 7;
+        }
+    }
+
+    // Backend: allocate registers and write the assembly (or the object)
+    else if (exitCode == 0)
+    {
+        bool generated;
+        if (artifacts)
+        {
+            // Keep a copy of the output for the cache
+            std::ostringstream assembly;
+            std::string &output = (*artifacts)[getOutputArtifact(request.format)];
+            generated = generateAssemblyCode(module, request.filename, assembly, request.allocator, request.target,
+                                             request.format, request.numThreads, request.profile);
+            output = assembly.str();
+            if (generated && request.assembly)
+            {
+                *request.assembly << output;
+            }
+            else if (generated)
+            {
+                generated = writeOutputFile(request.filename, getOutputExtension(request.format), output);
+            }
+        }
+        else
+        {
+            generated = request.assembly ? generateAssemblyCode(module, request.filename, *request.assembly, request.allocator,
+                                                                request.target, request.format, request.numThreads,
+                                                                request.profile)
+                                         : generateAssemblyCode(module, request.filename, request.allocator, request.target,
+                                                                request.format, request.numThreads, request.profile);
+        }
+
+        if (generated)
+        {
+            out << "Result: Assembly code generation successful." << endl;
+        }
+        else
+        {
+            exitCode = 5;
+        }
+    }
+
+    LLVMDisposeModule(module);
+    return exitCode;
+}
+
+/**
+ * @brief Writes the cached final artifacts of a program as its compilation would have.
+ *
+ * @param request The program being compiled.
+ * @param context The LLVM context, to convert the cached IR when the request asks for bitcode dumps.
+ * @param artifacts The cached artifacts.
+ * @param out The stream for the "Result:" lines.
+ * @return The exit code of the compilation.
+ */
+static int writeCachedArtifacts(const compileRequest &request, LLVMContextRef context, cacheArtifacts &artifacts,
+                                std::ostream &out)
+{
+    out << "Result: Parsing successful." << endl;
+    out << "Result: Semantic analysis successful." << endl;
+    out << "Result: Intermediate Representation (IR) generation successful." << endl;
+
+    const char *dumps[][2] = {{"manual.ll", "_manual"}, {"opt.ll", "_manual_opt"}};
+    for (int i = 0; i < 2; i++)
+    {
+        bool written = true;
+        if (request.dumpFormat && !strcmp(request.dumpFormat, ".ll"))
+        {
+            written = writeOutputFile(request.filename, std::string(dumps[i][1]) + ".ll", artifacts[dumps[i][0]]);
+        }
+        else if (request.dumpFormat)
+        {
+            LLVMModuleRef module = parseLLVMModel(artifacts[dumps[i][0]], request.filename, context);
+            written = module && dumpModule(module, request.filename, dumps[i][1], request.dumpFormat);
+            if (module)
+            {
+                LLVMDisposeModule(module);
+            }
+        }
+        if (!written)
+        {
+            return 5;
+        }
+        if (i == 0)
+        {
+            out << "Result: Optimization successful." << endl;
+        }
+    }
+
+    const std::string &output = artifacts[getOutputArtifact(request.format)];
+    if (request.assembly)
+    {
+        *request.assembly << output;
+    }
+    else if (!writeOutputFile(request.filename, getOutputExtension(request.format), output))
+    {
+        return 5;
+    }
+    out << "Result: Assembly code generation successful." << endl;
+    return 0;
+}
+
+/**
+ * @brief Compiles a program through the compilation cache of its request.
+ *
+ * @param request The program to compile; `request.cache` is set.
+ * @param context The LLVM context to create the module in.
+ * @param arena The AST arena to reuse, or NULL.
+ * @param out The stream for the "Result:" lines.
+ * @return The exit code of the compilation.
+ */
+static int compileWithCache(const compileRequest &request, LLVMContextRef context, astArena *arena, std::ostream &out)
+{
+    // The source bytes are the heart of the key; an unreadable file is left to the frontend to report
+    std::string source;
+    if (request.source)
+    {
+        source.assign(request.source, request.length);
+    }
+    else
+    {
+        std::ifstream file(request.filename, std::ios::binary);
+        if (!file)
+        {
+            LLVMModuleRef module;
+            return runFrontend(request, context, arena, &module, out);
+        }
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        source = contents.str();
+    }
+
+    compileCacheKey irKey;
+    irKey.add(MINICC_VERSION);
+    irKey.add(request.filename);
+    irKey.add(source);
+    compileCacheKey outKey = irKey;
+    outKey.add(formatOptimizationOptions(request.optimization, "-"));
+    outKey.add(getRegisterAllocatorName(request.allocator));
+    outKey.add(getTargetOption(request.target));
+    outKey.add(getOutputFormatName(request.format));
+
+    // Final artifacts: no stage runs at all
+    cacheArtifacts artifacts;
+    if (request.cache->lookup(outKey.value(), "out", artifacts))
+    {
+        return writeCachedArtifacts(request, context, artifacts, out);
+    }
+
+    // Optimizer input: the frontend is skipped
+    LLVMModuleRef module = NULL;
+    if (request.cache->lookup(irKey.value(), "ir", artifacts))
+    {
+        module = parseLLVMModel(artifacts["manual.ll"], request.filename, context);
+        if (module)
+        {
+            out << "Result: Parsing successful." << endl;
+            out << "Result: Semantic analysis successful." << endl;
+            out << "Result: Intermediate Representation (IR) generation successful." << endl;
+        }
+    }
+    if (!module)
+    {
+        int exitCode = runFrontend(request, context, arena, &module, out);
+        if (!module)
+        {
+            return exitCode;
+        }
+        request.cache->store(irKey.value(), "ir", {{"manual.ll", printModule(module)}});
+    }
+
+    int exitCode = optimizeAndGenerateAssembly(request, module, out, &artifacts);
+    if (exitCode == 0)
+    {
+        request.cache->store(outKey.value(), "out", artifacts);
+    }
+    return exitCode;
+}
+
+int compileProgram(const compileRequest &request, LLVMContextRef context, astArena *arena, std::ostream &out)
+{
+    // A run writes no artifacts, so it has nothing to take from the cache or to add to it; a profiled compilation depends on more
+    // than the keys hold
+    if (request.cache && request.cache->isOpen() && !request.run && !request.profile.instrument && !request.profile.profile)
+    {
+        return compileWithCache(request, context, arena, out);
+    }
+
+    // Frontend: parse, check and lower the program into `module`
+    LLVMModuleRef module;
+    int exitCode = runFrontend(request, context, arena, &module, out);
+    if (!module)
+    {
+        return exitCode;
+    }
+    return optimizeAndGenerateAssembly(request, module, out, NULL);
+}
@@ -0,0 +1,68 @@
+/**
+ * @file pipeline.h
+ * @brief The in-memory compilation pipeline shared by the minicc command line and its compile server.
+ *
+ * A compilation runs the frontend, the optimizer and the backend on one LLVM module that stays in memory from IR generation to
+ * assembly. The caller provides the LLVM context and, optionally, the AST arena, so that a long-running process can reuse both
+ * for every compilation instead of creating them again each time.
+ *
+ * @author Aimen Abdulaziz
+ * @date Spring 2023
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "codegen.h"
+#include "compilation.h"
+#include "compile_cache.h"
+#include "jit.h"
+#include "optimizer.h"
+#include "register_allocation.h"
+#include <llvm-c/Core.h>
+#include <ostream>
+
+/**
+ * @brief One compilation of the driver.
+ *
+ * The source is read from `filename` unless `source` is set, in which case the `length` bytes at `source` are compiled and
+ * `filename` only names them. The assembly is written to `assembly` if it is set, and to `<basename>.s` next to `filename`
+ * otherwise; with the object format, the object is written in its place, to `<basename>.o`. With a `cache`, the artifacts of a program that was compiled before are taken from it instead of being compiled
+ * again. With a `run`, no assembly is generated: the optimized module is run with the JIT (see jit.h) and its output printed.
+ * The `profile` instruments the assembly to count the runs of its basic blocks, or guides the optimizer and the backend with the
+ * counts of earlier runs (see block_profile.h); the cache is not used then, as the counts are not part of its keys.
+ */
+typedef struct
+{
+    const char *filename;     // the MiniC source file, or the name of the in-memory source
+    const char *source;       // the in-memory source, or NULL to read the file
+    size_t length;            // the length of the in-memory source
+    compileOptions options;   // the frontend options
+    OptimizationOptions optimization; // the passes and round limit of the optimizer
+    RegisterAllocator allocator;      // the register allocator of the backend
+    Target target;                    // the target of the backend: 32-bit x86 or x86-64
+    OutputFormat format;              // what the backend writes: assembly, or a relocatable object
+    unsigned numThreads;              // the threads the optimizer and the backend share the functions of the module between
+    const char *dumpFormat;   // the extension (".ll" or ".bc") of the IR dumps to write, or NULL for none
+    std::ostream *assembly;   // the stream to write the assembly to, or NULL for the .s file
+    CompileCache *cache;      // the compilation cache, or NULL to always compile
+    const jitRequest *run;    // the run of the optimized module with the JIT, instead of its assembly, or NULL
+    ProfileOptions profile;   // the profile-guided compilation: -fprofile-generate or -fprofile-use
+} compileRequest;
+
+/**
+ * @brief Compiles one MiniC program to assembly (or an object) with the module kept in memory between the stages.
+ *
+ * Each stage reports its "Result:" line to `out`.
+ *
+ * @param request The program to compile and where to write its assembly.
+ * @param context The LLVM context to create the module in. The module is disposed before returning.
+ * @param arena The AST arena to reuse, or NULL to give the compilation an arena of its own.
+ * @param out The stream for the stages' "Result:" lines.
+ * @return The exit code of the compilation: 0 on success, 1 for an unreadable input, 2 for a syntax error, 3 for a semantic
+ *         error, 4 if IR generation fails, 5 if an output cannot be written, 6 if the JIT cannot run the program and 7 if its
+ *         output differs before and after optimization.
+ */
+int compileProgram(const compileRequest &request, LLVMContextRef context, astArena *arena, std::ostream &out);
+
+#endif // PIPELINE_H
@@ -0,0 +1,315 @@
+#!/bin/bash
+#
+# MiniC driver testing script
+#
+# Compiles every program in tests/backend with minicc, links the assembly with
+# main.c, and compares the output of the executable with the output of the same
+# program compiled by clang. The IR dumps of --emit-ll must match the files the
+# three-executable pipeline writes, except for the module name.
+#
+# usage: ./testing.sh or make test (strongly recommended)
+#
+# Author: Aimen Abdulaziz
+# Date: Spring 2023
+
+# Makefile for compiling the code
+make
+
+# Define the directory containing the test files
+dir=../tests/backend
+
+# Define ANSI escape codes for colors
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m' # No Color
+
+# Compiles p10 and p12 with the minicc flags in $1, links each with main.c using the clang
+# flags in $2, and compares its output with the program compiled by clang. Sets failed=1 if
+# minicc fails or an output differs.
+compareWithClang() {
+    local output=s
+    [[ "$1" == *-filetype=obj* ]] && output=o
+    for base in p10 p12; do
+        ./minicc $1 $dir/"$base".c > /dev/null || failed=1
+        clang $dir/main.c $dir/"$base".$output $2 -o $dir/"$base".out
+        clang $dir/main.c $dir/"$base".c -o $dir/"$base".expected
+        input=$(shuf -i 1-1000 -n 1)
+        [ "$(echo "$input" | "./$dir/$base.out")" == "$(echo "$input" | "./$dir/$base.expected")" ] || failed=1
+        rm -f $dir/"$base".$output $dir/"$base".out $dir/"$base".expected
+    done
+}
+
+for file in `ls "$dir"/*.c | grep -v main.c`; do
+    # Extract the base name of the file without the .c extension
+    base=$(basename "$file" .c)
+
+    echo "Testing $file"
+
+    # Compile the program to assembly in one process
+    ./minicc "$file"
+    if [ $? -ne 0 ]; then
+        echo -e "${RED}Test failed: $base.c${NC}"
+        continue
+    fi
+
+    # Compile main.c and the generated assembly code into an executable
+    clang $dir/main.c $dir/"$base".s -m32 -o $dir/"$base".out
+
+    # Compile main.c and file into an executable. This will be used as the expected output.
+    clang $dir/main.c "$file" -o $dir/"$base".expected
+
+    # Pass a random integer as input to both executables and compare their outputs
+    input=$(shuf -i 1-1000 -n 1)
+    expected=$(echo "$input" | "./$dir/$base.expected")
+    output=$(echo "$input" | "./$dir/$base.out")
+    if [ "$output" != "$expected" ]; then
+        echo -e "${RED}Test failed: $base (input $input)${NC}"
+    else
+        echo -e "${GREEN}Test passed: $base${NC}"
+    fi
+
+    rm -f $dir/"$base".s $dir/"$base".out $dir/"$base".expected
+    echo "----------------------------------------"
+done
+
+# The in-memory pipeline must produce the same IR as the three executables
+file="$dir"/p1.c
+echo "Testing --emit-ll on $file"
+(cd ../frontend && make) > /dev/null && (cd ../optimization && make) > /dev/null
+mkdir -p dumps && cp "$file" dumps/
+../frontend/frontend "$file" > /dev/null && ../optimization/optimizer "$dir"/p1_manual.ll > /dev/null
+./minicc --emit-ll dumps/p1.c > /dev/null
+if diff <(tail -n +3 "$dir"/p1_manual.ll) <(tail -n +3 dumps/p1_manual.ll) > /dev/null &&
+   diff <(tail -n +3 "$dir"/p1_manual_opt.ll) <(tail -n +3 dumps/p1_manual_opt.ll) > /dev/null; then
+    echo -e "${GREEN}Test passed: --emit-ll${NC}"
+else
+    echo -e "${RED}Test failed: --emit-ll${NC}"
+fi
+rm -rf dumps "$dir"/p1_manual.ll "$dir"/p1_manual_opt.ll
+echo "----------------------------------------"
+
+# The compile server must produce the same assembly as a local compilation
+echo "Testing the compile server"
+socket=$(mktemp -u /tmp/minicc.XXXXXX.sock)
+./minicc --serve "$socket" > /dev/null &
+while [ ! -S "$socket" ]; do sleep 0.1; done
+failed=0
+for file in `ls "$dir"/*.c | grep -v main.c`; do
+    base=$(basename "$file" .c)
+    ./minicc "$file" > /dev/null && mv $dir/"$base".s $dir/"$base".local.s
+    ./minicc --connect "$socket" "$file" > /dev/null && cmp -s $dir/"$base".s $dir/"$base".local.s || failed=1
+    ./minicc --connect "$socket" --inline "$file" > /dev/null && cmp -s $dir/"$base".s $dir/"$base".local.s || failed=1
+    rm -f $dir/"$base".s $dir/"$base".local.s
+done
+# A broken program gets the exit code of a local compilation
+for file in ../tests/semantic_analysis/*.c; do
+    ./minicc --connect "$socket" "$file" > /dev/null
+    [ $? -eq 3 ] || failed=1
+done
+./minicc --connect "$socket" --shutdown > /dev/null
+wait
+if [ $failed -eq 0 ] && [ ! -e "$socket" ]; then
+    echo -e "${GREEN}Test passed: compile server${NC}"
+else
+    echo -e "${RED}Test failed: compile server${NC}"
+fi
+echo "----------------------------------------"
+
+# A compilation cache hit must write the same files as the compilation it replaces
+echo "Testing the compilation cache"
+cache=$(mktemp -d /tmp/minicc-cache.XXXXXX)
+failed=0
+count=0
+for file in `ls "$dir"/*.c | grep -v main.c`; do
+    base=$(basename "$file" .c)
+    ./minicc --emit-ll "$file" > /dev/null
+    for output in .s _manual.ll _manual_opt.ll; do mv $dir/"$base"$output $dir/"$base".local$output; done
+    for run in miss hit; do
+        ./minicc --cache-dir "$cache" --emit-ll "$file" > /dev/null || failed=1
+        for output in .s _manual.ll _manual_opt.ll; do
+            cmp -s $dir/"$base"$output $dir/"$base".local$output || failed=1
+        done
+    done
+    rm -f $dir/"$base".s $dir/"$base"_manual*.ll $dir/"$base".local*
+    count=$((count + 1))
+done
+./minicc --cache-stats --cache-dir "$cache" | grep -q "Final artifacts: $count hits, $count misses" || failed=1
+rm -rf "$cache"
+if [ $failed -eq 0 ]; then
+    echo -e "${GREEN}Test passed: compilation cache${NC}"
+else
+    echo -e "${RED}Test failed: compilation cache${NC}"
+fi
+echo "----------------------------------------"
+
+# -ftime-report must cover every phase of the pipeline
+echo "Testing -ftime-report"
+file="$dir"/p1.c
+report=$(./minicc -ftime-report=json "$file" 2>&1 > /dev/null)
+failed=0
+for phase in "Lexing and parsing" "Semantic analysis" "IR generation" "Constant propagation" "Constant folding" \
+             "Common subexpression elimination" "Dead code elimination" "Register allocation" "Block layout" "Instruction selection" \
+             "Peephole optimization" "Assembly emission"; do
+    echo "$report" | grep -q "\"name\": \"$phase\"" || failed=1
+done
+if [ $failed -eq 0 ]; then
+    echo -e "${GREEN}Test passed: -ftime-report${NC}"
+else
+    echo -e "${RED}Test failed: -ftime-report${NC}"
+fi
+rm -f $dir/p1.s
+echo "----------------------------------------"
+
+# -fopt-report must cover every pass, and tie its remarks to the function
+echo "Testing -fopt-report"
+file="$dir"/p10.c
+report=$(./minicc -fopt-report=json "$file" 2>&1 > /dev/null)
+failed=0
+for pass in "SSA construction" "Constant propagation" "Loop-invariant code motion" "Constant folding" \
+            "Common subexpression elimination" "Dead code elimination" "CFG simplification"; do
+    echo "$report" | grep -q "\"name\": \"$pass\"" || failed=1
+done
+echo "$report" | grep -q "\"name\": \"func\"" || failed=1
+echo "$report" | grep -q "\"change\": \"instructions hoisted\", \"block\": " || failed=1
+if [ $failed -eq 0 ]; then
+    echo -e "${GREEN}Test passed: -fopt-report${NC}"
+else
+    echo -e "${RED}Test failed: -fopt-report${NC}"
+fi
+rm -f $dir/p10.s
+echo "----------------------------------------"
+
+# Every optimization level must compile programs that still compute the same results
+echo "Testing -O0 and -O1"
+failed=0
+for level in -O0 -O1; do
+    compareWithClang $level -m32
+done
+if [ $failed -eq 0 ]; then
+    echo -e "${GREEN}Test passed: -O0 and -O1${NC}"
+else
+    echo -e "${RED}Test failed: -O0 and -O1${NC}"
+fi
+echo "----------------------------------------"
+
+# Deeply nested input at -O2: SSA renaming and value numbering walk the dominator tree without
+# recursing, and the loop passes visit each block of a loop nest once, so this must pass with a
+# small stack and in about linear time
+deep=deep_nesting.c
+{
+    printf 'extern void print(int);\nextern int read();\nint func(int a){\nint b;\nb = 0;\n'
+    for i in `seq 20000`; do printf 'if (a > 0) {\nwhile (b < 0) {\n'; done
+    printf 'b = b + 1;\n'
+    for i in `seq 20000`; do printf '}\n}\n'; done
+    printf 'print(b);\nreturn b;\n}\n'
+} > "$deep"
+echo "Testing $deep at -O2 (40000 nested statements, 1 MB stack)"
+(ulimit -s 1024; ./minicc -O2 "$deep" > /dev/null)
+if [ $? -eq 0 ]; then
+    echo -e "${GREEN}Test passed: $deep${NC}"
+else
+    echo -e "${RED}Test failed: $deep${NC}"
+fi
+rm -f "$deep" deep_nesting.s
+echo "----------------------------------------"
+
+echo "Testing -regalloc"
+failed=0
+for allocator in linear graph; do
+    compareWithClang -regalloc=$allocator -m32
+done
+./minicc -regalloc=bogus $dir/p10.c > /dev/null 2>&1 && failed=1
+if [ $failed -eq 0 ]; then
+    echo -e "${GREEN}Test passed: -regalloc${NC}"
+else
+    echo -e "${RED}Test failed: -regalloc${NC}"
+fi
+echo "----------------------------------------"
+
+echo "Testing -m64"
+failed=0
+compareWithClang -m64 ""
+if [ $failed -eq 0 ]; then
+    echo -e "${GREEN}Test passed: -m64${NC}"
+else
+    echo -e "${RED}Test failed: -m64${NC}"
+fi
+echo "----------------------------------------"
+
+# The objects of -filetype=obj link without the assembler, on both targets
+echo "Testing -filetype=obj"
+failed=0
+for target in -m32 -m64; do
+    compareWithClang "$target -filetype=obj" $target
+done
+./minicc -filetype=bogus $dir/p10.c > /dev/null 2>&1 && failed=1
+if [ $failed -eq 0 ]; then
+    echo -e "${GREEN}Test passed: -filetype=obj${NC}"
+else
+    echo -e "${RED}Test failed: -filetype=obj${NC}"
+fi
+echo "----------------------------------------"
+
+# Generating the functions on several threads must write the same files as one thread
+echo "Testing -j"
+failed=0
+for file in `ls "$dir"/*.c | grep -v main.c`; do
+    base=$(basename "$file" .c)
+    ./minicc "$file" > /dev/null && mv $dir/"$base".s $dir/"$base".serial.s
+    ./minicc -j4 "$file" > /dev/null && cmp -s $dir/"$base".s $dir/"$base".serial.s || failed=1
+    rm -f $dir/"$base".s $dir/"$base".serial.s
+done
+./minicc -j0 $dir/p10.c > /dev/null 2>&1 && failed=1
+if [ $failed -eq 0 ]; then
+    echo -e "${GREEN}Test passed: -j${NC}"
+else
+    echo -e "${RED}Test failed: -j${NC}"
+fi
+echo "----------------------------------------"
+
+# The JIT must print what the program linked with main.c prints, before and after optimization
+echo "Testing --run"
+failed=0
+for file in `ls "$dir"/*.c | grep -v main.c`; do
+    base=$(basename "$file" .c)
+    clang $dir/main.c "$file" -o $dir/"$base".expected
+    # Enough numbers for every read, since main.c's read returns garbage once the input runs out
+    input=$(shuf -i 1-1000 -n 100 -r)
+    [ "$(echo "$input" | ./minicc --run-check "$file" | grep -v '^Result:')" == "$(echo "$input" | "./$dir/$base.expected")" ] || failed=1
+    rm -f $dir/"$base".expected
+done
+./minicc --run=bogus $dir/p10.c > /dev/null 2>&1 && failed=1
+if [ $failed -eq 0 ]; then
+    echo -e "${GREEN}Test passed: --run${NC}"
+else
+    echo -e "${RED}Test failed: --run${NC}"
+fi
+echo "----------------------------------------"
+
+# An instrumented program must write a profile of its runs, and the profile must compile a program that computes the same
+echo "Testing -fprofile-generate and -fprofile-use"
+failed=0
+for target in -m32 -m64; do
+    # The counters are absolute addresses on x86
+    link=$([ $target == -m32 ] && echo "-m32 -no-pie")
+    rm -f $dir/p10.profile
+    clang $dir/main.c $dir/p10.c -o $dir/p10.expected
+    input=$(shuf -i 1-1000 -n 100 -r)
+    expected=$(echo "$input" | "./$dir/p10.expected")
+    ./minicc $target -fprofile-generate $dir/p10.c > /dev/null || failed=1
+    clang $dir/main.c $dir/p10.s ../backend/profile_runtime.c $link -o $dir/p10.out || failed=1
+    [ "$(echo "$input" | MINICC_PROFILE_FILE=$dir/p10.profile "./$dir/p10.out")" == "$expected" ] || failed=1
+    grep -q "^function func " $dir/p10.profile || failed=1
+    ./minicc $target -fprofile-use=$dir/p10.profile $dir/p10.c > /dev/null || failed=1
+    clang $dir/main.c $dir/p10.s $target -o $dir/p10.out || failed=1
+    [ "$(echo "$input" | "./$dir/p10.out")" == "$expected" ] || failed=1
+    rm -f $dir/p10.s $dir/p10.out $dir/p10.expected $dir/p10.profile
+done
+./minicc -fprofile-generate -filetype=obj $dir/p10.c > /dev/null 2>&1 && failed=1
+./minicc -fprofile-use=$dir/missing.profile $dir/p10.c > /dev/null 2>&1 && failed=1
+if [ $failed -eq 0 ]; then
+    echo -e "${GREEN}Test passed: -fprofile-generate and -fprofile-use${NC}"
+else
+    echo -e "${RED}Test failed: -fprofile-generate and -fprofile-use${NC}"
+fi
+echo "----------------------------------------"
@@ -1,4 +1,5 @@
 #include"ast.h"
+#include"ast_tape.h"
 #include<stdio.h>
 #include<stdlib.h>
 #include<assert.h>
@@ -13,10 +14,129 @@ char * get_indent_str(int n){
 	return ret;
 }
 
+/* Every chunk starts with a header linking it to the previously filled chunk */
+typedef struct ast_ArenaChunk {
+	struct ast_ArenaChunk *prev;
+	size_t size; // usable bytes after the header
+} astArenaChunk;
+
+struct ast_Arena {
+	astArenaChunk *chunk; // chunk currently being filled
+	size_t used;          // bytes handed out from the current chunk
+	size_t chunkSize;
+	vector<vector<astNode*>*> stmtLists; // lists owned through createBlock
+};
+
+static const size_t ARENA_ALIGN = alignof(max_align_t);
+static const size_t CHUNK_HEADER = (sizeof(astArenaChunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+// Each thread parses one file at a time into its own active arena
+static thread_local astArena *activeArena = NULL;
+
+static void arenaGrow(astArena *arena, size_t minSize){
+	size_t size = minSize > arena->chunkSize ? minSize : arena->chunkSize;
+	astArenaChunk *chunk = (astArenaChunk *)malloc(CHUNK_HEADER + size);
+	if (chunk == NULL){
+		fprintf(stderr,"Out of memory in AST arena\n");
+		exit(1);
+	}
+	chunk->prev = arena->chunk;
+	chunk->size = size;
+	arena->chunk = chunk;
+	arena->used = 0;
+}
+
+/* create and free functions for the AST arena */
+astArena* createArena(size_t chunkSize){
+	astArena *arena = new astArena();
+	arena->chunk = NULL;
+	arena->used = 0;
+	arena->chunkSize = chunkSize;
+	arenaGrow(arena, chunkSize);
+	return arena;
+}
+
+void freeArena(astArena *arena){
+	if (arena == NULL)
+		return;
+	if (activeArena == arena)
+		activeArena = NULL;
+
+	for (auto list : arena->stmtLists)
+		delete list;
+
+	astArenaChunk *chunk = arena->chunk;
+	while (chunk != NULL){
+		astArenaChunk *prev = chunk->prev;
+		free(chunk);
+		chunk = prev;
+	}
+	delete arena;
+}
+
+void resetArena(astArena *arena){
+	for (auto list : arena->stmtLists)
+		delete list;
+	arena->stmtLists.clear();
+
+	// Keep the current chunk for the next session and release the older ones
+	astArenaChunk *chunk = arena->chunk->prev;
+	while (chunk != NULL){
+		astArenaChunk *prev = chunk->prev;
+		free(chunk);
+		chunk = prev;
+	}
+	arena->chunk->prev = NULL;
+	arena->used = 0;
+}
+
+void setActiveArena(astArena *arena){
+	activeArena = arena;
+}
+
+astArena* getActiveArena(){
+	return activeArena;
+}
+
+/* Bump-allocate zeroed memory; falls back to a fresh chunk when the current one is full */
+void* arenaAlloc(astArena *arena, size_t size){
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	if (arena->used + size > arena->chunk->size)
+		arenaGrow(arena, size);
+
+	char *mem = (char *)arena->chunk + CHUNK_HEADER + arena->used;
+	arena->used += size;
+	memset(mem, 0, size);
+	return mem;
+}
+
+char* copyString(const char *str){
+	size_t len = strlen(str) + 1;
+	char *copy = activeArena ? (char *)arenaAlloc(activeArena, len) : (char *)malloc(len);
+	memcpy(copy, str, len);
+	return copy;
+}
+
+void freeString(char *str){
+	if (activeArena == NULL)
+		free(str);
+}
+
+static astNode* allocNode(){
+	if (activeArena != NULL)
+		return (astNode *)arenaAlloc(activeArena, sizeof(astNode));
+	return (astNode *)calloc(1, sizeof(astNode));
+}
+
+static void releaseNode(astNode *node){
+	if (activeArena == NULL)
+		free(node);
+}
+
 /* create and free functions for ast_prog type astNode */
 astNode* createProg(astNode *ext1, astNode	*ext2, astNode	*func){
 	astNode	*node;
-	node = (astNode *)calloc(1, sizeof(astNode));
+	node = allocNode();
 	node->type = ast_prog;
 
 	node->prog.ext1 = ext1;
@@ -32,18 +152,17 @@ void freeProg(astNode *node){
 	freeExtern(node->prog.ext1);
 	freeExtern(node->prog.ext2);
 	freeFunc(node->prog.func);
-	free(node);
+	releaseNode(node);
 	return;
 }
 
 /*create and free functions for ast_func type astNode */
 astNode* createFunc(const char *name, astNode *param, astNode* body){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = allocNode();
 	node->type = ast_func;
 
-	node->func.name = (char *) calloc(1, sizeof(char) * (strlen(name)+1));
-	strcpy(node->func.name, name);
+	node->func.name = copyString(name);
 
 	node->func.param = param;
 	node->func.body = body;
@@ -54,13 +173,13 @@ astNode* createFunc(const char *name, astNode *param, astNode* body){
 void freeFunc(astNode *node){
 	assert(node != NULL && node->type == ast_func);
 	
-	free(node->func.name);
+	freeString(node->func.name);
 	if (node->func.param != NULL)
 		freeVar(node->func.param);
 
 	freeBlock(node->func.body);
 	
-	free(node);
+	releaseNode(node);
 	
 	return;
 }
@@ -69,11 +188,10 @@ void freeFunc(astNode *node){
 
 astNode* createExtern(const char *name){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = allocNode();
 	node->type = ast_extern;
 	
-	node->ext.name = (char *) calloc(1, sizeof(char) * (strlen(name)+1));
-	strcpy(node->ext.name, name);
+	node->ext.name = copyString(name);
 
 	return(node);
 }
@@ -81,30 +199,32 @@ astNode* createExtern(const char *name){
 void freeExtern(astNode *node){
 	assert(node != NULL && node->type == ast_extern);
 	
-	free(node->ext.name);
-	free(node);
+	freeString(node->ext.name);
+	releaseNode(node);
 
 	return;
 }
 
 /*create and free functions for ast_var*/
 
-astNode* createVar(const char *name){
+astNode* createVar(SymbolId symbol){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = allocNode();
 	node->type = ast_var;
 	
-	node->var.name = (char *) calloc(1, sizeof(char) * (strlen(name)+1));
-	strcpy(node->var.name, name);
+	node->var.symbol = symbol;
 	
 	return(node);
 }
 
+astNode* createVar(const char *name){
+	return createVar(internSymbol(name));
+}
+
 void freeVar(astNode *node){
 	assert(node != NULL && node->type == ast_var);
 	
-	free(node->var.name);
-	free(node);
+	releaseNode(node);
 
 	return;
 }
@@ -112,7 +232,7 @@ void freeVar(astNode *node){
 /*create and free functions for ast_cnst type of node*/
 astNode* createCnst(int value){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = allocNode();
 	node->type = ast_cnst;
 
 	node->cnst.value = value;
@@ -121,7 +241,7 @@ astNode* createCnst(int value){
 
 void freeCnst(astNode *node){
 	assert(node != NULL);
-	free(node);
+	releaseNode(node);
 
 	return;
 }
@@ -129,7 +249,7 @@ void freeCnst(astNode *node){
 /*create and free functions for ast_rexpr type of node*/
 astNode* createRExpr(astNode *lhs, astNode *rhs, rop_type op){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = allocNode();
 	node->type = ast_rexpr;
 	
 	node->rexpr.lhs = lhs;
@@ -145,7 +265,7 @@ void freeRExpr(astNode *node){
 	// We call freeNode as we don't know the type of nodes for lhs and rhs
 	freeNode(node->rexpr.lhs);
 	freeNode(node->rexpr.rhs);
-	free(node);
+	releaseNode(node);
 
 	return;
 }
@@ -154,7 +274,7 @@ void freeRExpr(astNode *node){
 /*create and free functions for ast_bexpr type of node*/
 astNode* createBExpr(astNode *lhs, astNode *rhs, op_type op){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = allocNode();
 	node->type = ast_bexpr;
 	
 	node->bexpr.lhs = lhs;
@@ -171,7 +291,7 @@ void freeBExpr(astNode *node){
 	freeNode(node->bexpr.lhs);
 	freeNode(node->bexpr.rhs);
 
-	free(node);
+	releaseNode(node);
 
 	return;
 }
@@ -179,7 +299,7 @@ void freeBExpr(astNode *node){
 /* create and free functions for ast_uexpr type of node */
 astNode* createUExpr(astNode *expr, op_type op){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = allocNode();
 	node->type = ast_uexpr;
 	
 	node->uexpr.expr = expr;
@@ -192,42 +312,44 @@ void freeUExpr(astNode *node){
 	assert(node != NULL && node->type == ast_uexpr);
 	
 	freeNode(node->uexpr.expr);
-	free(node);
+	releaseNode(node);
 
 	return;
 }
 
 /* create and free functions for a statement of type ast_call */
-astNode* createCall(const char *name, astNode *param){
+astNode* createCall(SymbolId symbol, astNode *param){
 	astNode *node;
-	node = (astNode*) calloc(1, sizeof(astNode));
+	node = allocNode();
 	node->type = ast_stmt;
 	node->stmt.type = ast_call;
 	
-	node->stmt.call.name = (char *) calloc(strlen(name) + 1, sizeof(char));
-	strcpy(node->stmt.call.name, name);
+	node->stmt.call.symbol = symbol;
 	
 	node->stmt.call.param = param;
 
 	return node;
 }
 
+astNode* createCall(const char *name, astNode *param){
+	return createCall(internSymbol(name), param);
+}
+
 void freeCall(astNode *node){
 	assert(node != NULL && node->type == ast_stmt);
 	assert(node->stmt.type == ast_call);
 	
-	free(node->stmt.call.name);
 	if (node->stmt.call.param != NULL)
 		freeNode(node->stmt.call.param);
 
-	free(node);
+	releaseNode(node);
 	return;
 }
 
 /*create and free functions for a stmt of type ast_ret*/
 astNode* createRet(astNode	*expr){
 	astNode *node;
-	node = (astNode*) calloc(1, sizeof(astNode));
+	node = allocNode();
 	node->type = ast_stmt;
 	node->stmt.type = ast_ret;
 	
@@ -240,18 +362,19 @@ void freeRet(astNode *node){
 	assert(node->stmt.type == ast_ret);
 
 	freeNode(node->stmt.ret.expr);
-	free(node);
+	releaseNode(node);
 	return;
 }
 
 /*create and free functions for a stmt of type ast_block*/
 astNode* createBlock(vector<astNode*> *stmt_list){
-	vector<astNode*> slist;
-	astNode* node = (astNode *)calloc(1, sizeof(astNode));
+	astNode* node = allocNode();
 	node->type = ast_stmt;
 	node->stmt.type = ast_block;
 	
 	node->stmt.block.stmt_list = stmt_list;
+	if (activeArena != NULL)
+		activeArena->stmtLists.push_back(stmt_list);
 	
 	return(node);
 }
@@ -268,14 +391,15 @@ void freeBlock(astNode *node){
 		it++;	
 	}
 	
-	delete(node->stmt.block.stmt_list);
-	free(node);
+	if (activeArena == NULL)
+		delete(node->stmt.block.stmt_list);
+	releaseNode(node);
 	return;
 }
 
 /* create and free functions for stmt of type while*/
 astNode* createWhile(astNode *cond, astNode *body){
-	astNode* node = (astNode *)calloc(1, sizeof(astNode));
+	astNode* node = allocNode();
 	node->type = ast_stmt;
 	node->stmt.type = ast_while;
 	
@@ -292,13 +416,13 @@ void freeWhile(astNode *node){
 	freeNode(node->stmt.whilen.cond);
 	freeNode(node->stmt.whilen.body);
 	
-	free(node);
+	releaseNode(node);
 	return;
 }
 
 /*create and free functions for stmt of type if*/
 astNode* createIf(astNode *cond, astNode *ifbody, astNode *elsebody){
-	astNode* node = (astNode *)calloc(1, sizeof(astNode));
+	astNode* node = allocNode();
 	node->type = ast_stmt;
 	node->stmt.type = ast_if;
 
@@ -318,34 +442,36 @@ void freeIf(astNode *node){
 	if (node->stmt.ifn.else_body != NULL)
 		freeNode(node->stmt.ifn.else_body);
 
-	free(node);	
+	releaseNode(node);	
 
 	return;
 }
 
 /* create and free functions of stmt type ast_decl */
-astNode* createDecl(const char *name){
-	astNode* node = (astNode *)calloc(1, sizeof(astNode));
+astNode* createDecl(SymbolId symbol){
+	astNode* node = allocNode();
 	node->type = ast_stmt;
 	node->stmt.type = ast_decl;
 
-	node->stmt.decl.name = (char *)calloc(strlen(name)+1, sizeof(char));
-	strcpy(node->stmt.decl.name, name);
+	node->stmt.decl.symbol = symbol;
 
 	return(node);
 }
 
+astNode* createDecl(const char *name){
+	return createDecl(internSymbol(name));
+}
+
 void freeDecl(astNode *node){
 	assert(node != NULL && node->type == ast_stmt);
 	assert(node->stmt.type == ast_decl);
 	
-	free(node->stmt.decl.name);
-	free(node);
+	releaseNode(node);
 }
 
 /* create and free functions of stmt type ast_assign */
 astNode* createAsgn(astNode *lhs, astNode *rhs){
-	astNode* node = (astNode *)calloc(1, sizeof(astNode));
+	astNode* node = allocNode();
 	node->type = ast_stmt;
 	node->stmt.type = ast_asgn;
 
@@ -361,59 +487,42 @@ void freeAsgn(astNode *node){
 	
 	freeVar(node->stmt.asgn.lhs);
 	freeNode(node->stmt.asgn.rhs);
-	free(node);
+	releaseNode(node);
 
 	return;
 }
 
-/* free function for releasing all the memory assigned to a node based
-on the type. This function is called by other free* functions when
-the type of a child node is not obvious from the context */
+/* releases what a single node owns (its name or statement list, and the
+node itself) without touching its children */
+static void releaseNodeStorage(astNode *node){
+	if (node->type == ast_func)
+		freeString(node->func.name);
+	else if (node->type == ast_extern)
+		freeString(node->ext.name);
+	else if (node->type == ast_stmt && node->stmt.type == ast_block)
+		delete(node->stmt.block.stmt_list);
+	releaseNode(node);
+}
+
+/* free function for releasing all the memory assigned to a node and its
+subtree. This function is called by other free* functions when the type
+of a child node is not obvious from the context. It walks the subtree with
+an explicit stack instead of recursing, so arbitrarily deep nesting is safe */
 
 void freeNode(astNode *node){
 	assert(node != NULL);
 
-	switch(node->type){
-		case ast_prog:{
-						freeProg(node);
-						break;
-					  }
-		case ast_func:{
-						freeFunc(node);
-						break;
-					  }
-		case ast_stmt:{
-						freeStmt(node);
-						break;
-					  }
-		case ast_extern:{
-						freeExtern(node);
-						break;
-					  }
-		case ast_var: {	
-						freeVar(node);
-						break;
-					  }
-		case ast_cnst: {
-						 freeCnst(node);
-						 break;
-					  }
-		case ast_rexpr: {
-						freeRExpr(node);
-						break;
-					  }
-		case ast_bexpr: {
-						freeBExpr(node);
-						break;
-					  }
-		case ast_uexpr: {
-						freeUExpr(node);
-						break;
-					  }
-		default: {
-					fprintf(stderr,"Incorrect node type\n");
-				 	exit(1);
-				 }
+	// Nodes in an arena are only released all at once by freeArena
+	if (activeArena != NULL)
+		return;
+
+	// A node's last visit comes after all of its children have been released,
+	// and the walker no longer refers to it, so it can be released right away
+	astWalker walker(node);
+	astVisit visit;
+	while (walker.next(visit)){
+		if (isExit(visit))
+			releaseNodeStorage(visit.node);
 	}
 }
 
@@ -480,7 +589,7 @@ void printNode(astNode *node, int n){
 						break;
 					  }
 		case ast_var: {	
-						printf("%sVar: %s\n", indent, node->var.name);
+						printf("%sVar: %s\n", indent, symbolName(node->var.symbol));
 						break;
 					  }
 		case ast_cnst: {
@@ -518,7 +627,7 @@ void printStmt(astStmt *stmt, int n){
 
 	switch(stmt->type){
 		case ast_call: { 
-							printf("%sCall: name %s\n", indent, stmt->call.name);
+							printf("%sCall: name %s\n", indent, symbolName(stmt->call.symbol));
 							if (stmt->call.param != NULL){
 								printf("%sCall: param\n", indent);
 								printNode(stmt->call.param, n+1);
@@ -567,7 +676,7 @@ void printStmt(astStmt *stmt, int n){
 							break;
 						}
 		case ast_decl:	{
-							printf("%sDecl: %s\n", indent, stmt->decl.name);
+							printf("%sDecl: %s\n", indent, symbolName(stmt->decl.symbol));
 							break;
 						}
 		default: {
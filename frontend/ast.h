@@ -3,16 +3,18 @@
 
 #include <cstddef>
 #include <vector>
+#include "symbol_table.h"
 using namespace std;
 
 struct ast_Node;
 typedef struct ast_Node astNode;
 
-extern astNode *root; // declare root as external variable
-
 struct ast_Stmt;
 typedef struct ast_Stmt astStmt;
 
+struct ast_Arena;
+typedef struct ast_Arena astArena;
+
 //enum to identify node type
 typedef enum {
 		ast_prog,
@@ -74,7 +76,7 @@ typedef struct {
 	} astExtern;
 
 typedef struct {
-		char* name;
+		SymbolId symbol; // interned variable name
 	} astVar; 
 
 typedef struct {
@@ -100,7 +102,7 @@ typedef struct {
 
 /* structs for different statement types */
 typedef struct {
-		char* name;
+		SymbolId symbol; // interned name of the called function
 		astNode* param; // For read function this field will be NULL
 	} astCall;
 
@@ -124,7 +126,7 @@ typedef struct {
 	} astIf;
 
 typedef struct {
-		char* name;
+		SymbolId symbol; // interned name of the declared variable
 	} astDecl;
 
 typedef struct {
@@ -161,6 +163,35 @@ struct ast_Node{
 	};
 
 
+/*
+Arena (bump) allocator for AST nodes and AST strings. A parse session
+creates an arena and makes it active with setActiveArena; from then on
+every create* function carves its node out of the arena's current chunk
+and copyString copies into the same chunk, so nodes built together sit
+next to each other in memory. While an arena is active the free* functions
+do not release anything: the whole tree is dropped at once by freeArena,
+which only walks the chunk list (plus the statement lists handed to
+createBlock). With no active arena the create and free functions fall back
+to calloc/free exactly as before. The active arena is per thread, so files
+parsed on different threads each allocate from their own arena.
+A long-running process can keep one arena for every file it parses:
+resetArena drops the tree like freeArena but keeps the current chunk, so
+the next parse starts with its memory already allocated.
+*/
+
+#define AST_ARENA_CHUNK_SIZE (64 * 1024)
+
+astArena* createArena(size_t chunkSize=AST_ARENA_CHUNK_SIZE);
+void freeArena(astArena* arena);
+void resetArena(astArena* arena);
+void setActiveArena(astArena* arena);
+astArena* getActiveArena();
+void* arenaAlloc(astArena* arena, size_t size);
+
+/* Copy / release a string used by the AST, honouring the active arena. */
+char* copyString(const char* str);
+void freeString(char* str);
+
 /* 
 Declarations of create* functions for all the types of nodes 
 defined above. All the create* functions return a astNode*. 
@@ -169,7 +200,8 @@ defined above. All the create* functions return a astNode*.
 astNode* createProg(astNode* extern1, astNode* extern2, astNode* func);
 astNode* createFunc(const char* name, astNode* param, astNode* body);
 astNode* createExtern(const char *name);
-astNode* createVar(const char *name);
+astNode* createVar(SymbolId symbol);
+astNode* createVar(const char *name); // interns name
 astNode* createCnst(int value);
 astNode* createRExpr(astNode* lhs, astNode* rhs, rop_type op);
 astNode* createBExpr(astNode* lhs, astNode* rhs, op_type op);
@@ -182,12 +214,14 @@ other create functions these functions return
 a astNode*.
 */
 
-astNode* createCall(const char *name, astNode *param=NULL);
+astNode* createCall(SymbolId symbol, astNode *param=NULL);
+astNode* createCall(const char *name, astNode *param=NULL); // interns name
 astNode* createRet(astNode* expr);
 astNode* createBlock(vector<astNode*> *stmt_list);
 astNode* createWhile(astNode* cond, astNode* body);
 astNode* createIf(astNode* cond, astNode* if_body, astNode* else_body=NULL);
-astNode* createDecl(const char* decl);
+astNode* createDecl(SymbolId symbol);
+astNode* createDecl(const char* decl); // interns decl
 astNode* createAsgn(astNode* lhs, astNode* rhs);
 
 /* 
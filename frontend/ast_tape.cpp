@@ -0,0 +1,148 @@
+/**
+ * ast_tape.cpp
+ *
+ * This file implements the explicit-stack AST walker and the flat AST tape
+ * used by the frontend passes in place of recursive traversals.
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#include "ast_tape.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int astChildCount(astNode *node)
+{
+    switch (node->type)
+    {
+    case ast_prog:
+        return 3;
+    case ast_func:
+        return 2;
+    case ast_rexpr:
+    case ast_bexpr:
+        return 2;
+    case ast_uexpr:
+        return 1;
+    case ast_extern:
+    case ast_var:
+    case ast_cnst:
+        return 0;
+    case ast_stmt:
+        switch (node->stmt.type)
+        {
+        case ast_call:
+        case ast_ret:
+            return 1;
+        case ast_block:
+            return node->stmt.block.stmt_list->size();
+        case ast_while:
+        case ast_asgn:
+            return 2;
+        case ast_if:
+            return 3;
+        case ast_decl:
+            return 0;
+        }
+        break;
+    }
+
+    fprintf(stderr, "Incorrect node type\n");
+    exit(1);
+}
+
+astNode *astChild(astNode *node, int slot)
+{
+    assert(slot >= 0 && slot < astChildCount(node));
+
+    switch (node->type)
+    {
+    case ast_prog:
+        return slot == 0 ? node->prog.ext1 : slot == 1 ? node->prog.ext2 : node->prog.func;
+    case ast_func:
+        return slot == 0 ? node->func.param : node->func.body;
+    case ast_rexpr:
+        return slot == 0 ? node->rexpr.lhs : node->rexpr.rhs;
+    case ast_bexpr:
+        return slot == 0 ? node->bexpr.lhs : node->bexpr.rhs;
+    case ast_uexpr:
+        return node->uexpr.expr;
+    case ast_stmt:
+        switch (node->stmt.type)
+        {
+        case ast_call:
+            return node->stmt.call.param;
+        case ast_ret:
+            return node->stmt.ret.expr;
+        case ast_block:
+            return (*node->stmt.block.stmt_list)[slot];
+        case ast_while:
+            return slot == 0 ? node->stmt.whilen.cond : node->stmt.whilen.body;
+        case ast_if:
+            return slot == 0 ? node->stmt.ifn.cond : slot == 1 ? node->stmt.ifn.if_body : node->stmt.ifn.else_body;
+        case ast_asgn:
+            return slot == 0 ? node->stmt.asgn.lhs : node->stmt.asgn.rhs;
+        default:
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+    return NULL;
+}
+
+astWalker::astWalker(astNode *root)
+{
+    if (root != NULL)
+    {
+        stack.push_back(astVisit{root, 0, astChildCount(root)});
+    }
+}
+
+bool astWalker::next(astVisit &visit)
+{
+    if (stack.empty())
+    {
+        return false;
+    }
+
+    astVisit &top = stack.back();
+    visit = top;
+
+    if (top.step == top.childCount)
+    {
+        // Last visit of this node: resume its parent
+        stack.pop_back();
+    }
+    else
+    {
+        // Descend into the next child slot; an empty slot just moves the step on
+        astNode *child = astChild(top.node, top.step);
+        top.step++;
+        if (child != NULL)
+        {
+            stack.push_back(astVisit{child, 0, astChildCount(child)});
+        }
+    }
+    return true;
+}
+
+void buildTape(astNode *root, astTape &tape)
+{
+    tape.visits.clear();
+    tape.postOrder.clear();
+
+    astWalker walker(root);
+    astVisit visit;
+    while (walker.next(visit))
+    {
+        tape.visits.push_back(visit);
+        if (isExit(visit))
+        {
+            tape.postOrder.push_back(visit.node);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+/*
+ * MiniC Compiler - Linearized AST Traversal
+ *
+ * Deeply nested MiniC (machine-generated sources with thousands of nested
+ * if/while blocks) overflows the call stack when every pass recurses over the
+ * AST. astWalker is an explicit-stack iterator that produces the depth-first
+ * visits of a tree without recursion, and astTape is a flat array view of the
+ * whole walk built once after parsing. Semantic analysis, IR generation and
+ * freeNode loop over the tape instead of recursing, so their stack usage is
+ * bounded and they scan memory front to back.
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#ifndef AST_TAPE_H
+#define AST_TAPE_H
+
+#include "ast.h"
+#include <vector>
+using namespace std;
+
+/*
+ * One step of a depth-first walk. A node with n child slots is visited n+1
+ * times: step 0 before its first child (enter), step k after its k-th child,
+ * and step n after the last one (exit). Leaves are visited once, with
+ * step == childCount == 0. Empty optional slots (a function without a
+ * parameter, an if without an else) still get their step, so a step number
+ * means the same thing for every node of a given type.
+ */
+typedef struct
+{
+    astNode *node;
+    int step;
+    int childCount;
+} astVisit;
+
+inline bool isEnter(const astVisit &visit) { return visit.step == 0; }
+inline bool isExit(const astVisit &visit) { return visit.step == visit.childCount; }
+
+/************************** astChildCount **************************/
+/* Returns the number of child slots of a node:
+ *   prog: ext1, ext2, func          func: param, body
+ *   rexpr/bexpr: lhs, rhs           uexpr: expr
+ *   call: param                     ret: expr
+ *   block: one slot per statement   while: cond, body
+ *   if: cond, if_body, else_body    asgn: lhs, rhs
+ *   extern, var, cnst, decl: none
+ */
+int astChildCount(astNode *node);
+
+/************************** astChild **************************/
+/* Returns the child in the given slot, or NULL for an empty optional slot. */
+astNode *astChild(astNode *node, int slot);
+
+/*
+ * Explicit-stack iterator over the visits of a subtree, in the order
+ * described for astVisit. Usage:
+ *
+ *     astWalker walker(root);
+ *     astVisit visit;
+ *     while (walker.next(visit)) { ... }
+ */
+class astWalker
+{
+public:
+    explicit astWalker(astNode *root);
+
+    // Stores the next visit in `visit`. Returns false once the walk is over.
+    bool next(astVisit &visit);
+
+private:
+    vector<astVisit> stack; // nodes being walked, with the step each is at
+};
+
+/*
+ * Flat view of an AST, built once after parsing.
+ *
+ * visits holds every step of the depth-first walk in order, for passes that
+ * need to act both before and after children (scopes, control flow).
+ * postOrder holds each node once, children before their parent.
+ */
+typedef struct
+{
+    vector<astVisit> visits;
+    vector<astNode *> postOrder;
+} astTape;
+
+/************************** buildTape **************************/
+/* Fills `tape` with the walk of the subtree rooted at `root`. */
+void buildTape(astNode *root, astTape &tape);
+
+#endif // AST_TAPE_H
@@ -39,4 +39,5 @@ int main(){
 	printNode(a7);
 	
 	freeNode(a7);
+	clearSymbols();
 }
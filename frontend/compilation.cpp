@@ -0,0 +1,216 @@
+/**
+ * compilation.cpp
+ *
+ * This file runs one frontend compilation, from the scanner to an in-memory
+ * LLVM module, for both the frontend executable and the minicc driver.
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#include "compilation.h"
+#include "ast.h"
+#include "ast_tape.h"
+#include "parser.h"
+#include "semantic_analysis.h"
+#include "ir_generator.h"
+#include "source_map.h"
+#include "time_report.h"
+#include <iostream>
+#include "y.tab.h"
+
+// Runs semantic analysis and IR generation on a parsed AST and reports its errors and each result to `out`.
+// Stores the module in *module on success. Returns the exit code of the compilation.
+static int analyzeAndGenerateIR(astNode *root, const char *filename, const compileOptions &options,
+                                LLVMContextRef context, LLVMModuleRef *module, ostream &out)
+{
+#ifdef DEBUG
+    // Print the AST for debugging
+    printNode(root);
+#endif
+
+    // Linearize the AST once; the passes below walk this tape instead of recursing
+    astTape tape;
+    {
+        phaseTimer timer("AST linearization");
+        buildTape(root, tape);
+    }
+
+    if (options.fused)
+    {
+        // Check declarations while emitting IR, in a single AST walk
+        bool errorFound = false;
+        {
+            phaseTimer timer("Semantic analysis and IR generation (fused)");
+            *module = generateIR(tape, filename, context, &errorFound, &out);
+        }
+        if (errorFound)
+        {
+            out << "Result: Semantic analysis unsuccessful." << endl;
+            return 3;
+        }
+
+        out << "Result: Semantic analysis successful." << endl;
+    }
+    else
+    {
+        // Perform semantic analysis on the root node and check for errors
+        bool errorFound;
+        {
+            phaseTimer timer("Semantic analysis");
+            errorFound = semanticAnalysis(tape, out);
+        }
+        if (errorFound)
+        {
+            out << "Result: Semantic analysis unsuccessful." << endl;
+            return 3;
+        }
+
+        out << "Result: Semantic analysis successful." << endl;
+        phaseTimer timer("IR generation");
+        *module = generateIR(tape, filename, context);
+    }
+
+    if (!*module)
+    {
+        out << "Result: IR generation unsuccessful." << endl;
+        return 4;
+    }
+
+    out << "Result: Intermediate Representation (IR) generation successful." << endl;
+    return 0;
+}
+
+// Parses the input that `scanner` is set up to read, into `arena` if one is given or into an arena of
+// its own otherwise, and then checks and lowers it. Returns the exit code of the compilation.
+static int parseAndGenerateIR(yyscan_t scanner, const char *filename, const compileOptions &options,
+                              LLVMContextRef context, LLVMModuleRef *module, ostream &out, astArena *arena)
+{
+    // Allocate the AST out of a single arena for the whole parse session
+    astArena *sessionArena = arena ? arena : createArena();
+    setActiveArena(sessionArena);
+
+    // Parse the input; syntax errors are reported to `out` along with the results
+    yyset_extra(&out, scanner);
+    astNode *root = NULL;
+    int exitCode;
+    int parseResult;
+    {
+        phaseTimer timer("Lexing and parsing");
+        parseResult = yyparse(scanner, &root);
+    }
+    if (parseResult != 0)
+    {
+        out << "Result: Parsing unsuccessful." << endl;
+        exitCode = 2;
+    }
+    else
+    {
+        out << "Result: Parsing successful." << endl;
+        exitCode = analyzeAndGenerateIR(root, filename, options, context, module, out);
+        freeNode(root);
+    }
+
+    // Drop the whole AST at once (keeping a reused arena's memory), then the interned identifier names
+    if (arena)
+    {
+        resetArena(arena);
+    }
+    else
+    {
+        freeArena(sessionArena);
+    }
+    setActiveArena(NULL);
+    clearSymbols();
+    return exitCode;
+}
+
+int compileToModule(const char *filename, const compileOptions &options, LLVMContextRef context,
+                    LLVMModuleRef *module, ostream &out, astArena *arena)
+{
+    *module = NULL;
+    if (options.useMmap && !filename)
+    {
+        cerr << "--mmap requires an input file" << endl;
+        return 1;
+    }
+
+    yyscan_t scanner;
+    if (yylex_init(&scanner) != 0)
+    {
+        cerr << "Could not create the scanner" << endl;
+        return 1;
+    }
+
+    FILE *file = NULL;
+    sourceMap map = {NULL, 0, 0};
+    if (options.useMmap)
+    {
+        // Hand the mapped file straight to the scanner
+        if (!scanMappedFile(filename, &map, scanner))
+        {
+            cerr << "Could not map file '" << filename << "'" << endl;
+            yylex_destroy(scanner);
+            return 1;
+        }
+    }
+    else if (filename)
+    {
+        // Open the input file
+        file = fopen(filename, "r");
+        if (!file)
+        {
+            cerr << "Could not open file '" << filename << "'" << endl;
+            yylex_destroy(scanner);
+            return 1;
+        }
+        yyset_in(file, scanner);
+    }
+    else
+    {
+        yyset_in(stdin, scanner);
+    }
+
+    int exitCode = parseAndGenerateIR(scanner, filename, options, context, module, out, arena);
+
+    // Clean up: the scanner (which deletes its buffer over the mapping) before the mapping itself
+    if (file)
+    {
+        fclose(file);
+    }
+    yylex_destroy(scanner);
+    unmapSourceFile(&map);
+    return exitCode;
+}
+
+int compileSourceToModule(const char *name, const char *source, size_t length, const compileOptions &options,
+                          LLVMContextRef context, LLVMModuleRef *module, ostream &out, astArena *arena)
+{
+    *module = NULL;
+    yyscan_t scanner;
+    if (yylex_init(&scanner) != 0)
+    {
+        cerr << "Could not create the scanner" << endl;
+        return 1;
+    }
+
+    if (!scanSourceBytes(source, length, scanner))
+    {
+        cerr << "Could not read source '" << name << "'" << endl;
+        yylex_destroy(scanner);
+        return 1;
+    }
+
+    int exitCode = parseAndGenerateIR(scanner, name, options, context, module, out, arena);
+    yylex_destroy(scanner);
+    return exitCode;
+}
+
+// This function is called by the parser when it encounters a syntax error.
+// It reports the line number and the last token that was read to the stream
+// of the compilation (see parseAndGenerateIR).
+void yyerror(yyscan_t scanner, astNode **, const char *)
+{
+    ostream &out = *(ostream *)yyget_extra(scanner);
+    out << endl << "Syntax error (line: " << yyget_lineno(scanner) << "). Last token: " << yyget_text(scanner) << endl;
+}
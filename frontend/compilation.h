@@ -0,0 +1,53 @@
+/*
+ * MiniC Compiler - One Frontend Compilation
+ *
+ * Runs the whole frontend on one MiniC file: scanning and parsing into an
+ * AST arena, semantic analysis, and IR generation into an LLVM module that
+ * stays in memory. The frontend executable saves that module as _manual.ll;
+ * the minicc driver hands it straight to the optimizer and the backend.
+ *
+ * Everything a compilation creates (scanner, arena, interned symbols) belongs
+ * to that call, and the module lives in the caller's LLVM context, so any
+ * number of compilations can run at the same time on different threads.
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#ifndef COMPILATION_H
+#define COMPILATION_H
+
+#include "ast.h"
+#include <llvm-c/Core.h>
+#include <ostream>
+using namespace std;
+
+// Frontend options that apply to every file of a run
+typedef struct
+{
+    bool useMmap; // scan a memory mapping of the file instead of reading it through stdio
+    bool fused;   // check declarations during IR generation instead of in a separate AST walk
+    bool bitcode; // save the module as _manual.bc (LLVM bitcode) instead of _manual.ll
+} compileOptions;
+
+/************************** compileToModule **************************/
+/* Parses, checks and lowers one MiniC file (stdin if filename is NULL) and
+ * reports its syntax and semantic errors and each "Result:" line to `out`. On success *module is the verified
+ * module, created in `context` and owned by the caller; otherwise it is NULL.
+ * Returns the frontend exit code: 0 on success, 1 if the file cannot be read,
+ * 2 on a syntax error, 3 on a semantic error and 4 if IR generation fails.
+ * The AST is built in `arena` if one is given, which is reset for the next
+ * compilation afterwards; otherwise it gets an arena of its own.
+ */
+int compileToModule(const char *filename, const compileOptions &options, LLVMContextRef context,
+                    LLVMModuleRef *module, ostream &out, astArena *arena = NULL);
+
+/************************** compileSourceToModule **************************/
+/* Same as compileToModule for a source that is already in memory: the
+ * `length` bytes at `source`, reported under `name`. options.useMmap is
+ * ignored.
+ */
+int compileSourceToModule(const char *name, const char *source, size_t length, const compileOptions &options,
+                          LLVMContextRef context, LLVMModuleRef *module, ostream &out, astArena *arena = NULL);
+
+#endif // COMPILATION_H
@@ -5,98 +5,148 @@
  * which reads in a MiniC file, parses it, outputs the AST, and perform
  * semantic analysis.
  *
+ * Given several files (or -jN), it compiles them as a batch on a thread pool.
+ * Every compilation has its own scanner, parser state, AST arena, interned
+ * symbols and LLVM context, so nothing is shared between the worker threads.
+ *
  * @author Aimen Abdulaziz
  * @date Spring, 2023
  */
 
-#include "ast.h"
-#include "semantic_analysis.h"
-#include "ir_generator.h"
+#include "compilation.h"
+#include "file_utils.h"
+#include "thread_pool.h"
+#include "time_report.h"
 #include <iostream>
+#include <sstream>
 #include <string.h>
-#include "y.tab.h"
-
-extern void yyerror(const char *);
-extern int yylex();
-extern FILE *yyin;
-extern int yylex_destroy();
-extern int yylineno;
-extern char *yytext;
-
-astNode *root; // The root node of the Abstract Syntax Tree (AST)
+#include <stdlib.h>
+#include <vector>
 
 using namespace std;
 
-// Clean up function
-void cleanup()
+// Compiles one MiniC file (stdin if filename is NULL) into its _manual.ll or _manual.bc file and reports
+// its errors and each result to `out`. Each call has its own LLVM context, so any number of calls can run
+// at the same time on different threads. Returns the exit code of the compilation.
+static int compileFile(const char *filename, const compileOptions &options, ostream &out)
+{
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMModuleRef module;
+    int exitCode = compileToModule(filename, options, context, &module, out);
+    if (module)
+    {
+        // Write the generated LLVM IR code (or bitcode) next to the input file
+        std::string outputFilename;
+        changeFileExtension(filename, outputFilename, options.bitcode ? "_manual.bc" : "_manual.ll");
+        if (!saveLLVMModel(module, outputFilename.c_str()))
+        {
+            exitCode = 4;
+        }
+        LLVMDisposeModule(module);
+    }
+    LLVMContextDispose(context);
+    return exitCode;
+}
+
+// Compiles every file on a pool of `jobs` threads. The errors and results of each file are
+// collected while it compiles, then printed in the order the files were given.
+// Returns the highest exit code of any file (0 if every file compiled).
+static int compileBatch(const vector<const char *> &files, const compileOptions &options, unsigned jobs)
 {
-    if (yyin != stdin)
+    vector<ostringstream> logs(files.size());
+    vector<int> exitCodes(files.size(), 0);
     {
-        fclose(yyin);
+        ThreadPool pool(jobs);
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            pool.submit([&, i] { exitCodes[i] = compileFile(files[i], options, logs[i]); });
+        }
+        pool.wait();
+    }
+
+    int worst = 0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        istringstream lines(logs[i].str());
+        string line;
+        while (getline(lines, line))
+        {
+            cout << files[i] << ": " << line << endl;
+        }
+        if (exitCodes[i] > worst)
+        {
+            worst = exitCodes[i];
+        }
     }
-    yylex_destroy();
+    return worst;
 }
 
 // The main function for the MiniC compiler. It takes in a file name as an
 // argument, parses the file, outputs the AST and performs semantic analysis on the AST.
+// With --mmap the file is memory-mapped and scanned in place instead of being read through stdio.
+// With --fused the declaration checks are done during IR generation instead of in a separate AST walk.
+// With --emit-bc the module is saved as LLVM bitcode (_manual.bc) instead of textual IR.
+// With several files, or -jN, the files are compiled in parallel on N threads
+// (-j alone uses every hardware thread).
+// With -ftime-report (or -ftime-report=json) the time, allocations and peak memory of each phase
+// are printed to stderr at the end.
 int main(int argc, char *argv[])
 {
-    if (argc == 2)
+    vector<const char *> files;
+    compileOptions options = {false, false, false};
+    unsigned jobs = 0; // 0: not requested
+    bool timeReportJSON = false;
+    for (int i = 1; i < argc; i++)
     {
-        // Open the input file
-        yyin = fopen(argv[1], "r");
-        if (!yyin)
+        if (parseTimeReportOption(argv[i], timeReportJSON))
         {
-            cerr << "Could not open file '" << argv[1] << "'" << endl;
-            return 1;
+            continue;
+        }
+        else if (!strcmp(argv[i], "--mmap"))
+        {
+            options.useMmap = true;
+        }
+        else if (!strcmp(argv[i], "--fused"))
+        {
+            options.fused = true;
+        }
+        else if (!strcmp(argv[i], "--emit-bc"))
+        {
+            options.bitcode = true;
+        }
+        else if (!strncmp(argv[i], "-j", 2))
+        {
+            jobs = argv[i][2] ? atoi(argv[i] + 2) : ThreadPool::hardwareThreads();
+            if (jobs == 0)
+            {
+                cerr << "Invalid job count '" << argv[i] << "'" << endl;
+                return 1;
+            }
+        }
+        else
+        {
+            files.push_back(argv[i]);
         }
     }
 
-    // Parse the input
-    if (yyparse() != 0)
+    int exitCode;
+    if (files.size() <= 1 && jobs == 0)
     {
-        cout << "Result: Parsing unsuccessful." << endl;
-        cleanup();
-        return 2;
+        exitCode = compileFile(files.empty() ? NULL : files[0], options, cout);
     }
-
-    cout << "Result: Parsing successful." << endl;
-
-#ifdef DEBUG
-    // Print the AST for debugging
-    printNode(root);
-#endif
-
-    // Perform semantic analysis on the root node and check for errors
-    bool errorFound = semanticAnalysis(root);
-    if (errorFound)
+    else if (files.empty())
     {
-        cout << "Result: Semantic analysis unsuccessful." << endl;
-        cleanup();
-        freeNode(root);
-        return 3;
+        cerr << "Batch mode requires input files" << endl;
+        return 1;
     }
-
-    cout << "Result: Semantic analysis successful." << endl;
-    if (!generateIRAndSaveToFile(root, argv[1]))
+    else
     {
-        cout << "Result: IR generation unsuccessful." << endl;
-        cleanup();
-        freeNode(root);
-        return 4;
+        exitCode = compileBatch(files, options, jobs ? jobs : ThreadPool::hardwareThreads());
     }
 
-    cout << "Result: Intermediate Representation (IR) generation successful." << endl;
-
-    // Clean up
-    cleanup();
-    freeNode(root);
-    return 0;
-}
-
-// This function is called by the parser when it encounters a syntax error.
-// It prints out the line number and the last token that was read.
-void yyerror(const char *)
-{
-    cout << "\nSyntax error (line: " << yylineno << "). Last token: " << yytext << endl;
+    if (timeReportEnabled())
+    {
+        printTimeReport(cerr, timeReportJSON);
+    }
+    return exitCode;
 }
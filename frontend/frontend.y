@@ -11,6 +11,7 @@
  
 %{
 #include "ast.h" 
+#include "parser.h"
 #include "semantic_analysis.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,24 +20,32 @@
 #include <stack> // C++ stack
 #include <set>
 
-extern astNode *root; // root node is defined in ast.h
-
-extern void yyerror(const char *);
-extern int yylex();
-extern FILE *yyin;
-extern int yylex_destroy();
-extern int yylineno;
-extern char *yytext;
+// Machine-generated sources nest blocks far deeper than bison's default
+// parser stack limit of 10000 entries; the stack is grown on demand up to this
+#define YYMAXDEPTH 10000000
 %}
 
+/* Pure parser: the scanner handle and the AST root are passed in, no globals */
+%define api.pure full
+%lex-param   { yyscan_t scanner }
+%parse-param { yyscan_t scanner } { astNode **root }
+
+%code requires {
+#include "parser.h"
+}
+
 %union {
     int number;
-    char *sname;
+    SymbolId symbol; // interned identifier
     astNode *node;
     std::vector<astNode*> *node_list;
 }
 
-%token <sname> IDENTIFIER PRINT READ 
+%code {
+int yylex(YYSTYPE *yylval_param, yyscan_t yyscanner);
+}
+
+%token <symbol> IDENTIFIER PRINT READ 
 %token <number> NUMBER
 %token RETURN IF ELSE WHILE EXTERN VOID INT
 %token PLUS MINUS MULTIPLY DIVIDE GT LT EQ GE LE
@@ -57,20 +66,20 @@ extern char *yytext;
 program:
     extern_print extern_read function_definition { 
         $$ = createProg($1, $2, $3);
-        root = $$;
+        *root = $$;
     }
     | extern_read extern_print function_definition { 
         $$ = createProg($2, $1, $3);
-        root = $$;
+        *root = $$;
     }
     ;
 
 extern_print:
-    EXTERN VOID PRINT LPAREN extern_parameter RPAREN SEMICOLON { $$ = createExtern($3); free($3); }
+    EXTERN VOID PRINT LPAREN extern_parameter RPAREN SEMICOLON { $$ = createExtern(symbolName($3)); }
     ;
 
 extern_read:
-    EXTERN INT READ LPAREN RPAREN SEMICOLON { $$ = createExtern($3); free($3); }
+    EXTERN INT READ LPAREN RPAREN SEMICOLON { $$ = createExtern(symbolName($3)); }
     ;
 
 extern_parameter:
@@ -80,7 +89,7 @@ extern_parameter:
 
 /* Function paramter - at most one parameter */
 parameter: 
-    INT IDENTIFIER  { $$ = createVar($2); free($2); }
+    INT IDENTIFIER  { $$ = createVar($2); }
     | { $$ = NULL; }
     ;
 
@@ -97,8 +106,7 @@ function_definition:
 
 function_header:
     INT IDENTIFIER LPAREN parameter RPAREN { 
-        $$ = createFunc($2, $4, NULL); 
-        free($2);
+        $$ = createFunc(symbolName($2), $4, NULL); 
     }
     ;
 
@@ -125,7 +133,7 @@ variable_declarations:
 
 // Declare variables of integer type
 variable_declaration:
-    INT IDENTIFIER SEMICOLON { $$ = createDecl($2); free($2); }
+    INT IDENTIFIER SEMICOLON { $$ = createDecl($2); }
     ;
 
 statement_list:
@@ -154,7 +162,6 @@ assignment_statement:
     IDENTIFIER ASSIGN expression { 
         astNode *identifier_node = createVar($1);
         $$ = createAsgn(identifier_node, $3);
-        free($1);
     }
     ;
 
@@ -173,7 +180,7 @@ expression:
     ;
 
 term:
-    IDENTIFIER { $$ = createVar($1); free($1); } 
+    IDENTIFIER { $$ = createVar($1); } 
     | NUMBER  { $$ = createCnst($1); } 
     | MINUS term %prec UNARY  { $$ = createUExpr($2, uminus); }
 
@@ -189,9 +196,8 @@ while_loop:
 function_call:
     PRINT LPAREN term RPAREN { 
         $$ = createCall($1, $3); 
-        free($1);
     }
-    | READ LPAREN RPAREN { $$ = createCall($1, NULL); free($1); }
+    | READ LPAREN RPAREN { $$ = createCall($1, NULL); }
     ;
 
 condition:
@@ -0,0 +1,64 @@
+/*
+ * MiniC Compiler - Reentrant Parser Interface
+ *
+ * The bison parser is pure and the flex scanner is reentrant: all of their
+ * state lives in a yyscan_t handle and in the arguments of yyparse, so any
+ * number of files can be parsed at the same time on different threads.
+ *
+ *     yyscan_t scanner;
+ *     astNode *root = NULL;
+ *     yylex_init(&scanner);
+ *     yyset_in(file, scanner);        // or scanMappedFile / scanSourceBytes
+ *     if (yyparse(scanner, &root) == 0) { ... }
+ *     yylex_destroy(scanner);
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "ast.h"
+#include "source_map.h"
+#include <stdio.h>
+
+// Same definition flex emits in lex.yy.c
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+/* Reentrant scanner API generated by flex from frontend.l */
+int yylex_init(yyscan_t *scanner);
+int yylex_destroy(yyscan_t scanner);
+void yyset_in(FILE *file, yyscan_t scanner);
+int yyget_lineno(yyscan_t scanner);
+char *yyget_text(yyscan_t scanner);
+void yyset_extra(void *extra, yyscan_t scanner);
+void *yyget_extra(yyscan_t scanner);
+
+/************************** scanMappedFile **************************/
+/* Defined in frontend.l. Maps `path` into `map` and makes it the current
+ * buffer of `scanner` via yy_scan_buffer, so the scanner reads the mapping
+ * directly instead of a FILE. The buffer is deleted by yylex_destroy; unmap
+ * the file with unmapSourceFile after that. Returns false if the file cannot
+ * be mapped.
+ */
+bool scanMappedFile(const char *path, sourceMap *map, yyscan_t scanner);
+
+/************************** scanSourceBytes **************************/
+/* Defined in frontend.l. Makes a copy of the `length` bytes at `source` the
+ * current buffer of `scanner` via yy_scan_bytes, for sources that are already
+ * in memory (the compile server's inline sources). The copy is deleted by
+ * yylex_destroy. Returns false if the buffer cannot be created.
+ */
+bool scanSourceBytes(const char *source, size_t length, yyscan_t scanner);
+
+/************************** yyerror **************************/
+/* Called by the parser on a syntax error. Reports the line number and the
+ * last token read by `scanner` to the ostream set as its extra data.
+ */
+void yyerror(yyscan_t scanner, astNode **root, const char *message);
+
+#endif // PARSER_H
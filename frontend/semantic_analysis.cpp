@@ -9,35 +9,38 @@
  */
 
 #include "ast.h"
+#include "ast_tape.h"
 #include "semantic_analysis.h"
+#include "symbol_table.h"
+#include <iostream>
 #include <stdio.h>
 #include <vector>
-#include <set>
-#include <string>
 using namespace std;
 
+// Semantic analysis only needs to know whether a variable is visible
+typedef ScopedSymbolTable<bool> SymbolTable;
+
 /********************** local function prototypes ********************* */
-static bool traverse(astNode *node, vector<set<string>> *symbolTables);
-static bool traverseStmt(astStmt *stmt, vector<set<string>> *symbolTables);
+static bool visitStep(const astVisit &visit, SymbolTable *symbolTables, ostream &out);
 
 /*
  * Helper function to print the symbol tables for debugging purposes
  *
- * symbolTables: A reference to the vector containing the symbol tables.
+ * symbolTables: A reference to the scoped symbol table.
  */
-void printSymbolTables(const vector<set<string>>& symbolTables) {
+void printSymbolTables(const SymbolTable& symbolTables) {
     int index = 0;
-    for (const auto& table : symbolTables) {
+    for (const auto& scope : symbolTables.getScopes()) {
         printf("Index %d:\n", index);
-        for (const auto& symbol : table) {
-            printf("  %s\n", symbol.c_str());
+        for (SymbolId symbol : scope) {
+            printf("  %s\n", symbolName(symbol));
         }
         index++;
     }
 }
 
 /**************** semanticAnalysis() ****************/
-/* It traverses the AST and checks for undeclared variables and 
+/* It walks the AST and checks for undeclared variables and 
  * populates symbol tables accordingly. User will only call this 
  * function, and all necessary helper functions will invoked in 
  * this function.
@@ -50,182 +53,94 @@ bool semanticAnalysis(astNode *node) {
 		return false;
 	}
 
-    // Declare an empty stack of symbol tables
-    vector<set<string>> symbolTables;
-	
-	// Traverse the AST and populate the symbol tables
-	return traverse(node, &symbolTables);
+	astTape tape;
+	buildTape(node, tape);
+	return semanticAnalysis(tape, cout);
 }
 
-/**************** traverse() ****************/
-/**
- * A recursive helper function that traverses the given AST node and its
- * children. It populates the provided symbol tables based on the
- * encountered variables and their declarations.
- *
- * node:          The current AST node being traversed.
- * symbolTables:  A pointer to the vector containing the symbol tables.
+/**************** semanticAnalysis() ****************/
+/* Same as above, for an AST that has already been linearized. The walk
+ * is a single loop over the tape, so deep nesting does not grow the stack.
+ * The errors go to `out`, so a batch can keep the messages of each file
+ * together.
  * 
  * returns:       true if an error is found, false otherwise.
  */
-static bool traverse(astNode *node, vector<set<string>> *symbolTables) {
-	bool errorFound = 0;
-
-	if (!node) {
-		return errorFound;
-	}
-
-	switch (node->type) {
-		case ast_prog: {
-			errorFound = traverse(node->prog.ext1, symbolTables) || errorFound; 
-			errorFound = traverse(node->prog.ext2, symbolTables) || errorFound; 
-			errorFound = traverse(node->prog.func, symbolTables) || errorFound; 
-			break;
-		}
-
-		case ast_extern: {
-			// ignore extern nodes
-			break;
-		}
-		
-		case ast_func: {
-			// create a new symbol table currSymTable and push it to symbol table stack
-			set<string> currSymTable;
-			symbolTables->push_back(currSymTable);
-
-			// if func node has a parameter add parameter to currSymTable
-			if (node->func.param) {
-				symbolTables->back().insert(node->func.param->var.name);
-			}
-
-			// traverse the body of the function
-			errorFound = traverse(node->func.body, symbolTables) || errorFound; 
-
-			// pop the symbol table from the stack
-			symbolTables->pop_back();
-
-			break;
-		}
-
-		case ast_stmt: {
-			errorFound = traverseStmt(&node->stmt, symbolTables) || errorFound; 
-			break;
-		}
-
-		case ast_var: {
-			// check if the variable appears in one of the symbol tables on the stack
-			bool found = false;
-			for (auto &table : *symbolTables) {
-				if (table.find(node->var.name) != table.end()) {
-					// variable found in symbol table
-					found = true;
-					break;
-				}
-			}
-
-			if (!found) {
-				// variable not found in symbol table
-				printf("Error: undeclared variable '%s'\n", node->var.name);
-				errorFound = true; // Unsuccessful semantic analysis due to undeclared variable
-			}
-
-			break;
-		}
-
-		case ast_cnst: {
-			// ignore the values of constant nodes
-			break;
-		}
-
-		case ast_rexpr: {
-			errorFound = traverse(node->rexpr.lhs, symbolTables) || errorFound; 
-			errorFound = traverse(node->rexpr.rhs, symbolTables) || errorFound; 
-			break;
-		}
-
-		case ast_bexpr: {
-			errorFound = traverse(node->bexpr.lhs, symbolTables) || errorFound; 
-			errorFound = traverse(node->bexpr.rhs, symbolTables) || errorFound; 
-			break;
-		}
-
-		case ast_uexpr: {
-			errorFound = traverse(node->uexpr.expr, symbolTables) || errorFound; 
-			break;
-		}
+bool semanticAnalysis(const astTape &tape, ostream &out) {
+    // Declare an empty scoped symbol table
+    SymbolTable symbolTables;
+	bool errorFound = false;
+
+	// Walk the AST and populate the symbol tables
+	for (const astVisit &step : tape.visits) {
+		errorFound = visitStep(step, &symbolTables, out) || errorFound;
 	}
 	return errorFound;
 }
 
-/**************** traverseStmt() ****************/
+/**************** visitStep() ****************/
 /**
- * A recursive helper function that traverses the given AST statement node
- * and its children. It populates the provided symbol tables based on the
- * encountered variables and their declarations.
+ * Handles one step of the AST walk. Scopes are opened on the first visit
+ * of a function or block and closed on its last visit; declarations and
+ * variable uses are leaves, so they are visited exactly once.
  *
- * stmt:          The current AST statement node being traversed.
- * symbolTables:  A pointer to the vector containing the symbol tables.
+ * visit:         The current step of the walk.
+ * symbolTables:  A pointer to the scoped symbol table.
+ * out:           Where undeclared variables are reported.
  * 
  * returns:       true if an error is found, false otherwise.
  */
-static bool traverseStmt(astStmt *stmt, vector<set<string>> *symbolTables) {
-	bool errorFound = 0;
-	if (!stmt) {
-		return errorFound;
-	}
-
-	switch (stmt->type) {
-		case ast_call: {
-			if (stmt->call.param) {
-				errorFound = traverse(stmt->call.param, symbolTables) || errorFound; 
-			}
-			break;
-		}
-		
-		case ast_ret: {
-			errorFound = traverse(stmt->ret.expr, symbolTables) || errorFound; 
-			break;
-		}
+static bool visitStep(const astVisit &visit, SymbolTable *symbolTables, ostream &out) {
+	bool errorFound = false;
+	astNode *node = visit.node;
 
-		case ast_block: {
-			// create a new symbol table currSymTable and push it to symbol table stack
-			set<string> currSymTable;
-			symbolTables->push_back(currSymTable);
+	switch (node->type) {
+		case ast_func: {
+			if (isEnter(visit)) {
+				// open a new scope for the function
+				symbolTables->enterScope();
 
-			// visit all nodes in the statement list of block statement 
-			for (auto &node : *stmt->block.stmt_list) {
-				errorFound |= traverse(node, symbolTables);
+				// if func node has a parameter add parameter to the current scope
+				if (node->func.param) {
+					symbolTables->declare(node->func.param->var.symbol, true);
+				}
+			}
+			else if (isExit(visit)) {
+				// close the scope
+				symbolTables->exitScope();
 			}
-
-			// pop the symbol table from the stack
-			symbolTables->pop_back();
-
-			break;
-		}
-
-		case ast_while: {
-			errorFound = traverse(stmt->whilen.cond, symbolTables) || errorFound; 
-			errorFound = traverseStmt(&stmt->whilen.body->stmt, symbolTables) || errorFound; 
 			break;
 		}
 
-		case ast_if: {
-			errorFound = traverse(stmt->ifn.cond, symbolTables) || errorFound; 
-			errorFound = traverseStmt(&stmt->ifn.if_body->stmt, symbolTables) || errorFound; 
-			if (stmt->ifn.else_body) {
-				errorFound = traverseStmt(&stmt->ifn.else_body->stmt, symbolTables) || errorFound; 
+		case ast_stmt: {
+			if (node->stmt.type == ast_block) {
+				// open a new scope for the block, and close it after its last statement
+				if (isEnter(visit)) {
+					symbolTables->enterScope();
+				}
+				if (isExit(visit)) {
+					symbolTables->exitScope();
+				}
+			}
+			else if (node->stmt.type == ast_decl) {
+				// redeclaring in the same scope keeps the first declaration
+				symbolTables->declare(node->stmt.decl.symbol, true);
 			}
 			break;
 		}
 
-		case ast_asgn: {
-			errorFound = traverse(stmt->asgn.lhs, symbolTables) || errorFound; 
-			errorFound = traverse(stmt->asgn.rhs, symbolTables) || errorFound; 
+		case ast_var: {
+			// check if the variable is visible in any enclosing scope
+			if (!symbolTables->lookup(node->var.symbol)) {
+				// variable not found in symbol table
+				out << "Error: undeclared variable '" << symbolName(node->var.symbol) << "'" << endl;
+				errorFound = true; // Unsuccessful semantic analysis due to undeclared variable
+			}
 			break;
 		}
 
-		case ast_decl: {
-			symbolTables->back().insert(stmt->decl.name);
+		default: {
+			// externs, constants and expressions only matter through their children
 			break;
 		}
 	}
@@ -12,6 +12,9 @@
 #define SEMANTIC_ANALYSIS_H
 
 #include "ast.h"
+#include "ast_tape.h"
+#include <ostream>
+using namespace std;
 
 /************************** semanticAnalysis **************************/
 /* Takes an Abstract Syntax Tree (AST) node as an argument and performs 
@@ -21,4 +24,9 @@
  */
 bool semanticAnalysis(astNode *node);
 
+/* Same check over an AST tape built once after parsing (see ast_tape.h),
+ * reporting each undeclared variable to `out` instead of stdout.
+ */
+bool semanticAnalysis(const astTape &tape, ostream &out);
+
 #endif // SEMANTIC_ANALYSIS_H
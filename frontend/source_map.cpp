@@ -0,0 +1,75 @@
+/**
+ * source_map.cpp
+ *
+ * This file maps MiniC source files into memory for the flex scanner.
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#include "source_map.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool mapSourceFile(const char *path, sourceMap *map)
+{
+    map->data = NULL;
+    map->size = map->mapSize = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return false;
+    }
+
+    // Reserve zeroed anonymous memory for the file plus the two NULs, then
+    // map the file over the front of it. The tail of the file's last page
+    // reads as zero, and so does the reserved page after it when the file
+    // ends exactly on a page boundary, so the terminator never faults.
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = st.st_size;
+    size_t mapSize = (size + 2 + page - 1) / page * page;
+
+    void *base = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+
+    if (size > 0 &&
+        mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        munmap(base, mapSize);
+        close(fd);
+        return false;
+    }
+    close(fd);
+
+    // The scanner walks the buffer front to back exactly once
+    madvise(base, mapSize, MADV_SEQUENTIAL);
+
+    map->data = (char *)base;
+    map->size = size;
+    map->mapSize = mapSize;
+    return true;
+}
+
+void unmapSourceFile(sourceMap *map)
+{
+    if (map->data)
+    {
+        munmap(map->data, map->mapSize);
+    }
+    map->data = NULL;
+    map->size = map->mapSize = 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * MiniC Compiler - Memory-Mapped Source Input
+ *
+ * Maps a MiniC source file into memory in the layout flex's yy_scan_buffer
+ * expects: the file contents followed by two NUL bytes. The scanner then
+ * tokenizes the mapped pages in place, without stdio refills or copying the
+ * file into its own buffer, and yytext points straight into the mapping
+ * (see scanMappedFile in parser.h).
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#ifndef SOURCE_MAP_H
+#define SOURCE_MAP_H
+
+#include <cstddef>
+
+/* A mapped source file. `data[size]` and `data[size + 1]` are NUL. */
+typedef struct
+{
+    char *data;
+    size_t size;     // size of the file in bytes
+    size_t mapSize;  // size of the whole mapping (page aligned)
+} sourceMap;
+
+/************************** mapSourceFile **************************/
+/* Maps `path` privately and writably (flex temporarily writes NULs into the
+ * buffer while scanning; those writes are copy-on-write and never reach the
+ * file). Returns false and leaves `map` empty if the file cannot be mapped.
+ */
+bool mapSourceFile(const char *path, sourceMap *map);
+
+/************************** unmapSourceFile **************************/
+/* Releases a mapping made by mapSourceFile. Safe to call on an empty map. */
+void unmapSourceFile(sourceMap *map);
+
+#endif // SOURCE_MAP_H
@@ -0,0 +1,69 @@
+/**
+ * symbol_table.cpp
+ *
+ * This file implements identifier interning for the MiniC frontend. Every
+ * distinct identifier gets a dense SymbolId in the order it is first seen.
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#include "symbol_table.h"
+#include <stdlib.h>
+#include <string.h>
+#include <string_view>
+#include <unordered_map>
+
+// id -> name, and name -> id. The string_view keys point into `names`.
+// Every thread has its own interner, so files compiled in parallel never
+// share symbols; each compilation clears its thread's interner when done.
+static thread_local vector<char *> names;
+static thread_local unordered_map<string_view, SymbolId> symbolIds;
+
+SymbolId internSymbol(const char *name)
+{
+    return internSymbol(name, strlen(name));
+}
+
+SymbolId internSymbol(const char *name, size_t length)
+{
+    auto it = symbolIds.find(string_view(name, length));
+    if (it != symbolIds.end())
+    {
+        return it->second;
+    }
+
+    // First occurrence: keep our own NUL-terminated copy of the name
+    char *copy = (char *)malloc(length + 1);
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+
+    SymbolId symbol = names.size();
+    names.push_back(copy);
+    symbolIds.emplace(string_view(copy, length), symbol);
+    return symbol;
+}
+
+const char *symbolName(SymbolId symbol)
+{
+    if (symbol < 0 || (size_t)symbol >= names.size())
+    {
+        return "<unknown>";
+    }
+    return names[symbol];
+}
+
+int symbolCount()
+{
+    return names.size();
+}
+
+void clearSymbols()
+{
+    symbolIds.clear();
+    for (char *name : names)
+    {
+        free(name);
+    }
+    names.clear();
+}
@@ -0,0 +1,126 @@
+/*
+ * MiniC Compiler - Symbol Interning and Scoped Symbol Table
+ *
+ * The lexer interns every identifier into a dense integer SymbolId, so the
+ * AST, semantic analysis and IR generation hash and compare integers instead
+ * of strings. ScopedSymbolTable is the single scoped symbol table used by both
+ * semantic analysis and IR generation. Instead of a stack of hash maps that is
+ * searched from the innermost scope outward, it keeps one shadow stack per
+ * symbol: the innermost visible binding of a symbol is always at the top of
+ * its stack, so a lookup is a single array access.
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+typedef int SymbolId;
+
+#define NO_SYMBOL (-1)
+
+/************************** internSymbol **************************/
+/* Returns the SymbolId of the given identifier, assigning the next dense id
+ * the first time the identifier is seen. The name is copied only once, on
+ * first sight; later occurrences are looked up without copying. Symbols are
+ * interned per thread: ids are only meaningful on the thread that made them.
+ */
+SymbolId internSymbol(const char *name);
+SymbolId internSymbol(const char *name, size_t length);
+
+/************************** symbolName **************************/
+/* Returns the NUL-terminated name of an interned symbol. */
+const char *symbolName(SymbolId symbol);
+
+/************************** symbolCount **************************/
+/* Returns the number of distinct symbols interned so far. */
+int symbolCount();
+
+/************************** clearSymbols **************************/
+/* Forgets every symbol interned on this thread and releases the copied names. */
+void clearSymbols();
+
+/*
+ * Scoped symbol table keyed by SymbolId.
+ *
+ * shadowStack[id] holds every binding of `id` that is currently in scope,
+ * innermost last, together with the scope depth it was declared at.
+ * scopes[d] lists the symbols declared at depth d so exitScope can pop
+ * exactly those bindings.
+ */
+template <typename T>
+class ScopedSymbolTable
+{
+public:
+    // Open a new innermost scope
+    void enterScope()
+    {
+        scopes.push_back(vector<SymbolId>());
+    }
+
+    // Close the innermost scope, un-shadowing outer bindings
+    void exitScope()
+    {
+        for (SymbolId symbol : scopes.back())
+        {
+            shadowStack[symbol].pop_back();
+        }
+        scopes.pop_back();
+    }
+
+    // Bind `symbol` in the innermost scope. Returns false (and leaves the
+    // table untouched) if the symbol is already declared in that scope.
+    bool declare(SymbolId symbol, T value)
+    {
+        if (declaredInCurrentScope(symbol))
+        {
+            return false;
+        }
+        if ((size_t)symbol >= shadowStack.size())
+        {
+            shadowStack.resize(symbol + 1);
+        }
+        shadowStack[symbol].push_back(Binding{value, (int)scopes.size()});
+        scopes.back().push_back(symbol);
+        return true;
+    }
+
+    // Returns the innermost visible binding of `symbol`, or nullptr
+    T *lookup(SymbolId symbol)
+    {
+        if (symbol < 0 || (size_t)symbol >= shadowStack.size() || shadowStack[symbol].empty())
+        {
+            return nullptr;
+        }
+        return &shadowStack[symbol].back().value;
+    }
+
+    bool declaredInCurrentScope(SymbolId symbol) const
+    {
+        return symbol >= 0 && (size_t)symbol < shadowStack.size() && !shadowStack[symbol].empty() &&
+               shadowStack[symbol].back().depth == (int)scopes.size();
+    }
+
+    // Symbols declared in each open scope, outermost first (for debugging)
+    const vector<vector<SymbolId>> &getScopes() const
+    {
+        return scopes;
+    }
+
+private:
+    struct Binding
+    {
+        T value;
+        int depth;
+    };
+
+    vector<vector<Binding>> shadowStack;
+    vector<vector<SymbolId>> scopes;
+};
+
+#endif // SYMBOL_TABLE_H
@@ -67,3 +67,51 @@ for file in `ls "$dir"/"$semantic"/*.c`; do
     fi
     echo "----------------------------------------"
 done
+
+# Run the semantic analysis tests again with semantic analysis fused into IR generation
+# The fused mode must report the same errors and fail with exit code 3, like the separate pass.
+for file in `ls "$dir"/"$semantic"/*.c`; do
+    echo "Running $file (--fused)"
+    ./frontend --fused "$file"
+    if [ $? -eq 3 ]; then
+        echo -e "${GREEN}Test passed: $file${NC}"
+    else
+        echo -e "${RED}Test failed: $file${NC}"
+    fi
+    echo "----------------------------------------"
+done
+
+# Deeply nested input (machine-generated style): semantic analysis, IR generation and
+# freeNode walk a flat AST tape instead of recursing, so this must pass even with a small stack
+deep=deep_nesting.c
+{
+    printf 'extern void print(int);\nextern int read();\nint func(int a){\nint b;\nb = 0;\n'
+    for i in `seq 20000`; do printf 'if (a > 0) {\nwhile (b < 0) {\n'; done
+    printf 'b = b + 1;\n'
+    for i in `seq 20000`; do printf '}\n}\n'; done
+    printf 'print(b);\nreturn b;\n}\n'
+} > "$deep"
+echo "Running $deep (40000 nested statements, 1 MB stack)"
+(ulimit -s 1024; ./frontend "$deep" && ./frontend --fused "$deep")
+if [ $? -eq 0 ]; then
+    echo -e "${GREEN}Test passed: $deep${NC}"
+else
+    echo -e "${RED}Test failed: $deep${NC}"
+fi
+rm -f "$deep" deep_nesting_manual.ll
+echo "----------------------------------------"
+
+# Batch mode: compile every semantic analysis test at once on 4 threads. Each file is
+# compiled independently, so each must report its own failure and the batch must exit with 3.
+files=`ls "$dir"/"$semantic"/*.c`
+count=`echo $files | wc -w`
+echo "Running batch of $count files (-j4)"
+output=`./frontend -j4 $files`
+ret_value=$?
+failed=`echo "$output" | grep -c ": Result: Semantic analysis unsuccessful."`
+if [[ $ret_value -eq 3 && $failed -eq $count ]]; then
+    echo -e "${GREEN}Test passed: batch mode${NC}"
+else
+    echo -e "${RED}Test failed: batch mode${NC}"
+fi
+echo "----------------------------------------"
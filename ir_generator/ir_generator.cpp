@@ -26,17 +26,25 @@
 #include <stdlib.h>
 #include <cstring>
 #include "ast.h"
+#include "ir_generator.h"
 #include "file_utils.h"
-#include <unordered_map>
+#include "symbol_table.h"
+#include "ast_tape.h"
+#include <iostream>
 #include <string>
 #include <vector>
-#include <set>
 
 using namespace std;
 
-// Local function prototype
-static LLVMValueRef
-traverseASTAndGenerateIR(astNode *node, LLVMModuleRef &module, LLVMBuilderRef &builder, LLVMValueRef &func, vector<unordered_map<string, LLVMValueRef>> &varMap, LLVMTypeRef intType);
+// Maps each visible variable to the alloca holding its value. When semantic
+// analysis is fused into IR generation, the map also records whether an
+// undeclared variable was found during the walk, and where it is reported.
+struct VarMap : ScopedSymbolTable<LLVMValueRef>
+{
+	bool checkDeclarations = false;
+	bool errorFound = false;
+	ostream *diagnostics = &cout;
+};
 
 /* This array maps rop_type values to corresponding LLVMIntPredicate values.
  *
@@ -75,248 +83,304 @@ LLVMOpcode opcodes[] = {
 };
 
 /**
- * @brief Emits LLVM IR code for the given block and branch to the exit block.
+ * @brief Looks up the alloca of the innermost visible declaration of a variable.
  *
- * @param module       Reference to the LLVM module
- * @param builder      Reference to the LLVM IR builder
- * @param func         Reference to the LLVM function
- * @param varMap       A map of variable names and their LLVM values
- * @param intType      The LLVM integer type (32-bit)
- * @param body         Pointer to the AST node representing the block body
- * @param currBlock    Reference to the current basic block
- * @param exitBlock    Reference to the exit basic block
+ * When declarations are being checked (fused semantic analysis), an undeclared
+ * variable is reported with the same message semantic analysis prints.
+ *
+ * @param varMap  Scoped symbol table mapping variables to their LLVM values
+ * @param symbol  The interned variable name
+ * @return        The variable's alloca, or nullptr if it is not declared
  */
-static void
-emitBlock(LLVMModuleRef &module, LLVMBuilderRef &builder, LLVMValueRef &func, vector<unordered_map<string, LLVMValueRef>> &varMap, LLVMTypeRef intType, astNode *body, LLVMBasicBlockRef &currBlock, LLVMBasicBlockRef &exitBlock)
+static LLVMValueRef
+lookupVar(VarMap &varMap, SymbolId symbol)
 {
-	if (!body || !currBlock)
+	LLVMValueRef *varPtr = varMap.lookup(symbol);
+	if (varPtr)
 	{
-		return;
+		return *varPtr;
 	}
-	// Position the builder at the end of the current block
-	LLVMPositionBuilderAtEnd(builder, currBlock);
 
-	// Generate LLVM IR code for the body
-	traverseASTAndGenerateIR(body, module, builder, func, varMap, intType);
+	if (varMap.checkDeclarations)
+	{
+		*varMap.diagnostics << "Error: undeclared variable '" << symbolName(symbol) << "'" << endl;
+		varMap.errorFound = true;
+	}
+	return nullptr;
+}
 
-	// Unconditionally branch to the exit block
-	LLVMBuildBr(builder, exitBlock);
+// Everything the generator carries from one step of the AST walk to the next
+struct IRGenState
+{
+	LLVMContextRef context; // owned by the caller, one per compilation
+	LLVMModuleRef module;
+	LLVMBuilderRef builder;
+	LLVMValueRef func;
+	LLVMTypeRef intType;
+	VarMap varMap;
+
+	// Values of the sub-expressions waiting for their parent, innermost last
+	vector<LLVMValueRef> values;
+
+	// Three blocks per enclosing if/while statement, innermost last:
+	// while: header, body, exit    if: if, else (or nullptr), exit
+	vector<LLVMBasicBlockRef> blocks;
+
+	// The next variable visit names a function parameter or an assignment
+	// target, which is handled by its parent instead of being loaded
+	bool bindingNext = false;
+};
+
+static LLVMValueRef
+popValue(IRGenState &state)
+{
+	LLVMValueRef value = state.values.back();
+	state.values.pop_back();
+	return value;
+}
+
+// Drops the result of the statement the walk just left, if it pushed one:
+// a call pushes its result for an enclosing assignment or return, and
+// nothing pops it when the call is a statement of its own
+static void
+discardStatementResult(const astVisit &visit, IRGenState &state)
+{
+	astNode *statement = astChild(visit.node, visit.step - 1);
+	if (statement && statement->type == ast_stmt && statement->stmt.type == ast_call)
+	{
+		state.values.pop_back();
+	}
 }
 
 /**
- * @brief Traverse the AST and generate LLVM IR code for the input statement.
+ * @brief Emits LLVM IR code for one step of the walk over a statement node.
  *
- * @param stmt The input statement (AST) to be processed.
- * @param module The LLVM module being constructed.
- * @param builder The LLVM IR builder.
- * @param func The current LLVM function.
- * @param varMap A map storing the LLVM values of variables in the current scope.
- * @param intType The LLVM type of an integer.
- * @return The LLVMValueRef of the resulting LLVM IR or nullptr if the node does not generate a value.
+ * Control flow is built across the steps of a statement: blocks are created
+ * when the walk reaches the slot they are needed for, and blocks that must
+ * come after a nested body in the function layout are created detached and
+ * appended once that body is done.
+ *
+ * @param visit  The current step of the AST walk (see ast_tape.h).
+ * @param state  The generator state.
  */
-static LLVMValueRef
-traverseStmtAndGenerateIR(astStmt *stmt, LLVMModuleRef &module, LLVMBuilderRef &builder, LLVMValueRef &func, vector<unordered_map<string, LLVMValueRef>> &varMap, LLVMTypeRef intType)
+static void
+emitStmtStep(const astVisit &visit, IRGenState &state)
 {
-	LLVMValueRef result = nullptr;
+	astStmt *stmt = &visit.node->stmt;
+	LLVMBuilderRef builder = state.builder;
+	LLVMValueRef func = state.func;
+	LLVMTypeRef intType = state.intType;
+	vector<LLVMBasicBlockRef> &blocks = state.blocks;
+
 	switch (stmt->type)
 	{
 	case ast_call:
 	{
-		if (!strcmp(stmt->call.name, "print"))
+		// The call is emitted once its argument (if any) has been evaluated
+		if (!isExit(visit))
+		{
+			break;
+		}
+
+		if (!strcmp(symbolName(stmt->call.symbol), "print"))
 		{
 			// Get the 'print' function from the module
-			LLVMValueRef printFunc = LLVMGetNamedFunction(module, "print");
+			LLVMValueRef printFunc = LLVMGetNamedFunction(state.module, "print");
 
-			// Generate the IR code for the print function argument
-			LLVMValueRef arg = traverseASTAndGenerateIR(stmt->call.param, module, builder, func, varMap, intType);
-			LLVMValueRef args[] = {arg};
+			// The IR code for the print function argument has already been generated
+			LLVMValueRef args[] = {popValue(state)};
 
 			// Function type of the 'print' function
 			LLVMTypeRef printParamTypes[] = {intType}; // One integer parameter
-			LLVMTypeRef printFuncType = LLVMFunctionType(LLVMVoidType(), printParamTypes, 1, 0);
+			LLVMTypeRef printFuncType = LLVMFunctionType(LLVMVoidTypeInContext(state.context), printParamTypes, 1, 0);
 
 			// Build the call instruction for the 'print' function
-			LLVMBuildCall2(builder, printFuncType, printFunc, args, 1, "");
+			state.values.push_back(LLVMBuildCall2(builder, printFuncType, printFunc, args, 1, ""));
 		}
-		else if (!strcmp(stmt->call.name, "read"))
+		else if (!strcmp(symbolName(stmt->call.symbol), "read"))
 		{
 			// Get the 'read' function from the module
-			LLVMValueRef readFunc = LLVMGetNamedFunction(module, "read");
+			LLVMValueRef readFunc = LLVMGetNamedFunction(state.module, "read");
 
 			// Function type of the 'read' function
 			LLVMTypeRef readFuncType = LLVMFunctionType(intType, nullptr, 0, 0);
 
 			// Build the call instruction for the 'read' function
-			result = LLVMBuildCall2(builder, readFuncType, readFunc, nullptr, 0, "");
+			state.values.push_back(LLVMBuildCall2(builder, readFuncType, readFunc, nullptr, 0, ""));
 		}
 		break;
 	}
 	case ast_ret:
 	{
-		// Handle 'return' statement
-		LLVMValueRef returnValue = traverseASTAndGenerateIR(stmt->ret.expr, module, builder, func, varMap, intType);
-		LLVMBuildRet(builder, returnValue);
+		// Handle 'return' statement once the returned expression is evaluated
+		if (isExit(visit))
+		{
+			LLVMBuildRet(builder, popValue(state));
+		}
 		break;
 	}
 	case ast_block:
 	{
-		// Handle 'block' statement
-		// create a new symbol table currSymTable and push it to symbol table stack
-		unordered_map<string, LLVMValueRef> currSymTable;
-		varMap.push_back(currSymTable);
-
-		for (auto &node : *stmt->block.stmt_list)
+		// Handle 'block' statement: open a new scope for the block on the
+		// first visit and close it after the last statement
+		if (isEnter(visit))
 		{
-			traverseASTAndGenerateIR(node, module, builder, func, varMap, intType);
+			state.varMap.enterScope();
+		}
+		else
+		{
+			discardStatementResult(visit, state);
+		}
+		if (isExit(visit))
+		{
+			state.varMap.exitScope();
 		}
-
-		// pop the symbol table from the stack
-		varMap.pop_back();
 		break;
 	}
 	case ast_while:
 	{
-		// Create a new basic block to start insertion into (headerBlock).
-		LLVMBasicBlockRef headerBlock = LLVMAppendBasicBlock(func, "");
-
-		// Create an unconditional branch instruction to jump to the new bb
-		LLVMBuildBr(builder, headerBlock);
+		if (visit.step == 0)
+		{
+			// Create a new basic block to start insertion into (headerBlock).
+			LLVMBasicBlockRef headerBlock = LLVMAppendBasicBlockInContext(state.context, func, "");
 
-		// Create basic blocks for the while body
-		LLVMBasicBlockRef bodyBlock = LLVMAppendBasicBlock(func, "");
+			// Create an unconditional branch instruction to jump to the new bb
+			LLVMBuildBr(builder, headerBlock);
 
-		// Emit code for the body block
-		emitBlock(module, builder, func, varMap, intType, stmt->whilen.body, bodyBlock, headerBlock);
+			// Create basic blocks for the while body
+			LLVMBasicBlockRef bodyBlock = LLVMAppendBasicBlockInContext(state.context, func, "");
 
-		// Create basic blocks for the while exit
-		LLVMBasicBlockRef exitBlock = LLVMAppendBasicBlock(func, "");
+			// The condition is evaluated at the end of the headerBlock
+			LLVMPositionBuilderAtEnd(builder, headerBlock);
 
-		// Position the builder at the end of the headerBlock
-		LLVMPositionBuilderAtEnd(builder, headerBlock);
+			blocks.push_back(headerBlock);
+			blocks.push_back(bodyBlock);
+			blocks.push_back(nullptr);
+		}
+		else if (visit.step == 1)
+		{
+			// Create the exit block; it is added to the function after the body's blocks
+			LLVMBasicBlockRef exitBlock = LLVMCreateBasicBlockInContext(state.context, "");
+			blocks.back() = exitBlock;
 
-		// Get the result of the condition comparison
-		LLVMValueRef cmp = traverseASTAndGenerateIR(stmt->whilen.cond, module, builder, func, varMap, intType);
+			// Create a conditional branch based on the comparison result in the headerBlock
+			LLVMBuildCondBr(builder, popValue(state), blocks[blocks.size() - 2], exitBlock);
 
-		// Create a conditional branch based on the comparison result in the headerBlock
-		LLVMBuildCondBr(builder, cmp, bodyBlock, exitBlock);
+			// Emit code for the body block
+			LLVMPositionBuilderAtEnd(builder, blocks[blocks.size() - 2]);
+		}
+		else
+		{
+			discardStatementResult(visit, state);
+			LLVMBasicBlockRef headerBlock = blocks[blocks.size() - 3];
+			LLVMBasicBlockRef exitBlock = blocks.back();
+			blocks.resize(blocks.size() - 3);
 
-		// Emit code for the exit block
-		LLVMPositionBuilderAtEnd(builder, exitBlock);
+			// Unconditionally branch back to the header at the end of the body
+			LLVMBuildBr(builder, headerBlock);
 
+			// Emit code for the exit block
+			LLVMAppendExistingBasicBlock(func, exitBlock);
+			LLVMPositionBuilderAtEnd(builder, exitBlock);
+		}
 		break;
 	}
 	case ast_if:
 	{
-		// Create an if stmt basic block
-		LLVMBasicBlockRef ifBlock = LLVMAppendBasicBlock(func, "");
-
-		// Get the current basic block where the if statement is being inserted into
-		LLVMBasicBlockRef insertionBlock = LLVMGetInsertBlock(builder);
-
-		// Position the builder at the end of the ifBlock
-		LLVMPositionBuilderAtEnd(builder, ifBlock);
-
-		// Generate LLVM IR code for the if_body
-		traverseASTAndGenerateIR(stmt->ifn.if_body, module, builder, func, varMap, intType);
-
-		// Get the last basic block created within the nested constructs of the ifBlock
-		LLVMBasicBlockRef lastIfBlock = LLVMGetLastBasicBlock(func);
-
-		// Create a basic block for the else block
-		LLVMBasicBlockRef elseBlock = nullptr;
-		LLVMBasicBlockRef lastElseBlock = nullptr;
-
-		// Emit code for the else block
-		if (stmt->ifn.else_body)
+		if (visit.step == 1)
 		{
-			elseBlock = LLVMAppendBasicBlock(func, "");
-			LLVMPositionBuilderAtEnd(builder, elseBlock);
+			// The condition has been evaluated in the block the if statement is inserted into.
+			// Create an if stmt basic block, and the else and exit blocks, which are added to
+			// the function after the blocks of the bodies that precede them
+			LLVMBasicBlockRef ifBlock = LLVMAppendBasicBlockInContext(state.context, func, "");
+			LLVMBasicBlockRef elseBlock = stmt->ifn.else_body ? LLVMCreateBasicBlockInContext(state.context, "") : nullptr;
+			LLVMBasicBlockRef exitBlock = LLVMCreateBasicBlockInContext(state.context, "");
+
+			// Create a conditional branch based on the comparison result.
+			// If there's no else body, branch to exitBlock directly
+			LLVMBuildCondBr(builder, popValue(state), ifBlock, elseBlock ? elseBlock : exitBlock);
 
-			// Generate LLVM IR code for the else_body
-			traverseASTAndGenerateIR(stmt->ifn.else_body, module, builder, func, varMap, intType);
+			// Generate LLVM IR code for the if_body in the ifBlock
+			LLVMPositionBuilderAtEnd(builder, ifBlock);
 
-			// Get the last basic block created within the nested constructs of the elseBlock
-			lastElseBlock = LLVMGetLastBasicBlock(func);
+			blocks.push_back(ifBlock);
+			blocks.push_back(elseBlock);
+			blocks.push_back(exitBlock);
 		}
+		else if (visit.step == 2)
+		{
+			discardStatementResult(visit, state);
+			LLVMBasicBlockRef elseBlock = blocks[blocks.size() - 2];
 
-		// Position the builder at the end of the block where the condition was evaluated
-		LLVMPositionBuilderAtEnd(builder, insertionBlock);
-
-		// Create a basic block for the exit block
-		LLVMBasicBlockRef exitBlock = nullptr;
-
-		// Get the result of the condition comparison
-		LLVMValueRef cmp = traverseASTAndGenerateIR(stmt->ifn.cond, module, builder, func, varMap, intType);
+			// Unconditionally branch to the exit block from the last basic block
+			// created within the nested constructs of the ifBlock
+			LLVMPositionBuilderAtEnd(builder, LLVMGetLastBasicBlock(func));
+			LLVMBuildBr(builder, blocks.back());
 
-		// Create a conditional branch based on the comparison result
-		if (stmt->ifn.else_body)
-		{
-			LLVMBuildCondBr(builder, cmp, ifBlock, elseBlock);
-			exitBlock = LLVMAppendBasicBlock(func, "");
+			// Emit code for the else block
+			if (elseBlock)
+			{
+				LLVMAppendExistingBasicBlock(func, elseBlock);
+				LLVMPositionBuilderAtEnd(builder, elseBlock);
+			}
 		}
-		else
+		else if (visit.step == 3)
 		{
-			// If there's no else body, branch to exitBlock directly
-			exitBlock = LLVMAppendBasicBlock(func, "");
-			LLVMBuildCondBr(builder, cmp, ifBlock, exitBlock);
-		}
-
-		// Position the builder at the end of the last basic block of the if_block
-		LLVMPositionBuilderAtEnd(builder, lastIfBlock);
+			discardStatementResult(visit, state);
+			LLVMBasicBlockRef elseBlock = blocks[blocks.size() - 2];
+			LLVMBasicBlockRef exitBlock = blocks.back();
+			blocks.resize(blocks.size() - 3);
 
-		// Unconditionally branch to the exit block
-		LLVMBuildBr(builder, exitBlock);
-
-		// Unconditionally branch to the exit block if there's an else body
-		if (stmt->ifn.else_body)
-		{
-			// Position the builder at the end of the last basic block of the else_block
-			LLVMPositionBuilderAtEnd(builder, lastElseBlock);
+			// Unconditionally branch to the exit block from the last basic block of the else_block
+			if (elseBlock)
+			{
+				LLVMPositionBuilderAtEnd(builder, LLVMGetLastBasicBlock(func));
+				LLVMBuildBr(builder, exitBlock);
+			}
 
-			// Unconditionally branch to the exit block
-			LLVMBuildBr(builder, exitBlock);
+			// Emit code for the exit block
+			LLVMAppendExistingBasicBlock(func, exitBlock);
+			LLVMPositionBuilderAtEnd(builder, exitBlock);
 		}
-
-		// Emit code for the exit block
-		LLVMPositionBuilderAtEnd(builder, exitBlock);
-
 		break;
 	}
 	case ast_asgn:
 	{
-		// Generate LLVM IR code for the assignment statement
-		LLVMValueRef rhsValue = traverseASTAndGenerateIR(stmt->asgn.rhs, module, builder, func, varMap, intType);
-
-		// Search the pointer to the variable from the symbol table starting from the top of the stack
-		LLVMValueRef varPtr;
-		for (int i = varMap.size() - 1; i >= 0; i--)
+		if (visit.step == 0)
+		{
+			// Look up the innermost visible pointer to the variable (before the rhs,
+			// so undeclared variables are reported in source order)
+			state.values.push_back(lookupVar(state.varMap, stmt->asgn.lhs->var.symbol));
+			state.bindingNext = true;
+		}
+		else if (isExit(visit))
 		{
-			if (varMap[i].find(stmt->asgn.lhs->var.name) != varMap[i].end())
+			// Generate LLVM IR code for the assignment statement
+			LLVMValueRef rhsValue = popValue(state);
+			LLVMValueRef varPtr = popValue(state);
+			if (varPtr)
 			{
-				varPtr = varMap[i][stmt->asgn.lhs->var.name];
-				break;
+				LLVMBuildStore(builder, rhsValue, varPtr);
 			}
 		}
-
-		LLVMBuildStore(builder, rhsValue, varPtr);
 		break;
 	}
 	case ast_decl:
 	{
 		// Generate LLVM IR code for the declaration statement
 		// Check if the variable has already been declared in the same scope
-		if (varMap.back().find(stmt->decl.name) != varMap.back().end())
+		if (state.varMap.declaredInCurrentScope(stmt->decl.symbol))
 		{
-			printf("Error: Variable '%s' already declared in the same scope\n", stmt->decl.name);
+			printf("Error: Variable '%s' already declared in the same scope\n", symbolName(stmt->decl.symbol));
 			exit(1);
 		}
 
 		// Create an alloca instruction and set the alignment to 4 bytes
-		LLVMValueRef var = LLVMBuildAlloca(builder, intType, stmt->decl.name);
+		LLVMValueRef var = LLVMBuildAlloca(builder, intType, symbolName(stmt->decl.symbol));
 		LLVMSetAlignment(var, 4);
 
-		// Add the variable to the symbol table at the top of the stack
-		varMap.back()[stmt->decl.name] = var;
+		// Add the variable to the innermost scope
+		state.varMap.declare(stmt->decl.symbol, var);
 		break;
 	}
 	default:
@@ -325,32 +389,30 @@ traverseStmtAndGenerateIR(astStmt *stmt, LLVMModuleRef &module, LLVMBuilderRef &
 		break;
 	}
 	}
-	return result;
 }
 
 /**
- * Traverses the Abstract Syntax Tree (AST) and generates LLVM IR code for each node.
+ * Emits LLVM IR code for one step of the walk over the Abstract Syntax Tree (AST).
+ *
+ * Expressions are evaluated in post-order: each expression node builds its
+ * instruction on its last visit from the values its children pushed, and
+ * pushes its own result for its parent.
  *
- * @param node      The current AST node being processed.
- * @param module    Reference to the LLVM module.
- * @param builder   Reference to the LLVM IR builder.
- * @param func      Reference to the current LLVM function being processed.
- * @param varMap    Reference to the map of variable names and their corresponding LLVM values.
- * @param intType   The LLVM integer type used in the generated code.
- * @return          Returns the LLVM value for the given AST node or nullptr if the node does not generate a value.
+ * @param visit  The current step of the AST walk (see ast_tape.h).
+ * @param state  The generator state.
  */
-static LLVMValueRef
-traverseASTAndGenerateIR(astNode *node, LLVMModuleRef &module, LLVMBuilderRef &builder, LLVMValueRef &func, vector<unordered_map<string, LLVMValueRef>> &varMap, LLVMTypeRef intType)
+static void
+emitStep(const astVisit &visit, IRGenState &state)
 {
-	LLVMValueRef result = nullptr;
+	astNode *node = visit.node;
+	LLVMBuilderRef builder = state.builder;
+	LLVMTypeRef intType = state.intType;
+
 	switch (node->type)
 	{
 	case ast_prog:
 	{
-		// Traverse the AST nodes for external declarations and functions
-		traverseASTAndGenerateIR(node->prog.ext1, module, builder, func, varMap, intType);
-		traverseASTAndGenerateIR(node->prog.ext2, module, builder, func, varMap, intType);
-		traverseASTAndGenerateIR(node->prog.func, module, builder, func, varMap, intType);
+		// The external declarations and the function are emitted as they are visited
 		break;
 	}
 	case ast_extern:
@@ -361,7 +423,7 @@ traverseASTAndGenerateIR(astNode *node, LLVMModuleRef &module, LLVMBuilderRef &b
 		if (!strcmp(node->ext.name, "print"))
 		{
 			LLVMTypeRef printParamTypes[] = {intType};								  // One integer parameter
-			externFuncType = LLVMFunctionType(LLVMVoidType(), printParamTypes, 1, 0); // Return type is void
+			externFuncType = LLVMFunctionType(LLVMVoidTypeInContext(state.context), printParamTypes, 1, 0); // Return type is void
 		}
 		else if (!strcmp(node->ext.name, "read"))
 		{
@@ -369,102 +431,117 @@ traverseASTAndGenerateIR(astNode *node, LLVMModuleRef &module, LLVMBuilderRef &b
 		}
 
 		// Add the function to the module
-		func = LLVMAddFunction(module, node->ext.name, externFuncType);
+		state.func = LLVMAddFunction(state.module, node->ext.name, externFuncType);
 		break;
 	}
 	case ast_func:
 	{
+		if (isExit(visit))
+		{
+			// Close the function scope (MiniC only has one function)
+			state.varMap.exitScope();
+			break;
+		}
+		if (!isEnter(visit))
+		{
+			break;
+		}
+
 		// Create a non-variadic function type that returns an integer and takes one parameter of integer type
 		LLVMTypeRef returnType = intType;
 		LLVMTypeRef paramTypes[] = {intType};
 		LLVMTypeRef funcType = LLVMFunctionType(returnType, paramTypes, 1, 0);
 
 		// Add the function to the module
-		func = LLVMAddFunction(module, node->func.name, funcType);
+		state.func = LLVMAddFunction(state.module, node->func.name, funcType);
 
 		// Create a new basic block to start insertion into.
-		LLVMBasicBlockRef entryBlock = LLVMAppendBasicBlock(func, "");
+		LLVMBasicBlockRef entryBlock = LLVMAppendBasicBlockInContext(state.context, state.func, "");
 
 		// Create a builder to generate instructions with.
 		LLVMPositionBuilderAtEnd(builder, entryBlock);
 
-		// create a new symbol table currSymTable and push it to symbol table stack
-		unordered_map<string, LLVMValueRef> currSymTable;
-		varMap.push_back(currSymTable);
+		// open the function scope
+		state.varMap.enterScope();
 
 		if (node->func.param)
 		{
 			// Create a variable for the func parameter and store it in the entry block
-			LLVMValueRef var = LLVMBuildAlloca(builder, intType, node->func.param->var.name);
+			LLVMValueRef var = LLVMBuildAlloca(builder, intType, symbolName(node->func.param->var.symbol));
 			LLVMSetAlignment(var, 4);
-			LLVMBuildStore(builder, LLVMGetParam(func, 0), var);
+			LLVMBuildStore(builder, LLVMGetParam(state.func, 0), var);
 
-			// Add the variable to the variable map in the top symbol table
-			varMap.back()[node->func.param->var.name] = var;
-		}
-
-		// Traverse the function body
-		traverseASTAndGenerateIR(node->func.body, module, builder, func, varMap, intType);
-
-		// Pop the top of the variable map (MiniC only has one function)
-		varMap.pop_back();
+			// Add the variable to the function scope
+			state.varMap.declare(node->func.param->var.symbol, var);
 
+			// The parameter is the next node visited; it must not be loaded
+			state.bindingNext = true;
+		}
 		break;
 	}
 	case ast_stmt:
 	{
 		// Handle statement
-		result = traverseStmtAndGenerateIR(&node->stmt, module, builder, func, varMap, intType);
+		emitStmtStep(visit, state);
 		break;
 	}
 	case ast_var:
 	{
-		// Load the value of a variable - start check from the top of the symbol table stack
-		for (int i = varMap.size() - 1; i >= 0; i--)
+		if (state.bindingNext)
 		{
-			if (varMap[i].find(node->var.name) != varMap[i].end())
-			{
-				result = LLVMBuildLoad2(builder, intType, varMap[i][node->var.name], "");
-				break;
-			}
+			// A function parameter or assignment target: already handled by the parent
+			state.bindingNext = false;
+			break;
 		}
+
+		// Load the value of a variable from its innermost visible declaration.
+		// An undeclared variable (already reported) reads as undef so the walk can go on.
+		LLVMValueRef varPtr = lookupVar(state.varMap, node->var.symbol);
+		state.values.push_back(varPtr ? LLVMBuildLoad2(builder, intType, varPtr, "") : LLVMGetUndef(intType));
 		break;
 	}
 	case ast_cnst:
 	{
 		// Handle constant integer value
-		result = LLVMConstInt(intType, node->cnst.value, 0);
+		state.values.push_back(LLVMConstInt(intType, node->cnst.value, 0));
 		break;
 	}
 	case ast_rexpr:
 	{
-		// Handle relational expression
-		LLVMValueRef lhs = traverseASTAndGenerateIR(node->rexpr.lhs, module, builder, func, varMap, intType);
-		LLVMValueRef rhs = traverseASTAndGenerateIR(node->rexpr.rhs, module, builder, func, varMap, intType);
+		// Handle relational expression once both operands are evaluated
+		if (isExit(visit))
+		{
+			LLVMValueRef rhs = popValue(state);
+			LLVMValueRef lhs = popValue(state);
 
-		// Compare the two values and return the result
-		LLVMIntPredicate intPredicate = intPredicates[node->rexpr.op];
-		result = LLVMBuildICmp(builder, intPredicate, lhs, rhs, "");
+			// Compare the two values and push the result
+			LLVMIntPredicate intPredicate = intPredicates[node->rexpr.op];
+			state.values.push_back(LLVMBuildICmp(builder, intPredicate, lhs, rhs, ""));
+		}
 		break;
 	}
 	case ast_bexpr:
 	{
-		// Handle binary expression
-		LLVMValueRef lhs = traverseASTAndGenerateIR(node->bexpr.lhs, module, builder, func, varMap, intType);
-		LLVMValueRef rhs = traverseASTAndGenerateIR(node->bexpr.rhs, module, builder, func, varMap, intType);
+		// Handle binary expression once both operands are evaluated
+		if (isExit(visit))
+		{
+			LLVMValueRef rhs = popValue(state);
+			LLVMValueRef lhs = popValue(state);
 
-		// Perform the binary operation and return the result
-		LLVMOpcode opcode = opcodes[node->bexpr.op];
-		result = LLVMBuildBinOp(builder, opcode, lhs, rhs, "");
+			// Perform the binary operation and push the result
+			LLVMOpcode opcode = opcodes[node->bexpr.op];
+			state.values.push_back(LLVMBuildBinOp(builder, opcode, lhs, rhs, ""));
+		}
 		break;
 	}
 	case ast_uexpr:
 	{
-		// Handle unary expression
-		LLVMValueRef expr = traverseASTAndGenerateIR(node->uexpr.expr, module, builder, func, varMap, intType);
-
-		// Perform the unary operation and return the result
-		result = LLVMBuildNeg(builder, expr, "");
+		// Handle unary expression once its operand is evaluated
+		if (isExit(visit))
+		{
+			// Perform the unary operation and push the result
+			state.values.push_back(LLVMBuildNeg(builder, popValue(state), ""));
+		}
 		break;
 	}
 	default:
@@ -473,7 +550,6 @@ traverseASTAndGenerateIR(astNode *node, LLVMModuleRef &module, LLVMBuilderRef &b
 		break;
 	}
 	}
-	return result;
 }
 
 /**
@@ -481,10 +557,12 @@ traverseASTAndGenerateIR(astNode *node, LLVMModuleRef &module, LLVMBuilderRef &b
  *
  * @param node      The Abstract Syntax Tree (AST) node to generate LLVM IR code from.
  * @param filename  The input filename, used as the basis for the output file's name.
+ * @param semanticError  If non-null, semantic analysis is fused into this walk: undeclared variables are
+ *                       reported while the IR is emitted, and *semanticError tells whether any were found.
  * @return          Returns a pointer to the generated LLVM module, or nullptr if there was an error.
  */
 LLVMModuleRef
-generateIRAndSaveToFile(astNode *node, const char *filename)
+generateIRAndSaveToFile(astNode *node, const char *filename, bool *semanticError)
 {
 	if (!node)
 	{
@@ -492,23 +570,23 @@ generateIRAndSaveToFile(astNode *node, const char *filename)
 		return nullptr;
 	}
 
-	// Create LLVM module, builder, int primitive type, and function
-	LLVMModuleRef module = LLVMModuleCreateWithName(filename);
-	LLVMSetTarget(module, "x86_64-pc-linux-gnu");
-	LLVMBuilderRef builder = LLVMCreateBuilder();
-	LLVMTypeRef intType = LLVMInt32Type();
-	LLVMValueRef func;
-
-	// Initialize a vector of map to store the value references of variables
-	std::vector<unordered_map<string, LLVMValueRef>> varMap;
-
-	// Traverse the AST to generate LLVM IR code
-	traverseASTAndGenerateIR(node, module, builder, func, varMap, intType);
+	astTape tape;
+	buildTape(node, tape);
+	return generateIRAndSaveToFile(tape, filename, semanticError);
+}
 
-	// Verify the generated module
-	if (LLVMVerifyModule(module, LLVMAbortProcessAction, nullptr))
+/**
+ * Same as above, for an AST that has already been linearized (see ast_tape.h).
+ */
+LLVMModuleRef
+generateIRAndSaveToFile(const astTape &tape, const char *filename, bool *semanticError)
+{
+	// A context of our own, so files can be compiled in parallel
+	LLVMContextRef context = LLVMContextCreate();
+	LLVMModuleRef module = generateIR(tape, filename, context, semanticError);
+	if (!module)
 	{
-		printf("Error: The module is not valid\n");
+		LLVMContextDispose(context);
 		return nullptr;
 	}
 
@@ -519,16 +597,78 @@ generateIRAndSaveToFile(astNode *node, const char *filename)
 	changeFileExtension(filename, outputFilename, "_manual.ll");
 
 	// Write the generated LLVM IR code to a file called outputFilename
-	LLVMPrintModuleToFile(module, outputFilename.c_str(), nullptr);
+	bool saved = saveLLVMModel(module, outputFilename.c_str());
+
+	// Cleanup
+	LLVMDisposeModule(module);
+	LLVMContextDispose(context);
+
+	return saved ? module : nullptr;
+}
+
+/**
+ * Generates the LLVM IR of an AST tape into a new module owned by `context`, without writing it
+ * anywhere. The IR is generated in a single loop over the tape, so deep nesting does not grow the stack.
+ */
+LLVMModuleRef
+generateIR(const astTape &tape, const char *filename, LLVMContextRef context, bool *semanticError,
+		   ostream *diagnostics)
+{
+	if (tape.visits.empty())
+	{
+		printf("Error: AST is empty\n");
+		return nullptr;
+	}
+
+	// Create the LLVM module, builder, int primitive type, and function in the caller's context
+	IRGenState state;
+	state.context = context;
+	state.module = LLVMModuleCreateWithNameInContext(filename, state.context);
+	LLVMSetTarget(state.module, "x86_64-pc-linux-gnu");
+	state.builder = LLVMCreateBuilderInContext(state.context);
+	state.intType = LLVMInt32TypeInContext(state.context);
+	state.func = nullptr;
+
+	// The scoped symbol table stores the value references of variables
+	state.varMap.checkDeclarations = semanticError != nullptr;
+	if (diagnostics)
+	{
+		state.varMap.diagnostics = diagnostics;
+	}
+
+	// Walk the AST to generate LLVM IR code
+	for (const astVisit &visit : tape.visits)
+	{
+		emitStep(visit, state);
+	}
+
+	LLVMModuleRef module = state.module;
+	LLVMDisposeBuilder(state.builder);
+
+	if (semanticError)
+	{
+		*semanticError = state.varMap.errorFound;
+	}
+
+	// The program is not valid MiniC: throw away the partially built module
+	if (state.varMap.errorFound)
+	{
+		LLVMDisposeModule(module);
+		return nullptr;
+	}
+
+	// Verify the generated module
+	if (LLVMVerifyModule(module, LLVMAbortProcessAction, nullptr))
+	{
+		printf("Error: The module is not valid\n");
+		LLVMDisposeModule(module);
+		return nullptr;
+	}
 
 #ifdef DEBUG
 	// Print the generated LLVM IR code to the console
 	LLVMDumpModule(module);
 #endif
 
-	// Cleanup
-	LLVMDisposeBuilder(builder);
-	LLVMDisposeModule(module);
-
 	return module;
-}
\ No newline at end of file
+}
@@ -16,15 +16,42 @@
 #define LLVM_IR_GENERATOR_H
 
 #include "ast.h"
+#include "ast_tape.h"
 #include <llvm-c/Core.h>
+#include <ostream>
 
 /**
  * Generates LLVM IR code from the given AST and saves it to a file with a '_manual.ll' extension.
  *
+ * When semanticError is non-null, semantic analysis is fused into the same AST walk: undeclared
+ * variables are reported while the IR is emitted, *semanticError is set if any were found, and the
+ * partially built module is discarded. This saves the separate semanticAnalysis() traversal.
+ *
  * @param node      The Abstract Syntax Tree (AST) node to generate LLVM IR code from.
  * @param filename  The input filename, used as the basis for the output file's name.
+ * @param semanticError  Optional; enables the fused declaration check and receives its result.
  * @return          Returns a pointer to the generated LLVM module, or nullptr if there was an error.
  */
-LLVMModuleRef generateIRAndSaveToFile(astNode *node, const char *filename);
+LLVMModuleRef generateIRAndSaveToFile(astNode *node, const char *filename, bool *semanticError = nullptr);
+
+/**
+ * Same as above, for an AST tape built once after parsing (see ast_tape.h).
+ */
+LLVMModuleRef generateIRAndSaveToFile(const astTape &tape, const char *filename, bool *semanticError = nullptr);
+
+/**
+ * Generates LLVM IR code from an AST tape into a new module owned by `context`, without saving it.
+ * The caller keeps the module in memory for the next stage and disposes it; this is what the
+ * in-process driver uses to skip the textual '_manual.ll' round trip.
+ *
+ * @param tape      The linearized AST to generate LLVM IR code from.
+ * @param filename  The input filename, used as the module name.
+ * @param context   The LLVM context that will own the module (one per compilation).
+ * @param semanticError  Optional; enables the fused declaration check and receives its result.
+ * @param diagnostics    Optional; where the fused check reports undeclared variables (stdout if null).
+ * @return          Returns the verified LLVM module, or nullptr if there was an error.
+ */
+LLVMModuleRef generateIR(const astTape &tape, const char *filename, LLVMContextRef context, bool *semanticError = nullptr,
+						 std::ostream *diagnostics = nullptr);
 
 #endif // LLVM_IR_GENERATOR_H
@@ -5,15 +5,28 @@
  *
  * The optimizer performs the following transformations:
  * 1. Constant folding: Replace arithmetic operations with constants of the operands result
- * 2. Dead code elimination: Remove instructions that have no uses and no side effects
- * 3. Common subexpression elimination: Replace multiple identical computations with a single computation
- * 4. Constant propagation: Replace load instructions with constants if all the stores that write to the
- * 							memory location being read have the same constant value.
+ * 2. Dead code elimination: Remove instructions that no store, call or terminator depends on,
+ * 							across the whole function
+ * 3. Common subexpression elimination: Replace multiple identical computations with a single computation,
+ * 							found by local value numbering
+ * 4. Constant propagation: Replace load instructions with the value that all the stores reaching them
+ * 							write, if it is a constant or an SSA value that dominates the load
+ * 							(store-to-load forwarding).
+ * 5. Global value numbering: Replace instructions with an identical computation that dominates them,
+ * 							across basic blocks
+ * 6. SSA construction: Promote the allocas of the variables to SSA values with phi nodes, before the
+ * 							other passes run
+ * 7. Loop-invariant code motion: Move the computations whose operands do not change in a loop to
+ * 							the preheader of the loop, which runs once before it
+ * 8. Algebraic simplification: Simplify arithmetic with a constant operand (x + 0, x * 1, chains
+ * 							of constants), and turn multiplications by a power of two into shifts
+ * 9. Dead store elimination: Remove stores to variables that no load reads afterwards
+ * 10. CFG simplification: Fold constant branches, delete unreachable blocks, merge blocks into
+ * 							their single predecessor, and thread jumps through empty blocks
+ * 11. Sparse conditional constant propagation: Find the SSA values that are constant on every path
+ * 							that can run, skipping the branches that constants decide, and replace them
  *
- * Usage: ./optimizer <input-file>
- *
- * Output: The optimized LLVM IR code is save to a file named <basename>_opt.ll in the same directory
- * 		   as the input file
+ * The entry point of the optimizer executable is in optimizer_main.cpp.
  *
  * Author: Aimen Abdulaziz
  * Date: Spring 2023
@@ -27,154 +40,433 @@
 #include <llvm-c/IRReader.h>
 #include <llvm-c/Types.h>
 #include "file_utils.h"
+#include "optimizer.h"
+#include "time_report.h"
+#include "opt_report.h"
+#include "bit_vector.h"
+#include "dataflow.h"
+#include "dominator_tree.h"
+#include "natural_loops.h"
+#include "thread_pool.h"
 
 // C++ libraries
+#include <algorithm>
+#include <mutex>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <iostream>
 using namespace std;
 
+#ifdef DEBUG
+// Where the DEBUG output of the function being optimized on this thread goes: stdout, or the
+// log of the function when optimizeProgram optimizes functions in parallel, so that the output
+// of one function is never interleaved with that of another
+static thread_local FILE *debugOutput = stdout;
+
+#define debugPrintf(...) fprintf(debugOutput, __VA_ARGS__)
+
+static void
+debugDumpValue(LLVMValueRef value)
+{
+	char *text = LLVMPrintValueToString(value);
+	fputs(text, debugOutput);
+	LLVMDisposeMessage(text);
+}
+#endif
+
 /**
- * Checks if two LLVM instructions have the same operands.
+ * Determines whether an LLVM instruction has any uses.
  *
- * @param instruction1 The first instruction.
- * @param instruction2 The second instruction.
- * @return True if both instructions have the same operands, false otherwise.
+ * @param instruction the instruction to check
+ * @return true if the instruction has any uses, false otherwise
  */
 static bool
-isSameOperands(LLVMValueRef instruction1, LLVMValueRef instruction2)
+hasUses(LLVMValueRef instruction)
 {
-	int numberOfOperands1 = LLVMGetNumOperands(instruction1);
-	int numberOfOperands2 = LLVMGetNumOperands(instruction2);
+	return LLVMGetFirstUse(instruction) != NULL;
+}
 
-	if (numberOfOperands1 != numberOfOperands2)
+/**
+ * @return The label of a basic block as the IR printer writes it, such as `%7`. The printer numbers
+ * the unnamed arguments, blocks and instructions with a value of a function in order, so the label
+ * of an unnamed block is counted from the start of the function.
+ */
+static string
+blockLabel(LLVMBasicBlockRef basicBlock)
+{
+	size_t nameLength;
+	const char *name = LLVMGetValueName2(LLVMBasicBlockAsValue(basicBlock), &nameLength);
+	if (nameLength)
 	{
-		return false;
+		return "%" + string(name, nameLength);
 	}
-
-	for (int i = 0; i < numberOfOperands1; i++)
+	LLVMValueRef function = LLVMGetBasicBlockParent(basicBlock);
+	unsigned slot = 0;
+	for (auto argument = LLVMGetFirstParam(function); argument; argument = LLVMGetNextParam(argument))
 	{
-		LLVMValueRef operand1 = LLVMGetOperand(instruction1, i);
-		LLVMValueRef operand2 = LLVMGetOperand(instruction2, i);
-
-#ifdef DEBUG
-		printf("\nInstr1 - operand %d:\n", i);
-		LLVMDumpValue(operand1);
-		printf("\nInstr2 - operand %d:\n", i);
-		LLVMDumpValue(operand2);
-#endif
-
-		// Compare the operands by checking if they have the same value and type
-		if (operand1 != operand2 || LLVMTypeOf(operand1) != LLVMTypeOf(operand2))
+		LLVMGetValueName2(argument, &nameLength);
+		slot += nameLength == 0;
+	}
+	for (auto block = LLVMGetFirstBasicBlock(function); block != basicBlock; block = LLVMGetNextBasicBlock(block))
+	{
+		LLVMGetValueName2(LLVMBasicBlockAsValue(block), &nameLength);
+		slot += nameLength == 0;
+		for (auto instruction = LLVMGetFirstInstruction(block);
+			 instruction;
+			 instruction = LLVMGetNextInstruction(instruction))
 		{
-			return false;
+			LLVMGetValueName2(instruction, &nameLength);
+			slot += nameLength == 0 && LLVMGetTypeKind(LLVMTypeOf(instruction)) != LLVMVoidTypeKind;
 		}
 	}
-	return true;
+	return "%" + to_string(slot);
+}
+
+/**
+ * @return The text of a value for the optimization report: the whole of an instruction, or with
+ * `asOperand`, what an instruction that uses it writes, such as `%5` or `i32 3`.
+ */
+static string
+valueText(LLVMValueRef value, bool asOperand)
+{
+	if (LLVMValueIsBasicBlock(value))
+	{
+		return blockLabel(LLVMValueAsBasicBlock(value));
+	}
+	char *printed = LLVMPrintValueToString(value);
+	string text(printed);
+	LLVMDisposeMessage(printed);
+	text.erase(0, text.find_first_not_of(' '));
+	size_t assignment = text.find(" = ");
+	if (asOperand && LLVMIsAInstruction(value) && assignment != string::npos)
+	{
+		text.erase(assignment);
+	}
+	return text;
 }
 
 /**
- * Check if it is safe to replace the first Load instruction with the second Load instruction.
- * It is safe if there are no Store instructions between them that modify the pointer operand.
+ * @brief Schedules the passes of optimizeFunction by what changed since they last ran.
+ *
+ * The passes make every change to the IR through replaceAllUsesWith and erase, which record the
+ * basic blocks the change may affect: the blocks of the users of a replaced instruction (their
+ * operands changed) and of the instruction itself (it lost its uses), and the blocks of the
+ * operands of an erased instruction (they lost a use). Every change gets the next change number,
+ * which is kept for each of those blocks; a pass remembers the change number at which it last
+ * visited each block, or the whole function for a global pass, and only visits it again once a
+ * later change affects it. The stores whose operands changed, and whether a store was erased, are
+ * recorded for constant propagation, whose reaching-stores analysis depends on nothing else.
  *
- * @param instruction1 the first Load instruction
- * @param instruction2 the second Load instruction
- * @return true if it is safe to replace, false otherwise
+ * The manager also owns the control-flow graph, the dominator tree and the natural loops of the
+ * function. None of the passes it runs adds, removes or redirects basic blocks, so they are built
+ * once for all the rounds; the passes that change the graph (the insertion of loop preheaders and
+ * CFG simplification) run between managers.
+ *
+ * All the other state of a pass is local to the function, but the constants of an LLVM context
+ * are shared by all its functions: replacing or erasing an instruction changes the use lists of
+ * the constants among its operands, and folding creates constants. When the functions of a module
+ * are optimized in parallel, those steps hold the context mutex of the module.
+ *
+ * With the optimization report, the passes also record every change in the report of the function
+ * through remark.
  */
-static bool
-safeToReplaceLoadInstructions(LLVMValueRef instruction1, LLVMValueRef instruction2)
+class PassManager
 {
-	// Get the pointer operand
-	LLVMValueRef ptr1 = LLVMGetOperand(instruction1, 0);
+public:
+	// What a pass has already seen of the function
+	typedef struct PassState
+	{
+		vector<unsigned long> lastVisit; // <block index, change number when the pass last visited it>
+		unsigned long lastRun = 0;		 // change number when a global pass last ran
+	} PassState;
+
+	/**
+	 * @param function The function to optimize.
+	 * @param contextMutex The mutex of the LLVM context if other threads optimize its functions, NULL otherwise.
+	 * @param report The report of the function, or NULL if the optimization report is disabled.
+	 */
+	PassManager(LLVMValueRef function, mutex *contextMutex, FunctionReport *report)
+		: storeSetChanged(true), cfg(function), dominators(cfg), loops(cfg, dominators), blockChanges(cfg.size(), 1),
+		  changeCount(1), contextMutex(contextMutex), functionReport(report) {}
+
+	/**
+	 * @return A lock on the context mutex for the steps that change the constants of the context;
+	 * it holds nothing when the function is optimized on its own.
+	 */
+	unique_lock<mutex> lockContext()
+	{
+		return contextMutex ? unique_lock<mutex>(*contextMutex) : unique_lock<mutex>();
+	}
 
-	// Iterate over all the instructions between the two Load instructions
-	// and check if any of them are Store instructions that modify the pointer operand
-	LLVMValueRef currentInstr = instruction1;
-	while ((currentInstr = LLVMGetNextInstruction(currentInstr)) && (currentInstr != instruction2))
+	const ControlFlowGraph &controlFlowGraph() const { return cfg; }
+	const DominatorTree &dominatorTree() const { return dominators; }
+	const NaturalLoops &naturalLoops() const { return loops; }
+	FunctionReport *report() const { return functionReport; }
+
+	/**
+	 * @brief Records a change to an instruction in the report of the function, if there is one. It is
+	 * called before the change, with the value that is about to replace the instruction, or the block
+	 * it is about to move to, if there is one.
+	 */
+	void remark(const char *pass, const char *change, LLVMValueRef instruction, LLVMValueRef replacement = NULL)
 	{
-#ifdef DEBUG
-		printf("\nCurrent Instruction:\n");
-		LLVMDumpValue(currentInstr);
-#endif
-		if (LLVMIsAStoreInst(currentInstr))
+		if (!functionReport)
+		{
+			return;
+		}
+
+		// Printing reads the constants among the operands
+		unique_lock<mutex> lock = lockContext();
+		string message = valueText(instruction, false);
+		if (replacement)
+		{
+			message += " -> " + valueText(replacement, true);
+		}
+		functionReport->remark(pass, change, blockLabel(LLVMGetInstructionParent(instruction)), message);
+	}
+
+	/**
+	 * @return true, and records the visit, if a change affected the block since the pass last
+	 * visited it (or the pass never did).
+	 */
+	bool visitBlock(PassState &pass, unsigned block)
+	{
+		if (pass.lastVisit.empty())
+		{
+			pass.lastVisit.assign(cfg.size(), 0);
+		}
+		if (pass.lastVisit[block] >= blockChanges[block])
+		{
+			return false;
+		}
+		pass.lastVisit[block] = changeCount;
+		return true;
+	}
+
+	/**
+	 * @return true, and records the run, if anything changed since the global pass last ran.
+	 */
+	bool visitFunction(PassState &pass)
+	{
+		if (pass.lastRun >= changeCount)
 		{
-			// Check if the Store instruction has the same pointer as the operands
-			LLVMValueRef storePtr = LLVMGetOperand(currentInstr, 1);
-			if (storePtr == ptr1)
+			return false;
+		}
+		pass.lastRun = changeCount;
+		return true;
+	}
+
+	/**
+	 * @brief Replaces all uses of an instruction, and records the blocks and stores it affects.
+	 */
+	void replaceAllUsesWith(LLVMValueRef instruction, LLVMValueRef replacement)
+	{
+		if (!hasUses(instruction))
+		{
+			return;
+		}
+		markBlock(LLVMGetInstructionParent(instruction));
+		for (auto use = LLVMGetFirstUse(instruction); use; use = LLVMGetNextUse(use))
+		{
+			LLVMValueRef user = LLVMGetUser(use);
+			markBlock(LLVMGetInstructionParent(user));
+			if (LLVMIsAStoreInst(user))
 			{
-// the operands has been modified
-#ifdef DEBUG
-				printf("\nPointer has been modified\n");
-#endif
-				return false;
+				changedStores.push_back(user);
 			}
 		}
+		unique_lock<mutex> lock = lockContext();
+		LLVMReplaceAllUsesWith(instruction, replacement);
 	}
-#ifdef DEBUG
-	printf("\nPointer has not been modified\n");
-#endif
-	return true;
-}
+
+	/**
+	 * @brief Erases an instruction, and records the blocks of its operands, which lost a use.
+	 */
+	void erase(LLVMValueRef instruction)
+	{
+		int numberOfOperands = LLVMGetNumOperands(instruction);
+		for (int i = 0; i < numberOfOperands; i++)
+		{
+			LLVMValueRef operand = LLVMGetOperand(instruction, i);
+			if (LLVMIsAInstruction(operand))
+			{
+				markBlock(LLVMGetInstructionParent(operand));
+			}
+		}
+		if (LLVMIsAStoreInst(instruction))
+		{
+			storeSetChanged = true;
+		}
+		unique_lock<mutex> lock = lockContext();
+		LLVMInstructionEraseFromParent(instruction);
+	}
+
+	/**
+	 * @brief Moves an instruction to the end of a block, before its terminator, and records the
+	 * block it left and the block it joined. Its operands and uses do not change.
+	 */
+	void moveBeforeTerminator(LLVMValueRef instruction, LLVMBasicBlockRef basicBlock)
+	{
+		markBlock(LLVMGetInstructionParent(instruction));
+		markBlock(basicBlock);
+
+		size_t nameLength;
+		const char *name = LLVMGetValueName2(instruction, &nameLength);
+		string savedName(name, nameLength);
+		LLVMBuilderRef builder = LLVMCreateBuilderInContext(LLVMGetTypeContext(LLVMTypeOf(instruction)));
+		LLVMPositionBuilderBefore(builder, LLVMGetBasicBlockTerminator(basicBlock));
+		LLVMInstructionRemoveFromParent(instruction);
+		LLVMInsertIntoBuilderWithName(builder, instruction, savedName.c_str());
+		LLVMDisposeBuilder(builder);
+	}
+
+	// The stores whose operands were replaced since constant propagation last took them
+	vector<LLVMValueRef> changedStores;
+
+	// Whether a store was erased since constant propagation last numbered the stores (true at first)
+	bool storeSetChanged;
+
+private:
+	void markBlock(LLVMBasicBlockRef basicBlock)
+	{
+		blockChanges[cfg.index(basicBlock)] = ++changeCount;
+	}
+
+	ControlFlowGraph cfg;
+	DominatorTree dominators;
+	NaturalLoops loops;
+	vector<unsigned long> blockChanges; // <block index, number of the last change that affected it>
+	unsigned long changeCount;
+	mutex *contextMutex;
+	FunctionReport *functionReport;
+};
 
 /**
- * Determines whether two instructions represent a common subexpression.
- *
- * Two instructions are considered a common subexpression if they have the same opcode and
- * operands. If both instructions are not load instructions, they are considered a common
- * subexpression. If one or both instructions are load instructions, they are considered
- * a common subexpression only if it is safe to replace one load with the other.
- *
- * @param instruction1 The first instruction.
- * @param instruction2 The second instruction.
- * @return true if the instructions represent a common subexpression, false otherwise.
+ * The key under which local value numbering looks up an expression: two instructions with equal
+ * keys compute the same value. Loads also carry the version of the memory they read, which every
+ * store to their pointer bumps, so two loads of a pointer with a store between them differ.
  */
-static bool
-isCommonSubexpression(LLVMValueRef instruction1, LLVMValueRef instruction2)
+typedef struct ExpressionKey
 {
-	if (isSameOperands(instruction1, instruction2))
+	LLVMOpcode opcode;
+	LLVMTypeRef type;
+	int predicate;				 // of comparisons, 0 otherwise
+	vector<unsigned> operands;	 // the value numbers of the operands
+	unsigned memoryVersion;		 // of loads, 0 otherwise
+
+	bool operator==(const ExpressionKey &other) const
 	{
-		if (!LLVMIsALoadInst(instruction1) && !LLVMIsALoadInst(instruction2))
-		{
-			return true;
-		}
-		else if (safeToReplaceLoadInstructions(instruction1, instruction2))
+		return opcode == other.opcode && type == other.type && predicate == other.predicate &&
+			   memoryVersion == other.memoryVersion && operands == other.operands;
+	}
+} ExpressionKey;
+
+struct ExpressionKeyHash
+{
+	size_t operator()(const ExpressionKey &key) const
+	{
+		size_t hash = combineHash(std::hash<int>()(key.opcode), std::hash<LLVMTypeRef>()(key.type));
+		hash = combineHash(hash, std::hash<int>()(key.predicate));
+		hash = combineHash(hash, std::hash<unsigned>()(key.memoryVersion));
+		for (unsigned operand : key.operands)
 		{
-			return true;
+			hash = combineHash(hash, std::hash<unsigned>()(operand));
 		}
+		return hash;
 	}
-	return false;
+
+	static size_t combineHash(size_t seed, size_t value)
+	{
+		return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+	}
+};
+
+/**
+ * Returns the value number of a value, giving it a new one if it has none yet. Values defined
+ * outside the basic block (constants, arguments, allocas and instructions of other blocks) are
+ * numbered by identity; LLVM uniques constants, so equal constants share a number.
+ *
+ * @param valueNumbers The value numbers given so far in the basic block.
+ * @param value The value to number.
+ * @return The value number of value.
+ */
+static unsigned
+getValueNumber(unordered_map<LLVMValueRef, unsigned> &valueNumbers, LLVMValueRef value)
+{
+	auto found = valueNumbers.find(value);
+	if (found != valueNumbers.end())
+	{
+		return found->second;
+	}
+	unsigned number = valueNumbers.size();
+	valueNumbers[value] = number;
+	return number;
 }
 
 /**
- * Determines whether an LLVM instruction has any uses.
+ * Determines whether value numbering looks up an instruction. Allocas, instructions without a
+ * result (such as stores and branches) and calls are skipped: two calls to read() return
+ * different values even though their operands are the same. So are phis, whose value also
+ * depends on the block they are in and the edge it was entered by.
  *
- * @param instruction the instruction to check
- * @return true if the instruction has any uses, false otherwise
+ * @param instruction The instruction to check.
+ * @return true if the instruction computes a value that can be reused, false otherwise.
  */
 static bool
-hasUses(LLVMValueRef instruction)
+isValueNumbered(LLVMValueRef instruction)
 {
-	return LLVMGetFirstUse(instruction) != NULL;
+	LLVMOpcode op = LLVMGetInstructionOpcode(instruction);
+	return op != LLVMAlloca && op != LLVMCall && op != LLVMPHI &&
+		   LLVMGetTypeKind(LLVMTypeOf(instruction)) != LLVMVoidTypeKind;
+}
+
+/**
+ * Builds the key of an instruction from its opcode, type, predicate and the value numbers of its
+ * operands. The memory version of a load is left to the caller.
+ *
+ * @param valueNumbers The value numbers given so far.
+ * @param instruction The instruction, for which isValueNumbered is true.
+ * @return The key of the instruction, with a memory version of 0.
+ */
+static ExpressionKey
+buildExpressionKey(unordered_map<LLVMValueRef, unsigned> &valueNumbers, LLVMValueRef instruction)
+{
+	ExpressionKey key;
+	key.opcode = LLVMGetInstructionOpcode(instruction);
+	key.type = LLVMTypeOf(instruction);
+	key.predicate = key.opcode == LLVMICmp ? LLVMGetICmpPredicate(instruction) : 0;
+	int numberOfOperands = LLVMGetNumOperands(instruction);
+	for (int i = 0; i < numberOfOperands; i++)
+	{
+		key.operands.push_back(getValueNumber(valueNumbers, LLVMGetOperand(instruction, i)));
+	}
+	key.memoryVersion = 0;
+	return key;
 }
 
 /**
- * @brief Eliminate common subexpressions in an LLVM basic block.
+ * @brief Eliminate common subexpressions in an LLVM basic block with local value numbering.
  *
- * This function iterates over all the instructions in the basic block and keeps track
- * of each opcode and its corresponding instruction in a hashmap. For each instruction,
- * it checks if it is a common subexpression by iterating over all the previous
- * instructions with the same opcode. If it is a common subexpression, it replaces all
- * uses of the instruction with the previous instruction.
+ * This function walks the basic block once. Every operand gets a value number, and each instruction
+ * is looked up in a hashmap by its opcode, type, comparison predicate and the value numbers of its
+ * operands; loads also use the memory version of their pointer, which stores bump. If an earlier
+ * instruction with uses has the same key, all uses of the instruction are replaced with it and the
+ * instruction takes its value number. Otherwise the instruction becomes the one found under its key.
+ * Each instruction costs a constant number of hashmap operations, so the pass is linear in the size
+ * of the block.
  *
+ * @param passes The pass manager, which records the changes.
  * @param basicBlock The LLVM basic block to perform common subexpression elimination on.
  * @return true if any common subexpression was eliminated, false otherwise.
  */
 static bool
-commonSubexpressionElimination(LLVMBasicBlockRef basicBlock)
+commonSubexpressionElimination(PassManager &passes, LLVMBasicBlockRef basicBlock)
 {
-	// Create an empty hashmap opcodeMap of vectors of instructions
-	unordered_map<LLVMOpcode, vector<LLVMValueRef>> opcodeMap; // <opcode, vector of instructions>
+	unordered_map<LLVMValueRef, unsigned> valueNumbers;					 // <value, value number>
+	unordered_map<unsigned, unsigned> memoryVersions;					 // <value number of a pointer, stores so far>
+	unordered_map<ExpressionKey, LLVMValueRef, ExpressionKeyHash> expressions; // <key, first instruction>
 	bool subExpressionEliminated = false;
 
 	// Iterate over all the instructions in the basic block
@@ -186,44 +478,290 @@ commonSubexpressionElimination(LLVMBasicBlockRef basicBlock)
 		// Get the opcode of the instruction
 		LLVMOpcode op = LLVMGetInstructionOpcode(instruction);
 
-		// Skip alloca or useless instructions
-		if (op == LLVMAlloca)
+		// A store changes the memory its pointer points to, so later loads of it are new values
+		if (op == LLVMStore)
 		{
+			memoryVersions[getValueNumber(valueNumbers, LLVMGetOperand(instruction, 1))]++;
 			continue;
 		}
 
-		// Check if the instruction is already in the hashmap
-		if (opcodeMap.find(op) == opcodeMap.end())
+		if (!isValueNumbered(instruction))
 		{
-			// If not, add it to the hashmap and initialize the vector
-			opcodeMap[op] = vector<LLVMValueRef>();
+			continue;
 		}
 
-		// Check if the instruction is a common subexpression by iterating over all the
-		// previous instructions with the same opcode
-		for (auto prevInstruction : opcodeMap[op])
+		ExpressionKey key = buildExpressionKey(valueNumbers, instruction);
+		key.memoryVersion = op == LLVMLoad ? memoryVersions[key.operands[0]] : 0;
+
+		auto found = expressions.find(key);
+		if (found != expressions.end() && hasUses(found->second))
 		{
-			if (hasUses(prevInstruction) && isCommonSubexpression(prevInstruction, instruction))
+			LLVMValueRef prevInstruction = found->second;
+
+			// Replace all uses of the instruction with the previous instruction. An
+			// instruction without uses is left to DCE, and is no change at all here,
+			// or the optimizer would never reach its fixed point
+			if (hasUses(instruction))
 			{
-				// Replace all uses of the instruction with the previous instruction
-				LLVMReplaceAllUsesWith(instruction, prevInstruction);
+				passes.remark("Common subexpression elimination", "subexpressions eliminated", instruction,
+							  prevInstruction);
 				subExpressionEliminated = true;
+			}
+			passes.replaceAllUsesWith(instruction, prevInstruction);
+			unsigned number = valueNumbers[prevInstruction];
+			valueNumbers[instruction] = number;
 
 #ifdef DEBUG
-				printf("\nReplaced instruction:\n");
-				LLVMDumpValue(instruction);
-				printf("\nwith instruction:\n");
-				LLVMDumpValue(prevInstruction);
+			debugPrintf("\nReplaced instruction:\n");
+			debugDumpValue(instruction);
+			debugPrintf("\nwith instruction:\n");
+			debugDumpValue(prevInstruction);
 #endif
+			continue;
+		}
+
+		// The first instruction (with uses) that computes this value
+		expressions[key] = instruction;
+		getValueNumber(valueNumbers, instruction);
+	}
+
+	return subExpressionEliminated;
+}
+
+/**
+ * The state of global value numbering while it walks the dominator tree: the expressions and the
+ * memory versions available in the current block, with logs of the entries they replaced so that
+ * they can be restored when the walk leaves a subtree.
+ */
+typedef struct
+{
+	unordered_map<LLVMValueRef, unsigned> valueNumbers; // <value, value number>
+	unordered_map<ExpressionKey, LLVMValueRef, ExpressionKeyHash> expressions; // <key, dominating instruction>
+	unordered_map<unsigned, unsigned> memoryVersions; // <value number of a pointer, version>
+	vector<pair<ExpressionKey, LLVMValueRef>> expressionLog; // <key, previous instruction or NULL>
+	vector<pair<unsigned, unsigned>> memoryLog; // <pointer, previous version>
+	unsigned lastMemoryVersion; // versions are unique, so that two paths never share one
+	vector<vector<LLVMValueRef>> storedPointers; // <block, pointers its stores write to>
+	bool hasStores; // whether any block stores, so that the paths from a dominator can clobber pointers
+	vector<unsigned> visitedEpoch; // <block, the last walk back from a block that visited it>
+	unsigned epoch; // the number of the current walk back, so that visitedEpoch never has to be cleared
+	bool changed;
+} ValueNumberingScope;
+
+// A block of the dominator tree that the global value numbering walk is in
+typedef struct
+{
+	unsigned block;
+	unsigned nextChild;	   // the next of its children to visit
+	size_t expressionMark; // the size of the expression log before the block was numbered
+	size_t memoryMark;	   // the size of the memory log before the block was numbered
+} ValueNumberingFrame;
+
+/**
+ * Gives the pointer a new memory version in the current scope, as after a store to it.
+ *
+ * @param scope The state of the walk.
+ * @param pointer The pointer that is written to.
+ */
+static void
+clobberPointer(ValueNumberingScope &scope, LLVMValueRef pointer)
+{
+	unsigned number = getValueNumber(scope.valueNumbers, pointer);
+	unsigned &version = scope.memoryVersions[number];
+	scope.memoryLog.push_back({number, version});
+	version = ++scope.lastMemoryVersion;
+}
+
+/**
+ * Global value numbering of a basic block, when the walk of the dominator tree enters it.
+ *
+ * At the start of the block, the memory state is that at the end of its immediate dominator, except
+ * for the pointers stored to on a path from the dominator to the block: those are found by walking
+ * back from the predecessors of the block up to the dominator, which also covers the back edges of
+ * a loop whose header is the block. Then every instruction is looked up as in local value
+ * numbering; the expressions found are those of the dominators, so their instructions dominate it.
+ * The entries are logged, so that valueNumberDominatorTree can undo them once it leaves the blocks
+ * the block dominates.
+ *
+ * @param passes The pass manager, which holds the control-flow graph and the dominator tree.
+ * @param block The block to number.
+ * @param scope The state of the walk.
+ */
+static void
+valueNumberBlock(PassManager &passes, unsigned block, ValueNumberingScope &scope)
+{
+	const ControlFlowGraph &cfg = passes.controlFlowGraph();
+	const DominatorTree &dominators = passes.dominatorTree();
+
+	unsigned dominator = dominators.immediateDominator(block);
+	if (dominator != DominatorTree::NO_BLOCK && scope.hasStores)
+	{
+		unsigned epoch = ++scope.epoch;
+		vector<unsigned> worklist(cfg.predecessors(block));
+		scope.visitedEpoch[dominator] = epoch;
+		while (!worklist.empty())
+		{
+			unsigned between = worklist.back();
+			worklist.pop_back();
+			if (scope.visitedEpoch[between] == epoch)
+			{
+				continue;
+			}
+			scope.visitedEpoch[between] = epoch;
+			for (auto pointer : scope.storedPointers[between])
+			{
+				clobberPointer(scope, pointer);
+			}
+			for (unsigned predecessor : cfg.predecessors(between))
+			{
+				worklist.push_back(predecessor);
+			}
+		}
+	}
+
+	for (auto instruction = LLVMGetFirstInstruction(cfg.block(block));
+		 instruction;
+		 instruction = LLVMGetNextInstruction(instruction))
+	{
+		if (LLVMIsAStoreInst(instruction))
+		{
+			clobberPointer(scope, LLVMGetOperand(instruction, 1));
+			continue;
+		}
+
+		// Comparisons are left to local CSE: the backend branches on the flags that a comparison
+		// sets, so the comparison of a branch has to stay in the branch's block
+		if (!isValueNumbered(instruction) || LLVMIsAICmpInst(instruction))
+		{
+			continue;
+		}
+
+		ExpressionKey key = buildExpressionKey(scope.valueNumbers, instruction);
+		if (LLVMIsALoadInst(instruction))
+		{
+			auto version = scope.memoryVersions.find(key.operands[0]);
+			key.memoryVersion = version == scope.memoryVersions.end() ? 0 : version->second;
+		}
+
+		auto found = scope.expressions.find(key);
+		if (found != scope.expressions.end() && found->second && hasUses(found->second))
+		{
+			LLVMValueRef prevInstruction = found->second;
 
-				break;
+			// As in local CSE, an instruction without uses is left to DCE
+			if (hasUses(instruction))
+			{
+				passes.remark("Global value numbering", "redundant instructions replaced", instruction, prevInstruction);
+				scope.changed = true;
 			}
+			passes.replaceAllUsesWith(instruction, prevInstruction);
+			unsigned number = scope.valueNumbers[prevInstruction];
+			scope.valueNumbers[instruction] = number;
+
+#ifdef DEBUG
+			debugPrintf("\nGVN replaced instruction:\n");
+			debugDumpValue(instruction);
+			debugPrintf("\nwith instruction:\n");
+			debugDumpValue(prevInstruction);
+#endif
+			continue;
 		}
 
-		opcodeMap[op].push_back(instruction);
+		LLVMValueRef &entry = scope.expressions[key];
+		scope.expressionLog.push_back({key, entry});
+		entry = instruction;
+		getValueNumber(scope.valueNumbers, instruction);
 	}
+}
 
-	return subExpressionEliminated;
+/**
+ * Global value numbering of the blocks of the dominator tree below `root`, in depth-first order:
+ * each block is numbered, then the blocks it dominates, and then the scope is restored. The walk
+ * keeps its own stack of frames, as DominatorTree::numberTree does, so deeply nested programs do
+ * not grow the call stack.
+ *
+ * @param passes The pass manager, which holds the control-flow graph and the dominator tree.
+ * @param root The root of the walk, the entry block.
+ * @param scope The state of the walk.
+ */
+static void
+valueNumberDominatorTree(PassManager &passes, unsigned root, ValueNumberingScope &scope)
+{
+	const DominatorTree &dominators = passes.dominatorTree();
+	vector<ValueNumberingFrame> stack;
+	stack.push_back({root, 0, scope.expressionLog.size(), scope.memoryLog.size()});
+	valueNumberBlock(passes, root, scope);
+	while (!stack.empty())
+	{
+		ValueNumberingFrame &top = stack.back();
+		const vector<unsigned> &children = dominators.children(top.block);
+		if (top.nextChild < children.size())
+		{
+			unsigned child = children[top.nextChild++];
+			stack.push_back({child, 0, scope.expressionLog.size(), scope.memoryLog.size()});
+			valueNumberBlock(passes, child, scope);
+			continue;
+		}
+
+		// Leave the scope of the block: undo its entries, the latest first
+		while (scope.expressionLog.size() > top.expressionMark)
+		{
+			scope.expressions[scope.expressionLog.back().first] = scope.expressionLog.back().second;
+			scope.expressionLog.pop_back();
+		}
+		while (scope.memoryLog.size() > top.memoryMark)
+		{
+			scope.memoryVersions[scope.memoryLog.back().first] = scope.memoryLog.back().second;
+			scope.memoryLog.pop_back();
+		}
+		stack.pop_back();
+	}
+}
+
+/**
+ * @brief Eliminates the arithmetic and load instructions that recompute a value already computed
+ * by an instruction that dominates them (global value numbering).
+ *
+ * Common subexpression elimination only reuses values within a basic block. This pass walks the
+ * dominator tree from the entry block with a scoped table of expressions, so that an expression
+ * computed in a while header is also reused in the body. A load is only replaced by an earlier load
+ * of the same pointer if no store to the pointer can run between the two.
+ *
+ * @param passes The pass manager, which holds the control-flow graph and the dominator tree.
+ * @return true if any instruction was replaced, false otherwise.
+ */
+static bool
+globalValueNumbering(PassManager &passes)
+{
+	const ControlFlowGraph &cfg = passes.controlFlowGraph();
+	if (cfg.numReachable() == 0)
+	{
+		return false;
+	}
+
+	ValueNumberingScope scope;
+	scope.lastMemoryVersion = 0;
+	scope.changed = false;
+	scope.storedPointers.resize(cfg.size());
+	scope.hasStores = false;
+	scope.visitedEpoch.assign(cfg.size(), 0);
+	scope.epoch = 0;
+	for (unsigned block = 0; block < cfg.size(); block++)
+	{
+		for (auto instruction = LLVMGetFirstInstruction(cfg.block(block));
+			 instruction;
+			 instruction = LLVMGetNextInstruction(instruction))
+		{
+			if (LLVMIsAStoreInst(instruction))
+			{
+				scope.storedPointers[block].push_back(LLVMGetOperand(instruction, 1));
+				scope.hasStores = true;
+			}
+		}
+	}
+
+	valueNumberDominatorTree(passes, cfg.reversePostorder()[0], scope);
+	return scope.changed;
 }
 
 /**
@@ -248,62 +786,116 @@ hasSideEffects(LLVMValueRef instruction)
  * This function iterates through the toDelete vector and erases the corresponding instructions
  * from their parent basic block.
  *
+ * @param passes The pass manager, which records the changes.
  * @param toDelete The vector that stores the instructions to be deleted.
  */
-void deleteMarkedInstructions(vector<LLVMValueRef> &toDelete)
+static void
+deleteMarkedInstructions(PassManager &passes, vector<LLVMValueRef> &toDelete)
 {
 	// Now erase the marked instructions from the basic block
 	for (auto instruction : toDelete)
 	{
 #ifdef DEBUG
-		printf("\nDeleting instruction:\n");
-		LLVMDumpValue(instruction);
-		printf("\n");
+		debugPrintf("\nDeleting instruction:\n");
+		debugDumpValue(instruction);
+		debugPrintf("\n");
 #endif
 
-		LLVMInstructionEraseFromParent(instruction);
+		passes.erase(instruction);
 	}
 }
 
 /**
- * @brief This function performs dead code elimination on a given basic block.
+ * @brief This function performs dead code elimination on a whole function.
  *
- * It iterates over all instructions in the basic block, and if an instruction
- * has no uses and no side effects, it is marked for deletion. Afterwards, all
- * the marked instructions are erased from the basic block.
+ * It marks the instructions with side effects (stores, terminators and calls) as live, and then,
+ * from them, every instruction that a live instruction uses, across basic blocks. The instructions
+ * left unmarked compute values that nothing observable depends on: unused results, but also the
+ * loads whose users were removed from another block, and the phis of a loop that only feed each
+ * other. They are erased together, after their uses among themselves are dropped.
  *
- * @param basicBlock the basic block on which to perform dead code elimination
+ * @param passes the pass manager, which holds the control-flow graph and records the changes
  * @return true if any instruction was deleted, false otherwise
  */
 static bool
-deadCodeElimination(LLVMBasicBlockRef basicBlock)
+deadCodeElimination(PassManager &passes)
 {
-	vector<LLVMValueRef> toDelete;
+	const ControlFlowGraph &cfg = passes.controlFlowGraph();
+	unordered_set<LLVMValueRef> live;
+	vector<LLVMValueRef> worklist;
 
-	// Iterate over all the instructions in the basic block
-	for (auto instruction = LLVMGetFirstInstruction(basicBlock);
-		 instruction; instruction = LLVMGetNextInstruction(instruction))
+	// Mark the roots
+	for (unsigned block = 0; block < cfg.size(); block++)
 	{
+		for (auto instruction = LLVMGetFirstInstruction(cfg.block(block));
+			 instruction;
+			 instruction = LLVMGetNextInstruction(instruction))
+		{
+			if (hasSideEffects(instruction))
+			{
+				live.insert(instruction);
+				worklist.push_back(instruction);
+			}
+		}
+	}
 
-		// If the instruction has no uses and no side effects, mark it for deletion
-		if (!hasUses(instruction) && !hasSideEffects(instruction))
+	// Mark the instructions that live instructions use
+	while (!worklist.empty())
+	{
+		LLVMValueRef instruction = worklist.back();
+		worklist.pop_back();
+		int numberOfOperands = LLVMGetNumOperands(instruction);
+		for (int i = 0; i < numberOfOperands; i++)
 		{
-#ifdef DEBUG
-			printf("\nMarking instruction for deletion:\n");
-			LLVMDumpValue(instruction);
-#endif
-			toDelete.push_back(instruction);
+			LLVMValueRef operand = LLVMGetOperand(instruction, i);
+			if (LLVMIsAInstruction(operand) && live.insert(operand).second)
+			{
+				worklist.push_back(operand);
+			}
 		}
 	}
 
-	// Now erase the marked instructions from the basic block
-	deleteMarkedInstructions(toDelete);
+	// Sweep the rest
+	vector<LLVMValueRef> toDelete;
+	for (unsigned block = 0; block < cfg.size(); block++)
+	{
+		for (auto instruction = LLVMGetFirstInstruction(cfg.block(block));
+			 instruction;
+			 instruction = LLVMGetNextInstruction(instruction))
+		{
+			if (!live.count(instruction))
+			{
+#ifdef DEBUG
+				debugPrintf("\nMarking instruction for deletion:\n");
+				debugDumpValue(instruction);
+#endif
+				passes.remark("Dead code elimination", "instructions deleted", instruction);
+				toDelete.push_back(instruction);
+			}
+		}
+	}
+
+	// Only dead instructions use a dead instruction, but they may use each other in a cycle
+	for (auto instruction : toDelete)
+	{
+		if (hasUses(instruction))
+		{
+			LLVMValueRef undef;
+			{
+				unique_lock<mutex> lock = passes.lockContext();
+				undef = LLVMGetUndef(LLVMTypeOf(instruction));
+			}
+			passes.replaceAllUsesWith(instruction, undef);
+		}
+	}
+	deleteMarkedInstructions(passes, toDelete);
 
 	return toDelete.size() > 0; // return true if any instruction was deleted
 }
 
 /**
- * Check whether an LLVM instruction is an arithmetic (+-*) or an icmp operation.
+ * Check whether an LLVM instruction is an arithmetic (+-*, and the shifts that strength reduction
+ * turns multiplications into) or an icmp operation.
  *
  * @param instruction the LLVM instruction to check
  * @return true if the instruction is an arithmetic or an icmp operation, false otherwise
@@ -312,7 +904,7 @@ static bool
 isArithmeticOrIcmpOperation(LLVMValueRef instruction)
 {
 	LLVMOpcode op = LLVMGetInstructionOpcode(instruction);
-	return (op == LLVMAdd || op == LLVMSub || op == LLVMMul || op == LLVMICmp);
+	return (op == LLVMAdd || op == LLVMSub || op == LLVMMul || op == LLVMShl || op == LLVMICmp);
 }
 
 /**
@@ -336,9 +928,9 @@ allOperandsAreConstant(LLVMValueRef instruction)
 	}
 
 #ifdef DEBUG
-	printf("\nAll operands for the following instruction are constants:\n");
-	LLVMDumpValue(instruction);
-	printf("\n");
+	debugPrintf("\nAll operands for the following instruction are constants:\n");
+	debugDumpValue(instruction);
+	debugPrintf("\n");
 #endif
 
 	return true;
@@ -358,9 +950,9 @@ computeFoldedConstant(LLVMValueRef instruction)
 	LLVMValueRef operand2 = LLVMGetOperand(instruction, 1);
 
 #ifdef DEBUG
-	printf("Computing constant arithmetic for\n");
-	LLVMDumpValue(instruction);
-	printf("\n");
+	debugPrintf("Computing constant arithmetic for\n");
+	debugDumpValue(instruction);
+	debugPrintf("\n");
 #endif
 
 	LLVMOpcode op = LLVMGetInstructionOpcode(instruction);
@@ -377,6 +969,10 @@ computeFoldedConstant(LLVMValueRef instruction)
 	{
 		return LLVMConstMul(operand1, operand2);
 	}
+	else if (op == LLVMShl)
+	{
+		return LLVMConstShl(operand1, operand2);
+	}
 	else if (op == LLVMICmp)
 	{
 		LLVMIntPredicate predicate = LLVMGetICmpPredicate(instruction);
@@ -389,11 +985,12 @@ computeFoldedConstant(LLVMValueRef instruction)
  * Applies constant folding optimization to all arithmetic or icmp instructions in a given basic block where
  * all operands are constants.
  *
+ * @param passes the pass manager, which records the changes.
  * @param basicBlock the basic block to apply constant folding to.
  * @return true if any constant folding occurred in the basic block, false otherwise.
  */
 static bool
-constantFolding(LLVMBasicBlockRef basicBlock)
+constantFolding(PassManager &passes, LLVMBasicBlockRef basicBlock)
 {
 	bool codeChanged = false;
 	// Iterate over all the instructions in the basic block
@@ -405,31 +1002,259 @@ constantFolding(LLVMBasicBlockRef basicBlock)
 		// If the instruction is an arithmetic operation and all its operands are constants,
 		if (isArithmeticOrIcmpOperation(instruction) && allOperandsAreConstant(instruction))
 		{
-			LLVMValueRef foldedConstant = computeFoldedConstant(instruction);
-			LLVMReplaceAllUsesWith(instruction, foldedConstant);
+			LLVMValueRef foldedConstant;
+			{
+				unique_lock<mutex> lock = passes.lockContext();
+				foldedConstant = computeFoldedConstant(instruction);
+			}
+			if (hasUses(instruction))
+			{
+				passes.remark("Constant folding", "constants folded", instruction, foldedConstant);
+			}
+			passes.replaceAllUsesWith(instruction, foldedConstant);
 			codeChanged = true;
 
 #ifdef DEBUG
-			printf("Folded constant\n");
-			LLVMDumpValue(foldedConstant);
-			printf("\n");
+			debugPrintf("Folded constant\n");
+			debugDumpValue(foldedConstant);
+			debugPrintf("\n");
+#endif
+		}
+	}
+	return codeChanged;
+}
+
+/**
+ * If a value is an add or a sub of a constant (or a mul or a shl by one), splits it into the
+ * value it is computed from and the constant.
+ *
+ * @param value The value to split.
+ * @param opcode LLVMAdd to split x + c and x - c into x and c or -c, LLVMMul to split x * c and
+ * x << c into x and c or 2^c.
+ * @param base Set to the non-constant operand.
+ * @param constant Set to the constant, which wraps around as the instruction does.
+ * @return true if the value was split, false otherwise.
+ */
+static bool
+splitConstantOperand(LLVMValueRef value, LLVMOpcode opcode, LLVMValueRef &base, unsigned long long &constant)
+{
+	if (!LLVMIsAInstruction(value) || !LLVMIsAConstantInt(LLVMGetOperand(value, 1)) ||
+		LLVMIsAConstantInt(LLVMGetOperand(value, 0)))
+	{
+		return false;
+	}
+	base = LLVMGetOperand(value, 0);
+	unsigned long long operand = LLVMConstIntGetZExtValue(LLVMGetOperand(value, 1));
+	LLVMOpcode op = LLVMGetInstructionOpcode(value);
+	if (opcode == LLVMAdd && (op == LLVMAdd || op == LLVMSub))
+	{
+		constant = op == LLVMAdd ? operand : 0 - operand;
+		return true;
+	}
+	if (opcode == LLVMMul && (op == LLVMMul || (op == LLVMShl && operand < 64)))
+	{
+		constant = op == LLVMMul ? operand : 1ull << operand;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Builds a binary instruction before another one, to replace it.
+ *
+ * @param passes The pass manager, whose context lock the constants of the new instruction need.
+ * @param before The instruction to replace.
+ * @param opcode The opcode of the new instruction.
+ * @param operand The first operand of the new instruction.
+ * @param constant The second operand, a constant of the type of the instruction.
+ * @return The new instruction.
+ */
+static LLVMValueRef
+buildBinaryBefore(PassManager &passes, LLVMValueRef before, LLVMOpcode opcode, LLVMValueRef operand,
+				  unsigned long long constant)
+{
+	LLVMTypeRef type = LLVMTypeOf(before);
+	LLVMBuilderRef builder = LLVMCreateBuilderInContext(LLVMGetTypeContext(type));
+	LLVMPositionBuilderBefore(builder, before);
+	LLVMValueRef instruction;
+	{
+		unique_lock<mutex> lock = passes.lockContext();
+		instruction = LLVMBuildBinOp(builder, opcode, operand, LLVMConstInt(type, constant, 0), "");
+	}
+	LLVMDisposeBuilder(builder);
+	return instruction;
+}
+
+/**
+ * Computes a simpler value that an arithmetic or icmp instruction with a non-constant operand is
+ * equal to:
+ * - x + 0, x - 0, x * 1 and x << 0 are x; x * 0 is 0; x - x is 0
+ * - x == x, x >= x and x <= x are true; x != x, x > x and x < x are false
+ * - c + x and c * x become x + c and x * c, so that the rules below only look at the right operand
+ * - (x + c1) + c2 becomes x + (c1 + c2), and so do the chains of subs; (x * c1) * c2 becomes
+ *   x * (c1 * c2)
+ * - x * 2^k becomes x << k, a shift instead of a multiplication
+ * The constants wrap around like the arithmetic of the instructions does. An instruction that
+ * replaces another is built just before it; the old one is left to dead code elimination.
+ *
+ * @param passes The pass manager, whose context lock creating constants needs.
+ * @param instruction The instruction to simplify.
+ * @return The value to replace the instruction with, or NULL if it cannot be simplified.
+ */
+static LLVMValueRef
+simplifyInstruction(PassManager &passes, LLVMValueRef instruction)
+{
+	if (!isArithmeticOrIcmpOperation(instruction))
+	{
+		return NULL;
+	}
+	LLVMOpcode op = LLVMGetInstructionOpcode(instruction);
+	LLVMValueRef operand1 = LLVMGetOperand(instruction, 0);
+	LLVMValueRef operand2 = LLVMGetOperand(instruction, 1);
+	LLVMTypeRef type = LLVMTypeOf(instruction);
+
+	if (operand1 == operand2 && (op == LLVMICmp || op == LLVMSub))
+	{
+		bool value = false;
+		if (op == LLVMICmp)
+		{
+			LLVMIntPredicate predicate = LLVMGetICmpPredicate(instruction);
+			value = predicate == LLVMIntEQ || predicate == LLVMIntSGE || predicate == LLVMIntSLE ||
+					predicate == LLVMIntUGE || predicate == LLVMIntULE;
+		}
+		unique_lock<mutex> lock = passes.lockContext();
+		return LLVMConstInt(type, value, 0);
+	}
+
+	bool constant1 = LLVMIsAConstantInt(operand1) != NULL;
+	bool constant2 = LLVMIsAConstantInt(operand2) != NULL;
+	if ((op == LLVMAdd || op == LLVMMul) && constant1 && !constant2)
+	{
+		return buildBinaryBefore(passes, instruction, op, operand2, LLVMConstIntGetZExtValue(operand1));
+	}
+	if (constant1 || !constant2 || op == LLVMICmp)
+	{
+		// Constant folding takes the instructions whose operands are all constants
+		return NULL;
+	}
+
+	unsigned long long width = LLVMGetIntTypeWidth(type);
+	unsigned long long mask = width < 64 ? (1ull << width) - 1 : ~0ull;
+	unsigned long long constant = LLVMConstIntGetZExtValue(operand2);
+	LLVMValueRef base;
+	unsigned long long inner;
+	switch (op)
+	{
+	case LLVMAdd:
+	case LLVMSub:
+		if (constant == 0)
+		{
+			return operand1;
+		}
+		if (!splitConstantOperand(operand1, LLVMAdd, base, inner))
+		{
+			return NULL;
+		}
+		constant = (inner + (op == LLVMAdd ? constant : 0 - constant)) & mask;
+		return constant == 0 ? base : buildBinaryBefore(passes, instruction, LLVMAdd, base, constant);
+	case LLVMMul:
+		if (constant == 0)
+		{
+			return operand2;
+		}
+		if (constant == 1)
+		{
+			return operand1;
+		}
+		if (splitConstantOperand(operand1, LLVMMul, base, inner))
+		{
+			return buildBinaryBefore(passes, instruction, LLVMMul, base, (inner * constant) & mask);
+		}
+		if ((constant & (constant - 1)) == 0)
+		{
+			unsigned shift = 0;
+			while ((1ull << shift) != constant)
+			{
+				shift++;
+			}
+			return buildBinaryBefore(passes, instruction, LLVMShl, operand1, shift);
+		}
+		return NULL;
+	case LLVMShl:
+		return constant == 0 ? operand1 : NULL;
+	default:
+		return NULL;
+	}
+}
+
+/**
+ * Applies algebraic simplification and strength reduction to the arithmetic and icmp instructions
+ * of a basic block that have a non-constant operand (see simplifyInstruction).
+ *
+ * @param passes the pass manager, which records the changes.
+ * @param basicBlock the basic block to simplify.
+ * @return true if any instruction was simplified, false otherwise.
+ */
+static bool
+algebraicSimplification(PassManager &passes, LLVMBasicBlockRef basicBlock)
+{
+	bool codeChanged = false;
+	for (auto instruction = LLVMGetFirstInstruction(basicBlock);
+		 instruction;
+		 instruction = LLVMGetNextInstruction(instruction))
+	{
+		// An instruction without uses is left to dead code elimination
+		if (!hasUses(instruction))
+		{
+			continue;
+		}
+		LLVMValueRef simplified = simplifyInstruction(passes, instruction);
+		if (simplified)
+		{
+#ifdef DEBUG
+			debugPrintf("\nSimplified instruction:\n");
+			debugDumpValue(instruction);
+			debugPrintf("\nto:\n");
+			debugDumpValue(simplified);
+			debugPrintf("\n");
 #endif
+			passes.remark("Algebraic simplification", "instructions simplified", instruction, simplified);
+			passes.replaceAllUsesWith(instruction, simplified);
+			codeChanged = true;
 		}
 	}
 	return codeChanged;
 }
 
 /**
- * Builds a map of all store instructions that write to the same memory address.
- * @param function The LLVM function for which the store instructions map needs to be built.
- * @return An unordered map of store instructions map, where the key is the memory address being stored
- *         and the value is a vector of all store instructions that write to that memory address.
+ * @brief The store instructions of a function, numbered densely for the bit vectors of the
+ * reaching-stores analysis.
+ *
+ * Stores are numbered from 0 in layout order. A set of stores is then a BitVector with one bit
+ * per store, and the stores that write to each pointer are kept both as a list and as a set,
+ * so that a store kills the other stores to its pointer with a single word-wise difference.
+ */
+typedef struct
+{
+	vector<LLVMValueRef> stores;								 // store instruction by number
+	unordered_map<LLVMValueRef, unsigned> numbers;				 // number by store instruction
+	unordered_map<LLVMValueRef, vector<LLVMValueRef>> byPointer; // stores to each pointer
+	unordered_map<LLVMValueRef, BitVector> setByPointer;		 // the same, as a set
+} StoreInstructions;
+
+// A set of stores (a GEN, KILL, IN or OUT set) for each basic block, by its index in the ControlFlowGraph
+typedef vector<BitVector> StoreSetMap;
+
+/**
+ * Numbers all the store instructions of a function, and groups them by the memory address
+ * they write to.
+ *
+ * @param function The LLVM function whose store instructions are numbered.
+ * @param storeInstructions Receives the numbered stores and the stores of each pointer.
  */
-static unordered_map<LLVMValueRef, vector<LLVMValueRef>>
-buildStoreInstructionsMap(LLVMValueRef function)
+static void
+buildStoreInstructionsMap(LLVMValueRef function, StoreInstructions &storeInstructions)
 {
-	// <ptr for storing, vector of other store instruction that store in the same ptr>
-	unordered_map<LLVMValueRef, vector<LLVMValueRef>> storeInstructionsMap;
 	for (auto basicBlock = LLVMGetFirstBasicBlock(function);
 		 basicBlock;
 		 basicBlock = LLVMGetNextBasicBlock(basicBlock))
@@ -445,48 +1270,58 @@ buildStoreInstructionsMap(LLVMValueRef function)
 				continue;
 			}
 
+			// Give the store the next number, and add it to the stores of its pointer
 			LLVMValueRef storePtr = LLVMGetOperand(instruction, 1);
-
-			// If the storePtr is not already in storeInstructionsMap, add it with an empty vector
-			if (storeInstructionsMap.find(storePtr) == storeInstructionsMap.end())
-			{
-				storeInstructionsMap[storePtr] = vector<LLVMValueRef>();
-			}
-
-			// Add the instruction to the corresponding vector in storeInstructionsMap
-			storeInstructionsMap[storePtr].push_back(instruction);
+			storeInstructions.numbers[instruction] = storeInstructions.stores.size();
+			storeInstructions.stores.push_back(instruction);
+			storeInstructions.byPointer[storePtr].push_back(instruction);
 		}
 	}
 
-	return storeInstructionsMap;
+	// The sets can only be sized once all the stores are numbered
+	size_t numStores = storeInstructions.stores.size();
+	for (auto &pointerStores : storeInstructions.byPointer)
+	{
+		BitVector set(numStores);
+		for (auto storeInstr : pointerStores.second)
+		{
+			set.set(storeInstructions.numbers[storeInstr]);
+		}
+		storeInstructions.setByPointer[pointerStores.first] = set;
+	}
 }
 
 /**
  * @brief Builds kill and gen set maps for a given LLVM function leveraging the store instructions map.
  *
  * This function iterates through all basic blocks and instructions in the given LLVM function,
- * and populates the kill and gen set maps for each basic block. The kill set map contains
- * store instructions that are killed by other store instructions in the basic block, while
- * the gen set map contains the store instructions that are generated in the basic block.
+ * and populates the kill and gen set maps for each basic block. The kill set of a basic block
+ * holds every store to a pointer that the basic block stores to, while the gen set holds the
+ * last store to each of those pointers in the basic block. The kill set may include the
+ * basic block's own stores, as OUT = (IN - KILL) U GEN adds the gen set back.
  *
- * @param function The LLVM function for which kill and gen set maps are to be built.
- * @param storeInstructionsMap The map of store instructions affecting the same pointer.
- * @param killSetMap Pointer to the map that will store the kill sets for each basic block.
- * @param genSetMap Pointer to the map that will store the gen sets for each basic block.
+ * @param cfg The control-flow graph of the function for which kill and gen set maps are to be built.
+ * @param storeInstructions The numbered store instructions of the function.
+ * @param killSetMap The map that will store the kill sets for each basic block.
+ * @param genSetMap The map that will store the gen sets for each basic block.
  */
 static void
 buildKillNGenSetMaps(
-	LLVMValueRef function,
-	unordered_map<LLVMValueRef, vector<LLVMValueRef>> storeInstructionsMap,
-	unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> &killSetMap,
-	unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> &genSetMap)
+	const ControlFlowGraph &cfg,
+	StoreInstructions &storeInstructions,
+	StoreSetMap &killSetMap,
+	StoreSetMap &genSetMap)
 {
+	size_t numStores = storeInstructions.stores.size();
+	killSetMap.assign(cfg.size(), BitVector(numStores));
+	genSetMap.assign(cfg.size(), BitVector(numStores));
 
 	// Iterate through all basic blocks in the function.
-	for (auto basicBlock = LLVMGetFirstBasicBlock(function);
-		 basicBlock;
-		 basicBlock = LLVMGetNextBasicBlock(basicBlock))
+	for (unsigned block = 0; block < cfg.size(); block++)
 	{
+		LLVMBasicBlockRef basicBlock = cfg.block(block);
+		BitVector &killSet = killSetMap[block];
+		BitVector &genSet = genSetMap[block];
 
 		// Iterate through all instructions in the basic block.
 		for (auto instruction = LLVMGetFirstInstruction(basicBlock);
@@ -494,335 +1329,197 @@ buildKillNGenSetMaps(
 			 instruction = LLVMGetNextInstruction(instruction))
 		{
 
-			// Initialize empty kill and gen sets for basic blocks not already in the maps.
-			if (killSetMap.find(basicBlock) == killSetMap.end())
-			{
-				killSetMap[basicBlock] = unordered_set<LLVMValueRef>();
-			}
-			if (genSetMap.find(basicBlock) == genSetMap.end())
-			{
-				genSetMap[basicBlock] = unordered_set<LLVMValueRef>();
-			}
-
 			// Skip non-store instructions.
 			if (!LLVMIsAStoreInst(instruction))
 			{
 				continue;
 			}
 
-			LLVMValueRef storePtr = LLVMGetOperand(instruction, 1);
-
-			// Add the current store instruction to the gen set for the basic block.
-			genSetMap[basicBlock].insert(instruction);
-
-			// Iterate over the vector of store instructions that modify the same pointer.
-			for (auto storedInstr : storeInstructionsMap[storePtr])
-			{
-
-				// Add instructions to the kill set if they are different from the current instruction.
-				if (storedInstr != instruction)
-				{
-					killSetMap[basicBlock].insert(storedInstr);
-				}
-
-				// If there is any instruction killed by adding the current instruction, remove it from the GEN set.
-				if (genSetMap[basicBlock].find(storedInstr) != genSetMap[basicBlock].end() && storedInstr != instruction)
-				{
-					genSetMap[basicBlock].erase(storedInstr);
-
-#ifdef DEBUG
-					printf("\nRemoved instruction from GEN set:\n");
-					LLVMDumpValue(storedInstr);
-					printf("\n was killed by instruction:\n");
-					LLVMDumpValue(instruction);
-					printf("\n");
-#endif
-				}
-			}
-		}
-	}
-}
-
-/**
- * Builds a map of all the predecessors of each basic block in a given function.
- *
- * @param function LLVMValueRef for the function to build the predecessor map for
- * @return unordered_map of LLVMBasicBlockRef to vector of LLVMBasicBlockRef,
- *         where the vector contains all predecessors of a basic block
- */
-static unordered_map<LLVMBasicBlockRef, vector<LLVMBasicBlockRef>>
-buildPredMap(LLVMValueRef function)
-{
-	// Initialize the predecessor map
-	unordered_map<LLVMBasicBlockRef, vector<LLVMBasicBlockRef>> predMap;
-	for (auto basicBlock = LLVMGetFirstBasicBlock(function);
-		 basicBlock;
-		 basicBlock = LLVMGetNextBasicBlock(basicBlock))
-	{
-
-		LLVMValueRef bbTerminator = LLVMGetBasicBlockTerminator(basicBlock);
-
-		// Get the number of successors of the basic block
-		unsigned numSuccessors = LLVMGetNumSuccessors(bbTerminator);
-
-		// Iterate over all the successors of the basic block
-		for (auto i = 0; i < numSuccessors; i++)
-		{
-			LLVMBasicBlockRef successor = LLVMGetSuccessor(bbTerminator, i);
-
-			// Add the successor to the predecessor map
-			predMap[successor].push_back(basicBlock);
-		}
-	}
+			BitVector &pointerStores = storeInstructions.setByPointer[LLVMGetOperand(instruction, 1)];
 
-// Print the predecessor map
-#ifdef DEBUG
-	printf("\nPredecessor map:\n");
-	for (auto basicBlock = LLVMGetFirstBasicBlock(function);
-		 basicBlock;
-		 basicBlock = LLVMGetNextBasicBlock(basicBlock))
-	{
-		printf("\nBasic Block:\n");
-		LLVMDumpValue(LLVMBasicBlockAsValue(basicBlock));
-		printf("\nPredecessors:\n");
-		for (auto predBlock : predMap[basicBlock])
-		{
-			LLVMDumpValue(LLVMBasicBlockAsValue(predBlock));
-			printf("\n");
+			// The current store kills every store to the same pointer, including
+			// the earlier ones of this basic block, which leave the gen set
+			killSet |= pointerStores;
+			genSet.subtract(pointerStores);
+			genSet.set(storeInstructions.numbers[instruction]);
 		}
 	}
-#endif
-
-	return predMap;
 }
 
 /**
- * Given a basic block B, the map of predecessors to B, and the OUT sets of all basic blocks,
- * this function returns the union of all predecessors' OUT sets.
+ * @brief The reaching-stores analysis: the stores whose value may still be in memory at each
+ * point of a function.
  *
- * @param basicBlock: The basic block whose predecessors' OUT sets are to be unioned
- * @param predMap: The map of predecessors to basicBlock
- * @param outSetMap: The map of basic block to its OUT set
- * @return The union of all predecessors' OUT sets
+ * A forward analysis over sets of stores: IN[B] is the union of the OUT sets of B's
+ * predecessors, and OUT[B] = (IN[B] - KILL[B]) U GEN[B].
  */
-static unordered_set<LLVMValueRef>
-findUnionOfAllPredOuts(LLVMBasicBlockRef basicBlock,
-					   unordered_map<LLVMBasicBlockRef, vector<LLVMBasicBlockRef>> predMap,
-					   unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> outSetMap)
+class ReachingStoresAnalysis
 {
+public:
+	typedef BitVector Value;
+	static const DataflowDirection direction = FORWARD_DATAFLOW;
 
-	// Initialize the union of all predecessors' OUT sets
-	unordered_set<LLVMValueRef> unionOfAllPredOuts;
+	ReachingStoresAnalysis(size_t numStores, StoreSetMap &killSetMap, StoreSetMap &genSetMap)
+		: numStores(numStores), killSetMap(killSetMap), genSetMap(genSetMap) {}
 
-	// Iterate over all the predecessors of the basic block
-	for (auto predBlock : predMap[basicBlock])
-	{
-		// Find the OUT set for the predecessor
-		unordered_set<LLVMValueRef> predOutSet = outSetMap[predBlock];
-
-		// Add the OUT set of the predecessor to the union of all predecessors' OUT sets
-		unionOfAllPredOuts.insert(predOutSet.begin(), predOutSet.end());
-	}
-	return unionOfAllPredOuts;
-}
-
-/**
- * @brief Finds the union of (IN - KILL) and GEN sets for a basic block in a data flow analysis.
- *
- * This function finds the union of (IN - KILL) and GEN sets for a given basic block by
- * first checking if the IN set is empty. If it is empty, the function returns the GEN set.
- * If not, it computes the set difference between the IN and KILL sets and adds the
- * resulting set to the GEN set.
- *
- * @param basicBlock The basic block for which the union of IN and GEN sets is to be found.
- * @param inSetMap A map of IN sets for all basic blocks in the function.
- * @param killSetMap A map of KILL sets for all basic blocks in the function.
- * @param genSetMap A map of GEN sets for all basic blocks in the function.
- *
- * @return The union of IN and GEN sets for the given basic block.
- */
-static unordered_set<LLVMValueRef>
-findUnionOfInAndGen(LLVMBasicBlockRef basicBlock,
-					unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> inSetMap,
-					unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> killSetMap,
-					unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> genSetMap)
-{
+	// No store reaches the entry of the function, and the union starts from the empty set
+	Value boundary() const { return BitVector(numStores); }
+	Value initial() const { return BitVector(numStores); }
 
-	// If IN[B] is empty, return GEN[B]
-	if (inSetMap[basicBlock].empty())
-	{
-		return genSetMap[basicBlock];
-	}
+	// IN[B] = U OUT[P] for all P in pred(B)
+	void meet(Value &into, const Value &other) const { into |= other; }
 
-	// Find (IN[B] - KILL[B])
-	unordered_set<LLVMValueRef> result;
-	for (auto instruction : inSetMap[basicBlock])
+	// OUT[B] = (IN[B] - KILL[B]) U GEN[B]
+	void transfer(unsigned block, const Value &in, Value &out) const
 	{
-		// Only add instruction NOT present in KILL[B]
-		if (killSetMap[basicBlock].find(instruction) == killSetMap[basicBlock].end())
-		{
-			result.insert(instruction);
-		}
+		out = in;
+		out.subtract(killSetMap[block]);
+		out |= genSetMap[block];
 	}
 
-	// Find (IN[B] - KILL[B]) U GEN[B]
-	result.insert(genSetMap[basicBlock].begin(), genSetMap[basicBlock].end());
-
-	return result;
-}
+private:
+	size_t numStores;
+	StoreSetMap &killSetMap;
+	StoreSetMap &genSetMap;
+};
 
+#ifdef DEBUG
 /**
  * @brief Prints the IN and OUT sets for each basic block in the given LLVM function.
  *
- * @param function The LLVM function for which the IN and OUT sets are to be printed.
- * @param outSetMap The OUT set map for each basic block.
- * @param inSetMap The IN set map for each basic block.
+ * @param cfg The control-flow graph of the function for which the IN and OUT sets are to be printed.
+ * @param storeInstructions The numbered store instructions of the function.
+ * @param reachingStores The IN and OUT sets of each basic block.
  */
 static void
-printOutNInMaps(LLVMValueRef function,
-				unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> outSetMap,
-				unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> inSetMap)
+printOutNInMaps(const ControlFlowGraph &cfg,
+				StoreInstructions &storeInstructions,
+				DataflowResult<BitVector> &reachingStores)
 {
 
-	for (auto basicBlock = LLVMGetFirstBasicBlock(function);
-		 basicBlock;
-		 basicBlock = LLVMGetNextBasicBlock(basicBlock))
+	for (unsigned block = 0; block < cfg.size(); block++)
 	{
-		fprintf(stderr, "\nBasic Block:\n");
-		LLVMDumpValue(LLVMBasicBlockAsValue(basicBlock));
-		fprintf(stderr, "\nIN set:\n");
-		for (auto instruction : inSetMap[basicBlock])
+		debugPrintf("\nBasic Block:\n");
+		debugDumpValue(LLVMBasicBlockAsValue(cfg.block(block)));
+		debugPrintf("\nIN set:\n");
+		for (size_t store = 0; store < storeInstructions.stores.size(); store++)
 		{
-			LLVMDumpValue(instruction);
-			printf("\n");
+			if (reachingStores.entry[block].test(store))
+			{
+				debugDumpValue(storeInstructions.stores[store]);
+				debugPrintf("\n");
+			}
 		}
-		fprintf(stderr, "\nOUT set:\n");
-		for (auto instruction : outSetMap[basicBlock])
+		debugPrintf("\nOUT set:\n");
+		for (size_t store = 0; store < storeInstructions.stores.size(); store++)
 		{
-			LLVMDumpValue(instruction);
-			fprintf(stderr, "\n");
+			if (reachingStores.exit[block].test(store))
+			{
+				debugDumpValue(storeInstructions.stores[store]);
+				debugPrintf("\n");
+			}
 		}
 	}
 }
+#endif
 
 /**
  * @brief Builds the IN and OUT sets for each basic block in a given LLVM function.
  *
- * This function initializes the IN and OUT sets for each basic block in the function.
- * It then iteratively computes the IN and OUT sets for each basic block using the kill
- * and gen sets of the basic blocks and the IN and OUT sets of its predecessors.
+ * This function runs the reaching-stores analysis to its fixed point with the dataflow
+ * solver, which visits the basic blocks in reverse postorder and only revisits those whose
+ * predecessors' OUT sets changed.
  *
- * @param function The LLVM function for which IN and OUT sets are to be built.
- * @param predMap A map containing the predecessors of each basic block in the function.
+ * @param cfg The control-flow graph of the function for which IN and OUT sets are to be built.
+ * @param storeInstructions The numbered store instructions of the function.
  * @param killSetMap A map containing the kill sets for each basic block in the function.
  * @param genSetMap A map containing the gen sets for each basic block in the function.
- * @param inSetMap A map containing the IN sets for each basic block in the function.
- * @param outSetMap A map containing the OUT sets for each basic block in the function.
+ * @param reachingStores Receives the IN (entry) and OUT (exit) sets of each basic block.
  */
 static void buildInNOutSets(
-	LLVMValueRef function,
-	unordered_map<LLVMBasicBlockRef, vector<LLVMBasicBlockRef>> &predMap,
-	unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> &killSetMap,
-	unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> &genSetMap,
-	unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> &inSetMap,
-	unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> &outSetMap)
-{
-	// Initialize the IN and OUT sets for each basic block
-	for (auto basicBlock = LLVMGetFirstBasicBlock(function);
-		 basicBlock;
-		 basicBlock = LLVMGetNextBasicBlock(basicBlock))
-	{
-
-		// Initialize the IN and OUT sets for each basic block
-		inSetMap[basicBlock] = unordered_set<LLVMValueRef>();
-		outSetMap[basicBlock] = genSetMap[basicBlock];
-	}
-
-	// IN and OUT sets
-	bool codeChanged = true;
-
-#ifdef DEBUG
-	fprintf(stderr, "\nInitial IN and OUT sets:\n");
-	printOutNInMaps(function, outSetMap, inSetMap);
-	int iteration = 0;
-#endif
-
-	while (codeChanged)
-	{
-		codeChanged = false;
-
-		for (auto basicBlock = LLVMGetFirstBasicBlock(function);
-			 basicBlock;
-			 basicBlock = LLVMGetNextBasicBlock(basicBlock))
-		{
-
-			// IN[B] = U OUT[P] for all P in pred(B)
-			inSetMap[basicBlock] = findUnionOfAllPredOuts(basicBlock, predMap, outSetMap);
-
-			// OUT[B] = (IN[B] - KILL[B]) U GEN[B]
-			unordered_set<LLVMValueRef> newOut = findUnionOfInAndGen(basicBlock, inSetMap, killSetMap, genSetMap);
-
-			// Check if the OUT set has changed
-			if (outSetMap[basicBlock] != newOut)
-			{
-				codeChanged = true;
-			}
-
-			outSetMap[basicBlock] = newOut;
-		}
+	const ControlFlowGraph &cfg,
+	StoreInstructions &storeInstructions,
+	StoreSetMap &killSetMap,
+	StoreSetMap &genSetMap,
+	DataflowResult<BitVector> &reachingStores)
+{
+	ReachingStoresAnalysis analysis(storeInstructions.stores.size(), killSetMap, genSetMap);
+	solveDataflow(cfg, analysis, reachingStores);
 
 #ifdef DEBUG
-		fprintf(stderr, "\nIteration %d:\n", iteration);
-		printOutNInMaps(function, outSetMap, inSetMap);
-		iteration += 1;
+	debugPrintf("\nReaching stores after %zu block visits:\n", reachingStores.visits);
+	printOutNInMaps(cfg, storeInstructions, reachingStores);
 #endif
-	}
 }
 
 /**
- * @brief Checks if all store instructions write the same constant value.
+ * @brief Finds the value that a load reads if all the stores that reach it write the same value,
+ * so that the load can be replaced by it (store-to-load forwarding).
  *
- * This function takes a vector of store instructions and checks if all store instructions write
- * the same constant value into memory. It returns true if all store instructions write the same
- * constant value, and false otherwise.
+ * A constant or an argument can replace the load anywhere. A value computed by an instruction can
+ * only replace it where the instruction dominates the load: a store that reaches the load around
+ * a loop may write a value that the loop computes after the load.
  *
- * @param allStoresForLoadPtr A vector of store instructions writing to the same memory location.
- * @return True if all store instructions write the same constant value, false otherwise.
+ * @param allStoresForLoadPtr The stores that write to the pointer of the load and reach it.
+ * @param load The load instruction.
+ * @param passes The pass manager, which holds the dominator tree.
+ * @return The value the load reads, or NULL if it has to read it from memory.
  */
-static bool
-allStoreWriteSameConstant(vector<LLVMValueRef> allStoresForLoadPtr)
+static LLVMValueRef
+getForwardedValue(vector<LLVMValueRef> &allStoresForLoadPtr, LLVMValueRef load, PassManager &passes)
 {
 // Print all the store instructions
 #ifdef DEBUG
-	printf("\nAll store instructions:\n");
+	debugPrintf("\nAll store instructions:\n");
 	for (auto storeInstr : allStoresForLoadPtr)
 	{
-		LLVMDumpValue(storeInstr);
-		printf("\n");
+		debugDumpValue(storeInstr);
+		debugPrintf("\n");
 	}
 #endif
 
-	// Get the constant value written by the first store instruction
-	LLVMValueRef firstStoreVal = LLVMGetOperand(allStoresForLoadPtr[0], 0);
-
-	if (!LLVMIsAConstantInt(firstStoreVal))
+	// A load that no store reaches (such as a read of an uninitialized variable) has no value to propagate
+	if (allStoresForLoadPtr.empty())
 	{
-		return false;
+		return NULL;
 	}
 
-	// Iterate over all the store instructions that write to loadPtr
+	// Every store must write the value of the first one
+	LLVMValueRef value = LLVMGetOperand(allStoresForLoadPtr[0], 0);
 	for (auto storeInstr : allStoresForLoadPtr)
 	{
-		// Return false if it is not a constant store instruction or does not write the same constant value
-		LLVMValueRef storeVal = LLVMGetOperand(storeInstr, 0);
-		if (!LLVMIsAConstantInt(storeVal) || LLVMGetOperand(storeInstr, 0) != firstStoreVal)
+		if (LLVMGetOperand(storeInstr, 0) != value)
 		{
-			return false;
+			return NULL;
 		}
 	}
+	if (LLVMTypeOf(value) != LLVMTypeOf(load))
+	{
+		return NULL;
+	}
+	if (!LLVMIsAInstruction(value))
+	{
+		return value;
+	}
 
-	// All store instructions write the same constant value
-	return true;
+	// In the block of the load, the value must be computed before it
+	LLVMBasicBlockRef valueBlock = LLVMGetInstructionParent(value);
+	LLVMBasicBlockRef loadBlock = LLVMGetInstructionParent(load);
+	if (valueBlock != loadBlock)
+	{
+		const ControlFlowGraph &cfg = passes.controlFlowGraph();
+		return passes.dominatorTree().dominates(cfg.index(valueBlock), cfg.index(loadBlock)) ? value : NULL;
+	}
+	for (auto instruction = LLVMGetFirstInstruction(loadBlock);
+		 instruction != load;
+		 instruction = LLVMGetNextInstruction(instruction))
+	{
+		if (instruction == value)
+		{
+			return value;
+		}
+	}
+	return NULL;
 }
 
 /**
@@ -833,30 +1530,20 @@ allStoreWriteSameConstant(vector<LLVMValueRef> allStoresForLoadPtr)
  * The store instruction is then added to R (in-set) for future processing.
  *
  * @param instruction The LLVM store instruction to be processed.
- * @param storeInstructionsMap The map of store instructions affecting the same pointer.
+ * @param storeInstructions The numbered store instructions of the function.
  * @param R The in-set for the current basic block.
  */
 static void
 processStoreInstruction(LLVMValueRef instruction,
-						unordered_map<LLVMValueRef, vector<LLVMValueRef>> storeInstructionsMap,
-						unordered_set<LLVMValueRef> &R)
+						StoreInstructions &storeInstructions,
+						BitVector &R)
 {
 
 	// Remove all the instruction in R that will be killed by the current instruction
 	LLVMValueRef storePtr = LLVMGetOperand(instruction, 1);
+	R.subtract(storeInstructions.setByPointer[storePtr]);
 
-	for (auto killedInstr : storeInstructionsMap[storePtr])
-	{
-		R.erase(killedInstr);
-
-#ifdef DEBUG
-		printf("Instruction(s) killed by the current store instruction\n");
-		LLVMDumpValue(killedInstr);
-		printf("\n");
-#endif
-	}
-
-	R.insert(instruction);
+	R.set(storeInstructions.numbers[instruction]);
 }
 
 /**
@@ -864,88 +1551,98 @@ processStoreInstruction(LLVMValueRef instruction,
  *
  * This function processes the given load instruction, and identifies all the store instructions in the IN set map
  * that write to the same memory address as the load instruction. If all these store instructions write the same
- * constant value into memory, the function replaces all uses of the load instruction with the constant value in the
- * store instruction and marks the load instruction for deletion.
+ * value into memory, and the value can replace the load (see getForwardedValue), the function replaces all uses of
+ * the load instruction with it and marks the load instruction for deletion.
  *
  * @param instruction The LLVM load instruction to be processed.
- * @param storeInstructionsMap The map of store instructions affecting the same pointer.
+ * @param storeInstructions The numbered store instructions of the function.
  * @param R The in set of the basic block in which the instruction resides.
+ * @param passes The pass manager, which records the changes.
  * @param toDelete A vector containing LLVM instructions to be deleted from the basic block.
  */
 
 static void
 processLoadInstruction(LLVMValueRef instruction,
-					   unordered_map<LLVMValueRef, vector<LLVMValueRef>> storeInstructionsMap,
-					   unordered_set<LLVMValueRef> R, vector<LLVMValueRef> &toDelete)
+					   StoreInstructions &storeInstructions,
+					   BitVector &R, PassManager &passes, vector<LLVMValueRef> &toDelete)
 {
 #ifdef DEBUG
-	printf("Load instruction: \n");
-	LLVMDumpValue(instruction);
-	printf("\n");
+	debugPrintf("Load instruction: \n");
+	debugDumpValue(instruction);
+	debugPrintf("\n");
 #endif
 
 	LLVMValueRef loadPtr = LLVMGetOperand(instruction, 0);
 
 	// Find all the store instructions in R that write to loadPtr
 	vector<LLVMValueRef> allStoresForLoadPtr;
-	for (auto strInstr : storeInstructionsMap[loadPtr])
+	for (auto strInstr : storeInstructions.byPointer[loadPtr])
 	{
-		if (R.find(strInstr) != R.end())
+		if (R.test(storeInstructions.numbers[strInstr]))
 		{
 			allStoresForLoadPtr.push_back(strInstr);
 		}
 	}
 
-	// If all these store instructions are constant store instructions and write
-	// the same constant value into memory
-	if (allStoreWriteSameConstant(allStoresForLoadPtr))
+	// If all these store instructions write the same value into memory, and it can replace the load
+	LLVMValueRef value = getForwardedValue(allStoresForLoadPtr, instruction, passes);
+	if (value)
 	{
-		// replaces all uses of the load instruction by the constant in the store instruction
-		LLVMReplaceAllUsesWith(instruction, LLVMGetOperand(allStoresForLoadPtr[0], 0));
+		// replaces all uses of the load instruction by the value in the store instructions
+		passes.remark("Constant propagation", LLVMIsAConstant(value) ? "loads propagated" : "loads forwarded",
+					  instruction, value);
+		passes.replaceAllUsesWith(instruction, value);
 		toDelete.push_back(instruction);
 
 #ifdef DEBUG
-		printf("\nReplaced instruction:\n");
-		LLVMDumpValue(instruction);
-		printf("\nwith instruction:\n");
-		LLVMDumpValue(LLVMGetOperand(allStoresForLoadPtr[0], 0));
-		printf("\n");
+		debugPrintf("\nReplaced instruction:\n");
+		debugDumpValue(instruction);
+		debugPrintf("\nwith instruction:\n");
+		debugDumpValue(value);
+		debugPrintf("\n");
 #endif
 	}
 	else
 	{
 #ifdef DEBUG
-		printf("Not all store instructions write the same constant value\n");
+		debugPrintf("The stores do not write a value that can replace the load\n");
 #endif
 	}
 }
 
 /**
- * @brief Processes all basic blocks in the given LLVM function using the provided storeInstructionsMap and inSetMap.
+ * @brief Processes the given basic blocks of an LLVM function using the provided storeInstructions and inSetMap.
  *
- * This function iterates through all basic blocks and instructions in the given LLVM function,
+ * This function iterates through the basic blocks to visit and their instructions,
  * processes each instruction and updates the in and out sets of each basic block. Instructions marked
  * for deletion are stored in the toDelete vector.
  *
- * @param function The LLVM function for which the basic blocks are to be processed.
- * @param storeInstructionsMap The map of store instructions affecting the same pointer.
- * @param inSetMap The map of in sets for each basic block.
+ * @param cfg The control-flow graph of the function for which the basic blocks are to be processed.
+ * @param storeInstructions The numbered store instructions of the function.
+ * @param inSetMap The in sets for each basic block.
+ * @param visit Whether to process each basic block.
+ * @param passes The pass manager, which records the changes.
  * @param toDelete The vector that will store instructions marked for deletion.
  */
 static void
-processBasicBlocks(LLVMValueRef function,
-				   unordered_map<LLVMValueRef, vector<LLVMValueRef>> storeInstructionsMap,
-				   unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> inSetMap,
+processBasicBlocks(const ControlFlowGraph &cfg,
+				   StoreInstructions &storeInstructions,
+				   StoreSetMap &inSetMap,
+				   vector<bool> &visit,
+				   PassManager &passes,
 				   vector<LLVMValueRef> &toDelete)
 {
 
 	// Iterate over all the basic blocks in the function
-	for (auto basicBlock = LLVMGetFirstBasicBlock(function);
-		 basicBlock;
-		 basicBlock = LLVMGetNextBasicBlock(basicBlock))
+	for (unsigned block = 0; block < cfg.size(); block++)
 	{
-
-		unordered_set<LLVMValueRef> R = inSetMap[basicBlock];
+		if (!visit[block])
+		{
+			continue;
+		}
+
+		LLVMBasicBlockRef basicBlock = cfg.block(block);
+		BitVector R = inSetMap[block];
 
 		// Iterate over all the instructions in the basic block
 		for (auto instruction = LLVMGetFirstInstruction(basicBlock);
@@ -954,185 +1651,2120 @@ processBasicBlocks(LLVMValueRef function,
 		{
 
 #ifdef DEBUG
-			printf("Current store instruction: \n");
-			LLVMDumpValue(instruction);
-			printf("\n");
+			debugPrintf("Current store instruction: \n");
+			debugDumpValue(instruction);
+			debugPrintf("\n");
 #endif
 
 			if (LLVMIsAStoreInst(instruction))
 			{
-				processStoreInstruction(instruction, storeInstructionsMap, R);
+				processStoreInstruction(instruction, storeInstructions, R);
 			}
 			else if (LLVMIsALoadInst(instruction))
 			{
-				processLoadInstruction(instruction, storeInstructionsMap, R, toDelete);
+				processLoadInstruction(instruction, storeInstructions, R, passes, toDelete);
 			}
 		}
 	}
 }
 
+/**
+ * @brief The reaching stores of a function, kept by constant propagation from one round of the
+ * optimizer to the next.
+ *
+ * The analysis only depends on which stores there are and where, not on the values they write,
+ * so it stays valid until a store is erased. Between two runs, constant propagation only has to
+ * revisit the loads that a store with a new value operand reaches.
+ */
+typedef struct
+{
+	StoreInstructions storeInstructions;
+	DataflowResult<BitVector> reachingStores;
+} ReachingStoresCache;
+
 /**
  * @brief Performs constant propagation on the given function.
  *
- * It replaces load instructions with constants if all the stores
- * that write to the memory location being read have the same constant value.
+ * It replaces load instructions with the value that all the stores that write to the memory
+ * location being read have, if it is a constant or an SSA value that dominates the load.
+ *
+ * The first run (and the first after a store is erased) computes the reaching stores and
+ * visits every basic block. A later run only visits the blocks that hold, or are reached by,
+ * a store whose value operand has changed since: no other load can have a new result.
  *
  * @param function The LLVM function to optimize
+ * @param passes The pass manager, which holds the control-flow graph and records the changes
+ * @param cache The reaching stores of the function, from an earlier run
+ * @param propagate Whether to replace the loads, or only to bring the reaching stores up to date
+ * 					for dead store elimination
  *
  * @return True if any instruction was deleted, False otherwise
  */
 static bool
-constantPropagation(LLVMValueRef function)
+constantPropagation(LLVMValueRef function, PassManager &passes, ReachingStoresCache &cache, bool propagate)
 {
-	// Build a map of store instructions
-	unordered_map<LLVMValueRef, vector<LLVMValueRef>> storeInstructionsMap = buildStoreInstructionsMap(function);
+	const ControlFlowGraph &cfg = passes.controlFlowGraph();
+	StoreInstructions &storeInstructions = cache.storeInstructions;
+	vector<bool> visit(cfg.size(), false);
+
+	// Take the stores changed since the last run; the changes of this run are for the next one
+	vector<LLVMValueRef> changedStores;
+	changedStores.swap(passes.changedStores);
+
+	if (passes.storeSetChanged)
+	{
+		passes.storeSetChanged = false;
+
+		// Number the store instructions and group them by pointer
+		storeInstructions = StoreInstructions();
+		buildStoreInstructionsMap(function, storeInstructions);
 
-	// Declare KILL and GEN Maps and populate them
-	unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> killSetMap;
-	unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> genSetMap;
-	buildKillNGenSetMaps(function, storeInstructionsMap, killSetMap, genSetMap);
+		// Declare KILL and GEN Maps and populate them
+		StoreSetMap killSetMap;
+		StoreSetMap genSetMap;
+		buildKillNGenSetMaps(cfg, storeInstructions, killSetMap, genSetMap);
 
-	// Build a map of all the predecessors of each basic block
-	unordered_map<LLVMBasicBlockRef, vector<LLVMBasicBlockRef>> predMap = buildPredMap(function);
+		// Compute the IN and OUT sets for each basic block
+		buildInNOutSets(cfg, storeInstructions, killSetMap, genSetMap, cache.reachingStores);
+
+		visit.assign(cfg.size(), true);
+	}
+	else
+	{
+		if (changedStores.empty())
+		{
+			return false;
+		}
 
-	// Initialize the IN and OUT sets for each basic block
-	unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> inSetMap;
-	unordered_map<LLVMBasicBlockRef, unordered_set<LLVMValueRef>> outSetMap;
+		// The blocks of the changed stores, and the blocks they reach
+		BitVector changed(storeInstructions.stores.size());
+		for (auto storeInstr : changedStores)
+		{
+			changed.set(storeInstructions.numbers[storeInstr]);
+			visit[cfg.index(LLVMGetInstructionParent(storeInstr))] = true;
+		}
+		for (unsigned block = 0; block < cfg.size(); block++)
+		{
+			BitVector reached = cache.reachingStores.entry[block];
+			reached &= changed;
+			visit[block] = visit[block] || !reached.none();
+		}
+	}
 
-	buildInNOutSets(function, predMap, killSetMap, genSetMap, inSetMap, outSetMap);
+	if (!propagate)
+	{
+		return false;
+	}
 
 	vector<LLVMValueRef> toDelete;
 
-	// Iterate over all the basic blocks and instructions to perform constant propagation
-	processBasicBlocks(function, storeInstructionsMap, inSetMap, toDelete);
+	// Iterate over the basic blocks to visit and their instructions to perform constant propagation
+	processBasicBlocks(cfg, storeInstructions, cache.reachingStores.entry, visit, passes, toDelete);
 
 	// Now erase the marked instructions from the basic block
-	deleteMarkedInstructions(toDelete);
+	deleteMarkedInstructions(passes, toDelete);
 
 	return toDelete.size() > 0; // return true if any instruction was deleted
 }
 
 /**
- * @brief Optimizes a single LLVM function using various optimization techniques.
+ * Determines whether an alloca can be promoted to SSA values: it holds one integer and its address
+ * never escapes, so that it is only read by loads and only written by stores to it, of its own type.
+ * Every local variable and parameter of MiniC is such an alloca.
+ *
+ * @param alloca The alloca instruction to check.
+ * @return true if every use of the alloca is a load from it or a store to it of the type it holds,
+ * false otherwise.
+ */
+static bool
+isPromotableAlloca(LLVMValueRef alloca)
+{
+	LLVMTypeRef type = LLVMGetAllocatedType(alloca);
+	if (LLVMGetTypeKind(type) != LLVMIntegerTypeKind)
+	{
+		return false;
+	}
+	for (auto use = LLVMGetFirstUse(alloca); use; use = LLVMGetNextUse(use))
+	{
+		LLVMValueRef user = LLVMGetUser(use);
+		if (LLVMIsALoadInst(user))
+		{
+			if (LLVMTypeOf(user) != type)
+			{
+				return false;
+			}
+			continue;
+		}
+		if (!LLVMIsAStoreInst(user) || LLVMGetOperand(user, 0) == alloca || LLVMTypeOf(LLVMGetOperand(user, 0)) != type)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Performs dead store elimination on the given function.
  *
- * This function performs multiple optimizations on the given LLVM function, including
- * constant propagation, constant folding, common subexpression elimination, and
- * dead code elimination. Optimizations are applied iteratively until no more changes
- * are made to the function.
+ * A store is dead if no load reads the value it writes: another store to its pointer overwrites
+ * it on every path to a load, or no load of the pointer comes after it at all. The loads read the
+ * stores that reach them, which the reaching-stores analysis of constant propagation already has
+ * for the start of each basic block. Only the stores to allocas whose address does not escape are
+ * removed; the others may be read after the function returns.
  *
- * @param function The LLVM function to be optimized.
+ * It runs right after constant propagation, whose analysis is up to date until a store is erased.
+ *
+ * @param passes The pass manager, which holds the control-flow graph and records the changes
+ * @param cache The reaching stores of the function, as constant propagation left them
+ * @return True if any store was deleted, False otherwise
  */
-void optimizeFunction(LLVMValueRef function)
+static bool
+deadStoreElimination(PassManager &passes, ReachingStoresCache &cache)
 {
-	bool codeChanged = true;
+	const ControlFlowGraph &cfg = passes.controlFlowGraph();
+	StoreInstructions &storeInstructions = cache.storeInstructions;
+	BitVector read(storeInstructions.stores.size());
 
-	while (codeChanged)
+	// Mark the stores that reach a load of their pointer
+	for (unsigned block = 0; block < cfg.size(); block++)
 	{
-		// Reset codeChanged to false before applying optimizations
-		codeChanged = false;
+		BitVector R = cache.reachingStores.entry[block];
+		for (auto instruction = LLVMGetFirstInstruction(cfg.block(block));
+			 instruction;
+			 instruction = LLVMGetNextInstruction(instruction))
+		{
+			if (LLVMIsAStoreInst(instruction))
+			{
+				processStoreInstruction(instruction, storeInstructions, R);
+			}
+			else if (LLVMIsALoadInst(instruction))
+			{
+				auto pointerStores = storeInstructions.setByPointer.find(LLVMGetOperand(instruction, 0));
+				if (pointerStores != storeInstructions.setByPointer.end())
+				{
+					BitVector reaching = R;
+					reaching &= pointerStores->second;
+					read |= reaching;
+				}
+			}
+		}
+	}
 
-		// perform global optimization
-		codeChanged = constantPropagation(function) || codeChanged;
-#ifdef DEBUG
-		printf("\nConstant propagation: %d\n", codeChanged);
-		printf("______________________________________\n");
-#endif
+	vector<LLVMValueRef> toDelete;
+	unordered_map<LLVMValueRef, bool> promotable; // <pointer, whether it is an alloca whose address does not escape>
+	for (size_t store = 0; store < storeInstructions.stores.size(); store++)
+	{
+		LLVMValueRef pointer = LLVMGetOperand(storeInstructions.stores[store], 1);
+		if (!promotable.count(pointer))
+		{
+			promotable[pointer] = LLVMIsAAllocaInst(pointer) && isPromotableAlloca(pointer);
+		}
+		if (!read.test(store) && promotable[pointer])
+		{
+			passes.remark("Dead store elimination", "stores deleted", storeInstructions.stores[store]);
+			toDelete.push_back(storeInstructions.stores[store]);
+		}
+	}
+
+	deleteMarkedInstructions(passes, toDelete);
+
+	return toDelete.size() > 0; // return true if any store was deleted
+}
+
+/**
+ * The state of SSA construction while it walks the dominator tree: the value that each promoted
+ * variable holds at the current point, with a log of the values it replaced so that they can be
+ * restored when the walk leaves a subtree.
+ */
+typedef struct
+{
+	vector<LLVMValueRef> variables;						// the promoted allocas, by number
+	unordered_map<LLVMValueRef, unsigned> numbers;		// <alloca, number>
+	vector<vector<pair<LLVMValueRef, unsigned>>> phis;	// <block, phis placed in it and their variable>
+	vector<LLVMValueRef> currentValues;					// <variable, value at this point, or NULL before any store>
+	vector<pair<unsigned, LLVMValueRef>> valueLog;		// <variable, previous value>
+	vector<LLVMValueRef> zeros;							// <variable, the value it is read as before any store>
+	vector<LLVMValueRef> toDelete;						// the loads and stores of the promoted allocas
+} SSARenaming;
+
+// A block of the dominator tree that the SSA renaming walk is in
+typedef struct
+{
+	unsigned block;
+	unsigned nextChild; // the next of its children to visit
+	size_t valueMark;	// the size of the value log before the block was renamed
+} RenamingFrame;
+
+/**
+ * @return The value a promoted variable holds at the current point of the walk.
+ */
+static LLVMValueRef
+currentValue(SSARenaming &renaming, unsigned variable)
+{
+	LLVMValueRef value = renaming.currentValues[variable];
+	return value ? value : renaming.zeros[variable];
+}
+
+/**
+ * Gives the incoming values of the phis of the successors of a block, for the edges from the block.
+ *
+ * @param passes The pass manager, which holds the control-flow graph.
+ * @param block The predecessor.
+ * @param renaming The state of the walk, with the values at the end of the block.
+ */
+static void
+addIncomingValues(PassManager &passes, unsigned block, SSARenaming &renaming)
+{
+	const ControlFlowGraph &cfg = passes.controlFlowGraph();
+	LLVMBasicBlockRef basicBlock = cfg.block(block);
 
-		for (auto basicBlock = LLVMGetFirstBasicBlock(function);
-			 basicBlock;
-			 basicBlock = LLVMGetNextBasicBlock(basicBlock))
+	// A block that branches twice to the same successor gives its phis an entry for each edge, as LLVM requires
+	for (unsigned successor : cfg.successors(block))
+	{
+		for (auto &phi : renaming.phis[successor])
 		{
+			LLVMValueRef value = currentValue(renaming, phi.second);
+			unique_lock<mutex> lock = passes.lockContext();
+			LLVMAddIncoming(phi.first, &value, &basicBlock, 1);
+		}
+	}
+}
 
-			// call local optimization functions
-			codeChanged = constantFolding(basicBlock) || codeChanged;
-#ifdef DEBUG
-			printf("\nConstant folding: %d\n", codeChanged);
-			printf("______________________________________\n");
-#endif
+/**
+ * SSA renaming of a basic block, when the walk of the dominator tree enters it.
+ *
+ * The phis placed in the block define their variable, a store defines its variable with its value
+ * operand, and a load is replaced by the value its variable holds at that point. The values at the
+ * end of the block flow into the phis of its successors. The definitions are logged, so that
+ * renameDominatorTree can undo them once it leaves the blocks the block dominates.
+ *
+ * @param passes The pass manager, which holds the control-flow graph and records the changes.
+ * @param block The block to rename.
+ * @param renaming The state of the walk.
+ */
+static void
+renameBlock(PassManager &passes, unsigned block, SSARenaming &renaming)
+{
+	const ControlFlowGraph &cfg = passes.controlFlowGraph();
 
-			codeChanged = commonSubexpressionElimination(basicBlock) || codeChanged;
-#ifdef DEBUG
-			printf("\nCommon expression: %d\n", codeChanged);
-			printf("______________________________________\n");
-#endif
+	for (auto &phi : renaming.phis[block])
+	{
+		renaming.valueLog.push_back({phi.second, renaming.currentValues[phi.second]});
+		renaming.currentValues[phi.second] = phi.first;
+	}
 
-			codeChanged = deadCodeElimination(basicBlock) || codeChanged;
-#ifdef DEBUG
-			printf("\nDead code: %d\n", codeChanged);
-			printf("______________________________________\n");
-#endif
+	for (auto instruction = LLVMGetFirstInstruction(cfg.block(block));
+		 instruction;
+		 instruction = LLVMGetNextInstruction(instruction))
+	{
+		bool isLoad = LLVMIsALoadInst(instruction) != NULL;
+		if (!isLoad && !LLVMIsAStoreInst(instruction))
+		{
+			continue;
+		}
+		auto variable = renaming.numbers.find(LLVMGetOperand(instruction, isLoad ? 0 : 1));
+		if (variable == renaming.numbers.end())
+		{
+			continue;
+		}
+
+		if (isLoad)
+		{
+			passes.replaceAllUsesWith(instruction, currentValue(renaming, variable->second));
+		}
+		else
+		{
+			renaming.valueLog.push_back({variable->second, renaming.currentValues[variable->second]});
+			renaming.currentValues[variable->second] = LLVMGetOperand(instruction, 0);
 		}
+		renaming.toDelete.push_back(instruction);
 	}
+
+	addIncomingValues(passes, block, renaming);
 }
 
 /**
- * @brief Optimizes the entire program (LLVM module) by optimizing each function within.
+ * SSA renaming of the blocks of the dominator tree below `root`, in depth-first order: each block
+ * is renamed, then the blocks it dominates, and then the values its definitions replaced are
+ * restored. The walk keeps its own stack of frames, as DominatorTree::numberTree does, so deeply
+ * nested programs do not grow the call stack.
  *
- * This function iterates through all functions in the provided LLVM module
- * and optimizes each of them by calling the optimizeFunction function.
+ * @param passes The pass manager, which holds the dominator tree and records the changes.
+ * @param root The root of the walk, the entry block.
+ * @param renaming The state of the walk.
+ */
+static void
+renameDominatorTree(PassManager &passes, unsigned root, SSARenaming &renaming)
+{
+	const DominatorTree &dominators = passes.dominatorTree();
+	vector<RenamingFrame> stack;
+	stack.push_back({root, 0, renaming.valueLog.size()});
+	renameBlock(passes, root, renaming);
+	while (!stack.empty())
+	{
+		RenamingFrame &top = stack.back();
+		const vector<unsigned> &children = dominators.children(top.block);
+		if (top.nextChild < children.size())
+		{
+			unsigned child = children[top.nextChild++];
+			stack.push_back({child, 0, renaming.valueLog.size()});
+			renameBlock(passes, child, renaming);
+			continue;
+		}
+
+		// Leave the scope of the block: undo its definitions, the latest first
+		while (renaming.valueLog.size() > top.valueMark)
+		{
+			renaming.currentValues[renaming.valueLog.back().first] = renaming.valueLog.back().second;
+			renaming.valueLog.pop_back();
+		}
+		stack.pop_back();
+	}
+}
+
+/**
+ * Erases the phis placed by SSA construction that no other instruction needs: those whose value is
+ * only used by phis that are themselves unused, such as the phi of a variable that is assigned in a
+ * loop but never read after it. The phis that are needed are found from the non-phi instructions
+ * that use them, and the remaining ones are erased once their uses among themselves are dropped.
  *
- * @param module The LLVM module representing the program to be optimized.
+ * @param passes The pass manager, which records the changes.
+ * @param renaming The phis that were placed.
  */
-void optimizeProgram(LLVMModuleRef module)
+static void
+removeDeadPhis(PassManager &passes, SSARenaming &renaming)
 {
-	// Iterate through all functions in the module
-	for (auto function = LLVMGetFirstFunction(module);
-		 function;
-		 function = LLVMGetNextFunction(function))
+	unordered_set<LLVMValueRef> live;
+	vector<LLVMValueRef> worklist;
+	for (auto &blockPhis : renaming.phis)
+	{
+		for (auto &phi : blockPhis)
+		{
+			for (auto use = LLVMGetFirstUse(phi.first); use; use = LLVMGetNextUse(use))
+			{
+				if (!LLVMIsAPHINode(LLVMGetUser(use)))
+				{
+					live.insert(phi.first);
+					worklist.push_back(phi.first);
+					break;
+				}
+			}
+		}
+	}
+	while (!worklist.empty())
 	{
+		LLVMValueRef phi = worklist.back();
+		worklist.pop_back();
+		for (unsigned i = 0; i < LLVMCountIncoming(phi); i++)
+		{
+			LLVMValueRef incoming = LLVMGetIncomingValue(phi, i);
+			if (LLVMIsAPHINode(incoming) && live.insert(incoming).second)
+			{
+				worklist.push_back(incoming);
+			}
+		}
+	}
 
-		const char *funcName = LLVMGetValueName(function);
+	// Keep the live phis in the renaming state, for removeTrivialPhis
+	vector<LLVMValueRef> dead;
+	for (auto &blockPhis : renaming.phis)
+	{
+		vector<pair<LLVMValueRef, unsigned>> livePhis;
+		for (auto &phi : blockPhis)
+		{
+			if (live.count(phi.first))
+			{
+				livePhis.push_back(phi);
+				continue;
+			}
+			passes.replaceAllUsesWith(phi.first, renaming.zeros[phi.second]);
+			dead.push_back(phi.first);
+		}
+		blockPhis.swap(livePhis);
+	}
+	deleteMarkedInstructions(passes, dead);
+}
 
-#ifdef DEBUG
-		printf("Function Name: %s\n", funcName);
-#endif
+/**
+ * Replaces the phis whose incoming values are all the same value, or the phi itself, with that
+ * value, as the phi of a variable that a loop reads but never writes. Replacing a phi can make
+ * another one trivial, so the phis are checked again until none is.
+ *
+ * @param passes The pass manager, which records the changes.
+ * @param renaming The phis that were placed and survived removeDeadPhis.
+ */
+static void
+removeTrivialPhis(PassManager &passes, SSARenaming &renaming)
+{
+	vector<LLVMValueRef> phis;
+	for (auto &blockPhis : renaming.phis)
+	{
+		for (auto &phi : blockPhis)
+		{
+			phis.push_back(phi.first);
+		}
+	}
 
-		// Optimize the current function
-		optimizeFunction(function);
+	unordered_set<LLVMValueRef> removed;
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (auto phi : phis)
+		{
+			if (removed.count(phi))
+			{
+				continue;
+			}
+			LLVMValueRef same = NULL;
+			bool trivial = true;
+			for (unsigned i = 0; i < LLVMCountIncoming(phi) && trivial; i++)
+			{
+				LLVMValueRef incoming = LLVMGetIncomingValue(phi, i);
+				if (incoming == phi || incoming == same)
+				{
+					continue;
+				}
+				trivial = same == NULL;
+				same = incoming;
+			}
+			if (!trivial || same == NULL)
+			{
+				continue;
+			}
+			passes.replaceAllUsesWith(phi, same);
+			removed.insert(phi);
+			changed = true;
+		}
 	}
+
+	vector<LLVMValueRef> toDelete(removed.begin(), removed.end());
+	deleteMarkedInstructions(passes, toDelete);
 }
 
 /**
- * @brief The main function of the program.
+ * @brief Promotes the allocas of a function to SSA values (mem2reg).
+ *
+ * The IR generator gives every variable an alloca, and reads and writes it with loads and stores.
+ * This pass replaces the allocas whose address does not escape with SSA values, as described by
+ * Cytron et al.: a phi for a variable is placed at the iterated dominance frontier of the blocks
+ * that store to it, and a walk of the dominator tree then replaces every load with the value the
+ * variable holds at that point. A variable read before any store reads 0, which is as good as any
+ * other value for C's uninitialized locals. Dead and trivial phis are removed afterwards, and the
+ * loads, stores and allocas are erased.
  *
- * This function is the entry point of the program and is called when the program is executed.
- * It takes command line arguments as input and typically returns an integer value indicating
- * the success or failure of the program execution.
+ * The pass does not change the control-flow graph, so it shares the one of the pass manager. It runs
+ * once, before the other passes, which then see values instead of memory.
  *
- * @param argc The number of arguments passed to the program.
- * @param argv An array of strings containing the arguments passed to the program.
- * @return An integer value indicating the success or failure of the program execution.
+ * @param passes The pass manager, which holds the control-flow graph and the dominator tree and
+ * records the changes.
+ * @return true if any alloca was promoted, false otherwise.
  */
-int main(int argc, char **argv)
+static bool
+promoteAllocasToRegisters(PassManager &passes)
 {
-	// Check the number of arguments
-	if (argc != 2)
+	const ControlFlowGraph &cfg = passes.controlFlowGraph();
+	const DominatorTree &dominators = passes.dominatorTree();
+	if (cfg.numReachable() == 0)
+	{
+		return false;
+	}
+
+	SSARenaming renaming;
+	for (auto instruction = LLVMGetFirstInstruction(cfg.block(0));
+		 instruction;
+		 instruction = LLVMGetNextInstruction(instruction))
+	{
+		if (LLVMIsAAllocaInst(instruction) && isPromotableAlloca(instruction))
+		{
+			renaming.numbers[instruction] = renaming.variables.size();
+			renaming.variables.push_back(instruction);
+		}
+	}
+	if (renaming.variables.empty())
 	{
-		cout << "Usage: " << argv[0] << " <filename.ll>" << endl;
-		return 1;
+		return false;
 	}
 
-	// Create LLVM module from IR file
-	LLVMModuleRef mod = createLLVMModel(argv[1]);
+	// Each variable gets phis and a zero of its own type: the allocas may hold integers of any width
+	{
+		unique_lock<mutex> lock = passes.lockContext();
+		for (LLVMValueRef variable : renaming.variables)
+		{
+			renaming.zeros.push_back(LLVMConstInt(LLVMGetAllocatedType(variable), 0, 0));
+		}
+	}
+	renaming.currentValues.assign(renaming.variables.size(), NULL);
+	renaming.phis.resize(cfg.size());
 
-	// Check if module is valid
-	if (mod == NULL)
+	// The blocks that store to each variable
+	vector<vector<unsigned>> definingBlocks(renaming.variables.size());
+	for (unsigned block = 0; block < cfg.size(); block++)
 	{
-		cout << "Error: Invalid LLVM IR file" << endl;
-		return 2;
+		for (auto instruction = LLVMGetFirstInstruction(cfg.block(block));
+			 instruction;
+			 instruction = LLVMGetNextInstruction(instruction))
+		{
+			if (!LLVMIsAStoreInst(instruction))
+			{
+				continue;
+			}
+			auto variable = renaming.numbers.find(LLVMGetOperand(instruction, 1));
+			if (variable != renaming.numbers.end() &&
+				(definingBlocks[variable->second].empty() || definingBlocks[variable->second].back() != block))
+			{
+				definingBlocks[variable->second].push_back(block);
+			}
+		}
 	}
 
-	// Optimize the program
-	optimizeProgram(mod);
+	// Place the phis of each variable at the iterated dominance frontier of its definitions
+	vector<vector<unsigned>> frontiers = dominators.dominanceFrontiers(cfg);
+	LLVMBuilderRef builder = LLVMCreateBuilderInContext(LLVMGetTypeContext(LLVMTypeOf(renaming.zeros[0])));
+	vector<unsigned> hasPhi(cfg.size(), 0); // <block, number + 1 of the last variable given a phi in it>
+	vector<unsigned> queued(cfg.size(), 0);	// <block, number + 1 of the last variable that queued it>
+	for (unsigned variable = 0; variable < renaming.variables.size(); variable++)
+	{
+		vector<unsigned> worklist(definingBlocks[variable]);
+		for (unsigned block : worklist)
+		{
+			queued[block] = variable + 1;
+		}
+		LLVMTypeRef type = LLVMGetAllocatedType(renaming.variables[variable]);
+		size_t nameLength;
+		const char *name = LLVMGetValueName2(renaming.variables[variable], &nameLength);
+		while (!worklist.empty())
+		{
+			unsigned block = worklist.back();
+			worklist.pop_back();
+			for (unsigned frontier : frontiers[block])
+			{
+				if (hasPhi[frontier] == variable + 1)
+				{
+					continue;
+				}
+				hasPhi[frontier] = variable + 1;
+				LLVMPositionBuilderBefore(builder, LLVMGetFirstInstruction(cfg.block(frontier)));
+				renaming.phis[frontier].push_back({LLVMBuildPhi(builder, type, name), variable});
+				if (queued[frontier] != variable + 1)
+				{
+					queued[frontier] = variable + 1;
+					worklist.push_back(frontier);
+				}
+			}
+		}
+	}
+	LLVMDisposeBuilder(builder);
 
-	// Create a string to store the output filename
-	std::string outputFilename;
+	renameDominatorTree(passes, cfg.reversePostorder()[0], renaming);
 
-	// Append `_opt` to the basename of the input file and save it in outputFilename
-	changeFileExtension(argv[1], outputFilename, "_opt.ll");
+	// The unreachable blocks are not in the dominator tree: nothing they store is ever read
+	for (unsigned position = cfg.numReachable(); position < cfg.size(); position++)
+	{
+		unsigned block = cfg.reversePostorder()[position];
+		fill(renaming.currentValues.begin(), renaming.currentValues.end(), (LLVMValueRef)NULL);
+		for (auto instruction = LLVMGetFirstInstruction(cfg.block(block));
+			 instruction;
+			 instruction = LLVMGetNextInstruction(instruction))
+		{
+			bool isLoad = LLVMIsALoadInst(instruction) != NULL;
+			if (!isLoad && !LLVMIsAStoreInst(instruction))
+			{
+				continue;
+			}
+			auto variable = renaming.numbers.find(LLVMGetOperand(instruction, isLoad ? 0 : 1));
+			if (variable != renaming.numbers.end())
+			{
+				if (isLoad)
+				{
+					passes.replaceAllUsesWith(instruction, renaming.zeros[variable->second]);
+				}
+				renaming.toDelete.push_back(instruction);
+			}
+		}
+		addIncomingValues(passes, block, renaming);
+	}
 
-	// Writes the LLVM IR to a file named "test.ll"
-	LLVMPrintModuleToFile(mod, outputFilename.c_str(), NULL);
+	deleteMarkedInstructions(passes, renaming.toDelete);
+	removeDeadPhis(passes, renaming);
+	removeTrivialPhis(passes, renaming);
+	for (LLVMValueRef variable : renaming.variables)
+	{
+		passes.remark("SSA construction", "allocas promoted", variable);
+	}
+	deleteMarkedInstructions(passes, renaming.variables);
 
-	return 0;
+#ifdef DEBUG
+	debugPrintf("\nPromoted %zu allocas to SSA values\n", renaming.variables.size());
+#endif
+	return true;
+}
+
+/**
+ * @brief Gives every loop of the function a preheader: a block that branches to the header of the
+ * loop and nowhere else, and is the only way into it. The frontend already enters a `while` loop
+ * from a block of its own, so a block is only inserted for a loop that is entered from several
+ * blocks or from a conditional branch. The edges into the header from outside of the loop are
+ * redirected to the new block, which merges the incoming values of the phis of the header.
+ *
+ * It changes the control-flow graph, so it runs before the pass manager builds it.
+ *
+ * @param function The function whose loops get a preheader.
+ * @param contextMutex The mutex of the LLVM context if other threads optimize its functions, NULL otherwise.
+ * @param report The report of the function, or NULL if the optimization report is disabled.
+ * @return true if any block was inserted, false otherwise.
+ */
+static bool
+insertLoopPreheaders(LLVMValueRef function, mutex *contextMutex, FunctionReport *report)
+{
+	ControlFlowGraph cfg(function);
+	DominatorTree dominators(cfg);
+	NaturalLoops loops(cfg, dominators);
+	LLVMContextRef context = LLVMGetModuleContext(LLVMGetGlobalParent(function));
+	LLVMBuilderRef builder = LLVMCreateBuilderInContext(context);
+	bool inserted = false;
+
+	for (unsigned index = 0; index < loops.loops().size(); index++)
+	{
+		const NaturalLoop &loop = loops.loops()[index];
+		if (loop.preheader != DominatorTree::NO_BLOCK)
+		{
+			continue;
+		}
+		LLVMBasicBlockRef header = cfg.block(loop.header);
+		vector<LLVMBasicBlockRef> entries;
+		for (unsigned predecessor : cfg.predecessors(loop.header))
+		{
+			if (!loops.contains(index, predecessor))
+			{
+				entries.push_back(cfg.block(predecessor));
+			}
+		}
+		if (entries.empty())
+		{
+			// The header is the entry block of the function
+			continue;
+		}
+
+		LLVMBasicBlockRef preheader = LLVMInsertBasicBlockInContext(context, header, "");
+		LLVMPositionBuilderAtEnd(builder, preheader);
+		LLVMValueRef branch = LLVMBuildBr(builder, header);
+		for (LLVMBasicBlockRef entry : entries)
+		{
+			LLVMValueRef terminator = LLVMGetBasicBlockTerminator(entry);
+			for (unsigned i = 0; i < LLVMGetNumSuccessors(terminator); i++)
+			{
+				if (LLVMGetSuccessor(terminator, i) == header)
+				{
+					LLVMSetSuccessor(terminator, i, preheader);
+				}
+			}
+		}
+
+		// A phi cannot change its incoming blocks: replace each with one whose value from outside
+		// of the loop comes from the preheader
+		unique_lock<mutex> lock = contextMutex ? unique_lock<mutex>(*contextMutex) : unique_lock<mutex>();
+		LLVMValueRef next;
+		for (auto phi = LLVMGetFirstInstruction(header); phi && LLVMIsAPHINode(phi); phi = next)
+		{
+			next = LLVMGetNextInstruction(phi);
+			LLVMTypeRef type = LLVMTypeOf(phi);
+			LLVMPositionBuilderBefore(builder, phi);
+			LLVMValueRef newPhi = LLVMBuildPhi(builder, type, "");
+			vector<LLVMValueRef> outsideValues;
+			vector<LLVMBasicBlockRef> outsideBlocks;
+			for (unsigned i = 0; i < LLVMCountIncoming(phi); i++)
+			{
+				LLVMValueRef value = LLVMGetIncomingValue(phi, i);
+				LLVMBasicBlockRef block = LLVMGetIncomingBlock(phi, i);
+				if (loops.contains(index, cfg.index(block)))
+				{
+					LLVMAddIncoming(newPhi, &value, &block, 1);
+					continue;
+				}
+				outsideValues.push_back(value);
+				outsideBlocks.push_back(block);
+			}
+			LLVMValueRef outsideValue = outsideValues[0];
+			if (count(outsideValues.begin(), outsideValues.end(), outsideValue) != (long)outsideValues.size())
+			{
+				LLVMPositionBuilderBefore(builder, branch);
+				outsideValue = LLVMBuildPhi(builder, type, "");
+				LLVMAddIncoming(outsideValue, outsideValues.data(), outsideBlocks.data(), outsideValues.size());
+			}
+			LLVMAddIncoming(newPhi, &outsideValue, &preheader, 1);
+			size_t nameLength;
+			const char *name = LLVMGetValueName2(phi, &nameLength);
+			string savedName(name, nameLength);
+			LLVMReplaceAllUsesWith(phi, newPhi);
+			LLVMInstructionEraseFromParent(phi);
+			LLVMSetValueName2(newPhi, savedName.c_str(), savedName.size());
+		}
+		if (report)
+		{
+			report->remark("Loop-invariant code motion", "preheaders inserted", blockLabel(preheader),
+						   valueText(branch, false));
+		}
+		inserted = true;
+	}
+
+	LLVMDisposeBuilder(builder);
+	return inserted;
+}
+
+/**
+ * @return The blocks whose terminators branch to a basic block, once for each edge.
+ */
+static vector<LLVMBasicBlockRef>
+getPredecessors(LLVMBasicBlockRef basicBlock)
+{
+	vector<LLVMBasicBlockRef> predecessors;
+	for (auto use = LLVMGetFirstUse(LLVMBasicBlockAsValue(basicBlock)); use; use = LLVMGetNextUse(use))
+	{
+		LLVMValueRef user = LLVMGetUser(use);
+		if (LLVMIsAInstruction(user))
+		{
+			predecessors.push_back(LLVMGetInstructionParent(user));
+		}
+	}
+	return predecessors;
+}
+
+/**
+ * Replaces the incoming value of a phi from a block with the same value from each of a list of
+ * blocks, or removes it if the list is empty. Only the first entry is replaced, when the block
+ * branches to the phi on two edges. A phi cannot change its incoming blocks in place, so a new phi
+ * replaces it; if the incoming values of the phi are then all the same, that value replaces it
+ * instead, and so does undef if it has no incoming values left.
+ *
+ * @param phi The phi to change.
+ * @param from The block whose incoming value is replaced.
+ * @param to The blocks the value comes from instead.
+ */
+static void
+replacePhiIncoming(LLVMValueRef phi, LLVMBasicBlockRef from, const vector<LLVMBasicBlockRef> &to)
+{
+	vector<LLVMValueRef> values;
+	vector<LLVMBasicBlockRef> blocks;
+	bool replaced = false;
+	for (unsigned i = 0; i < LLVMCountIncoming(phi); i++)
+	{
+		LLVMValueRef value = LLVMGetIncomingValue(phi, i);
+		LLVMBasicBlockRef block = LLVMGetIncomingBlock(phi, i);
+		if (block == from && !replaced)
+		{
+			replaced = true;
+			values.insert(values.end(), to.size(), value);
+			blocks.insert(blocks.end(), to.begin(), to.end());
+			continue;
+		}
+		values.push_back(value);
+		blocks.push_back(block);
+	}
+	if (!replaced)
+	{
+		return;
+	}
+
+	LLVMValueRef replacement = NULL;
+	for (LLVMValueRef value : values)
+	{
+		if (value == phi || value == replacement)
+		{
+			continue;
+		}
+		replacement = replacement ? phi : value;
+	}
+	if (replacement == phi)
+	{
+		// Not all the same: a new phi
+		LLVMBuilderRef builder = LLVMCreateBuilderInContext(LLVMGetTypeContext(LLVMTypeOf(phi)));
+		LLVMPositionBuilderBefore(builder, phi);
+		replacement = LLVMBuildPhi(builder, LLVMTypeOf(phi), "");
+		LLVMAddIncoming(replacement, values.data(), blocks.data(), values.size());
+		LLVMDisposeBuilder(builder);
+	}
+	else if (!replacement)
+	{
+		replacement = LLVMGetUndef(LLVMTypeOf(phi));
+	}
+
+	size_t nameLength;
+	const char *name = LLVMGetValueName2(phi, &nameLength);
+	string savedName(name, nameLength);
+	LLVMReplaceAllUsesWith(phi, replacement);
+	LLVMInstructionEraseFromParent(phi);
+	if (LLVMIsAPHINode(replacement))
+	{
+		LLVMSetValueName2(replacement, savedName.c_str(), savedName.size());
+	}
+}
+
+/**
+ * Applies replacePhiIncoming to every phi of a basic block.
+ */
+static void
+replacePhiIncomingOfBlock(LLVMBasicBlockRef basicBlock, LLVMBasicBlockRef from, const vector<LLVMBasicBlockRef> &to)
+{
+	LLVMValueRef next;
+	for (auto phi = LLVMGetFirstInstruction(basicBlock); phi && LLVMIsAPHINode(phi); phi = next)
+	{
+		next = LLVMGetNextInstruction(phi);
+		replacePhiIncoming(phi, from, to);
+	}
+}
+
+/**
+ * Replaces a conditional branch with an unconditional one if its condition is a constant (as
+ * constant folding leaves `if (1 < 2)`) or both its targets are the same block; the successor it
+ * no longer branches to loses its incoming values from the block.
+ *
+ * @return true if any branch was folded, false otherwise.
+ */
+static bool
+foldConstantBranches(LLVMValueRef function, LLVMBuilderRef builder, FunctionReport *report)
+{
+	bool changed = false;
+	for (auto basicBlock = LLVMGetFirstBasicBlock(function); basicBlock; basicBlock = LLVMGetNextBasicBlock(basicBlock))
+	{
+		LLVMValueRef branch = LLVMGetBasicBlockTerminator(basicBlock);
+		if (!branch || !LLVMIsABranchInst(branch) || !LLVMIsConditional(branch))
+		{
+			continue;
+		}
+		LLVMValueRef condition = LLVMGetCondition(branch);
+		LLVMBasicBlockRef trueBlock = LLVMGetSuccessor(branch, 0);
+		LLVMBasicBlockRef falseBlock = LLVMGetSuccessor(branch, 1);
+		if (!LLVMIsAConstantInt(condition) && trueBlock != falseBlock)
+		{
+			continue;
+		}
+		if (report)
+		{
+			report->remark("CFG simplification", "branches folded", blockLabel(basicBlock), valueText(branch, false));
+		}
+		bool taken = trueBlock == falseBlock || LLVMConstIntGetZExtValue(condition);
+		LLVMBasicBlockRef target = taken ? trueBlock : falseBlock;
+		replacePhiIncomingOfBlock(taken ? falseBlock : trueBlock, basicBlock, {});
+
+		LLVMPositionBuilderBefore(builder, branch);
+		LLVMBuildBr(builder, target);
+		LLVMInstructionEraseFromParent(branch);
+		changed = true;
+	}
+	return changed;
+}
+
+/**
+ * Deletes the blocks that cannot be reached from the entry block. The values they define are only
+ * used in unreachable blocks, or by phis on the edges out of them, which are removed first.
+ *
+ * @return true if any block was deleted, false otherwise.
+ */
+static bool
+removeUnreachableBlocks(LLVMValueRef function, FunctionReport *report)
+{
+	unordered_set<LLVMBasicBlockRef> reachable;
+	vector<LLVMBasicBlockRef> worklist = {LLVMGetEntryBasicBlock(function)};
+	reachable.insert(worklist[0]);
+	while (!worklist.empty())
+	{
+		LLVMValueRef terminator = LLVMGetBasicBlockTerminator(worklist.back());
+		worklist.pop_back();
+		for (unsigned i = 0; terminator && i < LLVMGetNumSuccessors(terminator); i++)
+		{
+			LLVMBasicBlockRef successor = LLVMGetSuccessor(terminator, i);
+			if (reachable.insert(successor).second)
+			{
+				worklist.push_back(successor);
+			}
+		}
+	}
+
+	vector<LLVMBasicBlockRef> unreachable;
+	for (auto basicBlock = LLVMGetFirstBasicBlock(function); basicBlock; basicBlock = LLVMGetNextBasicBlock(basicBlock))
+	{
+		if (!reachable.count(basicBlock))
+		{
+			if (report)
+			{
+				report->remark("CFG simplification", "blocks removed", blockLabel(basicBlock), "unreachable");
+			}
+			unreachable.push_back(basicBlock);
+		}
+	}
+	for (LLVMBasicBlockRef basicBlock : unreachable)
+	{
+		LLVMValueRef terminator = LLVMGetBasicBlockTerminator(basicBlock);
+		for (unsigned i = 0; terminator && i < LLVMGetNumSuccessors(terminator); i++)
+		{
+			if (reachable.count(LLVMGetSuccessor(terminator, i)))
+			{
+				replacePhiIncomingOfBlock(LLVMGetSuccessor(terminator, i), basicBlock, {});
+			}
+		}
+	}
+	for (LLVMBasicBlockRef basicBlock : unreachable)
+	{
+		for (auto instruction = LLVMGetFirstInstruction(basicBlock);
+			 instruction;
+			 instruction = LLVMGetNextInstruction(instruction))
+		{
+			if (hasUses(instruction))
+			{
+				LLVMReplaceAllUsesWith(instruction, LLVMGetUndef(LLVMTypeOf(instruction)));
+			}
+		}
+	}
+	for (LLVMBasicBlockRef basicBlock : unreachable)
+	{
+		LLVMDeleteBasicBlock(basicBlock);
+	}
+	return !unreachable.empty();
+}
+
+/**
+ * Merges each block that only branches to a block with no other predecessor into that block: the
+ * instructions of the predecessor move to the start of the successor, the phis of which have only
+ * one incoming value left, and the branches to the predecessor now go to the successor. Merging
+ * into the successor keeps the phis of the blocks after it as they are.
+ *
+ * @return true if any blocks were merged, false otherwise.
+ */
+static bool
+mergeBlocks(LLVMValueRef function, LLVMBuilderRef builder, FunctionReport *report)
+{
+	bool changed = false;
+	LLVMBasicBlockRef next;
+	for (auto basicBlock = LLVMGetFirstBasicBlock(function); basicBlock; basicBlock = next)
+	{
+		next = LLVMGetNextBasicBlock(basicBlock);
+		if (basicBlock == LLVMGetEntryBasicBlock(function))
+		{
+			continue;
+		}
+		vector<LLVMBasicBlockRef> predecessors = getPredecessors(basicBlock);
+		if (predecessors.size() != 1 || predecessors[0] == basicBlock)
+		{
+			continue;
+		}
+		LLVMBasicBlockRef predecessor = predecessors[0];
+		LLVMValueRef branch = LLVMGetBasicBlockTerminator(predecessor);
+		if (LLVMGetNumSuccessors(branch) != 1)
+		{
+			continue;
+		}
+
+		if (report)
+		{
+			report->remark("CFG simplification", "blocks merged", blockLabel(predecessor),
+						   "merged into " + blockLabel(basicBlock));
+		}
+		replacePhiIncomingOfBlock(basicBlock, predecessor, {});
+		if (predecessor == LLVMGetEntryBasicBlock(function))
+		{
+			LLVMMoveBasicBlockBefore(basicBlock, predecessor);
+		}
+		LLVMPositionBuilderBefore(builder, LLVMGetFirstInstruction(basicBlock));
+		LLVMValueRef nextInstruction;
+		for (auto instruction = LLVMGetFirstInstruction(predecessor); instruction != branch; instruction = nextInstruction)
+		{
+			nextInstruction = LLVMGetNextInstruction(instruction);
+			size_t nameLength;
+			const char *name = LLVMGetValueName2(instruction, &nameLength);
+			string savedName(name, nameLength);
+			LLVMInstructionRemoveFromParent(instruction);
+			LLVMInsertIntoBuilderWithName(builder, instruction, savedName.c_str());
+		}
+		LLVMReplaceAllUsesWith(LLVMBasicBlockAsValue(predecessor), LLVMBasicBlockAsValue(basicBlock));
+		if (next == predecessor)
+		{
+			next = LLVMGetNextBasicBlock(predecessor);
+		}
+		LLVMDeleteBasicBlock(predecessor);
+		changed = true;
+	}
+	return changed;
+}
+
+/**
+ * Redirects the branches to a block that only holds an unconditional branch to the target of that
+ * branch, which leaves the empty block unreachable. The phis of the target then take the value
+ * they took from the empty block from each of its predecessors, unless one of them already
+ * branches to the target. The preheader of a loop is kept, for loop-invariant code motion.
+ *
+ * @param loopHeaders The headers of the loops of the function.
+ * @param report The report of the function, or NULL if the optimization report is disabled.
+ * @return true if any branch was redirected, false otherwise.
+ */
+static bool
+threadJumps(LLVMValueRef function, const unordered_set<LLVMBasicBlockRef> &loopHeaders, FunctionReport *report)
+{
+	bool changed = false;
+	for (auto basicBlock = LLVMGetFirstBasicBlock(function); basicBlock; basicBlock = LLVMGetNextBasicBlock(basicBlock))
+	{
+		LLVMValueRef branch = LLVMGetFirstInstruction(basicBlock);
+		if (basicBlock == LLVMGetEntryBasicBlock(function) || !LLVMIsABranchInst(branch) || LLVMIsConditional(branch))
+		{
+			continue;
+		}
+		LLVMBasicBlockRef target = LLVMGetSuccessor(branch, 0);
+		vector<LLVMBasicBlockRef> predecessors = getPredecessors(basicBlock);
+		if (target == basicBlock || predecessors.empty() || loopHeaders.count(target))
+		{
+			continue;
+		}
+		if (LLVMIsAPHINode(LLVMGetFirstInstruction(target)))
+		{
+			vector<LLVMBasicBlockRef> targetPredecessors = getPredecessors(target);
+			bool sharedPredecessor = false;
+			for (LLVMBasicBlockRef predecessor : predecessors)
+			{
+				sharedPredecessor = sharedPredecessor ||
+									find(targetPredecessors.begin(), targetPredecessors.end(), predecessor) !=
+										targetPredecessors.end();
+			}
+			if (sharedPredecessor)
+			{
+				continue;
+			}
+			replacePhiIncomingOfBlock(target, basicBlock, predecessors);
+		}
+		if (report)
+		{
+			report->remark("CFG simplification", "jumps threaded", blockLabel(basicBlock), valueText(branch, false));
+		}
+		LLVMReplaceAllUsesWith(LLVMBasicBlockAsValue(basicBlock), LLVMBasicBlockAsValue(target));
+		changed = true;
+	}
+	return changed;
+}
+
+/**
+ * @brief Simplifies the control-flow graph of a function until nothing changes: folds constant
+ * conditional branches, deletes unreachable blocks, merges blocks into their single predecessor,
+ * and threads jumps through empty blocks.
+ *
+ * It changes the control-flow graph, so it runs between the rounds of the other passes, each of
+ * which starts with a new pass manager. Nearly every step changes the uses of constants (the
+ * conditions of branches, the incoming values of phis), so it holds the context lock throughout.
+ *
+ * @param function The function to simplify.
+ * @param contextMutex The mutex of the LLVM context if other threads optimize its functions, NULL otherwise.
+ * @param report The report of the function, or NULL if the optimization report is disabled.
+ * @return true if anything changed, false otherwise.
+ */
+static bool
+simplifyControlFlow(LLVMValueRef function, mutex *contextMutex, FunctionReport *report)
+{
+	unique_lock<mutex> lock = contextMutex ? unique_lock<mutex>(*contextMutex) : unique_lock<mutex>();
+	LLVMBuilderRef builder = LLVMCreateBuilderInContext(LLVMGetModuleContext(LLVMGetGlobalParent(function)));
+
+	// None of the steps creates a loop
+	unordered_set<LLVMBasicBlockRef> loopHeaders;
+	{
+		ControlFlowGraph cfg(function);
+		DominatorTree dominators(cfg);
+		NaturalLoops loops(cfg, dominators);
+		for (const NaturalLoop &loop : loops.loops())
+		{
+			loopHeaders.insert(cfg.block(loop.header));
+		}
+	}
+
+	bool changed = false;
+	bool progress = true;
+	while (progress)
+	{
+		progress = foldConstantBranches(function, builder, report);
+		progress = removeUnreachableBlocks(function, report) || progress;
+		progress = mergeBlocks(function, builder, report) || progress;
+		progress = threadJumps(function, loopHeaders, report) || progress;
+		changed = changed || progress;
+	}
+
+	LLVMDisposeBuilder(builder);
+#ifdef DEBUG
+	debugPrintf("\nCFG simplification: %d\n", changed);
+	debugPrintf("______________________________________\n");
+#endif
+	return changed;
+}
+
+/**
+ * Determines whether an instruction of a loop computes the same value on every iteration, so that
+ * it can run once in the preheader instead: an arithmetic or icmp instruction, or a load from a
+ * variable that no store in the loop writes, whose operands are all computed outside of the loop.
+ * None of these can trap or write memory, so they can also be hoisted from the blocks that do not
+ * run on every iteration. Calls cannot write the variable either, as its address never escapes.
+ *
+ * @param instruction The instruction to check.
+ * @param loops The loops of the function.
+ * @param loop The index of the loop of the instruction.
+ * @param cfg The control-flow graph of the function.
+ * @param storedPointers The pointers that the stores of the loop write to.
+ * @return true if the instruction can be hoisted to the preheader, false otherwise.
+ */
+static bool
+isLoopInvariant(LLVMValueRef instruction, const NaturalLoops &loops, unsigned loop, const ControlFlowGraph &cfg,
+				const unordered_set<LLVMValueRef> &storedPointers)
+{
+	if (LLVMIsALoadInst(instruction))
+	{
+		LLVMValueRef pointer = LLVMGetOperand(instruction, 0);
+		if (!LLVMIsAAllocaInst(pointer) || !isPromotableAlloca(pointer) || storedPointers.count(pointer))
+		{
+			return false;
+		}
+	}
+	else if (!isArithmeticOrIcmpOperation(instruction))
+	{
+		return false;
+	}
+
+	int numberOfOperands = LLVMGetNumOperands(instruction);
+	for (int i = 0; i < numberOfOperands; i++)
+	{
+		LLVMValueRef operand = LLVMGetOperand(instruction, i);
+		if (LLVMIsAInstruction(operand) && loops.contains(loop, cfg.index(LLVMGetInstructionParent(operand))))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @return The outermost of the loops from `loop` out to `limit` that an instruction invariant in
+ * `loop` is invariant in too. An instruction invariant in a loop is invariant in the loops nested
+ * in it, so the instruction can be hoisted straight out of all of them.
+ */
+static unsigned
+outermostInvariantLoop(LLVMValueRef instruction, const NaturalLoops &loops, unsigned loop, unsigned limit,
+					   const ControlFlowGraph &cfg, const vector<unordered_set<LLVMValueRef>> &storedPointers)
+{
+	if (limit == loop || isLoopInvariant(instruction, loops, limit, cfg, storedPointers[limit]))
+	{
+		return limit;
+	}
+	unsigned parent = loops.loops()[loop].parent;
+	while (isLoopInvariant(instruction, loops, parent, cfg, storedPointers[parent]))
+	{
+		loop = parent;
+		parent = loops.loops()[loop].parent;
+	}
+	return loop;
+}
+
+/**
+ * @brief Performs loop-invariant code motion: moves the loop-invariant instructions of every loop
+ * to its preheader.
+ *
+ * The loops are visited from the innermost out, and an instruction invariant in a loop is hoisted
+ * at once out of the loops around it that it is invariant in too, as far as they have preheaders,
+ * so it only moves once. A loop only scans its own blocks, those of none of its inner loops: what
+ * an inner loop kept after it was visited depends on a value or a store of the inner loop, so it is
+ * not invariant in the outer loop either. The blocks of an inner loop without a preheader, which
+ * cannot be visited, are scanned with the loop around it instead. The stores of each block are
+ * also only gathered once, and the pointers they write to are passed on to the loops around it, so
+ * a deep loop nest costs linear time. The blocks of a loop are visited in reverse postorder, so an
+ * instruction is only checked once the operands it depends on have been hoisted.
+ *
+ * @param passes The pass manager, which holds the loops and records the changes.
+ * @return true if any instruction was hoisted, false otherwise.
+ */
+static bool
+loopInvariantCodeMotion(PassManager &passes)
+{
+	const ControlFlowGraph &cfg = passes.controlFlowGraph();
+	const NaturalLoops &loops = passes.naturalLoops();
+	const vector<NaturalLoop> &loopList = loops.loops();
+	bool codeChanged = false;
+
+	vector<unsigned> positions(cfg.size()); // <block, its position in reverse postorder>
+	for (unsigned position = 0; position < cfg.numReachable(); position++)
+	{
+		positions[cfg.reversePostorder()[position]] = position;
+	}
+
+	// A loop writes what the loops nested in it write. Every loop comes before the loops it is in.
+	vector<unordered_set<LLVMValueRef>> storedPointers(loopList.size()); // <loop, the pointers its stores write to>
+	for (unsigned index = 0; index < loopList.size(); index++)
+	{
+		unordered_set<LLVMValueRef> &stored = storedPointers[index];
+		for (unsigned block : loopList[index].ownBlocks)
+		{
+			for (auto instruction = LLVMGetFirstInstruction(cfg.block(block));
+				 instruction;
+				 instruction = LLVMGetNextInstruction(instruction))
+			{
+				if (LLVMIsAStoreInst(instruction))
+				{
+					stored.insert(LLVMGetOperand(instruction, 1));
+				}
+			}
+		}
+		if (loopList[index].parent != NaturalLoops::NO_LOOP)
+		{
+			storedPointers[loopList[index].parent].insert(stored.begin(), stored.end());
+		}
+	}
+
+	// <loop, the outermost loop around it reached through loops that all have a preheader, or itself>
+	vector<unsigned> hoistLimits(loopList.size());
+	for (unsigned index = loopList.size(); index-- > 0;)
+	{
+		unsigned parent = loopList[index].parent;
+		bool throughParent = parent != NaturalLoops::NO_LOOP && loopList[parent].preheader != DominatorTree::NO_BLOCK;
+		hoistLimits[index] = throughParent ? hoistLimits[parent] : index;
+	}
+
+	vector<vector<unsigned>> scannedBlocks(loopList.size()); // <loop, the blocks it scans>
+	for (unsigned index = 0; index < loopList.size(); index++)
+	{
+		const NaturalLoop &loop = loopList[index];
+		vector<unsigned> &blocks = scannedBlocks[index];
+		bool inherited = !blocks.empty();
+		blocks.insert(blocks.end(), loop.ownBlocks.begin(), loop.ownBlocks.end());
+		if (inherited)
+		{
+			sort(blocks.begin(), blocks.end(), [&](unsigned a, unsigned b)
+				 { return positions[a] < positions[b]; });
+		}
+
+		if (loop.preheader != DominatorTree::NO_BLOCK)
+		{
+			for (unsigned block : blocks)
+			{
+				LLVMValueRef next;
+				for (auto instruction = LLVMGetFirstInstruction(cfg.block(block)); instruction; instruction = next)
+				{
+					next = LLVMGetNextInstruction(instruction);
+					if (!isLoopInvariant(instruction, loops, index, cfg, storedPointers[index]))
+					{
+						continue;
+					}
+					unsigned outermost =
+						outermostInvariantLoop(instruction, loops, index, hoistLimits[index], cfg, storedPointers);
+					LLVMBasicBlockRef preheader = cfg.block(loopList[outermost].preheader);
+#ifdef DEBUG
+					debugPrintf("\nHoisting loop-invariant instruction:\n");
+					debugDumpValue(instruction);
+					debugPrintf("\n");
+#endif
+					passes.remark("Loop-invariant code motion", "instructions hoisted", instruction,
+								  LLVMBasicBlockAsValue(preheader));
+					passes.moveBeforeTerminator(instruction, preheader);
+					codeChanged = true;
+				}
+			}
+		}
+
+		// The loop around this one scans its blocks if this one could not
+		if (loop.parent != NaturalLoops::NO_LOOP && loop.preheader == DominatorTree::NO_BLOCK)
+		{
+			vector<unsigned> &parentBlocks = scannedBlocks[loop.parent];
+			parentBlocks.insert(parentBlocks.end(), blocks.begin(), blocks.end());
+		}
+		vector<unsigned>().swap(blocks);
+		unordered_set<LLVMValueRef>().swap(storedPointers[index]);
+	}
+	return codeChanged;
+}
+
+/**
+ * The value of an instruction in sparse conditional constant propagation: undefined until the
+ * pass finds that the instruction runs, then one constant for as long as that is all it can be,
+ * then overdefined. A value only ever moves down this lattice.
+ */
+typedef struct LatticeValue
+{
+	enum State
+	{
+		UNDEFINED,
+		CONSTANT,
+		OVERDEFINED
+	} state;
+	long long constant; // sign-extended from the width of the type
+} LatticeValue;
+
+/**
+ * The state of sparse conditional constant propagation: the lattice value of every instruction,
+ * the edges of the control-flow graph that can be taken, and the work left.
+ */
+typedef struct
+{
+	unordered_map<LLVMValueRef, LatticeValue> values;
+	vector<bool> executableBlocks;
+	unordered_set<unsigned long long> executableEdges; // <source * number of blocks + destination>
+	vector<pair<unsigned, unsigned>> edgeWorklist;	   // the edges found executable, not visited yet
+	vector<LLVMValueRef> valueWorklist;				   // the instructions whose value moved down
+} SCCPState;
+
+/**
+ * @return The lattice value of an operand: a constant integer is itself, an instruction has the
+ * value found so far, and anything else (an argument, undef) is overdefined.
+ */
+static LatticeValue
+getLatticeValue(SCCPState &state, LLVMValueRef value)
+{
+	if (LLVMIsAConstantInt(value))
+	{
+		return {LatticeValue::CONSTANT, LLVMConstIntGetSExtValue(value)};
+	}
+	if (LLVMIsAInstruction(value))
+	{
+		auto found = state.values.find(value);
+		return found == state.values.end() ? LatticeValue{LatticeValue::UNDEFINED, 0} : found->second;
+	}
+	return {LatticeValue::OVERDEFINED, 0};
+}
+
+/**
+ * @return The meet of two lattice values: the highest value that is below both.
+ */
+static LatticeValue
+meetLatticeValues(LatticeValue a, LatticeValue b)
+{
+	if (a.state == LatticeValue::UNDEFINED)
+	{
+		return b;
+	}
+	if (b.state == LatticeValue::UNDEFINED)
+	{
+		return a;
+	}
+	if (a.state == LatticeValue::CONSTANT && b.state == LatticeValue::CONSTANT && a.constant == b.constant)
+	{
+		return a;
+	}
+	return {LatticeValue::OVERDEFINED, 0};
+}
+
+/**
+ * @return The low `width` bits of a value, sign-extended to 64 bits.
+ */
+static long long
+signExtend(unsigned long long value, unsigned width)
+{
+	return width >= 64 ? (long long)value : (long long)(value << (64 - width)) >> (64 - width);
+}
+
+/**
+ * @brief Computes the lattice value of an arithmetic or icmp instruction from those of its
+ * operands, with the same wrap-around arithmetic as constant folding.
+ */
+static LatticeValue
+evaluateInstruction(SCCPState &state, LLVMValueRef instruction)
+{
+	LatticeValue a = getLatticeValue(state, LLVMGetOperand(instruction, 0));
+	LatticeValue b = getLatticeValue(state, LLVMGetOperand(instruction, 1));
+	LLVMOpcode op = LLVMGetInstructionOpcode(instruction);
+
+	// Zero times anything is zero
+	if (op == LLVMMul && ((a.state == LatticeValue::CONSTANT && a.constant == 0) ||
+						  (b.state == LatticeValue::CONSTANT && b.constant == 0)))
+	{
+		return {LatticeValue::CONSTANT, 0};
+	}
+	if (a.state == LatticeValue::OVERDEFINED || b.state == LatticeValue::OVERDEFINED)
+	{
+		return {LatticeValue::OVERDEFINED, 0};
+	}
+	if (a.state == LatticeValue::UNDEFINED || b.state == LatticeValue::UNDEFINED)
+	{
+		return {LatticeValue::UNDEFINED, 0};
+	}
+
+	unsigned width = LLVMGetIntTypeWidth(LLVMTypeOf(LLVMGetOperand(instruction, 0)));
+	unsigned long long x = a.constant, y = b.constant;
+	unsigned long long mask = width >= 64 ? ~0ull : (1ull << width) - 1;
+	switch (op)
+	{
+	case LLVMAdd:
+		return {LatticeValue::CONSTANT, signExtend(x + y, width)};
+	case LLVMSub:
+		return {LatticeValue::CONSTANT, signExtend(x - y, width)};
+	case LLVMMul:
+		return {LatticeValue::CONSTANT, signExtend(x * y, width)};
+	case LLVMShl:
+		// Shifting by the width or more is poison, which is no one constant
+		if ((y & mask) >= width)
+		{
+			return {LatticeValue::OVERDEFINED, 0};
+		}
+		return {LatticeValue::CONSTANT, signExtend(x << (y & mask), width)};
+	case LLVMICmp:
+	{
+		bool result;
+		switch (LLVMGetICmpPredicate(instruction))
+		{
+		case LLVMIntEQ:
+			result = (x & mask) == (y & mask);
+			break;
+		case LLVMIntNE:
+			result = (x & mask) != (y & mask);
+			break;
+		case LLVMIntUGT:
+			result = (x & mask) > (y & mask);
+			break;
+		case LLVMIntUGE:
+			result = (x & mask) >= (y & mask);
+			break;
+		case LLVMIntULT:
+			result = (x & mask) < (y & mask);
+			break;
+		case LLVMIntULE:
+			result = (x & mask) <= (y & mask);
+			break;
+		case LLVMIntSGT:
+			result = a.constant > b.constant;
+			break;
+		case LLVMIntSGE:
+			result = a.constant >= b.constant;
+			break;
+		case LLVMIntSLT:
+			result = a.constant < b.constant;
+			break;
+		default:
+			result = a.constant <= b.constant;
+			break;
+		}
+		return {LatticeValue::CONSTANT, result ? -1 : 0};
+	}
+	default:
+		return {LatticeValue::OVERDEFINED, 0};
+	}
+}
+
+/**
+ * @brief Marks an edge of the control-flow graph as executable, and queues it if it was not.
+ */
+static void
+markEdgeExecutable(SCCPState &state, const ControlFlowGraph &cfg, unsigned from, unsigned to)
+{
+	if (state.executableEdges.insert((unsigned long long)from * cfg.size() + to).second)
+	{
+		state.edgeWorklist.push_back({from, to});
+	}
+}
+
+/**
+ * @brief Visits an instruction of an executable block: computes its lattice value again, and
+ * queues it if the value moved down, or marks the edges its block can take if it is the terminator.
+ */
+static void
+visitSCCPInstruction(SCCPState &state, const ControlFlowGraph &cfg, LLVMValueRef instruction)
+{
+	unsigned block = cfg.index(LLVMGetInstructionParent(instruction));
+	if (LLVMIsATerminatorInst(instruction))
+	{
+		const vector<unsigned> &successors = cfg.successors(block);
+		if (LLVMIsABranchInst(instruction) && LLVMIsConditional(instruction))
+		{
+			// A branch on a value that is still undefined takes no edge yet
+			LatticeValue condition = getLatticeValue(state, LLVMGetCondition(instruction));
+			if (condition.state == LatticeValue::CONSTANT)
+			{
+				markEdgeExecutable(state, cfg, block, successors[condition.constant ? 0 : 1]);
+				return;
+			}
+			if (condition.state == LatticeValue::UNDEFINED)
+			{
+				return;
+			}
+		}
+		for (unsigned successor : successors)
+		{
+			markEdgeExecutable(state, cfg, block, successor);
+		}
+		return;
+	}
+	if (LLVMGetTypeKind(LLVMTypeOf(instruction)) != LLVMIntegerTypeKind)
+	{
+		return;
+	}
+
+	LatticeValue value;
+	if (LLVMIsAPHINode(instruction))
+	{
+		// Only the values that come in along executable edges count
+		value = {LatticeValue::UNDEFINED, 0};
+		for (unsigned i = 0; i < LLVMCountIncoming(instruction); i++)
+		{
+			unsigned incomingBlock = cfg.index(LLVMGetIncomingBlock(instruction, i));
+			if (state.executableEdges.count((unsigned long long)incomingBlock * cfg.size() + block))
+			{
+				value = meetLatticeValues(value, getLatticeValue(state, LLVMGetIncomingValue(instruction, i)));
+			}
+		}
+	}
+	else if (isArithmeticOrIcmpOperation(instruction))
+	{
+		value = evaluateInstruction(state, instruction);
+	}
+	else
+	{
+		value = {LatticeValue::OVERDEFINED, 0};
+	}
+
+	LatticeValue &current = state.values[instruction];
+	if (value.state != current.state || value.constant != current.constant)
+	{
+		current = value;
+		state.valueWorklist.push_back(instruction);
+	}
+}
+
+/**
+ * @brief Performs sparse conditional constant propagation (Wegman and Zadeck) on an SSA function.
+ *
+ * Every instruction starts undefined, and only the entry block is executable. Visiting the
+ * instructions of an executable block lowers their values, and the branches mark the edges they
+ * can take: only one for a branch on a constant. A block becomes executable with its first
+ * executable edge, and only the values that come in along executable edges count in a phi, so a
+ * value that is a constant on every path that can run is found to be that constant, even around
+ * loops and past branches that the constants decide. Each instruction is visited again only when
+ * one of its operands or, for a phi, its executable edges change, so the whole function is solved
+ * in one run of the worklists.
+ *
+ * The instructions found to be constants are then replaced by them. Branches on them become
+ * constant branches, which CFG simplification folds, deleting the blocks that cannot run.
+ *
+ * @param passes The pass manager, which holds the control-flow graph and records the changes.
+ * @return true if any instruction was replaced, false otherwise.
+ */
+static bool
+sparseConditionalConstantPropagation(PassManager &passes)
+{
+	const ControlFlowGraph &cfg = passes.controlFlowGraph();
+	if (cfg.numReachable() == 0)
+	{
+		return false;
+	}
+
+	SCCPState state;
+	state.executableBlocks.assign(cfg.size(), false);
+	state.edgeWorklist.push_back({DominatorTree::NO_BLOCK, cfg.reversePostorder()[0]});
+	while (!state.edgeWorklist.empty() || !state.valueWorklist.empty())
+	{
+		while (!state.edgeWorklist.empty())
+		{
+			unsigned block = state.edgeWorklist.back().second;
+			state.edgeWorklist.pop_back();
+
+			// A new edge into a block that already runs only changes its phis
+			bool firstEdge = !state.executableBlocks[block];
+			state.executableBlocks[block] = true;
+			for (auto instruction = LLVMGetFirstInstruction(cfg.block(block));
+				 instruction && (firstEdge || LLVMIsAPHINode(instruction));
+				 instruction = LLVMGetNextInstruction(instruction))
+			{
+				visitSCCPInstruction(state, cfg, instruction);
+			}
+		}
+
+		while (!state.valueWorklist.empty())
+		{
+			LLVMValueRef instruction = state.valueWorklist.back();
+			state.valueWorklist.pop_back();
+			for (auto use = LLVMGetFirstUse(instruction); use; use = LLVMGetNextUse(use))
+			{
+				LLVMValueRef user = LLVMGetUser(use);
+				if (LLVMIsAInstruction(user) && state.executableBlocks[cfg.index(LLVMGetInstructionParent(user))])
+				{
+					visitSCCPInstruction(state, cfg, user);
+				}
+			}
+		}
+	}
+
+	// Replace the constants; the instructions of the blocks that cannot run are left to CFG simplification
+	bool codeChanged = false;
+	for (unsigned block = 0; block < cfg.size(); block++)
+	{
+		if (!state.executableBlocks[block])
+		{
+			continue;
+		}
+		for (auto instruction = LLVMGetFirstInstruction(cfg.block(block));
+			 instruction;
+			 instruction = LLVMGetNextInstruction(instruction))
+		{
+			auto found = state.values.find(instruction);
+			if (found == state.values.end() || found->second.state != LatticeValue::CONSTANT || !hasUses(instruction))
+			{
+				continue;
+			}
+			LLVMValueRef constant;
+			{
+				unique_lock<mutex> lock = passes.lockContext();
+				constant = LLVMConstInt(LLVMTypeOf(instruction), (unsigned long long)found->second.constant, 1);
+			}
+#ifdef DEBUG
+			debugPrintf("\nSCCP replaced instruction:\n");
+			debugDumpValue(instruction);
+			debugPrintf("\nwith constant:\n");
+			debugDumpValue(constant);
+			debugPrintf("\n");
+#endif
+			passes.remark("Sparse conditional constant propagation", "values found constant", instruction, constant);
+			passes.replaceAllUsesWith(instruction, constant);
+			codeChanged = true;
+		}
+	}
+	return codeChanged;
+}
+
+/**
+ * @brief Runs the passes that keep the control-flow graph as it is on a function, until none of
+ * them changes it: constant propagation, dead store elimination, global value numbering,
+ * loop-invariant code motion, constant folding, algebraic simplification, common subexpression
+ * elimination, and dead code elimination. After the first round, each pass only revisits the
+ * basic blocks that changed since it last visited them (see PassManager).
+ *
+ * @param function The LLVM function to be optimized.
+ * @param passes The pass manager of the function, for its current control-flow graph.
+ * @param enabledPasses The OptimizationPass bits of the passes to run.
+ * @param roundsLeft The number of rounds the function may still take, counted down by each round.
+ */
+static void
+runPassRounds(LLVMValueRef function, PassManager &passes, unsigned enabledPasses, unsigned &roundsLeft)
+{
+	bool codeChanged = true;
+
+	// Each pass only visits what changed since it last ran
+	const ControlFlowGraph &cfg = passes.controlFlowGraph();
+	PassManager::PassState deadStores, valueNumbering, loopInvariants, folding, simplification, subexpressions, deadCode;
+	ReachingStoresCache reachingStores;
+
+	while (codeChanged && roundsLeft > 0)
+	{
+		// Reset codeChanged to false before applying optimizations
+		codeChanged = false;
+		roundsLeft--;
+		if (passes.report())
+		{
+			passes.report()->addRound();
+		}
+
+		// perform global optimization; dead store elimination needs the reaching stores even without it
+		if (enabledPasses & (PASS_CONSTANT_PROPAGATION | PASS_DEAD_STORE_ELIMINATION))
+		{
+			passTimer timer(passes.report(), "Constant propagation");
+			codeChanged = constantPropagation(function, passes, reachingStores,
+											  enabledPasses & PASS_CONSTANT_PROPAGATION) ||
+						  codeChanged;
+		}
+#ifdef DEBUG
+		debugPrintf("\nConstant propagation: %d\n", codeChanged);
+		debugPrintf("______________________________________\n");
+#endif
+
+		// The reaching stores that constant propagation just brought up to date
+		if ((enabledPasses & PASS_DEAD_STORE_ELIMINATION) && passes.visitFunction(deadStores))
+		{
+			passTimer timer(passes.report(), "Dead store elimination");
+			codeChanged = deadStoreElimination(passes, reachingStores) || codeChanged;
+		}
+#ifdef DEBUG
+		debugPrintf("\nDead store: %d\n", codeChanged);
+		debugPrintf("______________________________________\n");
+#endif
+
+		if ((enabledPasses & PASS_GLOBAL_VALUE_NUMBERING) && passes.visitFunction(valueNumbering))
+		{
+			passTimer timer(passes.report(), "Global value numbering");
+			codeChanged = globalValueNumbering(passes) || codeChanged;
+		}
+#ifdef DEBUG
+		debugPrintf("\nGlobal value numbering: %d\n", codeChanged);
+		debugPrintf("______________________________________\n");
+#endif
+
+		if ((enabledPasses & PASS_LOOP_INVARIANT_CODE_MOTION) && passes.visitFunction(loopInvariants))
+		{
+			passTimer timer(passes.report(), "Loop-invariant code motion");
+			codeChanged = loopInvariantCodeMotion(passes) || codeChanged;
+		}
+#ifdef DEBUG
+		debugPrintf("\nLoop-invariant code motion: %d\n", codeChanged);
+		debugPrintf("______________________________________\n");
+#endif
+
+		for (unsigned block = 0; block < cfg.size(); block++)
+		{
+			LLVMBasicBlockRef basicBlock = cfg.block(block);
+
+			// call local optimization functions on the blocks that changed since they last ran
+			if ((enabledPasses & PASS_CONSTANT_FOLDING) && passes.visitBlock(folding, block))
+			{
+				passTimer timer(passes.report(), "Constant folding");
+				codeChanged = constantFolding(passes, basicBlock) || codeChanged;
+			}
+#ifdef DEBUG
+			debugPrintf("\nConstant folding: %d\n", codeChanged);
+			debugPrintf("______________________________________\n");
+#endif
+
+			if ((enabledPasses & PASS_ALGEBRAIC_SIMPLIFICATION) && passes.visitBlock(simplification, block))
+			{
+				passTimer timer(passes.report(), "Algebraic simplification");
+				codeChanged = algebraicSimplification(passes, basicBlock) || codeChanged;
+			}
+#ifdef DEBUG
+			debugPrintf("\nAlgebraic simplification: %d\n", codeChanged);
+			debugPrintf("______________________________________\n");
+#endif
+
+			if ((enabledPasses & PASS_COMMON_SUBEXPRESSION_ELIMINATION) && passes.visitBlock(subexpressions, block))
+			{
+				passTimer timer(passes.report(), "Common subexpression elimination");
+				codeChanged = commonSubexpressionElimination(passes, basicBlock) || codeChanged;
+			}
+#ifdef DEBUG
+			debugPrintf("\nCommon expression: %d\n", codeChanged);
+			debugPrintf("______________________________________\n");
+#endif
+		}
+
+		if ((enabledPasses & PASS_DEAD_CODE_ELIMINATION) && passes.visitFunction(deadCode))
+		{
+			passTimer timer(passes.report(), "Dead code elimination");
+			codeChanged = deadCodeElimination(passes) || codeChanged;
+		}
+#ifdef DEBUG
+		debugPrintf("\nDead code: %d\n", codeChanged);
+		debugPrintf("______________________________________\n");
+#endif
+	}
+}
+
+/**
+ * @brief Optimizes a single LLVM function using various optimization techniques.
+ *
+ * This function first gives every loop a preheader and promotes the variables of the function to
+ * SSA values. It then propagates the constants of the SSA values, runs the passes of runPassRounds
+ * until no more changes are made to the function, and simplifies its control-flow graph; if that
+ * changed anything, the passes run again on the new graph, with a new pass manager. Only the passes
+ * of the pipeline run, and the function is left as it is once it has taken the most rounds the
+ * pipeline allows, whether or not the passes reached their fixed point.
+ *
+ * @param function The LLVM function to be optimized.
+ * @param options The passes to run and the round limit.
+ * @param contextMutex The mutex of the LLVM context if other threads optimize its functions, NULL otherwise.
+ * @param report The report of the function, or NULL if the optimization report is disabled.
+ */
+static void
+runFunctionPasses(LLVMValueRef function, const OptimizationOptions &options, mutex *contextMutex,
+				  FunctionReport *report)
+{
+	// A declaration, such as that of print() or read(), has nothing to optimize
+	if (LLVMCountBasicBlocks(function) == 0)
+	{
+		return;
+	}
+
+	// Give the loops preheaders before the pass manager builds the control-flow graph
+	if (options.passes & PASS_LOOP_INVARIANT_CODE_MOTION)
+	{
+		passTimer timer(report, "Loop-invariant code motion");
+		insertLoopPreheaders(function, contextMutex, report);
+	}
+
+	unsigned roundsLeft = options.maxRounds;
+	bool controlFlowChanged = true;
+	for (bool firstRun = true; controlFlowChanged && roundsLeft > 0; firstRun = false)
+	{
+		PassManager passes(function, contextMutex, report);
+
+		// Turn the loads and stores of the variables into values once, so that the passes see them
+		if (firstRun && (options.passes & PASS_SSA_CONSTRUCTION))
+		{
+			passTimer timer(report, "SSA construction");
+			promoteAllocasToRegisters(passes);
+		}
+
+		// Find the constants of the SSA values, and the branches they decide, in one run
+		if (options.passes & PASS_SPARSE_CONDITIONAL_CONSTANT_PROPAGATION)
+		{
+			passTimer timer(report, "Sparse conditional constant propagation");
+			sparseConditionalConstantPropagation(passes);
+		}
+
+		runPassRounds(function, passes, options.passes, roundsLeft);
+
+		if (!(options.passes & PASS_CFG_SIMPLIFICATION))
+		{
+			break;
+		}
+		passTimer timer(report, "CFG simplification");
+		controlFlowChanged = simplifyControlFlow(function, contextMutex, report);
+	}
+}
+
+// The names of the passes in a -passes= list, in the order the optimizer runs them
+static const struct
+{
+	const char *name;
+	OptimizationPass pass;
+} PASS_NAMES[] = {
+	{"mem2reg", PASS_SSA_CONSTRUCTION},
+	{"sccp", PASS_SPARSE_CONDITIONAL_CONSTANT_PROPAGATION},
+	{"constprop", PASS_CONSTANT_PROPAGATION},
+	{"dse", PASS_DEAD_STORE_ELIMINATION},
+	{"gvn", PASS_GLOBAL_VALUE_NUMBERING},
+	{"licm", PASS_LOOP_INVARIANT_CODE_MOTION},
+	{"fold", PASS_CONSTANT_FOLDING},
+	{"simplify", PASS_ALGEBRAIC_SIMPLIFICATION},
+	{"cse", PASS_COMMON_SUBEXPRESSION_ELIMINATION},
+	{"dce", PASS_DEAD_CODE_ELIMINATION},
+	{"simplifycfg", PASS_CFG_SIMPLIFICATION},
+};
+
+OptimizationOptions optimizationLevel(unsigned level)
+{
+	const unsigned localPasses = PASS_CONSTANT_PROPAGATION | PASS_DEAD_STORE_ELIMINATION | PASS_CONSTANT_FOLDING |
+								 PASS_ALGEBRAIC_SIMPLIFICATION | PASS_COMMON_SUBEXPRESSION_ELIMINATION |
+								 PASS_DEAD_CODE_ELIMINATION | PASS_CFG_SIMPLIFICATION;
+	if (level == 0)
+	{
+		return {0, 0};
+	}
+	if (level == 1)
+	{
+		return {localPasses, 2};
+	}
+	return {localPasses | PASS_SSA_CONSTRUCTION | PASS_SPARSE_CONDITIONAL_CONSTANT_PROPAGATION |
+				PASS_GLOBAL_VALUE_NUMBERING | PASS_LOOP_INVARIANT_CODE_MOTION,
+			16};
+}
+
+bool parseOptimizationOption(const char *option, OptimizationOptions &options, bool &valid)
+{
+	if (!strcmp(option, "-O0") || !strcmp(option, "-O1") || !strcmp(option, "-O2"))
+	{
+		options = optimizationLevel(option[2] - '0');
+		return true;
+	}
+	if (!strncmp(option, "-passes=", strlen("-passes=")))
+	{
+		string list(option + strlen("-passes="));
+		unsigned passes = 0;
+		for (size_t start = 0; start < list.size();)
+		{
+			size_t comma = min(list.find(',', start), list.size());
+			string name = list.substr(start, comma - start);
+			bool found = false;
+			for (auto &entry : PASS_NAMES)
+			{
+				if (name == entry.name)
+				{
+					passes |= entry.pass;
+					found = true;
+				}
+			}
+			if (!found)
+			{
+				cerr << "Unknown pass '" << name << "'" << endl;
+				valid = false;
+				return true;
+			}
+			start = comma + 1;
+		}
+		options.passes = passes;
+		return true;
+	}
+	if (!strncmp(option, "-max-rounds=", strlen("-max-rounds=")))
+	{
+		const char *value = option + strlen("-max-rounds=");
+		char *end;
+		long rounds = strtol(value, &end, 10);
+		if (!*value || *end || rounds < 0)
+		{
+			cerr << "Invalid round limit '" << value << "'" << endl;
+			valid = false;
+			return true;
+		}
+		options.maxRounds = rounds;
+		return true;
+	}
+	return false;
+}
+
+string formatOptimizationOptions(const OptimizationOptions &options, const char *dashes)
+{
+	string passes;
+	for (auto &entry : PASS_NAMES)
+	{
+		if (options.passes & entry.pass)
+		{
+			passes += (passes.empty() ? "" : ",") + string(entry.name);
+		}
+	}
+	return string(dashes) + "passes=" + passes + " " + dashes + "max-rounds=" + to_string(options.maxRounds);
+}
+
+/**
+ * @return A report for a function if the optimization report is enabled and the function has a
+ * body, NULL otherwise.
+ */
+static FunctionReport *
+createFunctionReport(LLVMValueRef function)
+{
+	if (!optReportEnabled() || LLVMCountBasicBlocks(function) == 0)
+	{
+		return NULL;
+	}
+	size_t nameLength;
+	const char *name = LLVMGetValueName2(function, &nameLength);
+	return new FunctionReport(string(name, nameLength));
+}
+
+/**
+ * @brief Submits the report of a function, if it has one, to the optimization report.
+ */
+static void
+submitFunctionReport(FunctionReport *report)
+{
+	if (report)
+	{
+		report->submit();
+		delete report;
+	}
+}
+
+/**
+ * @brief Optimizes a single LLVM function, see runFunctionPasses.
+ *
+ * The optimizer keeps no state between functions, so functions of different LLVM contexts can
+ * be optimized on different threads at the same time.
+ *
+ * @param function The LLVM function to be optimized.
+ * @param options The passes to run and the round limit.
+ */
+void optimizeFunction(LLVMValueRef function, const OptimizationOptions &options)
+{
+	FunctionReport *report = createFunctionReport(function);
+	runFunctionPasses(function, options, NULL, report);
+	submitFunctionReport(report);
+}
+
+// The round limit of a function that never ran in the profile
+static const unsigned COLD_FUNCTION_ROUNDS = 1;
+
+/**
+ * @return The pipeline of a function: that of the program, with at most COLD_FUNCTION_ROUNDS
+ * rounds if the profile has counts for the function and it never ran.
+ *
+ * The function is looked up by name alone, and its records of every checksum count. The checksums
+ * are those of the control-flow graphs the backend instrumented, after optimization, so the
+ * optimizer cannot tell whether the function still has the graph it was counted with: a function
+ * that changed since the profile was written is still given the cold budget if none of its runs
+ * ever entered it. Only the backend, which sees the optimized graph, checks the checksum.
+ */
+static OptimizationOptions
+getFunctionOptions(LLVMValueRef function, const OptimizationOptions &options, const BlockProfile *profile)
+{
+	OptimizationOptions functionOptions = options;
+	const char *name = LLVMGetValueName(function);
+	if (profile && profile->hasFunction(name) && profile->entryCount(name) == 0)
+	{
+		functionOptions.maxRounds = min(options.maxRounds, COLD_FUNCTION_ROUNDS);
+	}
+	return functionOptions;
+}
+
+/**
+ * @brief Optimizes the entire program (LLVM module) by optimizing each function within.
+ *
+ * This function iterates through all functions in the provided LLVM module
+ * and optimizes each of them. With more than one thread, the functions are optimized by a pool
+ * of workers, each taking the next function from the queue when it is done with the last, and
+ * sharing only the mutex that guards the constants of the context; each function is optimized
+ * exactly as it would be on its own, so the module is the same as with one thread. With a profile,
+ * the functions that never ran get fewer rounds (see getFunctionOptions).
+ *
+ * @param module The LLVM module representing the program to be optimized.
+ * @param numThreads The number of threads to optimize the functions with.
+ * @param options The passes to run and the round limit.
+ * @param profile The block counts of the runs of the program, or NULL.
+ */
+void optimizeProgram(LLVMModuleRef module, unsigned numThreads, const OptimizationOptions &options,
+					 const BlockProfile *profile)
+{
+	// -O0 leaves the module as it is
+	if (options.passes == 0)
+	{
+		return;
+	}
+
+	// Read the bodies of the functions first if the module was loaded lazily from bitcode,
+	// as the bitcode reader cannot run on several threads
+	vector<LLVMValueRef> functions;
+	for (auto function = LLVMGetFirstFunction(module);
+		 function;
+		 function = LLVMGetNextFunction(function))
+	{
+		if (materializeFunction(function))
+		{
+			functions.push_back(function);
+		}
+	}
+
+	if (numThreads <= 1 || functions.size() <= 1)
+	{
+		for (auto function : functions)
+		{
+#ifdef DEBUG
+			debugPrintf("Function Name: %s\n", LLVMGetValueName(function));
+#endif
+			optimizeFunction(function, getFunctionOptions(function, options, profile));
+		}
+		return;
+	}
+
+	mutex contextMutex;
+	vector<FunctionReport *> reports(functions.size());
+	for (size_t i = 0; i < functions.size(); i++)
+	{
+		reports[i] = createFunctionReport(functions[i]);
+	}
+#ifdef DEBUG
+	// The DEBUG output of each function, printed in the order of the functions once all are done
+	vector<char *> logs(functions.size(), NULL);
+	vector<size_t> logSizes(functions.size(), 0);
+#endif
+	{
+		ThreadPool pool(min<size_t>(numThreads, functions.size()));
+		for (size_t i = 0; i < functions.size(); i++)
+		{
+			pool.submit([&, i] {
+#ifdef DEBUG
+				debugOutput = open_memstream(&logs[i], &logSizes[i]);
+				debugPrintf("Function Name: %s\n", LLVMGetValueName(functions[i]));
+#endif
+				runFunctionPasses(functions[i], getFunctionOptions(functions[i], options, profile), &contextMutex,
+								  reports[i]);
+#ifdef DEBUG
+				fclose(debugOutput);
+				debugOutput = stdout;
+#endif
+			});
+		}
+		pool.wait();
+	}
+
+	// The reports of the functions, in the order of the functions as with one thread
+	for (FunctionReport *report : reports)
+	{
+		submitFunctionReport(report);
+	}
+#ifdef DEBUG
+	for (size_t i = 0; i < functions.size(); i++)
+	{
+		fwrite(logs[i], 1, logSizes[i], stdout);
+		free(logs[i]);
+	}
+#endif
 }
@@ -2,13 +2,21 @@
  * optimizer.h - Header file for the optimizer module
  *
  * This module provides functionality to optimize LLVM IR code by applying
- * various optimization techniques, such as constant propagation, constant folding,
- * common subexpression elimination, and dead code elimination. It provides
- * functions to optimize a single function or the entire program (LLVM module).
+ * various optimization techniques, such as SSA construction, sparse conditional
+ * constant propagation, constant propagation, dead store elimination, loop-invariant
+ * code motion, constant folding, algebraic simplification, common subexpression
+ * elimination, dead code elimination and CFG simplification. It provides functions to
+ * optimize a single function or the entire program (LLVM module).
+ *
+ * Which passes run, and for how many rounds at most, is chosen by an optimization
+ * level (-O0, -O1 or -O2) or a list of passes (-passes=...). With a block profile
+ * (-fprofile-use), the functions that never ran get a single round.
  *
  * Functions:
  *  - optimizeFunction: Optimizes a single LLVM function
  *  - optimizeProgram: Optimizes the entire program (LLVM module)
+ *  - optimizationLevel: The passes and the round limit of an optimization level
+ *  - parseOptimizationOption: Parses the command-line options that choose them
  *
  * Author: Aimen Abdulaziz
  * Date: Spring 2023
@@ -17,28 +25,109 @@
 #ifndef OPTIMIZER_H
 #define OPTIMIZER_H
 
+#include "block_profile.h"
 #include <llvm-c/Core.h>
+#include <string>
+
+// The passes of the optimizer, as bits of OptimizationOptions::passes
+enum OptimizationPass : unsigned
+{
+	PASS_SSA_CONSTRUCTION = 1 << 0,
+	PASS_SPARSE_CONDITIONAL_CONSTANT_PROPAGATION = 1 << 1,
+	PASS_CONSTANT_PROPAGATION = 1 << 2,
+	PASS_DEAD_STORE_ELIMINATION = 1 << 3,
+	PASS_GLOBAL_VALUE_NUMBERING = 1 << 4,
+	PASS_LOOP_INVARIANT_CODE_MOTION = 1 << 5,
+	PASS_CONSTANT_FOLDING = 1 << 6,
+	PASS_ALGEBRAIC_SIMPLIFICATION = 1 << 7,
+	PASS_COMMON_SUBEXPRESSION_ELIMINATION = 1 << 8,
+	PASS_DEAD_CODE_ELIMINATION = 1 << 9,
+	PASS_CFG_SIMPLIFICATION = 1 << 10
+};
+
+// The pipeline of the optimizer
+typedef struct OptimizationOptions
+{
+	unsigned passes;	// the OptimizationPass bits of the passes to run; none skips the optimizer
+	unsigned maxRounds; // the most rounds of the passes on a function before it is left as it is
+} OptimizationOptions;
+
+/**
+ * @brief The pipeline of an optimization level.
+ *
+ * -O0 runs no pass at all. -O1 runs the cheap passes that need no SSA form (constant
+ * propagation, dead store elimination, constant folding, algebraic simplification, common
+ * subexpression elimination, dead code elimination and CFG simplification) for two rounds at
+ * most. -O2, the default, adds SSA construction, sparse conditional constant propagation, global
+ * value numbering and loop-invariant code motion, for up to 16 rounds.
+ *
+ * @param level 0, 1 or 2; higher levels are -O2.
+ * @return The passes and the round limit of the level.
+ */
+OptimizationOptions optimizationLevel(unsigned level);
+
+/**
+ * @brief Parses an option that chooses the optimization pipeline: `-O0`, `-O1` or `-O2`;
+ * `-passes=<list>` with a comma-separated list of pass names (mem2reg, sccp, constprop, dse, gvn,
+ * licm, fold, simplify, cse, dce and simplifycfg), which replaces the passes of the level; or
+ * `-max-rounds=<n>`, which replaces its round limit.
+ *
+ * @param option A command-line argument.
+ * @param options The pipeline, updated if the argument is a valid option.
+ * @param valid Set to false, with a message on stderr, if the argument is the option but its
+ * value is not valid.
+ * @return true if the argument is one of the options.
+ */
+bool parseOptimizationOption(const char *option, OptimizationOptions &options, bool &valid);
+
+/**
+ * @brief Writes a pipeline as the options that choose it, `-passes=<list> -max-rounds=<n>`, for
+ * the keys of the compilation cache and the requests to the compile server.
+ *
+ * @param options The pipeline.
+ * @param dashes The prefix of each option, such as "-".
+ * @return The options, separated by a space.
+ */
+std::string formatOptimizationOptions(const OptimizationOptions &options, const char *dashes);
 
 /**
  * @brief Optimizes a single LLVM function using various optimization techniques.
  *
- * This function performs multiple optimizations on the given LLVM function, including
- * constant propagation, constant folding, common subexpression elimination, and
- * dead code elimination. Optimizations are applied iteratively until no more changes
- * are made to the function.
+ * This function promotes the variables of the given LLVM function to SSA values (phi nodes
+ * included), and then performs multiple optimizations on it, including constant propagation,
+ * constant folding, common subexpression elimination, and dead code elimination. Optimizations
+ * are applied iteratively until no more changes are made to the function, or until the round
+ * limit of the options is reached.
+ *
+ * The optimizer keeps no state between functions, so functions of different LLVM contexts can
+ * be optimized on different threads at the same time.
+ *
+ * Once the optimization report is enabled (see opt_report.h), the runs, time and changes of
+ * every pass on the function are added to it.
  *
  * @param function The LLVM function to be optimized.
+ * @param options The passes to run and the round limit.
  */
-void optimizeFunction(LLVMValueRef function);
+void optimizeFunction(LLVMValueRef function, const OptimizationOptions &options = optimizationLevel(2));
 
 /**
  * @brief Optimizes the entire program (LLVM module) by optimizing each function within.
  *
  * This function iterates through all functions in the provided LLVM module
- * and optimizes each of them by calling the optimizeFunction function.
+ * and optimizes each of them. With more than one thread, the functions are spread across a pool
+ * of worker threads; the optimized module is the same as with one thread.
+ *
+ * With a profile, a function that the profile has counts for but that never ran is optimized for
+ * a single round, as its time is better spent on the others. The functions that ran are optimized
+ * as they were for the instrumented build, so that their control-flow graphs still match their
+ * counts in the code generator.
  *
  * @param module The LLVM module representing the program to be optimized.
+ * @param numThreads The number of threads to optimize the functions with.
+ * @param options The passes to run and the round limit.
+ * @param profile The block counts of the runs of the program (-fprofile-use), or NULL.
  */
-void optimizeProgram(LLVMModuleRef module);
+void optimizeProgram(LLVMModuleRef module, unsigned numThreads = 1,
+					 const OptimizationOptions &options = optimizationLevel(2), const BlockProfile *profile = NULL);
 
 #endif // OPTIMIZER_H
@@ -0,0 +1,154 @@
+/*
+ * optimizer_main.cpp
+ *
+ * Entry point of the standalone optimizer executable: reads an LLVM IR file,
+ * optimizes it with optimizeProgram, and writes the result next to the input.
+ * The optimizer itself lives in optimizer.cpp so that the minicc driver can
+ * link it and optimize its module in memory.
+ *
+ * Usage: ./optimizer [-O0|-O1|-O2] [-passes=<list>] [-max-rounds=<n>] [-ftime-report[=json]]
+ *                    [-fopt-report[=json]] [-j[<threads>]] [-fprofile-use[=<file>]] <input-file>
+ *        -O0 leaves the IR as it is, -O1 runs the passes that need no SSA form for at most 2 rounds,
+ *        and -O2 (the default) runs every pass for at most 16 rounds
+ *        -passes runs only the comma-separated passes of <list> (mem2reg, sccp, constprop, dse, gvn,
+ *        licm, fold, simplify, cse, dce, simplifycfg), and -max-rounds caps the rounds of each function
+ *        -ftime-report prints the time, allocations and peak memory of each phase to stderr
+ *        -fopt-report prints the changes, runs and time of each pass, and the rounds of each function, to stderr;
+ *        -fopt-report=json also prints a remark for every change
+ *        -j optimizes the functions of the module on <threads> threads (one per hardware thread by default)
+ *        -fprofile-use gives a single round to the functions that never ran in a block profile
+ *        (minicc.profile by default, see block_profile.h)
+ *
+ * Output: The optimized LLVM IR code is save to a file named <basename>_opt.ll in the same directory
+ * 		   as the input file (<basename>_opt.bc if the input is a bitcode file)
+ *
+ * Author: Aimen Abdulaziz
+ * Date: Spring 2023
+ */
+
+#include "optimizer.h"
+#include "file_utils.h"
+#include "time_report.h"
+#include "opt_report.h"
+#include "thread_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+using namespace std;
+
+/**
+ * @brief The main function of the program.
+ *
+ * This function is the entry point of the program and is called when the program is executed.
+ * It takes command line arguments as input and typically returns an integer value indicating
+ * the success or failure of the program execution.
+ *
+ * @param argc The number of arguments passed to the program.
+ * @param argv An array of strings containing the arguments passed to the program.
+ * @return An integer value indicating the success or failure of the program execution.
+ */
+int main(int argc, char **argv)
+{
+	// The options (the pipeline, -ftime-report[=json], -fopt-report[=json], -j[<threads>] and -fprofile-use) come before the
+	// input file
+	bool timeReportJSON = false;
+	bool optReportJSON = false;
+	OptimizationOptions options = optimizationLevel(2);
+	unsigned numThreads = 1;
+	ProfileOptions profileOptions = {false, NULL};
+	BlockProfile profile;
+	int first = 1;
+	for (; first < argc - 1; first++)
+	{
+		bool valid = true;
+		if (parseOptimizationOption(argv[first], options, valid))
+		{
+			if (!valid)
+			{
+				return 1;
+			}
+		}
+		else if (parseTimeReportOption(argv[first], timeReportJSON) || parseOptReportOption(argv[first], optReportJSON))
+		{
+			continue;
+		}
+		else if (parseProfileOption(argv[first], profileOptions, profile, valid))
+		{
+			if (!valid)
+			{
+				return 1;
+			}
+			// The optimizer does not instrument anything; the code generator does
+			if (profileOptions.instrument)
+			{
+				cout << "-fprofile-generate is an option of the code generator" << endl;
+				return 1;
+			}
+		}
+		else if (!strncmp(argv[first], "-j", 2))
+		{
+			numThreads = argv[first][2] ? atoi(argv[first] + 2) : ThreadPool::hardwareThreads();
+			if (numThreads == 0)
+			{
+				cout << "Invalid thread count '" << argv[first] << "'" << endl;
+				return 1;
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	// Check the number of arguments
+	if (argc != first + 1)
+	{
+		cout << "Usage: " << argv[0] << " [-O0|-O1|-O2] [-passes=<list>] [-max-rounds=<n>]"
+			 << " [-ftime-report[=json]] [-fopt-report[=json]] [-j[<threads>]] [-fprofile-use[=<file>]]"
+			 << " <filename.ll|filename.bc>" << endl;
+		return 1;
+	}
+	char *filename = argv[first];
+
+	// Create LLVM module from IR file, in a context owned by this compilation
+	LLVMContextRef context = LLVMContextCreate();
+	LLVMModuleRef mod = createLLVMModel(filename, context);
+
+	int exitCode = 0;
+	if (mod == NULL)
+	{
+		// The module is not valid
+		cout << "Error: Invalid LLVM IR file" << endl;
+		exitCode = 2;
+	}
+	else
+	{
+		// Optimize the program
+		optimizeProgram(mod, numThreads, options, profileOptions.profile);
+
+		// Create a string to store the output filename
+		std::string outputFilename;
+
+		// Append `_opt` to the basename of the input file and save it in outputFilename,
+		// in the same format (textual IR or bitcode) as the input
+		changeFileExtension(filename, outputFilename, isBitcodeFile(filename) ? "_opt.bc" : "_opt.ll");
+
+		// Writes the LLVM IR to a file named "test.ll"
+		if (!saveLLVMModel(mod, outputFilename.c_str()))
+		{
+			exitCode = 2;
+		}
+		LLVMDisposeModule(mod);
+	}
+	LLVMContextDispose(context);
+
+	if (optReportEnabled())
+	{
+		printOptReport(cerr, optReportJSON);
+	}
+	if (timeReportEnabled())
+	{
+		printTimeReport(cerr, timeReportJSON);
+	}
+	return exitCode;
+}
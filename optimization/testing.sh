@@ -14,9 +14,26 @@ dir=../tests/optimization
 SRC=./optimizer
 
 # Loop through each file and run it with miniC.out
-for i in {1..6}; do
+for i in {1..8}; do
     echo "Running test$i.ll"
     echo
     $SRC "$dir/test$i.ll"
     echo "----------------------------------------"
 done
+
+# Bitcode inputs must be optimized exactly like textual IR, and written back as bitcode
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m' # No Color
+for i in {1..8}; do
+    echo "Running test$i.bc"
+    llvm-as-15 "$dir/test$i.ll" -o "$dir/test$i.bc"
+    $SRC "$dir/test$i.bc" > /dev/null
+    if diff <(tail -n +3 "$dir/test${i}_opt.ll") <(llvm-dis-15 "$dir/test${i}_opt.bc" -o - | tail -n +3) > /dev/null; then
+        echo -e "${GREEN}Test passed: test$i.bc${NC}"
+    else
+        echo -e "${RED}Test failed: test$i.bc${NC}"
+    fi
+    rm -f "$dir/test$i.bc" "$dir/test${i}_opt.bc"
+    echo "----------------------------------------"
+done
@@ -0,0 +1,45 @@
+extern int read();
+extern void print(int);
+
+int func(int n)
+{
+	int k;
+	int i;
+	int j;
+	int s;
+	int c;
+	int t;
+	k = read();
+	i = 0;
+	s = 0;
+	c = 0;
+
+	while (i < n)
+	{
+		t = k * 4;
+		s = s + t;
+		if (k > n)
+		{
+			c = c + 1;
+		}
+		i = i + 1;
+	}
+	print(c);
+	print(s);
+
+	i = 0;
+	while (i < 3)
+	{
+		j = 0;
+		while (j < n)
+		{
+			t = n - 1;
+			s = s + t;
+			t = i * k;
+			s = s + t;
+			j = j + 1;
+		}
+		i = i + 1;
+	}
+	return s;
+}
@@ -0,0 +1,40 @@
+extern int read();
+extern void print(int);
+
+int func(int n)
+{
+	int x;
+	int y;
+	int z;
+	int i;
+	x = read();
+	i = 0;
+	z = 0;
+
+	while (i < n)
+	{
+		y = x + 3;
+		y = y + 4;
+		y = y - 2;
+		z = z + y;
+		y = i * 8;
+		z = z + y;
+		y = 3 * i;
+		z = z + y;
+		y = z * 1;
+		y = y + 0;
+		z = y - i;
+		i = i + 1;
+	}
+	print(z);
+
+	y = x - x;
+	if (x == x)
+	{
+		y = y + 5;
+	}
+	y = y * 0;
+	z = z + y;
+	y = x * 9;
+	return z + y;
+}
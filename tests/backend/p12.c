@@ -0,0 +1,40 @@
+extern int read();
+extern void print(int);
+
+int func(int n)
+{
+	int a;
+	int b;
+	int c;
+	int d;
+	a = 1;
+	b = 0;
+	c = read();
+	d = 0;
+
+	while (b < n)
+	{
+		if (a == 1)
+		{
+			d = d + c;
+		}
+		else
+		{
+			a = a + 1;
+			d = 100;
+		}
+		b = b + 1;
+	}
+	print(a);
+
+	c = a * 7;
+	if (c > 5)
+	{
+		d = d + c;
+	}
+	else
+	{
+		d = d - c;
+	}
+	return d;
+}
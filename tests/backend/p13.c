@@ -0,0 +1,41 @@
+extern int read();
+extern void print(int);
+
+int func(int n)
+{
+	int a;
+	int b;
+	int c;
+	int d;
+	int e;
+	int i;
+	int s;
+	int t;
+	a = read();
+	b = a + 3;
+	c = a * 5;
+	d = b - 7;
+	e = c + d;
+	i = 0;
+	s = 0;
+
+	while (i < n)
+	{
+		s = s + a;
+		t = b * i;
+		s = s + t;
+		if (s > 1000)
+		{
+			s = s - c;
+		}
+		d = d + e;
+		e = e + 1;
+		i = i + 1;
+	}
+	print(d);
+	print(e);
+
+	s = s + a;
+	s = s + b;
+	return s + c;
+}
@@ -0,0 +1,26 @@
+extern int read();
+extern void print(int);
+
+int func(int n)
+{
+	int i;
+	int s;
+	i = 0;
+	s = 0;
+
+	while (i < n)
+	{
+		s = s + 1000;
+		if (i < n)
+		{
+			s = s + 3;
+		}
+		else
+		{
+			s = s - 100;
+		}
+		i = i + 1;
+	}
+
+	return s;
+}
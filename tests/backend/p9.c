@@ -0,0 +1,37 @@
+extern int read();
+extern void print(int);
+
+int func(int n)
+{
+	int a;
+	int b;
+	int t;
+	int i;
+	a = 1;
+	b = 2;
+	i = 0;
+
+	while (i < n)
+	{
+		t = a;
+		a = b;
+		b = t;
+		if (i < 3)
+		{
+			a = a + i;
+		}
+		i = i + 1;
+	}
+
+	print(a);
+	print(b);
+	if (n > 3)
+	{
+		t = a * b;
+	}
+	else
+	{
+		t = a - b;
+	}
+	return t;
+}
@@ -5,18 +5,9 @@ target triple = "x86_64-pc-linux-gnu"
 
 ; Function Attrs: noinline nounwind optnone uwtable
 define dso_local i32 @func(i32 noundef %0) #0 {
-  %2 = alloca i32, align 4
-  %3 = alloca i32, align 4
-  %4 = alloca i32, align 4
-  store i32 %0, i32* %2, align 4
-  %5 = load i32, i32* %2, align 4
-  %6 = mul nsw i32 %5, 10
-  store i32 %6, i32* %3, align 4
-  store i32 %6, i32* %4, align 4
-  %7 = load i32, i32* %3, align 4
-  %8 = load i32, i32* %4, align 4
-  %9 = add nsw i32 %7, %8
-  ret i32 %9
+  %2 = mul nsw i32 %0, 10
+  %3 = add nsw i32 %2, %2
+  ret i32 %3
 }
 
 attributes #0 = { noinline nounwind optnone uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
@@ -5,21 +5,9 @@ target triple = "x86_64-pc-linux-gnu"
 
 ; Function Attrs: noinline nounwind optnone uwtable
 define dso_local i32 @func(i32 noundef %0, i32 noundef %1) #0 {
-  %3 = alloca i32, align 4
-  %4 = alloca i32, align 4
-  %5 = alloca i32, align 4
-  %6 = alloca i32, align 4
-  store i32 %0, i32* %3, align 4
-  store i32 %1, i32* %4, align 4
-  %7 = load i32, i32* %3, align 4
-  %8 = load i32, i32* %4, align 4
-  %9 = mul nsw i32 %7, %8
-  store i32 %9, i32* %5, align 4
-  store i32 %9, i32* %6, align 4
-  %10 = load i32, i32* %5, align 4
-  %11 = load i32, i32* %6, align 4
-  %12 = add nsw i32 %10, %11
-  ret i32 %12
+  %3 = mul nsw i32 %0, %1
+  %4 = add nsw i32 %3, %3
+  ret i32 %4
 }
 
 attributes #0 = { noinline nounwind optnone uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
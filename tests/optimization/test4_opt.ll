@@ -5,12 +5,6 @@ target triple = "x86_64-pc-linux-gnu"
 
 ; Function Attrs: noinline nounwind optnone uwtable
 define dso_local i32 @func() #0 {
-  %1 = alloca i32, align 4
-  %2 = alloca i32, align 4
-  %3 = alloca i32, align 4
-  store i32 10, i32* %1, align 4
-  store i32 20, i32* %2, align 4
-  store i32 30, i32* %3, align 4
   ret i32 30
 }
 
@@ -5,21 +5,9 @@ target triple = "x86_64-pc-linux-gnu"
 
 ; Function Attrs: noinline nounwind optnone uwtable
 define dso_local i32 @func(i32 noundef %0) #0 {
-  %2 = alloca i32, align 4
-  %3 = alloca i32, align 4
-  %4 = alloca i32, align 4
-  %5 = alloca i32, align 4
-  store i32 %0, i32* %2, align 4
-  %6 = load i32, i32* %2, align 4
-  %7 = mul nsw i32 %6, 10
-  store i32 %7, i32* %3, align 4
-  store i32 %7, i32* %4, align 4
-  %8 = load i32, i32* %4, align 4
-  %9 = mul nsw i32 %6, %8
-  store i32 %9, i32* %5, align 4
-  %10 = load i32, i32* %3, align 4
-  %11 = add nsw i32 %10, %8
-  ret i32 %11
+  %2 = mul nsw i32 %0, 10
+  %3 = add nsw i32 %2, %2
+  ret i32 %3
 }
 
 attributes #0 = { noinline nounwind optnone uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
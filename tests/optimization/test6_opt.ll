@@ -5,52 +5,19 @@ target triple = "x86_64-pc-linux-gnu"
 
 ; Function Attrs: noinline nounwind optnone uwtable
 define dso_local i32 @func(i32 noundef %0) #0 {
-  %2 = alloca i32, align 4
-  %3 = alloca i32, align 4
-  %4 = alloca i32, align 4
-  %5 = alloca i32, align 4
-  %6 = alloca i32, align 4
-  %7 = alloca i32, align 4
-  store i32 %0, ptr %3, align 4
-  store i32 10, ptr %6, align 4
-  %8 = load i32, ptr %3, align 4
-  %9 = add nsw i32 %8, 10
-  store i32 %9, ptr %4, align 4
-  store i32 %9, ptr %5, align 4
-  store i32 20, ptr %7, align 4
-  store i32 10, ptr %4, align 4
-  br label %10
+  br label %2
 
-10:                                               ; preds = %13, %1
-  %11 = load i32, ptr %3, align 4
-  %12 = icmp slt i32 %11, 100
-  br i1 %12, label %13, label %18
+2:                                                ; preds = %5, %1
+  %3 = phi i32 [ %0, %1 ], [ %6, %5 ]
+  %4 = icmp slt i32 %3, 100
+  br i1 %4, label %5, label %7
 
-13:                                               ; preds = %10
-  %14 = load i32, ptr %3, align 4
-  %15 = add nsw i32 %14, 5
-  store i32 %15, ptr %3, align 4
-  %16 = load i32, ptr %6, align 4
-  %17 = add nsw i32 %16, 10
-  store i32 %17, ptr %6, align 4
-  store i32 20, ptr %7, align 4
-  br label %10, !llvm.loop !6
+5:                                                ; preds = %2
+  %6 = add nsw i32 %3, 5
+  br label %2, !llvm.loop !6
 
-18:                                               ; preds = %10
-  br i1 false, label %19, label %21
-
-19:                                               ; preds = %18
-  %20 = load i32, ptr %6, align 4
-  store i32 %20, ptr %2, align 4
-  br label %22
-
-21:                                               ; preds = %18
-  store i32 100, ptr %2, align 4
-  br label %22
-
-22:                                               ; preds = %21, %19
-  %23 = load i32, ptr %2, align 4
-  ret i32 %23
+7:                                                ; preds = %2
+  ret i32 100
 }
 
 attributes #0 = { noinline nounwind optnone uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
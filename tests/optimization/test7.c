@@ -0,0 +1,13 @@
+//Global value numbering
+int func(int n){
+	int i, s;
+
+	i = 0;
+	s = 0;
+	while (i < n*2){
+		s = s + n*2;
+		i = i + 1;
+	}
+
+	return(s);
+}
@@ -0,0 +1,51 @@
+; ModuleID = 'test7.c'
+source_filename = "test7.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; Function Attrs: noinline nounwind optnone uwtable
+define dso_local i32 @func(i32 noundef %0) #0 {
+  %2 = alloca i32, align 4
+  %3 = alloca i32, align 4
+  %4 = alloca i32, align 4
+  store i32 %0, i32* %2, align 4
+  store i32 0, i32* %3, align 4
+  store i32 0, i32* %4, align 4
+  br label %5
+
+5:                                                ; preds = %10, %1
+  %6 = load i32, i32* %3, align 4
+  %7 = load i32, i32* %2, align 4
+  %8 = mul nsw i32 %7, 2
+  %9 = icmp slt i32 %6, %8
+  br i1 %9, label %10, label %17
+
+10:                                               ; preds = %5
+  %11 = load i32, i32* %4, align 4
+  %12 = load i32, i32* %2, align 4
+  %13 = mul nsw i32 %12, 2
+  %14 = add nsw i32 %11, %13
+  store i32 %14, i32* %4, align 4
+  %15 = load i32, i32* %3, align 4
+  %16 = add nsw i32 %15, 1
+  store i32 %16, i32* %3, align 4
+  br label %5, !llvm.loop !6
+
+17:                                               ; preds = %5
+  %18 = load i32, i32* %4, align 4
+  ret i32 %18
+}
+
+attributes #0 = { noinline nounwind optnone uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
+
+!llvm.module.flags = !{!0, !1, !2, !3, !4}
+!llvm.ident = !{!5}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{i32 7, !"PIC Level", i32 2}
+!2 = !{i32 7, !"PIE Level", i32 2}
+!3 = !{i32 7, !"uwtable", i32 1}
+!4 = !{i32 7, !"frame-pointer", i32 2}
+!5 = !{!"Ubuntu clang version 14.0.0-1ubuntu1"}
+!6 = distinct !{!6, !7}
+!7 = !{!"llvm.loop.mustprogress"}
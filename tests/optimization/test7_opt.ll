@@ -0,0 +1,38 @@
+; ModuleID = '../tests/optimization/test7.ll'
+source_filename = "test7.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; Function Attrs: noinline nounwind optnone uwtable
+define dso_local i32 @func(i32 noundef %0) #0 {
+  %2 = shl i32 %0, 1
+  br label %3
+
+3:                                                ; preds = %7, %1
+  %4 = phi i32 [ 0, %1 ], [ %8, %7 ]
+  %5 = phi i32 [ 0, %1 ], [ %9, %7 ]
+  %6 = icmp slt i32 %5, %2
+  br i1 %6, label %7, label %10
+
+7:                                                ; preds = %3
+  %8 = add nsw i32 %4, %2
+  %9 = add nsw i32 %5, 1
+  br label %3, !llvm.loop !6
+
+10:                                               ; preds = %3
+  ret i32 %4
+}
+
+attributes #0 = { noinline nounwind optnone uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
+
+!llvm.module.flags = !{!0, !1, !2, !3, !4}
+!llvm.ident = !{!5}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{i32 7, !"PIC Level", i32 2}
+!2 = !{i32 7, !"PIE Level", i32 2}
+!3 = !{i32 7, !"uwtable", i32 1}
+!4 = !{i32 7, !"frame-pointer", i32 2}
+!5 = !{!"Ubuntu clang version 14.0.0-1ubuntu1"}
+!6 = distinct !{!6, !7}
+!7 = !{!"llvm.loop.mustprogress"}
@@ -0,0 +1,38 @@
+; ModuleID = 'test8.ll'
+source_filename = "test8.ll"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; Store-to-load forwarding: the load of @g in %5 is replaced by %2, which the only store that
+; reaches it writes and which dominates it. The load of @h in the loop is kept: the store that
+; reaches it around the loop writes a value computed after it.
+@g = dso_local global i32 0, align 4
+@h = dso_local global i32 0, align 4
+
+define dso_local i32 @func(i32 noundef %0) {
+  %2 = add nsw i32 %0, 3
+  store i32 %2, i32* @g, align 4
+  %3 = icmp sgt i32 %0, 0
+  br i1 %3, label %4, label %5
+
+4:                                                ; preds = %1
+  call void @print(i32 noundef %0)
+  br label %5
+
+5:                                                ; preds = %4, %1
+  %6 = load i32, i32* @g, align 4
+  br label %7
+
+7:                                                ; preds = %7, %5
+  %8 = load i32, i32* @h, align 4
+  %9 = add nsw i32 %8, 1
+  store i32 %9, i32* @h, align 4
+  %10 = icmp slt i32 %9, 10
+  br i1 %10, label %7, label %11
+
+11:                                               ; preds = %7
+  %12 = add nsw i32 %6, %8
+  ret i32 %12
+}
+
+declare void @print(i32 noundef)
@@ -0,0 +1,34 @@
+; ModuleID = '../tests/optimization/test8.ll'
+source_filename = "test8.ll"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+@g = dso_local global i32 0, align 4
+@h = dso_local global i32 0, align 4
+
+define dso_local i32 @func(i32 noundef %0) {
+  %2 = add nsw i32 %0, 3
+  store i32 %2, i32* @g, align 4
+  %3 = icmp sgt i32 %0, 0
+  br i1 %3, label %4, label %5
+
+4:                                                ; preds = %1
+  call void @print(i32 noundef %0)
+  br label %5
+
+5:                                                ; preds = %4, %1
+  br label %6
+
+6:                                                ; preds = %6, %5
+  %7 = load i32, i32* @h, align 4
+  %8 = add nsw i32 %7, 1
+  store i32 %8, i32* @h, align 4
+  %9 = icmp slt i32 %8, 10
+  br i1 %9, label %6, label %10
+
+10:                                               ; preds = %6
+  %11 = add nsw i32 %2, %7
+  ret i32 %11
+}
+
+declare void @print(i32 noundef)